@@ -207,33 +207,17 @@ std::string decompress(const std::string& compressed_str) {
 }
 
 void compress_file(const std::string& from_path, const std::string& to_path) {
-  // Create a temporary file first and once the copy has succeeded, move it to the target file.
-  // This should prevent half-finished copies if the process is terminated prematurely (e.g.
-  // CTRL+C).
-  const auto base_path = file::get_dir_part(to_path);
-  auto tmp_file = file::tmp_file_t(base_path, ".tmp");
-
-  // Compress the source file and write it to the temporary file.
+  // Compress the source file and write it atomically to the target file (via a scratch file). This
+  // should prevent half-finished files if the process is terminated prematurely (e.g. CTRL+C).
   // TODO(m): Do buffered/streaming compression.
-  file::write(compress(file::read(from_path)), tmp_file.path());
-
-  // Move the temporary file to its target name.
-  file::move(tmp_file.path(), to_path);
+  file::write_atomic(compress(file::read(from_path)), to_path);
 }
 
 void decompress_file(const std::string& from_path, const std::string& to_path) {
-  // Create a temporary file first and once the copy has succeeded, move it to the target file.
-  // This should prevent half-finished copies if the process is terminated prematurely (e.g.
-  // CTRL+C).
-  const auto base_path = file::get_dir_part(to_path);
-  auto tmp_file = file::tmp_file_t(base_path, ".tmp");
-
-  // Decompress the source file and write it to the temporary file.
+  // Decompress the source file and write it atomically to the target file (via a scratch file). This
+  // should prevent half-finished files if the process is terminated prematurely (e.g. CTRL+C).
   // TODO(m): Do buffered/streaming decompression.
-  file::write(decompress(file::read(from_path)), tmp_file.path());
-
-  // Move the temporary file to its target name.
-  file::move(tmp_file.path(), to_path);
+  file::write_atomic(decompress(file::read(from_path)), to_path);
 }
 
 }  // namespace comp
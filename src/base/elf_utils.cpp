@@ -0,0 +1,213 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <base/elf_utils.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace bcache {
+namespace elf {
+namespace {
+// ELF constants.
+const uint8_t ELFCLASS32 = 1;
+const uint8_t ELFCLASS64 = 2;
+const uint8_t ELFDATA2LSB = 1;
+const uint8_t ELFDATA2MSB = 2;
+const uint32_t PT_NOTE = 4;
+const uint32_t NT_GNU_BUILD_ID = 3;
+
+// Upper limits for sanity checking (protects against corrupt or malicious files).
+const uint32_t MAX_PROGRAM_HEADERS = 1024;
+const uint64_t MAX_NOTE_SEGMENT_SIZE = 65536;
+
+#ifndef _WIN32
+class scoped_fd_t {
+public:
+  explicit scoped_fd_t(const int fd) : m_fd(fd) {
+  }
+
+  ~scoped_fd_t() {
+    if (m_fd != -1) {
+      close(m_fd);
+    }
+  }
+
+  int fd() const {
+    return m_fd;
+  }
+
+private:
+  const int m_fd;
+};
+
+bool read_at(const int fd, void* buf, const size_t count, const uint64_t offset) {
+  auto* ptr = reinterpret_cast<char*>(buf);
+  size_t total = 0;
+  while (total < count) {
+    const auto n = pread(fd, ptr + total, count - total, static_cast<off_t>(offset + total));
+    if (n <= 0) {
+      return false;
+    }
+    total += static_cast<size_t>(n);
+  }
+  return true;
+}
+#endif
+
+class reader_t {
+public:
+  explicit reader_t(const bool big_endian) : m_big_endian(big_endian) {
+  }
+
+  uint16_t u16(const uint8_t* p) const {
+    return m_big_endian ? static_cast<uint16_t>((p[0] << 8) | p[1])
+                        : static_cast<uint16_t>(p[0] | (p[1] << 8));
+  }
+
+  uint32_t u32(const uint8_t* p) const {
+    return m_big_endian ? ((static_cast<uint32_t>(u16(p)) << 16) | u16(p + 2))
+                        : (u16(p) | (static_cast<uint32_t>(u16(p + 2)) << 16));
+  }
+
+  uint64_t u64(const uint8_t* p) const {
+    return m_big_endian ? ((static_cast<uint64_t>(u32(p)) << 32) | u32(p + 4))
+                        : (u32(p) | (static_cast<uint64_t>(u32(p + 4)) << 32));
+  }
+
+private:
+  const bool m_big_endian;
+};
+
+uint64_t align_up(const uint64_t x, const uint64_t alignment) {
+  return (x + alignment - 1) & ~(alignment - 1);
+}
+
+std::string to_hex(const uint8_t* data, const size_t size) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  std::string result(size * 2, '0');
+  for (size_t i = 0; i < size; ++i) {
+    result[2 * i] = HEX_DIGITS[data[i] >> 4];
+    result[2 * i + 1] = HEX_DIGITS[data[i] & 15];
+  }
+  return result;
+}
+
+std::string find_build_id_note(const std::vector<uint8_t>& notes,
+                               const uint64_t alignment,
+                               const reader_t& reader) {
+  uint64_t pos = 0;
+  while (pos + 12 <= notes.size()) {
+    const auto name_size = reader.u32(&notes[pos]);
+    const auto desc_size = reader.u32(&notes[pos + 4]);
+    const auto type = reader.u32(&notes[pos + 8]);
+    const auto name_pos = pos + 12;
+    const auto desc_pos = name_pos + align_up(name_size, alignment);
+    const auto next_pos = desc_pos + align_up(desc_size, alignment);
+    if (desc_pos + desc_size > notes.size()) {
+      break;
+    }
+    if (type == NT_GNU_BUILD_ID && name_size == 4 && desc_size > 0 &&
+        std::memcmp(&notes[name_pos], "GNU", 4) == 0) {
+      return to_hex(&notes[desc_pos], desc_size);
+    }
+    pos = next_pos;
+  }
+  return std::string();
+}
+}  // namespace
+
+std::string get_build_id(const std::string& path) {
+#ifdef _WIN32
+  // ELF executables are not used on Windows.
+  (void)path;
+  return std::string();
+#else
+  scoped_fd_t file(open(path.c_str(), O_RDONLY));
+  if (file.fd() == -1) {
+    return std::string();
+  }
+
+  // Read and check the ELF header (the 64-bit header is larger than the 32-bit header).
+  uint8_t header[64];
+  if (!read_at(file.fd(), header, 52, 0)) {
+    return std::string();
+  }
+  if (header[0] != 0x7f || header[1] != 'E' || header[2] != 'L' || header[3] != 'F') {
+    return std::string();
+  }
+  const auto elf_class = header[4];
+  const auto elf_data = header[5];
+  if ((elf_class != ELFCLASS32 && elf_class != ELFCLASS64) ||
+      (elf_data != ELFDATA2LSB && elf_data != ELFDATA2MSB)) {
+    return std::string();
+  }
+  const bool is_64bit = (elf_class == ELFCLASS64);
+  if (is_64bit && !read_at(file.fd(), &header[52], 12, 52)) {
+    return std::string();
+  }
+  const reader_t reader(elf_data == ELFDATA2MSB);
+
+  // Locate the program header table.
+  const auto ph_offset = is_64bit ? reader.u64(&header[32]) : reader.u32(&header[28]);
+  const auto ph_entry_size = reader.u16(&header[is_64bit ? 54 : 42]);
+  const auto ph_count = reader.u16(&header[is_64bit ? 56 : 44]);
+  const auto min_entry_size = is_64bit ? 56u : 32u;
+  if (ph_offset == 0 || ph_count == 0 || ph_count > MAX_PROGRAM_HEADERS ||
+      ph_entry_size < min_entry_size) {
+    return std::string();
+  }
+  std::vector<uint8_t> ph_table(static_cast<size_t>(ph_entry_size) * ph_count);
+  if (!read_at(file.fd(), ph_table.data(), ph_table.size(), ph_offset)) {
+    return std::string();
+  }
+
+  // Scan all PT_NOTE segments for a GNU build ID note.
+  for (uint32_t i = 0; i < ph_count; ++i) {
+    const auto* ph = &ph_table[static_cast<size_t>(i) * ph_entry_size];
+    if (reader.u32(ph) != PT_NOTE) {
+      continue;
+    }
+    const auto offset = is_64bit ? reader.u64(ph + 8) : reader.u32(ph + 4);
+    const auto size = is_64bit ? reader.u64(ph + 32) : reader.u32(ph + 16);
+    const auto align = is_64bit ? reader.u64(ph + 48) : reader.u32(ph + 28);
+    if (size == 0 || size > MAX_NOTE_SEGMENT_SIZE) {
+      continue;
+    }
+    std::vector<uint8_t> notes(static_cast<size_t>(size));
+    if (!read_at(file.fd(), notes.data(), notes.size(), offset)) {
+      continue;
+    }
+    const auto build_id = find_build_id_note(notes, align == 8 ? 8 : 4, reader);
+    if (!build_id.empty()) {
+      return build_id;
+    }
+  }
+
+  return std::string();
+#endif
+}
+}  // namespace elf
+}  // namespace bcache
@@ -0,0 +1,39 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef BUILDCACHE_ELF_UTILS_HPP_
+#define BUILDCACHE_ELF_UTILS_HPP_
+
+#include <string>
+
+namespace bcache {
+namespace elf {
+/// @brief Get the build ID of an ELF executable.
+///
+/// The build ID is a unique identifier that is embedded by the linker (e.g. using the --build-id
+/// option) in a note section of the binary. It is read using a few small reads of the file
+/// headers, which is much cheaper than hashing the entire file or running the program.
+/// @param path Path to the executable file.
+/// @returns the build ID as a hexadecimal string, or an empty string if the file is not an ELF file
+/// or if it does not contain a build ID.
+std::string get_build_id(const std::string& path);
+}  // namespace elf
+}  // namespace bcache
+
+#endif  // BUILDCACHE_ELF_UTILS_HPP_
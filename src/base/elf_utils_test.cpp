@@ -0,0 +1,116 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <base/elf_utils.hpp>
+#include <base/file_utils.hpp>
+
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <string>
+
+// Workaround for macOS build errors.
+// See: https://github.com/onqtam/doctest/issues/126
+#include <iostream>
+
+using namespace bcache;
+
+namespace {
+void put_u16(std::string& data, const size_t pos, const uint16_t x) {
+  data[pos] = static_cast<char>(x & 255);
+  data[pos + 1] = static_cast<char>(x >> 8);
+}
+
+void put_u32(std::string& data, const size_t pos, const uint32_t x) {
+  put_u16(data, pos, static_cast<uint16_t>(x & 65535));
+  put_u16(data, pos + 2, static_cast<uint16_t>(x >> 16));
+}
+
+void put_u64(std::string& data, const size_t pos, const uint64_t x) {
+  put_u32(data, pos, static_cast<uint32_t>(x & 0xffffffffu));
+  put_u32(data, pos + 4, static_cast<uint32_t>(x >> 32));
+}
+
+// Create a minimal 64-bit little endian ELF file with a single PT_NOTE segment.
+std::string make_elf64(const uint32_t note_type, const std::string& note_name) {
+  const size_t ph_offset = 64;
+  const size_t note_offset = ph_offset + 56;
+  const std::string build_id("\x01\x23\x45\x67\x89\xab\xcd\xef", 8);
+
+  std::string data(note_offset + 12 + 4 + build_id.size(), '\0');
+  data[0] = 0x7f;
+  data[1] = 'E';
+  data[2] = 'L';
+  data[3] = 'F';
+  data[4] = 2;  // ELFCLASS64
+  data[5] = 1;  // ELFDATA2LSB
+  put_u64(data, 32, ph_offset);
+  put_u16(data, 54, 56);  // e_phentsize
+  put_u16(data, 56, 1);   // e_phnum
+
+  // Program header.
+  put_u32(data, ph_offset, 4);  // PT_NOTE
+  put_u64(data, ph_offset + 8, note_offset);
+  put_u64(data, ph_offset + 32, data.size() - note_offset);
+  put_u64(data, ph_offset + 48, 4);
+
+  // Note.
+  put_u32(data, note_offset, 4);
+  put_u32(data, note_offset + 4, static_cast<uint32_t>(build_id.size()));
+  put_u32(data, note_offset + 8, note_type);
+  data.replace(note_offset + 12, 4, note_name);
+  data.replace(note_offset + 16, build_id.size(), build_id);
+
+  return data;
+}
+}  // namespace
+
+TEST_CASE("get_build_id() extracts the GNU build ID") {
+#ifndef _WIN32
+  SUBCASE("64-bit ELF file with a build ID") {
+    const file::tmp_file_t tmp_file(file::get_temp_dir(), ".elf");
+    file::write(make_elf64(3, std::string("GNU\0", 4)), tmp_file.path());
+    CHECK_EQ(elf::get_build_id(tmp_file.path()), "0123456789abcdef");
+  }
+#endif
+
+  SUBCASE("ELF file with an unrelated note") {
+    const file::tmp_file_t tmp_file(file::get_temp_dir(), ".elf");
+    file::write(make_elf64(1, std::string("GNU\0", 4)), tmp_file.path());
+    CHECK_EQ(elf::get_build_id(tmp_file.path()), "");
+  }
+
+  SUBCASE("Truncated ELF file") {
+    const file::tmp_file_t tmp_file(file::get_temp_dir(), ".elf");
+    file::write(make_elf64(3, std::string("GNU\0", 4)).substr(0, 100), tmp_file.path());
+    CHECK_EQ(elf::get_build_id(tmp_file.path()), "");
+  }
+
+  SUBCASE("Non-ELF file") {
+    const file::tmp_file_t tmp_file(file::get_temp_dir(), ".txt");
+    file::write("This is not an executable file, but it is long enough to hold a header.",
+                tmp_file.path());
+    CHECK_EQ(elf::get_build_id(tmp_file.path()), "");
+  }
+
+  SUBCASE("Missing file") {
+    const file::tmp_file_t tmp_file(file::get_temp_dir(), ".elf");
+    CHECK_EQ(elf::get_build_id(tmp_file.path()), "");
+  }
+}
@@ -48,7 +48,10 @@
 #else
 #include <climits>
 #include <cstdlib>
+#include <cerrno>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/statvfs.h>
 #include <sys/time.h>
 #include <unistd.h>
 #include <utime.h>
@@ -209,6 +212,17 @@ bool is_relateive_path(const std::string& path) {
   return get_last_path_separator_pos(path) != std::string::npos;
 }
 
+#if defined(__linux__) && defined(O_TMPFILE)
+/// @brief Check if unnamed temporary files can be linked into the file system.
+///
+/// An O_TMPFILE file is published with linkat() via its /proc/self/fd/N path, which requires a
+/// mounted /proc file system.
+bool can_publish_unnamed_files() {
+  static const bool s_has_proc_fd = (access("/proc/self/fd", X_OK) == 0);
+  return s_has_proc_fd;
+}
+#endif
+
 }  // namespace
 
 tmp_file_t::tmp_file_t(const std::string& dir, const std::string& extension) {
@@ -221,16 +235,133 @@ tmp_file_t::tmp_file_t(const std::string& dir, const std::string& extension) {
 
 tmp_file_t::~tmp_file_t() {
   try {
+#ifdef _WIN32
     if (file_exists(m_path)) {
       remove_file(m_path);
     } else if (dir_exists(m_path)) {
       remove_dir(m_path);
     }
+#else
+    // Most temporary files are plain files (or have already been moved away), so try to unlink the
+    // path directly instead of stat:ing it first.
+    if ((unlink(m_path.c_str()) != 0) && (errno == EISDIR || errno == EPERM)) {
+      if (dir_exists(m_path)) {
+        remove_dir(m_path);
+      }
+    }
+#endif
   } catch (const std::exception& e) {
     debug::log(debug::ERROR) << e.what();
   }
 }
 
+scratch_file_t::scratch_file_t(const std::string& target_path) : m_target_path(target_path) {
+  auto dir = get_dir_part(target_path);
+#if defined(__linux__) && defined(O_TMPFILE)
+  // Try to create an unnamed file in the target directory.
+  if (can_publish_unnamed_files()) {
+    m_fd = open(dir.empty() ? "." : dir.c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, 0666);
+    if (m_fd >= 0) {
+      return;
+    }
+  }
+#endif
+
+  // Fall back to a named temporary file in the target directory.
+  m_tmp_path = append_path(dir, std::string("bcache-") + get_unique_id() + ".tmp");
+#ifdef _WIN32
+  if (_wfopen_s(&m_file, utf8_to_ucs2(m_tmp_path).c_str(), L"wb") != 0) {
+    m_file = nullptr;
+  }
+  const bool success = (m_file != nullptr);
+#else
+  m_fd = open(m_tmp_path.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0666);
+  const bool success = (m_fd >= 0);
+#endif
+  if (!success) {
+    throw std::runtime_error("Unable to create a temporary file.");
+  }
+}
+
+scratch_file_t::~scratch_file_t() {
+  close();
+  if (!m_tmp_path.empty()) {
+    remove_file(m_tmp_path, true);
+  }
+}
+
+void scratch_file_t::write(const void* data, const size_t size) {
+  const auto* ptr = reinterpret_cast<const char*>(data);
+  auto bytes_left = size;
+#ifdef _WIN32
+  while ((bytes_left != 0U) && (m_file != nullptr) && (std::ferror(m_file) == 0)) {
+    const auto bytes_written = std::fwrite(ptr, 1, bytes_left, m_file);
+    ptr += bytes_written;
+    bytes_left -= bytes_written;
+  }
+#else
+  while ((bytes_left != 0U) && (m_fd >= 0)) {
+    const auto bytes_written = ::write(m_fd, ptr, bytes_left);
+    if (bytes_written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    ptr += bytes_written;
+    bytes_left -= static_cast<size_t>(bytes_written);
+  }
+#endif
+  if (bytes_left != 0U) {
+    throw std::runtime_error("Unable to write the file.");
+  }
+}
+
+void scratch_file_t::publish() {
+#if defined(__linux__) && defined(O_TMPFILE)
+  if (m_tmp_path.empty() && (m_fd >= 0)) {
+    // Link the unnamed file into the file system. linkat() does not replace existing files, so if
+    // the target file exists we link to a temporary name and move that over the target file.
+    const auto fd_path = std::string("/proc/self/fd/") + std::to_string(m_fd);
+    if (linkat(AT_FDCWD, fd_path.c_str(), AT_FDCWD, m_target_path.c_str(), AT_SYMLINK_FOLLOW) ==
+        0) {
+      close();
+      return;
+    }
+    if (errno != EEXIST) {
+      throw std::runtime_error("Unable to publish the file.");
+    }
+    auto tmp_path = append_path(get_dir_part(m_target_path),
+                                std::string("bcache-") + get_unique_id() + ".tmp");
+    if (linkat(AT_FDCWD, fd_path.c_str(), AT_FDCWD, tmp_path.c_str(), AT_SYMLINK_FOLLOW) != 0) {
+      throw std::runtime_error("Unable to publish the file.");
+    }
+    m_tmp_path = tmp_path;
+  }
+#endif
+
+  if (m_tmp_path.empty()) {
+    throw std::runtime_error("The file has already been published.");
+  }
+  close();
+  move(m_tmp_path, m_target_path);
+  m_tmp_path.clear();
+}
+
+void scratch_file_t::close() {
+#ifdef _WIN32
+  if (m_file != nullptr) {
+    std::fclose(m_file);
+    m_file = nullptr;
+  }
+#else
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+#endif
+}
+
 scoped_work_dir_t::scoped_work_dir_t(const std::string& new_work_dir) {
   if (!new_work_dir.empty()) {
     m_old_work_dir = get_cwd();
@@ -681,16 +812,16 @@ bool file_exists(const std::string& path) {
 }
 
 void move(const std::string& from_path, const std::string& to_path) {
+  // Rename the file.
+#ifdef _WIN32
   // First remove the old target file, if any (otherwise the rename will fail).
   if (file_exists(to_path)) {
     remove_file(to_path);
   }
-
-  // Rename the file.
-#ifdef _WIN32
   const auto success =
       (_wrename(utf8_to_ucs2(from_path).c_str(), utf8_to_ucs2(to_path).c_str()) == 0);
 #else
+  // Note: rename() atomically replaces the old target file, if any.
   const auto success = (std::rename(from_path.c_str(), to_path.c_str()) == 0);
 #endif
 
@@ -703,69 +834,77 @@ void copy(const std::string& from_path, const std::string& to_path) {
   // Copy to a temporary file first and once the copy has succeeded rename it to the target file.
   // This should prevent half-finished copies if the process is terminated prematurely (e.g.
   // CTRL+C).
+#ifdef _WIN32
   const auto base_path = get_dir_part(to_path);
   auto tmp_file = tmp_file_t(base_path, ".tmp");
 
-#ifdef _WIN32
   // TODO(m): We could handle paths longer than MAX_PATH, e.g. by prepending strings with "\\?\"?
   bool success =
       (CopyFileW(utf8_to_ucs2(from_path).c_str(), utf8_to_ucs2(tmp_file.path()).c_str(), FALSE) !=
        0);
+  if (!success) {
+    // Note: At this point the temporary file (if any) will be deleted.
+    throw std::runtime_error("Unable to copy file.");
+  }
+
+  // Move the temporary file to its target name.
+  move(tmp_file.path(), to_path);
 #else
-  // For non-Windows systems we use a classic buffered read-write loop.
-  bool success = false;
+  // For non-Windows systems we use a classic buffered read-write loop into a scratch file.
   auto* from_file = std::fopen(from_path.c_str(), "rb");
-  if (from_file != nullptr) {
-    auto* to_file = std::fopen(tmp_file.path().c_str(), "wb");
-    if (to_file != nullptr) {
-      // We use a buffer size that typically fits in an L1 cache.
-      static const int BUFFER_SIZE = 8192;
-      std::vector<std::uint8_t> buf(BUFFER_SIZE);
-      success = true;
-      while (std::feof(from_file) == 0) {
-        const auto bytes_read = std::fread(buf.data(), 1, buf.size(), from_file);
-        if (bytes_read == 0U) {
-          break;
-        }
-        const auto bytes_written = std::fwrite(buf.data(), 1, bytes_read, to_file);
-        if (bytes_written != bytes_read) {
-          success = false;
-          break;
-        }
+  if (from_file == nullptr) {
+    throw std::runtime_error("Unable to copy file.");
+  }
+  try {
+    scratch_file_t to_file(to_path);
+
+    // We use a buffer size that typically fits in an L1 cache.
+    static const int BUFFER_SIZE = 8192;
+    std::vector<std::uint8_t> buf(BUFFER_SIZE);
+    while (std::feof(from_file) == 0) {
+      const auto bytes_read = std::fread(buf.data(), 1, buf.size(), from_file);
+      if (bytes_read == 0U) {
+        break;
       }
-      std::fclose(to_file);
+      to_file.write(buf.data(), bytes_read);
+    }
+    if (std::ferror(from_file) != 0) {
+      throw std::runtime_error("Unable to read the file.");
     }
     std::fclose(from_file);
-  }
-#endif
+    from_file = nullptr;
 
-  if (!success) {
-    // Note: At this point the temporary file (if any) will be deleted.
+    // Publish the file under its target name.
+    to_file.publish();
+  } catch (...) {
+    if (from_file != nullptr) {
+      std::fclose(from_file);
+    }
+    // Note: At this point the scratch file (if any) has been discarded.
     throw std::runtime_error("Unable to copy file.");
   }
-
-  // Move the temporary file to its target name.
-  move(tmp_file.path(), to_path);
+#endif
 }
 
 void link_or_copy(const std::string& from_path, const std::string& to_path) {
-  // First remove the old file, if any (otherwise the hard link will fail).
-  if (file_exists(to_path)) {
-    remove_file(to_path);
-  }
-
   // First try to make a hard link. However this may fail if the files are on different volumes for
-  // instance.
+  // instance. The link is created with a temporary name and then moved to the target file, so that
+  // the old target file (if any) is replaced atomically.
+  const auto base_path = get_dir_part(to_path);
+  auto tmp_file = tmp_file_t(base_path, ".tmp");
   bool success;
 #ifdef _WIN32
-  success = (CreateHardLinkW(
-                 utf8_to_ucs2(to_path).c_str(), utf8_to_ucs2(from_path).c_str(), nullptr) != 0);
+  success = (CreateHardLinkW(utf8_to_ucs2(tmp_file.path()).c_str(),
+                             utf8_to_ucs2(from_path).c_str(),
+                             nullptr) != 0);
 #else
-  success = (link(from_path.c_str(), to_path.c_str()) == 0);
+  success = (link(from_path.c_str(), tmp_file.path().c_str()) == 0);
 #endif
 
-  // If the hard link failed, make a full copy instead.
-  if (!success) {
+  if (success) {
+    move(tmp_file.path(), to_path);
+  } else {
+    // If the hard link failed, make a full copy instead.
     debug::log(debug::DEBUG) << "Hard link failed - copying instead.";
     copy(from_path, to_path);
   }
@@ -795,6 +934,105 @@ void touch(const std::string& path) {
   }
 }
 
+void make_read_only(const std::string& path) {
+#ifndef _WIN32
+  struct stat file_stat;
+  bool success = (stat(path.c_str(), &file_stat) == 0);
+  if (success) {
+    const auto mode = file_stat.st_mode & ~static_cast<mode_t>(S_IWUSR | S_IWGRP | S_IWOTH);
+    success = (mode == file_stat.st_mode) || (chmod(path.c_str(), mode) == 0);
+  }
+  if (!success) {
+    throw std::runtime_error("Unable to make the file read-only.");
+  }
+#else
+  (void)path;
+#endif
+}
+
+int get_file_mode(const std::string& path) {
+#ifndef _WIN32
+  struct stat file_stat;
+  if (stat(path.c_str(), &file_stat) != 0) {
+    throw std::runtime_error("Unable to get the file mode.");
+  }
+  return static_cast<int>(file_stat.st_mode & static_cast<mode_t>(07777));
+#else
+  (void)path;
+  return 0;
+#endif
+}
+
+void set_file_mode(const std::string& path, const int mode) {
+#ifndef _WIN32
+  if (chmod(path.c_str(), static_cast<mode_t>(mode) & static_cast<mode_t>(07777)) != 0) {
+    throw std::runtime_error("Unable to set the file mode.");
+  }
+#else
+  (void)path;
+  (void)mode;
+#endif
+}
+
+std::string get_symlink_target(const std::string& path) {
+#ifndef _WIN32
+  struct stat file_stat;
+  if ((lstat(path.c_str(), &file_stat) != 0) || !S_ISLNK(file_stat.st_mode)) {
+    return std::string();
+  }
+  std::string target(static_cast<size_t>(file_stat.st_size) + 1U, '\0');
+  const auto size = readlink(path.c_str(), &target[0], target.size());
+  if ((size <= 0) || (static_cast<size_t>(size) >= target.size())) {
+    throw std::runtime_error("Unable to read the symbolic link " + path);
+  }
+  target.resize(static_cast<size_t>(size));
+  return target;
+#else
+  (void)path;
+  return std::string();
+#endif
+}
+
+void create_symlink(const std::string& target, const std::string& path) {
+#ifndef _WIN32
+  if (symlink(target.c_str(), path.c_str()) != 0) {
+    throw std::runtime_error("Unable to create the symbolic link " + path);
+  }
+#else
+  (void)target;
+  throw std::runtime_error("Symbolic links are not supported: " + path);
+#endif
+}
+
+int64_t get_link_count(const std::string& path) {
+#ifdef _WIN32
+  int64_t link_count = -1;
+  HANDLE h = CreateFileW(utf8_to_ucs2(path).c_str(),
+                         FILE_READ_ATTRIBUTES,
+                         FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                         nullptr,
+                         OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL,
+                         nullptr);
+  if (h != INVALID_HANDLE_VALUE) {
+    BY_HANDLE_FILE_INFORMATION info;
+    if (GetFileInformationByHandle(h, &info) != FALSE) {
+      link_count = static_cast<int64_t>(info.nNumberOfLinks);
+    }
+    CloseHandle(h);
+  }
+  if (link_count >= 0) {
+    return link_count;
+  }
+#else
+  struct stat file_stat;
+  if (stat(path.c_str(), &file_stat) == 0) {
+    return static_cast<int64_t>(file_stat.st_nlink);
+  }
+#endif
+  throw std::runtime_error("Unable to get the file link count.");
+}
+
 std::string read(const std::string& path) {
   FILE* f;
 
@@ -870,16 +1108,10 @@ void write(const std::string& data, const std::string& path) {
 }
 
 void write_atomic(const std::string& data, const std::string& path) {
-  // 1) Write to a temporary file.
-  const auto base_path = get_dir_part(path);
-  auto tmp_file = tmp_file_t(base_path, ".tmp");
-  write(data, tmp_file.path());
-
-  // 2) Remove the target path if it already exists.
-  remove_file(path, true);
-
-  // 3) Move the temporary file to the target file name.
-  move(tmp_file.path(), path);
+  // Write to a scratch file and publish it under the target file name once it is complete.
+  scratch_file_t file(path);
+  file.write(data);
+  file.publish();
 }
 
 void append(const std::string& data, const std::string& path) {
@@ -995,6 +1227,59 @@ file_info_t get_file_info(const std::string& path) {
   throw std::runtime_error("Unable to get file information.");
 }
 
+file_stat_t get_file_stat(const std::string& path) {
+#ifdef _WIN32
+  WIN32_FILE_ATTRIBUTE_DATA attributes;
+  if (GetFileAttributesExW(utf8_to_ucs2(path).c_str(), GetFileExInfoStandard, &attributes) != 0) {
+    // FILETIME is the number of 100-nanosecond intervals since January 1, 1601 (UTC).
+    const auto to_unix_ns = [](const FILETIME& t) {
+      const auto t64 = two_dwords_to_int64(t.dwLowDateTime, t.dwHighDateTime);
+      return (t64 - 116444736000000000LL) * 100;
+    };
+    const auto size = two_dwords_to_int64(attributes.nFileSizeLow, attributes.nFileSizeHigh);
+    return file_stat_t(
+        size, to_unix_ns(attributes.ftLastWriteTime), to_unix_ns(attributes.ftCreationTime), 0U);
+  }
+#else
+  struct stat file_stat;
+  if (stat(path.c_str(), &file_stat) == 0) {
+#ifdef __APPLE__
+    const auto& mtime = file_stat.st_mtimespec;
+    const auto& ctime = file_stat.st_ctimespec;
+#else
+    const auto& mtime = file_stat.st_mtim;
+    const auto& ctime = file_stat.st_ctim;
+#endif
+    const auto to_ns = [](const struct timespec& t) {
+      return static_cast<int64_t>(t.tv_sec) * 1000000000LL + static_cast<int64_t>(t.tv_nsec);
+    };
+    return file_stat_t(static_cast<int64_t>(file_stat.st_size),
+                       to_ns(mtime),
+                       to_ns(ctime),
+                       static_cast<uint64_t>(file_stat.st_ino),
+                       static_cast<uint64_t>(file_stat.st_dev));
+  }
+#endif
+
+  throw std::runtime_error("Unable to get file status.");
+}
+
+int64_t get_free_disk_space(const std::string& path) {
+#ifdef _WIN32
+  ULARGE_INTEGER free_bytes;
+  if (GetDiskFreeSpaceExW(utf8_to_ucs2(path).c_str(), &free_bytes, nullptr, nullptr) != 0) {
+    return static_cast<int64_t>(free_bytes.QuadPart);
+  }
+#else
+  struct statvfs fs_stat;
+  if (statvfs(path.c_str(), &fs_stat) == 0) {
+    return static_cast<int64_t>(fs_stat.f_bavail) * static_cast<int64_t>(fs_stat.f_frsize);
+  }
+#endif
+
+  throw std::runtime_error("Unable to get the free disk space.");
+}
+
 std::string human_readable_size(const int64_t byte_size) {
   static const char* SUFFIX[6] = {"bytes", "KiB", "MiB", "GiB", "TiB", "PiB"};
   static const int MAX_SUFFIX_IDX = (sizeof(SUFFIX) / sizeof(SUFFIX[0])) - 1;
@@ -1014,7 +1299,9 @@ std::string human_readable_size(const int64_t byte_size) {
   return std::string(buf);
 }
 
-std::vector<file_info_t> walk_directory(const std::string& path, const filter_t& filter) {
+std::vector<file_info_t> walk_directory(const std::string& path,
+                                        const filter_t& filter,
+                                        const bool follow_symlinks) {
   std::vector<file_info_t> files;
 
 #ifdef _WIN32
@@ -1032,8 +1319,10 @@ std::vector<file_info_t> walk_directory(const std::string& path, const filter_t&
       time::seconds_t access_time = 0;
       int64_t size = 0;
       bool is_dir = false;
-      if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
-        auto subdir_files = walk_directory(file_path, filter);
+      const auto is_link = ((find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0);
+      if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0 &&
+          (follow_symlinks || !is_link)) {
+        auto subdir_files = walk_directory(file_path, filter, follow_symlinks);
         for (const auto& entry : subdir_files) {
           files.emplace_back(entry);
           size += entry.size();
@@ -1073,13 +1362,15 @@ std::vector<file_info_t> walk_directory(const std::string& path, const filter_t&
     if ((name != ".") && (name != "..") && filter.keep(name)) {
       const auto file_path = append_path(path, name);
       struct stat file_stat;
-      if (stat(file_path.c_str(), &file_stat) == 0) {
+      const auto stat_result = follow_symlinks ? stat(file_path.c_str(), &file_stat)
+                                               : lstat(file_path.c_str(), &file_stat);
+      if (stat_result == 0) {
         time::seconds_t modify_time = 0;
         time::seconds_t access_time = 0;
         int64_t size = 0;
         bool is_dir = false;
         if (S_ISDIR(file_stat.st_mode)) {
-          auto subdir_files = walk_directory(file_path, filter);
+          auto subdir_files = walk_directory(file_path, filter, follow_symlinks);
           for (const auto& entry : subdir_files) {
             files.emplace_back(entry);
             size += entry.size();
@@ -21,6 +21,7 @@
 #define BUILDCACHE_FILE_UTILS_HPP_
 
 #include <cstdint>
+#include <cstdio>
 #include <string>
 #include <vector>
 
@@ -50,6 +51,58 @@ private:
   std::string m_path;
 };
 
+/// @brief A helper class for writing files atomically.
+///
+/// The data is written to a scratch file in the same directory as the target file, and once all
+/// the data has been written the file is published under the target file name in a single atomic
+/// operation (replacing the old target file, if any). If the object goes out of scope before the
+/// file has been published, the data is discarded.
+///
+/// On Linux the scratch file is an unnamed O_TMPFILE file (if supported by the file system), so no
+/// temporary files are left behind if the process is terminated prematurely.
+class scratch_file_t {
+public:
+  /// @brief Create a scratch file for the given target file.
+  /// @param target_path The path to the target file.
+  /// @throws runtime_error if the scratch file could not be created.
+  explicit scratch_file_t(const std::string& target_path);
+
+  /// @brief Discard the scratch file (unless it has been published).
+  ~scratch_file_t();
+
+  /// @brief Append data to the scratch file.
+  /// @param data The data to write.
+  /// @param size The number of bytes to write.
+  /// @throws runtime_error if the data could not be written.
+  void write(const void* data, const size_t size);
+
+  /// @brief Append data to the scratch file.
+  /// @param data The data to write.
+  /// @throws runtime_error if the data could not be written.
+  void write(const std::string& data) {
+    write(data.data(), data.size());
+  }
+
+  /// @brief Publish the scratch file under the target file name.
+  /// @throws runtime_error if the file could not be published.
+  void publish();
+
+private:
+  // Prohibit copy & assignment.
+  scratch_file_t(const scratch_file_t&) = delete;
+  scratch_file_t& operator=(const scratch_file_t&) = delete;
+
+  void close();
+
+  std::string m_target_path;
+  std::string m_tmp_path;  ///< The name of the scratch file (empty for unnamed files).
+#ifdef _WIN32
+  FILE* m_file = nullptr;
+#else
+  int m_fd = -1;
+#endif
+};
+
 /// @brief A helper class for temporarily changing the current working dir (CWD).
 ///
 /// When the scoped_work_dir_t object is created, the current working directory is changed to the
@@ -128,6 +181,81 @@ private:
   bool m_is_dir;
 };
 
+/// @brief File status information that is used for detecting file modifications.
+///
+/// If the file status information for a file is unchanged, the file contents are assumed to be
+/// unchanged too (this is the same heuristic that is used by tools such as make and git).
+class file_stat_t {
+public:
+  /// @brief Construct an invalid (unknown) file status.
+  file_stat_t() = default;
+
+  file_stat_t(const int64_t size,
+              const int64_t modify_time_ns,
+              const int64_t change_time_ns,
+              const uint64_t inode,
+              const uint64_t device = 0U)
+      : m_size(size),
+        m_modify_time_ns(modify_time_ns),
+        m_change_time_ns(change_time_ns),
+        m_inode(inode),
+        m_device(device),
+        m_valid(true) {
+  }
+
+  /// @returns the size of the file (in bytes).
+  int64_t size() const {
+    return m_size;
+  }
+
+  /// @returns the last modification time of the file, in nanoseconds since the Unix epoch.
+  int64_t modify_time_ns() const {
+    return m_modify_time_ns;
+  }
+
+  /// @returns the last status change time of the file, in nanoseconds since the Unix epoch.
+  /// @note On Windows this is the file creation time.
+  int64_t change_time_ns() const {
+    return m_change_time_ns;
+  }
+
+  /// @returns the inode number of the file, or zero if no such identification is known.
+  uint64_t inode() const {
+    return m_inode;
+  }
+
+  /// @returns the ID of the device that holds the file, or zero if no such identification is known.
+  /// @note The device is not compared by the comparison operators, since it is not known for all
+  /// file status objects (e.g. the ones that are stored in direct mode manifests).
+  uint64_t device() const {
+    return m_device;
+  }
+
+  /// @returns true if this object holds valid file status information.
+  bool is_valid() const {
+    return m_valid;
+  }
+
+  /// @returns true if both objects are valid and the file status information is identical.
+  bool operator==(const file_stat_t& other) const {
+    return m_valid && other.m_valid && m_size == other.m_size &&
+           m_modify_time_ns == other.m_modify_time_ns &&
+           m_change_time_ns == other.m_change_time_ns && m_inode == other.m_inode;
+  }
+
+  bool operator!=(const file_stat_t& other) const {
+    return !(*this == other);
+  }
+
+private:
+  int64_t m_size = 0;
+  int64_t m_modify_time_ns = 0;
+  int64_t m_change_time_ns = 0;
+  uint64_t m_inode = 0;
+  uint64_t m_device = 0;
+  bool m_valid = false;
+};
+
 /// @brief File name filter function for directory traversal.
 class filter_t {
 public:
@@ -302,6 +430,18 @@ exe_path_t find_executable(const std::string& program, const std::string& exclud
 /// @returns a file information object.
 file_info_t get_file_info(const std::string& path);
 
+/// @brief Get the file status information for a file.
+/// @param path The path to the file.
+/// @returns a file status object.
+/// @throws runtime_error if the file status could not be read.
+file_stat_t get_file_stat(const std::string& path);
+
+/// @brief Get the free disk space that is available to the current user.
+/// @param path The path to a file or directory in the file system to check.
+/// @returns the number of available bytes.
+/// @throws runtime_error if the information could not be retrieved.
+int64_t get_free_disk_space(const std::string& path);
+
 /// @brief Convert a size to a human readable string.
 /// @param byte_size The size (number of bytes).
 /// @returns a string containing a human readable version of the size, e.g. "4.7 MiB".
@@ -310,10 +450,13 @@ std::string human_readable_size(const int64_t byte_size);
 /// @brief Walk a directory and its subdirectories.
 /// @param path The path to the directory.
 /// @param filter File name filter.
+/// @param follow_symlinks Set this to false to list symbolic links as (empty, non-directory)
+/// entries of their own instead of following them.
 /// @returns a vector of file information objects.
 /// @note Directories are listed after any files that are contained within the directories.
 std::vector<file_info_t> walk_directory(const std::string& path,
-                                        const filter_t& filter = filter_t());
+                                        const filter_t& filter = filter_t(),
+                                        const bool follow_symlinks = true);
 
 /// @brief Create a directory.
 /// @param path The path to the directory.
@@ -365,7 +508,8 @@ void copy(const std::string& from_path, const std::string& to_path);
 
 /// @brief Make a hard link or a full copy of a file.
 ///
-/// A hard link will be performed if possible. Otherwise a full copy will be made.
+/// A hard link will be performed if possible. Otherwise a full copy will be made. In both cases an
+/// existing destination file is replaced atomically (except on Windows).
 /// @param from_path The source file.
 /// @param to_path The destination file.
 /// @throws runtime_error if the operation could not be completed.
@@ -376,6 +520,44 @@ void link_or_copy(const std::string& from_path, const std::string& to_path);
 /// @throws runtime_error if the operation could not be completed.
 void touch(const std::string& path);
 
+/// @brief Make a file read-only (remove all write permissions).
+/// @param path The path to the file.
+/// @throws runtime_error if the operation could not be completed.
+/// @note This is a no-op on Windows, where read-only files can not be deleted or replaced.
+void make_read_only(const std::string& path);
+
+/// @brief Get the permission bits of a file or directory (e.g. 0755).
+/// @param path The path to the file.
+/// @returns the permission bits, or zero if file modes are not supported (on Windows).
+/// @throws runtime_error if the operation could not be completed.
+int get_file_mode(const std::string& path);
+
+/// @brief Set the permission bits of a file or directory.
+/// @param path The path to the file.
+/// @param mode The permission bits (e.g. 0755).
+/// @throws runtime_error if the operation could not be completed.
+/// @note This is a no-op on Windows.
+void set_file_mode(const std::string& path, const int mode);
+
+/// @brief Get the target of a symbolic link.
+/// @param path The path to the symbolic link.
+/// @returns the (unresolved) link target, or an empty string if the path is not a symbolic link.
+/// @throws runtime_error if the link could not be read.
+/// @note Symbolic links are not detected on Windows, where this always returns an empty string.
+std::string get_symlink_target(const std::string& path);
+
+/// @brief Create a symbolic link.
+/// @param target The link target.
+/// @param path The path to the symbolic link (must not exist).
+/// @throws runtime_error if the operation could not be completed.
+void create_symlink(const std::string& target, const std::string& path);
+
+/// @brief Get the number of hard links to a file.
+/// @param path The path to the file.
+/// @returns the number of hard links (directory entries) that refer to the file.
+/// @throws runtime_error if the operation could not be completed.
+int64_t get_link_count(const std::string& path);
+
 /// @brief Read a file into a string.
 /// @param path The path to the file.
 /// @returns the contents of the file as a string.
@@ -333,3 +333,76 @@ TEST_CASE("Scoped working directory") {
   // We should now be in the old CWD.
   CHECK_EQ(old_cwd, file::get_cwd());
 }
+
+TEST_CASE("get_file_stat produces expected results") {
+  const auto tmp = file::tmp_file_t(file::get_temp_dir(), ".stat");
+
+  SUBCASE("Missing file") {
+    CHECK_THROWS(file::get_file_stat(tmp.path()));
+  }
+
+  SUBCASE("Unchanged and changed file") {
+    file::write("Hello", tmp.path());
+    const auto stat1 = file::get_file_stat(tmp.path());
+    const auto stat2 = file::get_file_stat(tmp.path());
+    CHECK(stat1.is_valid());
+    CHECK_EQ(stat1.size(), 5);
+    CHECK(stat1 == stat2);
+
+    file::write("Hello world", tmp.path());
+    const auto stat3 = file::get_file_stat(tmp.path());
+    CHECK_EQ(stat3.size(), 11);
+    CHECK(stat1 != stat3);
+  }
+
+  SUBCASE("Invalid file status never matches") {
+    const auto invalid = file::file_stat_t();
+    CHECK_FALSE(invalid.is_valid());
+    CHECK(invalid != file::file_stat_t());
+  }
+}
+
+TEST_CASE("link_or_copy replaces the target file") {
+  const auto source = file::tmp_file_t(file::get_temp_dir(), ".src");
+  const auto target = file::tmp_file_t(file::get_temp_dir(), ".dst");
+  file::write("Hello", source.path());
+  file::write("Old contents", target.path());
+
+  file::link_or_copy(source.path(), target.path());
+  CHECK_EQ(file::read(target.path()), "Hello");
+  CHECK_GE(file::get_link_count(source.path()), 1);
+
+  SUBCASE("Read-only files can still be replaced") {
+    file::make_read_only(target.path());
+    file::link_or_copy(source.path(), target.path());
+    CHECK_EQ(file::read(target.path()), "Hello");
+  }
+}
+
+TEST_CASE("scratch_file_t publishes or discards the data") {
+  const auto dir = file::tmp_file_t(file::get_temp_dir(), "");
+  file::create_dir(dir.path());
+  const auto target = file::append_path(dir.path(), "target.txt");
+
+  SUBCASE("Unpublished data is discarded") {
+    {
+      file::scratch_file_t scratch(target);
+      scratch.write("Hello");
+    }
+    CHECK_EQ(file::file_exists(target), false);
+    CHECK_EQ(file::walk_directory(dir.path()).size(), 0);
+  }
+
+  SUBCASE("Published data replaces the target file") {
+    file::write("Old contents", target);
+    {
+      file::scratch_file_t scratch(target);
+      scratch.write("Hello");
+      scratch.write(" world!");
+      CHECK_EQ(file::read(target), "Old contents");
+      scratch.publish();
+    }
+    CHECK_EQ(file::read(target), "Hello world!");
+    CHECK_EQ(file::walk_directory(dir.path()).size(), 1);
+  }
+}
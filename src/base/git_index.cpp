@@ -0,0 +1,493 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#include <base/git_index.hpp>
+
+#include <base/debug_utils.hpp>
+#include <base/env_utils.hpp>
+#include <base/file_utils.hpp>
+#include <base/string_list.hpp>
+#include <base/unicode_utils.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bcache {
+namespace git {
+namespace {
+// Prefix for blob ID based file digests.
+const std::string BLOB_DIGEST_PREFIX = "g:";
+
+// Index entry flags.
+const uint16_t FLAG_EXTENDED = 0x4000U;
+const uint16_t FLAG_STAGE_MASK = 0x3000U;
+const uint16_t EXT_FLAG_SKIP_WORKTREE = 0x4000U;
+const uint16_t EXT_FLAG_INTENT_TO_ADD = 0x2000U;
+
+// File mode bits.
+const uint32_t MODE_TYPE_MASK = 0170000U;
+const uint32_t MODE_TYPE_REGULAR = 0100000U;
+
+// Size of the fixed part of an index entry, excluding the object hash and the flags.
+const size_t ENTRY_STAT_SIZE = 40U;
+
+class reader_t {
+public:
+  reader_t(const uint8_t* data, const size_t size) : m_data(data), m_size(size) {
+  }
+
+  const uint8_t* get(const size_t pos, const size_t count) const {
+    if (pos > m_size || count > (m_size - pos)) {
+      throw std::runtime_error("Premature end of git index data.");
+    }
+    return &m_data[pos];
+  }
+
+  uint16_t u16(const size_t pos) const {
+    const auto* p = get(pos, 2);
+    return static_cast<uint16_t>((static_cast<uint32_t>(p[0]) << 8) | static_cast<uint32_t>(p[1]));
+  }
+
+  uint32_t u32(const size_t pos) const {
+    const auto* p = get(pos, 4);
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+  }
+
+  // Read a NUL terminated string, and return the number of bytes consumed (including the NUL).
+  size_t str(const size_t pos, std::string& result) const {
+    const auto* p = get(pos, 0);
+    const auto* end = reinterpret_cast<const uint8_t*>(std::memchr(p, 0, m_size - pos));
+    if (end == nullptr) {
+      throw std::runtime_error("Unterminated path in git index data.");
+    }
+    result.assign(reinterpret_cast<const char*>(p), static_cast<size_t>(end - p));
+    return static_cast<size_t>(end - p) + 1U;
+  }
+
+  // Read a variable width integer (index format version 4), and return the number of bytes
+  // consumed.
+  size_t varint(const size_t pos, size_t& result) const {
+    size_t n = 0;
+    auto c = *get(pos + n++, 1);
+    result = c & 127U;
+    while ((c & 128U) != 0) {
+      c = *get(pos + n++, 1);
+      result = ((result + 1U) << 7) | (c & 127U);
+    }
+    return n;
+  }
+
+  size_t size() const {
+    return m_size;
+  }
+
+private:
+  const uint8_t* m_data;
+  const size_t m_size;
+};
+
+std::string to_hex(const uint8_t* data, const size_t size) {
+  static const char HEX_CHARS[] = "0123456789abcdef";
+  std::string result(size * 2U, '0');
+  for (size_t i = 0; i < size; ++i) {
+    result[i * 2U] = HEX_CHARS[data[i] >> 4];
+    result[i * 2U + 1U] = HEX_CHARS[data[i] & 15U];
+  }
+  return result;
+}
+
+#ifndef _WIN32
+// A work tree and its (parsed) index.
+struct repo_t {
+  std::string work_tree;
+  index_t index;
+  uint32_t index_mtime_sec = 0;
+  uint32_t index_mtime_nsec = 0;
+
+  // True if the config or a global attributes file may make the checked out files differ from the
+  // blobs (e.g. due to line ending conversion or filters).
+  bool may_convert = false;
+
+  // Directories in the work tree, and whether or not they have a .gitattributes file that may
+  // apply content conversion to files.
+  std::map<std::string, bool> dir_may_convert;
+};
+
+// All repositories that have been loaded by this process, keyed by directory. A nullptr means that
+// the directory is not part of a (usable) git work tree.
+std::map<std::string, std::shared_ptr<repo_t>> s_repos_by_dir;
+
+std::string trim(const std::string& str) {
+  const auto first = str.find_first_not_of(" \t\r\n");
+  const auto last = str.find_last_not_of(" \t\r\n");
+  return (first == std::string::npos) ? std::string() : str.substr(first, last - first + 1);
+}
+
+// Attributes that may make a checked out file differ from the blob in the repository. This also
+// catches the legacy "crlf" attribute and macros that are defined in terms of these attributes.
+const char* const CONVERSION_ATTRIBUTES[] = {"text", "eol", "crlf", "filter", "ident", "encoding"};
+
+// Read a config or attributes file, in lower case and without spaces and tabs.
+std::string read_normalized(const std::string& path) {
+  auto content = lower_case(file::read(path));
+  content.erase(std::remove_if(content.begin(),
+                               content.end(),
+                               [](const char c) { return c == ' ' || c == '\t'; }),
+                content.end());
+  return content;
+}
+
+// Get the common directory of a repository (different from the git directory for linked work
+// trees).
+std::string get_common_dir(const std::string& git_dir) {
+  const auto commondir_path = file::append_path(git_dir, "commondir");
+  if (file::file_exists(commondir_path)) {
+    const auto common_dir = trim(file::read(commondir_path));
+    if (!common_dir.empty()) {
+      return (common_dir[0] == '/') ? common_dir : file::append_path(git_dir, common_dir);
+    }
+  }
+  return git_dir;
+}
+
+// Get the object hash size for a repository (SHA-1 or SHA-256).
+size_t get_hash_size(const std::string& git_dir) {
+  const auto config_paths = string_list_t{file::append_path(git_dir, "config"),
+                                          file::append_path(get_common_dir(git_dir), "config")};
+  for (const auto& config_path : config_paths) {
+    if (file::file_exists(config_path)) {
+      if (read_normalized(config_path).find("objectformat=sha256") != std::string::npos) {
+        return 32U;
+      }
+    }
+  }
+  return 20U;
+}
+
+// Check if an attributes file may apply content conversion to any file.
+bool has_conversion_attributes(const std::string& attributes_path) {
+  if (!file::file_exists(attributes_path)) {
+    return false;
+  }
+  const auto attributes = read_normalized(attributes_path);
+  for (const auto* attribute : CONVERSION_ATTRIBUTES) {
+    if (attributes.find(attribute) != std::string::npos) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Check if the config of a repository (including the global and system config) or any of the
+// attributes files that apply to the entire repository may apply content conversion to files.
+bool may_convert_content(const std::string& git_dir) {
+  const auto common_dir = get_common_dir(git_dir);
+  const auto home_dir = file::get_user_home_dir();
+  const auto xdg_config_dir = env_defined("XDG_CONFIG_HOME")
+                                  ? file::append_path(get_env("XDG_CONFIG_HOME"), "git")
+                                  : file::append_path(home_dir, ".config/git");
+
+  auto config_paths = string_list_t{file::append_path(git_dir, "config"),
+                                    file::append_path(common_dir, "config"),
+                                    file::append_path(git_dir, "config.worktree"),
+                                    file::append_path(home_dir, ".gitconfig"),
+                                    file::append_path(xdg_config_dir, "config")};
+  if (!env_defined("GIT_CONFIG_NOSYSTEM")) {
+    config_paths += "/etc/gitconfig";
+  }
+  for (const auto& config_path : config_paths) {
+    if (file::file_exists(config_path)) {
+      const auto config = read_normalized(config_path);
+      if (config.find("autocrlf=true") != std::string::npos ||
+          config.find("autocrlf=input") != std::string::npos ||
+          config.find("attributesfile") != std::string::npos) {
+        return true;
+      }
+    }
+  }
+
+  return has_conversion_attributes(file::append_path(common_dir, "info/attributes")) ||
+         has_conversion_attributes(file::append_path(xdg_config_dir, "attributes"));
+}
+
+// Check if any .gitattributes file in the work tree that applies to a file (i.e. in the directory
+// of the file or any of its parent directories) may apply content conversion to the file.
+bool may_convert_file(repo_t& repo, const std::string& abs_path) {
+  auto dir = file::get_dir_part(abs_path);
+  while (dir.size() >= repo.work_tree.size()) {
+    auto it = repo.dir_may_convert.find(dir);
+    if (it == repo.dir_may_convert.end()) {
+      const auto may_convert = has_conversion_attributes(file::append_path(dir, ".gitattributes"));
+      it = repo.dir_may_convert.insert(std::make_pair(dir, may_convert)).first;
+    }
+    if (it->second) {
+      return true;
+    }
+    if (dir == repo.work_tree) {
+      break;
+    }
+    dir = file::get_dir_part(dir);
+  }
+  return false;
+}
+
+std::shared_ptr<repo_t> load_repo(const std::string& work_tree, const std::string& dot_git) {
+  // Find the git directory (.git is a file for linked work trees and submodules).
+  auto git_dir = dot_git;
+  if (file::file_exists(dot_git)) {
+    const auto gitdir_file = trim(file::read(dot_git));
+    if (gitdir_file.compare(0, 8, "gitdir: ") != 0) {
+      throw std::runtime_error("Invalid .git file: " + dot_git);
+    }
+    git_dir = gitdir_file.substr(8);
+    if (git_dir.empty() || git_dir[0] != '/') {
+      git_dir = file::append_path(work_tree, git_dir);
+    }
+  }
+
+  // Memory map the index file.
+  const auto index_path = file::append_path(git_dir, "index");
+  const auto fd = ::open(index_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open " + index_path);
+  }
+  struct stat index_stat;
+  if (::fstat(fd, &index_stat) != 0 || index_stat.st_size <= 0) {
+    ::close(fd);
+    throw std::runtime_error("Unable to stat " + index_path);
+  }
+  const auto size = static_cast<size_t>(index_stat.st_size);
+  auto* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("Unable to map " + index_path);
+  }
+
+  auto repo = std::make_shared<repo_t>();
+  repo->work_tree = work_tree;
+  repo->may_convert = may_convert_content(git_dir);
+#ifdef __APPLE__
+  repo->index_mtime_sec = static_cast<uint32_t>(index_stat.st_mtimespec.tv_sec);
+  repo->index_mtime_nsec = static_cast<uint32_t>(index_stat.st_mtimespec.tv_nsec);
+#else
+  repo->index_mtime_sec = static_cast<uint32_t>(index_stat.st_mtim.tv_sec);
+  repo->index_mtime_nsec = static_cast<uint32_t>(index_stat.st_mtim.tv_nsec);
+#endif
+  try {
+    repo->index = index_t(reinterpret_cast<const uint8_t*>(data), size, get_hash_size(git_dir));
+  } catch (...) {
+    ::munmap(data, size);
+    throw;
+  }
+  ::munmap(data, size);
+
+  return repo;
+}
+
+std::shared_ptr<repo_t> find_repo(const std::string& dir) {
+  const auto it = s_repos_by_dir.find(dir);
+  if (it != s_repos_by_dir.end()) {
+    return it->second;
+  }
+
+  std::shared_ptr<repo_t> repo;
+  const auto dot_git = file::append_path(dir, ".git");
+  if (file::dir_exists(dot_git) || file::file_exists(dot_git)) {
+    try {
+      repo = load_repo(dir, dot_git);
+      debug::log(debug::DEBUG) << "Loaded the git index for " << dir;
+    } catch (const std::exception& e) {
+      debug::log(debug::DEBUG) << "Unable to use the git index for " << dir << ": " << e.what();
+    }
+  } else {
+    const auto parent = file::get_dir_part(dir);
+    if (!parent.empty() && parent != dir) {
+      repo = find_repo(parent);
+    }
+  }
+
+  s_repos_by_dir[dir] = repo;
+  return repo;
+}
+#endif
+}  // namespace
+
+index_t::index_t(const uint8_t* data, const size_t size, const size_t hash_size) {
+  const reader_t reader(data, size);
+
+  // Parse the header.
+  if (std::memcmp(reader.get(0, 4), "DIRC", 4) != 0) {
+    throw std::runtime_error("Invalid git index signature.");
+  }
+  const auto version = reader.u32(4);
+  if (version < 2U || version > 4U) {
+    throw std::runtime_error("Unsupported git index version.");
+  }
+  const auto num_entries = reader.u32(8);
+
+  // Parse the entries.
+  m_entries.reserve(num_entries);
+  size_t pos = 12;
+  std::string path;
+  for (uint32_t i = 0; i < num_entries; ++i) {
+    const auto entry_pos = pos;
+    const auto mode = reader.u32(pos + 24);
+    const auto* hash = reader.get(pos + ENTRY_STAT_SIZE, hash_size);
+    const auto flags = reader.u16(pos + ENTRY_STAT_SIZE + hash_size);
+    pos += ENTRY_STAT_SIZE + hash_size + 2U;
+    uint16_t extended_flags = 0U;
+    if ((flags & FLAG_EXTENDED) != 0U) {
+      extended_flags = reader.u16(pos);
+      pos += 2U;
+    }
+
+    if (version == 4U) {
+      // The path is prefix compressed, relative to the previous path.
+      size_t strip_len;
+      pos += reader.varint(pos, strip_len);
+      if (strip_len > path.size()) {
+        throw std::runtime_error("Invalid path compression in git index.");
+      }
+      std::string suffix;
+      pos += reader.str(pos, suffix);
+      path = path.substr(0, path.size() - strip_len) + suffix;
+    } else {
+      // The path is NUL padded so that the entry size is a multiple of eight bytes.
+      const auto path_len = reader.str(pos, path) - 1U;
+      pos = entry_pos + ((pos - entry_pos + path_len + 8U) & ~static_cast<size_t>(7U));
+    }
+
+    // Only keep stage 0 regular files that are present in the work tree.
+    const auto ignored_extended_flags = EXT_FLAG_SKIP_WORKTREE | EXT_FLAG_INTENT_TO_ADD;
+    const auto is_usable = (mode & MODE_TYPE_MASK) == MODE_TYPE_REGULAR &&
+                           (flags & FLAG_STAGE_MASK) == 0U &&
+                           (extended_flags & ignored_extended_flags) == 0U;
+    if (is_usable) {
+      entry_t entry;
+      entry.path = path;
+      entry.ctime_sec = reader.u32(entry_pos);
+      entry.ctime_nsec = reader.u32(entry_pos + 4);
+      entry.mtime_sec = reader.u32(entry_pos + 8);
+      entry.mtime_nsec = reader.u32(entry_pos + 12);
+      entry.ino = reader.u32(entry_pos + 20);
+      entry.size = reader.u32(entry_pos + 36);
+      entry.blob_id = to_hex(hash, hash_size);
+      m_entries.emplace_back(std::move(entry));
+    }
+  }
+
+  // A split index only holds a part of the entries, and replaced entries are stored without their
+  // paths, so we can not use it.
+  while (pos + 8U + hash_size <= reader.size()) {
+    if (std::memcmp(reader.get(pos, 4), "link", 4) == 0) {
+      throw std::runtime_error("Split git indexes are not supported.");
+    }
+    pos += 8U + reader.u32(pos + 4);
+  }
+}
+
+const index_t::entry_t* index_t::find(const std::string& path) const {
+  const auto it = std::lower_bound(
+      m_entries.begin(), m_entries.end(), path, [](const entry_t& entry, const std::string& p) {
+        return entry.path < p;
+      });
+  return (it != m_entries.end() && it->path == path) ? &(*it) : nullptr;
+}
+
+std::string get_clean_blob_id(const std::string& path) {
+#ifndef _WIN32
+  try {
+    const auto abs_path = file::canonicalize_path(
+        (!path.empty() && path[0] == '/') ? path : file::append_path(file::get_cwd(), path));
+    const auto repo = find_repo(file::get_dir_part(abs_path));
+    if (!repo || abs_path.size() <= repo->work_tree.size() + 1U) {
+      return std::string();
+    }
+
+    // The blob ID identifies the clean content, so it can only be used if the file is checked out
+    // as is.
+    if (repo->may_convert || may_convert_file(*repo, abs_path)) {
+      return std::string();
+    }
+
+    const auto* entry = repo->index.find(abs_path.substr(repo->work_tree.size() + 1U));
+    if (entry == nullptr) {
+      return std::string();
+    }
+
+    // Compare the file status information to the index entry (in the same way as git does).
+    struct stat file_stat;
+    if (::lstat(abs_path.c_str(), &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+      return std::string();
+    }
+#ifdef __APPLE__
+    const auto& mtime = file_stat.st_mtimespec;
+    const auto& ctime = file_stat.st_ctimespec;
+#else
+    const auto& mtime = file_stat.st_mtim;
+    const auto& ctime = file_stat.st_ctim;
+#endif
+    if (entry->mtime_sec != static_cast<uint32_t>(mtime.tv_sec) ||
+        entry->mtime_nsec != static_cast<uint32_t>(mtime.tv_nsec) ||
+        entry->ctime_sec != static_cast<uint32_t>(ctime.tv_sec) ||
+        entry->ctime_nsec != static_cast<uint32_t>(ctime.tv_nsec) ||
+        entry->ino != static_cast<uint32_t>(file_stat.st_ino) ||
+        entry->size != static_cast<uint32_t>(file_stat.st_size)) {
+      return std::string();
+    }
+
+    // A "racily clean" entry (modified in the same time stamp tick as the index was written) may
+    // have been modified without the status information changing.
+    if (entry->mtime_sec > repo->index_mtime_sec ||
+        (entry->mtime_sec == repo->index_mtime_sec &&
+         entry->mtime_nsec >= repo->index_mtime_nsec)) {
+      return std::string();
+    }
+
+    return entry->blob_id;
+  } catch (const std::exception& e) {
+    debug::log(debug::DEBUG) << "Git index lookup failed for " << path << ": " << e.what();
+    return std::string();
+  }
+#else
+  (void)path;
+  return std::string();
+#endif
+}
+
+std::string get_clean_blob_digest(const std::string& path) {
+  const auto blob_id = get_clean_blob_id(path);
+  return blob_id.empty() ? std::string() : (BLOB_DIGEST_PREFIX + blob_id);
+}
+
+bool is_blob_digest(const std::string& digest) {
+  return digest.compare(0, BLOB_DIGEST_PREFIX.size(), BLOB_DIGEST_PREFIX) == 0;
+}
+}  // namespace git
+}  // namespace bcache
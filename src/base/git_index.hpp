@@ -0,0 +1,97 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#ifndef BUILDCACHE_GIT_INDEX_HPP_
+#define BUILDCACHE_GIT_INDEX_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bcache {
+namespace git {
+/// @brief A parsed git index (the ".git/index" file).
+///
+/// Only the information that is needed for identifying clean files is kept, i.e. stage 0 entries
+/// for regular files. Index format versions 2, 3 and 4 are supported.
+class index_t {
+public:
+  /// @brief The cached file status information and blob ID for a file.
+  struct entry_t {
+    std::string path;  ///< The path relative to the work tree root, using "/" separators.
+    uint32_t ctime_sec;
+    uint32_t ctime_nsec;
+    uint32_t mtime_sec;
+    uint32_t mtime_nsec;
+    uint32_t ino;
+    uint32_t size;
+    std::string blob_id;  ///< The blob ID (hexadecimal string).
+  };
+
+  /// @brief Construct an empty index.
+  index_t() = default;
+
+  /// @brief Parse git index data.
+  /// @param data The raw index file data.
+  /// @param size The size of the data.
+  /// @param hash_size The object hash size of the repository (20 for SHA-1, 32 for SHA-256).
+  /// @throws runtime_error if the data could not be parsed.
+  index_t(const uint8_t* data, const size_t size, const size_t hash_size);
+
+  /// @brief Find an entry.
+  /// @param path The path relative to the work tree root, using "/" separators.
+  /// @returns the entry, or nullptr if there is no such (usable) entry.
+  const entry_t* find(const std::string& path) const;
+
+private:
+  std::vector<entry_t> m_entries;  // Sorted by path (as in the index file).
+};
+
+/// @brief Get the git blob ID of a file, if the file is known to be clean.
+///
+/// The file is looked up in the index of the git work tree that contains the file. If the file is
+/// tracked and its file status information (size, time stamps and inode) matches the index entry,
+/// the blob ID from the index is returned without reading the file. The index of each work tree is
+/// only loaded once per process.
+///
+/// Since the blob ID identifies the clean content (as stored in the repository), no blob ID is
+/// returned if the checked out file may differ from the blob, i.e. if core.autocrlf is enabled or
+/// if any attributes file that applies to the file may enable line ending conversion, filters or
+/// other content conversions. This is only supported on POSIX systems.
+/// @param path The path to the file.
+/// @returns the blob ID as a hexadecimal string, or an empty string if the file is not tracked, or
+/// if it may have been modified after the index was last updated.
+std::string get_clean_blob_id(const std::string& path);
+
+/// @brief Get a file digest that is based on the git blob ID of a file.
+///
+/// The digest is prefixed so that it can never be confused with a regular file content hash.
+/// @param path The path to the file.
+/// @returns the digest, or an empty string if the file is not known to be clean (see
+/// get_clean_blob_id()).
+std::string get_clean_blob_digest(const std::string& path);
+
+/// @brief Check if a file digest was produced by get_clean_blob_digest().
+/// @param digest The file digest.
+/// @returns true if the digest is based on a git blob ID.
+bool is_blob_digest(const std::string& digest);
+}  // namespace git
+}  // namespace bcache
+
+#endif  // BUILDCACHE_GIT_INDEX_HPP_
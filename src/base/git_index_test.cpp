@@ -0,0 +1,257 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#include <base/env_utils.hpp>
+#include <base/file_utils.hpp>
+#include <base/git_index.hpp>
+
+#include <doctest/doctest.h>
+
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <utime.h>
+
+#include <ctime>
+#endif
+
+// Workaround for macOS build errors.
+// See: https://github.com/onqtam/doctest/issues/126
+#include <iostream>
+
+using namespace bcache;
+
+namespace {
+const size_t SHA1_SIZE = 20U;
+
+void append_u16(std::vector<uint8_t>& data, const uint32_t x) {
+  data.push_back(static_cast<uint8_t>(x >> 8));
+  data.push_back(static_cast<uint8_t>(x));
+}
+
+void append_u32(std::vector<uint8_t>& data, const uint32_t x) {
+  append_u16(data, x >> 16);
+  append_u16(data, x);
+}
+
+std::vector<uint8_t> make_header(const uint32_t version, const uint32_t num_entries) {
+  std::vector<uint8_t> data = {'D', 'I', 'R', 'C'};
+  append_u32(data, version);
+  append_u32(data, num_entries);
+  return data;
+}
+
+// Append the fixed size part of an index entry, with the size field set to "size", and all hash
+// bytes set to "hash_byte".
+void append_entry_head(std::vector<uint8_t>& data,
+                       const uint32_t mode,
+                       const uint32_t size,
+                       const uint8_t hash_byte,
+                       const uint32_t flags) {
+  for (uint32_t i = 0; i < 5; ++i) {
+    append_u32(data, 100U + i);  // ctime, mtime, dev
+  }
+  append_u32(data, 1234U);  // ino
+  append_u32(data, mode);
+  append_u32(data, 0U);  // uid
+  append_u32(data, 0U);  // gid
+  append_u32(data, size);
+  data.insert(data.end(), SHA1_SIZE, hash_byte);
+  append_u16(data, flags);
+}
+
+void append_v2_entry(std::vector<uint8_t>& data,
+                     const std::string& path,
+                     const uint32_t mode = 0100644U,
+                     const uint32_t flags = 0U) {
+  const auto entry_start = data.size();
+  append_entry_head(data, mode, static_cast<uint32_t>(path.size()), 0xabU, flags | path.size());
+  data.insert(data.end(), path.begin(), path.end());
+  do {
+    data.push_back(0U);
+  } while (((data.size() - entry_start) % 8U) != 0U);
+}
+
+void append_v4_entry(std::vector<uint8_t>& data,
+                     const std::string& suffix,
+                     const uint8_t strip_len,
+                     const uint32_t path_len) {
+  append_entry_head(data, 0100644U, path_len, 0xcdU, path_len);
+  data.push_back(strip_len);
+  data.insert(data.end(), suffix.begin(), suffix.end());
+  data.push_back(0U);
+}
+
+#ifndef _WIN32
+// Write a work tree with the given files, and a git index (version 2) that describes the files as
+// clean. All blob IDs are set to 0x12.
+void make_work_tree(const std::string& work_tree, const std::vector<std::string>& paths) {
+  file::create_dir_with_parents(file::append_path(work_tree, ".git"));
+  auto data = make_header(2U, static_cast<uint32_t>(paths.size()));
+  for (const auto& path : paths) {
+    const auto abs_path = file::append_path(work_tree, path);
+    file::create_dir_with_parents(file::get_dir_part(abs_path));
+    file::write(path, abs_path);
+
+    // Make sure that the file is not racily clean.
+    struct utimbuf times;
+    times.actime = times.modtime = std::time(nullptr) - 10;
+    REQUIRE(::utime(abs_path.c_str(), &times) == 0);
+
+    struct stat file_stat;
+    REQUIRE(::stat(abs_path.c_str(), &file_stat) == 0);
+    const auto entry_start = data.size();
+#ifdef __APPLE__
+    const auto& mtime = file_stat.st_mtimespec;
+    const auto& ctime = file_stat.st_ctimespec;
+#else
+    const auto& mtime = file_stat.st_mtim;
+    const auto& ctime = file_stat.st_ctim;
+#endif
+    append_u32(data, static_cast<uint32_t>(ctime.tv_sec));
+    append_u32(data, static_cast<uint32_t>(ctime.tv_nsec));
+    append_u32(data, static_cast<uint32_t>(mtime.tv_sec));
+    append_u32(data, static_cast<uint32_t>(mtime.tv_nsec));
+    append_u32(data, 0U);  // dev
+    append_u32(data, static_cast<uint32_t>(file_stat.st_ino));
+    append_u32(data, 0100644U);
+    append_u32(data, 0U);  // uid
+    append_u32(data, 0U);  // gid
+    append_u32(data, static_cast<uint32_t>(file_stat.st_size));
+    data.insert(data.end(), SHA1_SIZE, 0x12U);
+    append_u16(data, static_cast<uint32_t>(path.size()));
+    data.insert(data.end(), path.begin(), path.end());
+    do {
+      data.push_back(0U);
+    } while (((data.size() - entry_start) % 8U) != 0U);
+  }
+  data.insert(data.end(), SHA1_SIZE, 0U);  // Checksum.
+  file::write(std::string(data.begin(), data.end()), file::append_path(work_tree, ".git/index"));
+}
+#endif
+}  // namespace
+
+TEST_CASE("Parsing git indexes") {
+  SUBCASE("Version 2") {
+    auto data = make_header(2U, 4U);
+    append_v2_entry(data, "include/a.h");
+    append_v2_entry(data, "include/b.h", 0120000U);         // Symbolic link.
+    append_v2_entry(data, "include/c.h", 0100644U, 0x1000U);  // Stage 1 (merge conflict).
+    append_v2_entry(data, "src/main.cpp");
+    data.insert(data.end(), SHA1_SIZE, 0U);  // Checksum.
+
+    const git::index_t index(data.data(), data.size(), SHA1_SIZE);
+
+    const auto* a = index.find("include/a.h");
+    REQUIRE(a != nullptr);
+    CHECK_EQ(a->ctime_sec, 100U);
+    CHECK_EQ(a->mtime_nsec, 103U);
+    CHECK_EQ(a->ino, 1234U);
+    CHECK_EQ(a->size, 11U);
+    CHECK_EQ(a->blob_id, "abababababababababababababababababababab");
+
+    CHECK(index.find("include/b.h") == nullptr);
+    CHECK(index.find("include/c.h") == nullptr);
+    CHECK(index.find("src/main.cpp") != nullptr);
+    CHECK(index.find("src") == nullptr);
+    CHECK(index.find("src/main.c") == nullptr);
+  }
+
+  SUBCASE("Version 4 (prefix compressed paths)") {
+    auto data = make_header(4U, 3U);
+    append_v4_entry(data, "include/a.h", 0U, 11U);
+    append_v4_entry(data, "b.h", 3U, 11U);  // "include/" + "b.h"
+    append_v4_entry(data, "src/x.c", 11U, 7U);
+    data.insert(data.end(), SHA1_SIZE, 0U);  // Checksum.
+
+    const git::index_t index(data.data(), data.size(), SHA1_SIZE);
+
+    CHECK(index.find("include/a.h") != nullptr);
+    const auto* b = index.find("include/b.h");
+    REQUIRE(b != nullptr);
+    CHECK_EQ(b->blob_id, "cdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcd");
+    CHECK(index.find("src/x.c") != nullptr);
+  }
+
+  SUBCASE("Invalid data") {
+    auto data = make_header(5U, 0U);
+    CHECK_THROWS(git::index_t(data.data(), data.size(), SHA1_SIZE));
+
+    data = make_header(2U, 1U);
+    append_entry_head(data, 0100644U, 0U, 0U, 3U);
+    data.push_back('a');  // Truncated path.
+    CHECK_THROWS(git::index_t(data.data(), data.size(), SHA1_SIZE));
+  }
+}
+
+#ifndef _WIN32
+TEST_CASE("Clean blob IDs") {
+  const auto EXPECTED_ID = std::string("1212121212121212121212121212121212121212");
+
+  file::tmp_file_t tmp_dir(file::get_temp_dir(), "");
+  file::create_dir(tmp_dir.path());
+  const auto root = file::canonicalize_path(tmp_dir.path());
+
+  // Isolate the test from the global and system git config.
+  scoped_set_env_t home_env("HOME", root);
+  scoped_set_env_t xdg_env("XDG_CONFIG_HOME", file::append_path(root, ".config"));
+  scoped_set_env_t nosystem_env("GIT_CONFIG_NOSYSTEM", "1");
+
+  SUBCASE("Files without conversion") {
+    const auto work_tree = file::append_path(root, "plain");
+    make_work_tree(work_tree, {"a.h", "sub/b.h"});
+    file::write("*.png binary\n", file::append_path(work_tree, ".gitattributes"));
+
+    CHECK_EQ(git::get_clean_blob_id(file::append_path(work_tree, "a.h")), EXPECTED_ID);
+    CHECK_EQ(git::get_clean_blob_id(file::append_path(work_tree, "sub/b.h")), EXPECTED_ID);
+    CHECK(git::is_blob_digest(git::get_clean_blob_digest(file::append_path(work_tree, "a.h"))));
+
+    // Modified files are not clean.
+    file::write("modified", file::append_path(work_tree, "a.h"));
+    CHECK_EQ(git::get_clean_blob_id(file::append_path(work_tree, "a.h")), "");
+  }
+
+  SUBCASE("Files with conversion attributes") {
+    const auto work_tree = file::append_path(root, "attributes");
+    make_work_tree(work_tree, {"a.h", "sub/b.h"});
+    file::write("*.h text eol=crlf\n", file::append_path(work_tree, "sub/.gitattributes"));
+
+    CHECK_EQ(git::get_clean_blob_id(file::append_path(work_tree, "a.h")), EXPECTED_ID);
+    CHECK_EQ(git::get_clean_blob_id(file::append_path(work_tree, "sub/b.h")), "");
+  }
+
+  SUBCASE("Repository with autocrlf") {
+    const auto work_tree = file::append_path(root, "autocrlf");
+    make_work_tree(work_tree, {"a.h"});
+    file::write("[core]\n\tautocrlf = true\n", file::append_path(work_tree, ".git/config"));
+
+    CHECK_EQ(git::get_clean_blob_id(file::append_path(work_tree, "a.h")), "");
+  }
+
+  SUBCASE("Global attributes") {
+    const auto work_tree = file::append_path(root, "global");
+    make_work_tree(work_tree, {"a.h"});
+    file::create_dir_with_parents(file::append_path(root, ".config/git"));
+    file::write("* filter=lfs\n", file::append_path(root, ".config/git/attributes"));
+
+    CHECK_EQ(git::get_clean_blob_id(file::append_path(work_tree, "a.h")), "");
+  }
+}
+#endif
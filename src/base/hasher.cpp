@@ -20,6 +20,7 @@
 #include <base/hasher.hpp>
 
 #include <base/file_utils.hpp>
+#include <base/time_macro_scanner.hpp>
 
 #include <algorithm>
 #include <stdexcept>
@@ -38,6 +39,14 @@ namespace {
 const size_t ITEM_SEPARATOR_SIZE = 11;
 const unsigned char ITEM_SEPARATOR[ITEM_SEPARATOR_SIZE] = {42, 0, 254, 1, 5, 7, 195, 40, 3, 0, 14};
 
+// When scanning and hashing data in the same pass, the data is processed in blocks that are small
+// enough to stay in the CPU cache between the two operations.
+const size_t SCAN_BLOCK_SIZE = 16384;
+
+// The longest time macro (__TIMESTAMP__) is 13 characters, so a macro that starts in one block can
+// extend at most this many characters into the next block.
+const size_t SCAN_BLOCK_OVERLAP = 12;
+
 bool is_ar_data(const std::string& data) {
   const char AR_SIGNATURE[] = {0x21, 0x3c, 0x61, 0x72, 0x63, 0x68, 0x3e, 0x0a};
   return (data.size() >= 8 && std::equal(data.cbegin(), data.cbegin() + 8, &AR_SIGNATURE[0]));
@@ -117,6 +126,21 @@ void hasher_t::update_from_file(const std::string& path) {
   inject_separator();
 }
 
+bool hasher_t::update_from_file_with_time_macro_check(const std::string& path) {
+  const auto file_data = file::read(path);
+  bool found = false;
+  for (size_t pos = 0; pos < file_data.size(); pos += SCAN_BLOCK_SIZE) {
+    const auto block_size = std::min(SCAN_BLOCK_SIZE, file_data.size() - pos);
+    if (!found) {
+      const auto scan_size = std::min(block_size + SCAN_BLOCK_OVERLAP, file_data.size() - pos);
+      found = has_time_macros(&file_data[pos], scan_size);
+    }
+    update(&file_data[pos], block_size);
+  }
+  inject_separator();
+  return found;
+}
+
 void hasher_t::update_from_file_deterministic(const std::string& path) {
   const auto file_data = file::read(path);
   if (is_ar_data(file_data)) {
@@ -94,6 +94,15 @@ public:
   /// @throws runtime_error if the operation could not be completed.
   void update_from_file(const std::string& path);
 
+  /// @brief Update the hash with more data, and check the data for time macros.
+  ///
+  /// This is equivalent to update_from_file(), but the data is also scanned for C/C++ time macros
+  /// (see has_time_macros()) in the same pass over the data.
+  /// @param path Path to a file that contains the data to hash.
+  /// @returns true if the file contains any time macros.
+  /// @throws runtime_error if the operation could not be completed.
+  bool update_from_file_with_time_macro_check(const std::string& path);
+
   /// @brief Update the hash with more data.
   ///
   /// This method tries to produce a deterministic hash by employing file format specific heuristics
@@ -17,6 +17,7 @@
 //  3. This notice may not be removed or altered from any source distribution.
 //--------------------------------------------------------------------------------------------------
 
+#include <base/file_utils.hpp>
 #include <base/hasher.hpp>
 
 #include <doctest/doctest.h>
@@ -116,3 +117,32 @@ TEST_CASE("hasher_t() can be copied") {
     CHECK_EQ(result2, "b58be4dce016a838d28afd10f0fb7ee5");
   }
 }
+
+TEST_CASE("hasher_t can check files for time macros") {
+  // Create a file that is larger than the internal scan block size, with a time macro that
+  // straddles a scan block boundary.
+  const file::tmp_file_t tmp_file(file::get_temp_dir(), ".c");
+  std::string data(16384 - 4, ' ');
+  data += "__TIME__";
+  data += std::string(20000, ' ');
+  file::write(data, tmp_file.path());
+
+  SUBCASE("The hash is the same as for update_from_file()") {
+    hasher_t hasher1;
+    hasher1.update_from_file(tmp_file.path());
+    hasher_t hasher2;
+    hasher2.update_from_file_with_time_macro_check(tmp_file.path());
+    CHECK_EQ(hasher1.final().as_string(), hasher2.final().as_string());
+  }
+
+  SUBCASE("Time macros are detected across block boundaries") {
+    hasher_t hasher;
+    CHECK_EQ(hasher.update_from_file_with_time_macro_check(tmp_file.path()), true);
+  }
+
+  SUBCASE("Files without time macros are not flagged") {
+    file::write(std::string(40000, 'x'), tmp_file.path());
+    hasher_t hasher;
+    CHECK_EQ(hasher.update_from_file_with_time_macro_check(tmp_file.path()), false);
+  }
+}
@@ -338,4 +338,16 @@ std::string sha1_hmac(const std::string& key, const std::string& data) {
   return to_string(digest);
 }
 
+bool is_equal_digest(const std::string& a, const std::string& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  unsigned int diff = 0U;
+  for (std::string::size_type i = 0; i < a.size(); ++i) {
+    diff |= static_cast<unsigned int>(static_cast<unsigned char>(a[i]) ^
+                                      static_cast<unsigned char>(b[i]));
+  }
+  return diff == 0U;
+}
+
 }  // namespace bcache
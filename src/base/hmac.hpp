@@ -30,6 +30,15 @@ namespace bcache {
 /// @returns the digest as a binary string (20 bytes long).
 std::string sha1_hmac(const std::string& key, const std::string& data);
 
+/// @brief Compare two digests in constant time.
+///
+/// The time that the comparison takes does not depend on the contents of the digests (only on
+/// their sizes), so it does not reveal how much of a forged digest is correct.
+/// @param a The first digest.
+/// @param b The second digest.
+/// @returns true if the digests are equal.
+bool is_equal_digest(const std::string& a, const std::string& b);
+
 }  // namespace bcache
 
 #endif  // BUILDCACHE_HMAC_HPP_
@@ -80,3 +80,11 @@ TEST_CASE("sha1_hmac() produces expected results") {
     CHECK_EQ(result, "b5442dce0788560bdc2548180868e5cb3c76ecea");
   }
 }
+
+TEST_CASE("is_equal_digest() compares digests") {
+  const auto digest = sha1_hmac("key", "data");
+  CHECK(is_equal_digest(digest, sha1_hmac("key", "data")));
+  CHECK_FALSE(is_equal_digest(digest, sha1_hmac("key", "date")));
+  CHECK_FALSE(is_equal_digest(digest, digest.substr(0, 10)));
+  CHECK(is_equal_digest(std::string(), std::string()));
+}
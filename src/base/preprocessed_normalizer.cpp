@@ -0,0 +1,325 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <base/preprocessed_normalizer.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace bcache {
+namespace {
+/// @brief A parsed line marker, e.g. <tt># 12 "file.h" 1 3</tt> or <tt>#line 12 "file.h"</tt>.
+struct line_marker_t {
+  long line_no = 0;
+  bool has_file_name = false;
+  std::string file_name;  // Escaped, as it appears in the source.
+  std::string flags;
+};
+
+bool is_space(const char c) {
+  return c == ' ' || c == '\t';
+}
+
+bool is_digit(const char c) {
+  return c >= '0' && c <= '9';
+}
+
+bool is_identifier_char(const char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || is_digit(c) || c == '_';
+}
+
+const char* skip_space(const char* p, const char* end) {
+  while (p < end && is_space(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+bool parse_line_marker(const char* begin, const char* end, line_marker_t& marker) {
+  auto p = skip_space(begin, end);
+  if (p == end || *p != '#') {
+    return false;
+  }
+  p = skip_space(p + 1, end);
+  if ((end - p) >= 4 && std::memcmp(p, "line", 4) == 0) {
+    p = skip_space(p + 4, end);
+  }
+
+  // Line number.
+  if (p == end || !is_digit(*p)) {
+    return false;
+  }
+  marker.line_no = 0;
+  while (p < end && is_digit(*p)) {
+    marker.line_no = marker.line_no * 10 + (*p - '0');
+    ++p;
+  }
+  if (p < end && !is_space(*p)) {
+    return false;
+  }
+  p = skip_space(p, end);
+
+  // Optional file name (a string literal).
+  marker.has_file_name = false;
+  marker.file_name.clear();
+  if (p < end && *p == '"') {
+    const auto name_begin = ++p;
+    while (p < end && *p != '"') {
+      p += (*p == '\\' && (p + 1) < end) ? 2 : 1;
+    }
+    if (p == end) {
+      return false;
+    }
+    marker.has_file_name = true;
+    marker.file_name.assign(name_begin, p);
+    p = skip_space(p + 1, end);
+  }
+
+  // Flags (e.g. "1 3 4").
+  auto flags_end = end;
+  while (flags_end > p && (is_space(flags_end[-1]) || flags_end[-1] == '\r')) {
+    --flags_end;
+  }
+  marker.flags.assign(p, flags_end);
+  return true;
+}
+
+/// @brief Check if a quote is preceded by a raw string prefix (R, u8R, uR, UR or LR).
+bool has_raw_string_prefix(const char* begin, const char* quote) {
+  if (quote == begin || quote[-1] != 'R') {
+    return false;
+  }
+  auto p = quote - 1;
+  if ((p - begin) >= 2 && p[-2] == 'u' && p[-1] == '8') {
+    p -= 2;
+  } else if (p > begin && (p[-1] == 'u' || p[-1] == 'U' || p[-1] == 'L')) {
+    --p;
+  }
+  return p == begin || !is_identifier_char(p[-1]);
+}
+
+/// @brief Check if a single quote is a digit separator (e.g. in 1'000) rather than a character
+/// literal.
+bool is_digit_separator(const char* begin, const char* quote) {
+  auto p = quote;
+  while (p > begin && (is_identifier_char(p[-1]) || p[-1] == '\'' || p[-1] == '.')) {
+    --p;
+  }
+  return p < quote && is_digit(*p);
+}
+
+/// @brief Update the raw string literal state for a line of source code.
+///
+/// Ordinary string and character literals are skipped, so that a quote inside them is not mistaken
+/// for the start of a raw string literal.
+/// @param begin The start of the line.
+/// @param end The end of the line.
+/// @param[in,out] raw_string_end The terminator of the current raw string literal (e.g.
+/// <tt>)x"</tt>), or an empty string if the line does not start inside of a raw string literal.
+void scan_raw_strings(const char* begin, const char* end, std::string& raw_string_end) {
+  // The maximum length of a raw string delimiter, according to the C++ standard.
+  const long MAX_DELIMITER_LEN = 16;
+
+  auto p = begin;
+  while (p < end) {
+    if (!raw_string_end.empty()) {
+      const auto* terminator =
+          std::search(p, end, raw_string_end.data(), raw_string_end.data() + raw_string_end.size());
+      if (terminator == end) {
+        return;
+      }
+      p = terminator + raw_string_end.size();
+      raw_string_end.clear();
+      continue;
+    }
+
+    const auto c = *p;
+    if (c == '"' && has_raw_string_prefix(begin, p)) {
+      const auto* delimiter_begin = p + 1;
+      auto* delimiter_end = delimiter_begin;
+      while (delimiter_end < end && (delimiter_end - delimiter_begin) <= MAX_DELIMITER_LEN &&
+             std::strchr("()\\\" \t", *delimiter_end) == nullptr) {
+        ++delimiter_end;
+      }
+      if (delimiter_end < end && *delimiter_end == '(' &&
+          (delimiter_end - delimiter_begin) <= MAX_DELIMITER_LEN) {
+        raw_string_end = ")" + std::string(delimiter_begin, delimiter_end) + "\"";
+        p = delimiter_end + 1;
+        continue;
+      }
+    }
+
+    if ((c == '"') || (c == '\'' && !is_digit_separator(begin, p))) {
+      // Skip an ordinary string or character literal.
+      ++p;
+      while (p < end && *p != c) {
+        p += (*p == '\\' && (p + 1) < end) ? 2 : 1;
+      }
+      p = (p < end) ? p + 1 : end;
+    } else {
+      ++p;
+    }
+  }
+}
+
+std::string unescape(const std::string& str) {
+  std::string result;
+  result.reserve(str.size());
+  for (size_t i = 0; i < str.size(); ++i) {
+    if (str[i] == '\\' && (i + 1) < str.size()) {
+      ++i;
+    }
+    result += str[i];
+  }
+  return result;
+}
+
+std::string escape(const std::string& str) {
+  std::string result;
+  result.reserve(str.size());
+  for (const auto c : str) {
+    if (c == '\\' || c == '"') {
+      result += '\\';
+    }
+    result += c;
+  }
+  return result;
+}
+
+std::string map_file_name(const std::string& escaped_name, const prefix_map_list_t& prefix_maps) {
+  if (prefix_maps.empty()) {
+    return escaped_name;
+  }
+  const auto name = unescape(escaped_name);
+  for (auto it = prefix_maps.rbegin(); it != prefix_maps.rend(); ++it) {
+    const auto& old_prefix = it->first;
+    if (!old_prefix.empty() && name.compare(0, old_prefix.size(), old_prefix) == 0) {
+      return escape(it->second + name.substr(old_prefix.size()));
+    }
+  }
+  return escaped_name;
+}
+
+void append_marker(std::string& result,
+                   const long line_no,
+                   const std::string& file_name,
+                   const std::string& flags) {
+  result += "# ";
+  result += std::to_string(line_no);
+  result += " \"";
+  result += file_name;
+  result += '"';
+  if (!flags.empty()) {
+    result += ' ';
+    result += flags;
+  }
+  result += '\n';
+}
+}  // namespace
+
+std::string normalize_preprocessed_source(const std::string& source,
+                                          const prefix_map_list_t& prefix_maps,
+                                          const bool collapse_whitespace) {
+  std::string result;
+  result.reserve(source.size());
+
+  // State for collapsing whitespace.
+  std::string current_file;
+  long line_no = 1;
+  long next_emitted_line_no = 1;
+  bool pending_file_record = false;
+  std::string pending_flags;
+
+  // The contents of raw string literals must be kept verbatim, even if they look like line markers
+  // or have trailing whitespace.
+  std::string raw_string_end;
+
+  line_marker_t marker;
+  const auto* p = source.data();
+  const auto* const end = p + source.size();
+  while (p < end) {
+    // Find the end of the line.
+    const auto* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+    const auto* line_end = (eol != nullptr) ? eol : end;
+    const auto* next = (eol != nullptr) ? eol + 1 : end;
+
+    const auto starts_in_raw_string = !raw_string_end.empty();
+    scan_raw_strings(p, line_end, raw_string_end);
+    const auto ends_in_raw_string = !raw_string_end.empty();
+
+    if (!starts_in_raw_string && parse_line_marker(p, line_end, marker)) {
+      const auto file_name = marker.has_file_name
+                                 ? map_file_name(marker.file_name, prefix_maps)
+                                 : current_file;
+      if (collapse_whitespace) {
+        // A marker that enters or leaves a file (or changes the file) must be recorded, but plain
+        // line number changes are implied by the line numbers of the following lines.
+        if (!marker.flags.empty() || file_name != current_file) {
+          if (pending_file_record) {
+            append_marker(result, line_no, current_file, pending_flags);
+          }
+          pending_file_record = true;
+          pending_flags = marker.flags;
+        }
+        line_no = marker.line_no;
+      } else if (marker.has_file_name) {
+        append_marker(result, marker.line_no, file_name, marker.flags);
+      } else {
+        result.append(p, next);
+      }
+      current_file = file_name;
+    } else if (collapse_whitespace) {
+      // Strip trailing whitespace (unless it is part of a raw string literal).
+      auto content_end = line_end;
+      while (!ends_in_raw_string && content_end > p &&
+             (is_space(content_end[-1]) || content_end[-1] == '\r')) {
+        --content_end;
+      }
+
+      // Emit non-empty lines, with explicit line information when needed. Lines inside of raw
+      // string literals are always emitted, even if they are empty.
+      if (content_end > p || starts_in_raw_string) {
+        if (pending_file_record) {
+          append_marker(result, line_no, current_file, pending_flags);
+          pending_file_record = false;
+        } else if (line_no != next_emitted_line_no) {
+          result += "# ";
+          result += std::to_string(line_no);
+          result += '\n';
+        }
+        result.append(p, content_end);
+        result += '\n';
+        next_emitted_line_no = line_no + 1;
+      }
+      ++line_no;
+    } else {
+      result.append(p, next);
+    }
+
+    p = next;
+  }
+
+  // Flush any trailing file record (e.g. an empty header file at the end of the source).
+  if (pending_file_record) {
+    append_marker(result, line_no, current_file, pending_flags);
+  }
+
+  return result;
+}
+}  // namespace bcache
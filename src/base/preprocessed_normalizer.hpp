@@ -0,0 +1,58 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef BUILDCACHE_PREPROCESSED_NORMALIZER_HPP_
+#define BUILDCACHE_PREPROCESSED_NORMALIZER_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bcache {
+/// @brief A list of path prefix mappings (old prefix, new prefix).
+///
+/// When several mappings match a path, the last matching mapping in the list is used (this is
+/// consistent with how GCC handles -fdebug-prefix-map).
+using prefix_map_list_t = std::vector<std::pair<std::string, std::string>>;
+
+/// @brief Normalize preprocessed C/C++ source code.
+///
+/// The normalized source is only meant for hashing: It represents the same sequence of source lines
+/// with the same file and line number information as the original preprocessed source, so two
+/// sources that normalize to the same string produce identical line information in the compiled
+/// output (e.g. in debug or coverage information).
+///
+/// The following normalizations are performed:
+///  - File names in line markers (e.g. <tt># 12 "/path/to/file.h" 1</tt>) are rewritten using the
+///    given prefix mappings.
+///  - Optionally, whitespace that does not affect the line information is removed. Line markers
+///    and blank lines are replaced by a canonical representation of the same line numbers, and
+///    trailing whitespace is removed.
+///
+/// The contents of raw string literals (e.g. <tt>R"x( ... )x"</tt>) are always left verbatim.
+/// @param source The preprocessed source code.
+/// @param prefix_maps Path prefix mappings to apply to line marker file names.
+/// @param collapse_whitespace Whether or not to remove irrelevant whitespace.
+/// @returns the normalized source.
+std::string normalize_preprocessed_source(const std::string& source,
+                                          const prefix_map_list_t& prefix_maps,
+                                          const bool collapse_whitespace);
+}  // namespace bcache
+
+#endif  // BUILDCACHE_PREPROCESSED_NORMALIZER_HPP_
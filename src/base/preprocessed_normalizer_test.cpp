@@ -0,0 +1,157 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <base/preprocessed_normalizer.hpp>
+
+#include <doctest/doctest.h>
+
+#include <string>
+
+// Workaround for macOS build errors.
+// See: https://github.com/onqtam/doctest/issues/126
+#include <iostream>
+
+using namespace bcache;
+
+TEST_CASE("normalize_preprocessed_source() maps line marker paths") {
+  const prefix_map_list_t prefix_maps = {{"/home/a/src", "."}, {"/home/a/src/lib", "lib"}};
+
+  SUBCASE("Matching paths are mapped, and the last matching map is used") {
+    const std::string source =
+        "# 1 \"/home/a/src/main.c\"\n"
+        "# 1 \"/home/a/src/lib/foo.h\" 1\n"
+        "int foo(void);\n"
+        "# 2 \"/home/a/src/main.c\" 2\n"
+        "#line 7 \"/usr/include/stdio.h\"\n";
+    const std::string expected =
+        "# 1 \"./main.c\"\n"
+        "# 1 \"lib/foo.h\" 1\n"
+        "int foo(void);\n"
+        "# 2 \"./main.c\" 2\n"
+        "# 7 \"/usr/include/stdio.h\"\n";
+    CHECK_EQ(normalize_preprocessed_source(source, prefix_maps, false), expected);
+  }
+
+  SUBCASE("Escaped paths are handled") {
+    const prefix_map_list_t windows_maps = {{"C:\\src", "."}};
+    const std::string source = "# 1 \"C:\\\\src\\\\main.c\"\nint x;\n";
+    const std::string expected = "# 1 \".\\\\main.c\"\nint x;\n";
+    CHECK_EQ(normalize_preprocessed_source(source, windows_maps, false), expected);
+  }
+
+  SUBCASE("Other lines are left untouched") {
+    const std::string source = "#pragma once  \n\n  int   x;\r\n# define X\n";
+    CHECK_EQ(normalize_preprocessed_source(source, prefix_maps, false), source);
+  }
+}
+
+TEST_CASE("normalize_preprocessed_source() collapses whitespace") {
+  const prefix_map_list_t no_maps;
+
+  SUBCASE("Blank lines and line markers are equivalent") {
+    const std::string source1 =
+        "# 1 \"main.c\"\n"
+        "int a;\n"
+        "\n"
+        "\n"
+        "\n"
+        "int b;   \n";
+    const std::string source2 =
+        "# 1 \"main.c\"\n"
+        "int a;\n"
+        "# 5 \"main.c\"\n"
+        "int b;\n";
+    const auto result1 = normalize_preprocessed_source(source1, no_maps, true);
+    const auto result2 = normalize_preprocessed_source(source2, no_maps, true);
+    CHECK_EQ(result1, result2);
+    CHECK_EQ(result1, "# 1 \"main.c\"\nint a;\n# 5\nint b;\n");
+  }
+
+  SUBCASE("Different line numbers are not equivalent") {
+    const std::string source1 = "# 1 \"main.c\"\nint a;\n\nint b;\n";
+    const std::string source2 = "# 1 \"main.c\"\nint a;\nint b;\n";
+    CHECK_NE(normalize_preprocessed_source(source1, no_maps, true),
+             normalize_preprocessed_source(source2, no_maps, true));
+  }
+
+  SUBCASE("Leading whitespace is significant") {
+    const std::string source1 = "# 1 \"main.c\"\nint a;\n";
+    const std::string source2 = "# 1 \"main.c\"\n  int a;\n";
+    CHECK_NE(normalize_preprocessed_source(source1, no_maps, true),
+             normalize_preprocessed_source(source2, no_maps, true));
+  }
+
+  SUBCASE("File changes are preserved") {
+    const std::string source =
+        "# 1 \"main.c\"\n"
+        "# 1 \"empty.h\" 1\n"
+        "# 2 \"main.c\" 2\n"
+        "\n"
+        "int a;\n";
+    CHECK_EQ(normalize_preprocessed_source(source, no_maps, true),
+             "# 1 \"main.c\"\n# 1 \"empty.h\" 1\n# 3 \"main.c\" 2\nint a;\n");
+  }
+}
+
+TEST_CASE("normalize_preprocessed_source() keeps raw string literals verbatim") {
+  const prefix_map_list_t prefix_maps = {{"/home/a/src", "."}};
+
+  SUBCASE("Line markers and whitespace inside of raw strings are kept") {
+    const std::string source =
+        "# 1 \"/home/a/src/main.cpp\"\n"
+        "const char* s = R\"x(first  \n"
+        "# 12 \"/home/a/src/foo.h\"\n"
+        "\n"
+        "  )\"  \n"
+        "last)x\";  \n"
+        "int y;\n";
+    const std::string expected =
+        "# 1 \"./main.cpp\"\n"
+        "const char* s = R\"x(first  \n"
+        "# 12 \"/home/a/src/foo.h\"\n"
+        "\n"
+        "  )\"  \n"
+        "last)x\";\n"
+        "int y;\n";
+    CHECK_EQ(normalize_preprocessed_source(source, prefix_maps, true), expected);
+    CHECK_EQ(normalize_preprocessed_source(source, prefix_maps, false),
+             "# 1 \"./main.cpp\"\n" + source.substr(source.find('\n') + 1));
+  }
+
+  SUBCASE("Different raw string contents give different results") {
+    const std::string source1 = "auto s = R\"(a \n)\";\n";
+    const std::string source2 = "auto s = R\"(a\n)\";\n";
+    CHECK_NE(normalize_preprocessed_source(source1, prefix_maps, true),
+             normalize_preprocessed_source(source2, prefix_maps, true));
+  }
+
+  SUBCASE("Quotes that do not start raw strings are ignored") {
+    const std::string source =
+        "auto a = \"R\\\"(\";  \n"
+        "auto b = 1'000'000;  \n"
+        "auto c = FOOR\"(\";  \n"
+        "auto d = u8R\"(x)\";  \n";
+    const std::string expected =
+        "auto a = \"R\\\"(\";\n"
+        "auto b = 1'000'000;\n"
+        "auto c = FOOR\"(\";\n"
+        "auto d = u8R\"(x)\";\n";
+    CHECK_EQ(normalize_preprocessed_source(source, prefix_maps, true), expected);
+  }
+}
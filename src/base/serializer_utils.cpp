@@ -39,6 +39,10 @@ std::string from_int(const int32_t x) {
   return data;
 }
 
+std::string from_int64(const int64_t x) {
+  return from_int(static_cast<int32_t>(x)) + from_int(static_cast<int32_t>(x >> 32));
+}
+
 std::string from_string(const std::string& x) {
   return from_int(static_cast<int32_t>(x.size())) + x;
 }
@@ -78,6 +82,12 @@ int32_t to_int(const std::string& data, std::string::size_type& pos) {
                               (static_cast<uint32_t>(static_cast<uint8_t>(data[pos - 1])) << 24));
 }
 
+int64_t to_int64(const std::string& data, std::string::size_type& pos) {
+  const auto low = static_cast<uint32_t>(to_int(data, pos));
+  const auto high = static_cast<uint32_t>(to_int(data, pos));
+  return static_cast<int64_t>(static_cast<uint64_t>(low) | (static_cast<uint64_t>(high) << 32));
+}
+
 std::string to_string(const std::string& data, std::string::size_type& pos) {
   const auto size = static_cast<std::string::size_type>(to_int(data, pos));
   if ((pos + size) > data.size()) {
@@ -29,12 +29,14 @@ namespace bcache {
 namespace serialize {
 std::string from_bool(const bool x);
 std::string from_int(const int32_t x);
+std::string from_int64(const int64_t x);
 std::string from_string(const std::string& x);
 std::string from_vector(const std::vector<std::string>& x);
 std::string from_map(const std::map<std::string, std::string>& x);
 
 bool to_bool(const std::string& data, std::string::size_type& pos);
 int32_t to_int(const std::string& data, std::string::size_type& pos);
+int64_t to_int64(const std::string& data, std::string::size_type& pos);
 std::string to_string(const std::string& data, std::string::size_type& pos);
 std::vector<std::string> to_vector(const std::string& data, std::string::size_type& pos);
 std::map<std::string, std::string> to_map(const std::string& data, std::string::size_type& pos);
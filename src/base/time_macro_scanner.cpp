@@ -0,0 +1,195 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <base/time_macro_scanner.hpp>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#define BUILDCACHE_HAS_SSE2 1
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BUILDCACHE_HAS_AVX2 1
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define BUILDCACHE_HAS_NEON 1
+#endif
+
+namespace bcache {
+namespace {
+// All the time macros start with "__" followed by either 'T' or 'D'. The SIMD scanners search for
+// that three character prefix, and any candidates are then verified by verify_candidate().
+const size_t PREFIX_SIZE = 3;
+
+bool verify_candidate(const char* data, const size_t size) {
+  // Note: The caller has already checked the "__T" or "__D" prefix.
+  if (size >= 8 &&
+      (std::memcmp(data, "__TIME__", 8) == 0 || std::memcmp(data, "__DATE__", 8) == 0)) {
+    return true;
+  }
+  return size >= 13 && std::memcmp(data, "__TIMESTAMP__", 13) == 0;
+}
+
+bool is_candidate(const char* data, const size_t size) {
+  return size >= PREFIX_SIZE && data[0] == '_' && data[1] == '_' &&
+         (data[2] == 'T' || data[2] == 'D');
+}
+
+bool scan_scalar(const char* data, const size_t size, size_t pos) {
+  while (pos < size) {
+    const auto* next = static_cast<const char*>(std::memchr(data + pos, '_', size - pos));
+    if (next == nullptr) {
+      break;
+    }
+    pos = static_cast<size_t>(next - data);
+    if (is_candidate(next, size - pos) && verify_candidate(next, size - pos)) {
+      return true;
+    }
+    ++pos;
+  }
+  return false;
+}
+
+#if defined(BUILDCACHE_HAS_SSE2)
+size_t count_trailing_zeros(const unsigned x) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, x);
+  return static_cast<size_t>(index);
+#else
+  return static_cast<size_t>(__builtin_ctz(x));
+#endif
+}
+
+bool scan_sse2(const char* data, const size_t size) {
+  const auto underscore = _mm_set1_epi8('_');
+  const auto letter_t = _mm_set1_epi8('T');
+  const auto letter_d = _mm_set1_epi8('D');
+  size_t pos = 0;
+  for (; pos + 16 + (PREFIX_SIZE - 1) <= size; pos += 16) {
+    const auto* p = data + pos;
+    const auto c0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const auto c1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+    const auto c2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2));
+    const auto match = _mm_and_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(c0, underscore), _mm_cmpeq_epi8(c1, underscore)),
+        _mm_or_si128(_mm_cmpeq_epi8(c2, letter_t), _mm_cmpeq_epi8(c2, letter_d)));
+    auto mask = static_cast<unsigned>(_mm_movemask_epi8(match));
+    while (mask != 0U) {
+      const auto bit = count_trailing_zeros(mask);
+      if (verify_candidate(p + bit, size - (pos + bit))) {
+        return true;
+      }
+      mask &= mask - 1U;
+    }
+  }
+  return scan_scalar(data, size, pos);
+}
+#endif
+
+#if defined(BUILDCACHE_HAS_AVX2)
+__attribute__((target("avx2"))) bool scan_avx2(const char* data, const size_t size) {
+  const auto underscore = _mm256_set1_epi8('_');
+  const auto letter_t = _mm256_set1_epi8('T');
+  const auto letter_d = _mm256_set1_epi8('D');
+  size_t pos = 0;
+  for (; pos + 32 + (PREFIX_SIZE - 1) <= size; pos += 32) {
+    const auto* p = data + pos;
+    const auto c0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const auto c1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+    const auto c2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 2));
+    const auto match = _mm256_and_si256(
+        _mm256_and_si256(_mm256_cmpeq_epi8(c0, underscore), _mm256_cmpeq_epi8(c1, underscore)),
+        _mm256_or_si256(_mm256_cmpeq_epi8(c2, letter_t), _mm256_cmpeq_epi8(c2, letter_d)));
+    auto mask = static_cast<unsigned>(_mm256_movemask_epi8(match));
+    while (mask != 0U) {
+      const auto bit = count_trailing_zeros(mask);
+      if (verify_candidate(p + bit, size - (pos + bit))) {
+        return true;
+      }
+      mask &= mask - 1U;
+    }
+  }
+  return scan_scalar(data, size, pos);
+}
+#endif
+
+#if defined(BUILDCACHE_HAS_NEON)
+bool scan_neon(const char* data, const size_t size) {
+  const auto underscore = vdupq_n_u8('_');
+  const auto letter_t = vdupq_n_u8('T');
+  const auto letter_d = vdupq_n_u8('D');
+  size_t pos = 0;
+  for (; pos + 16 + (PREFIX_SIZE - 1) <= size; pos += 16) {
+    const auto* p = reinterpret_cast<const uint8_t*>(data + pos);
+    const auto c0 = vld1q_u8(p);
+    const auto c1 = vld1q_u8(p + 1);
+    const auto c2 = vld1q_u8(p + 2);
+    const auto match =
+        vandq_u8(vandq_u8(vceqq_u8(c0, underscore), vceqq_u8(c1, underscore)),
+                 vorrq_u8(vceqq_u8(c2, letter_t), vceqq_u8(c2, letter_d)));
+    if (vmaxvq_u8(match) != 0) {
+      // Candidates are rare, so we verify the entire block with the scalar code.
+      for (size_t i = 0; i < 16; ++i) {
+        const auto* candidate = data + pos + i;
+        if (is_candidate(candidate, size - (pos + i)) &&
+            verify_candidate(candidate, size - (pos + i))) {
+          return true;
+        }
+      }
+    }
+  }
+  return scan_scalar(data, size, pos);
+}
+#endif
+
+#if !defined(BUILDCACHE_HAS_SSE2) && !defined(BUILDCACHE_HAS_NEON)
+bool scan_generic(const char* data, const size_t size) {
+  return scan_scalar(data, size, 0);
+}
+#endif
+
+using scan_func_t = bool (*)(const char*, const size_t);
+
+scan_func_t select_scan_func() {
+#if defined(BUILDCACHE_HAS_AVX2)
+  if (__builtin_cpu_supports("avx2")) {
+    return scan_avx2;
+  }
+#endif
+#if defined(BUILDCACHE_HAS_SSE2)
+  return scan_sse2;
+#elif defined(BUILDCACHE_HAS_NEON)
+  return scan_neon;
+#else
+  return scan_generic;
+#endif
+}
+}  // namespace
+
+bool has_time_macros(const char* data, const size_t size) {
+  static const auto scan_func = select_scan_func();
+  return scan_func(data, size);
+}
+}  // namespace bcache
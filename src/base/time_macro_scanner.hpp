@@ -0,0 +1,40 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef BUILDCACHE_TIME_MACRO_SCANNER_HPP_
+#define BUILDCACHE_TIME_MACRO_SCANNER_HPP_
+
+#include <cstddef>
+
+namespace bcache {
+/// @brief Check if a block of data contains any time macros.
+///
+/// The C/C++ preprocessor macros __DATE__, __TIME__ and __TIMESTAMP__ expand to the current date
+/// and/or time, which means that a source file that uses any of them can not be cached based on
+/// the file contents alone.
+///
+/// The scanner uses SIMD instructions where available (SSE2/AVX2 on x86, NEON on ARM64), and a
+/// scalar implementation elsewhere. It may report false positives (e.g. in comments).
+/// @param data Pointer to the data.
+/// @param size Number of bytes to scan.
+/// @returns true if any time macros were found.
+bool has_time_macros(const char* data, const size_t size);
+}  // namespace bcache
+
+#endif  // BUILDCACHE_TIME_MACRO_SCANNER_HPP_
@@ -0,0 +1,104 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <base/file_utils.hpp>
+#include <base/hasher.hpp>
+#include <base/time_macro_scanner.hpp>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace bcache;
+
+namespace {
+const int NUM_LOOPS = 20;
+
+// Generate data that resembles preprocessed C++ code (lots of identifiers with underscores).
+std::string make_test_data(const size_t size) {
+  const std::string code =
+      "  template <typename _Tp, typename _Alloc = std::allocator<_Tp> >\n"
+      "  class vector : protected _Vector_base<_Tp, _Alloc> {\n"
+      "#if __cplusplus >= 201103L\n"
+      "    static_assert(is_same<typename remove_cv<_Tp>::type, _Tp>::value, \"\");\n"
+      "#endif\n"
+      "    typedef __gnu_cxx::__alloc_traits<_Tp_alloc_type> _Alloc_traits;\n";
+  std::string result;
+  result.reserve(size + code.size());
+  while (result.size() < size) {
+    result += code;
+  }
+  result.resize(size);
+  return result;
+}
+
+template <typename F>
+void benchmark(const std::string& name, const size_t size, F func) {
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < NUM_LOOPS; ++i) {
+    func();
+  }
+  const auto t1 = std::chrono::steady_clock::now();
+  const auto seconds = std::chrono::duration<double>(t1 - t0).count();
+  const auto mib_per_s = (static_cast<double>(size) * NUM_LOOPS) / (seconds * 1024.0 * 1024.0);
+  std::cout << std::left << std::setw(22) << name << std::right << std::fixed
+            << std::setprecision(1) << std::setw(10) << mib_per_s << " MiB/s\n";
+}
+}  // namespace
+
+int main(int argc, const char** argv) {
+  if (argc > 2) {
+    std::cout << "Usage: " << argv[0] << " [size]\n";
+    std::cout << "  size  Number of bytes of test data (default: 64 MiB)\n";
+    return 1;
+  }
+  const size_t size = (argc == 2) ? static_cast<size_t>(std::stoll(argv[1])) : (64U << 20);
+
+  // Write the test data to a temporary file.
+  const file::tmp_file_t tmp_file(file::get_temp_dir(), ".ii");
+  const auto data = make_test_data(size);
+  file::write(data, tmp_file.path());
+
+  bool found = false;
+  benchmark("scan (memory)", size, [&data, &found] {
+    found = has_time_macros(data.data(), data.size()) || found;
+  });
+  benchmark("hash (memory)", size, [&data] {
+    hasher_t hasher;
+    hasher.update(data);
+    (void)hasher.final();
+  });
+  benchmark("hash (file)", size, [&tmp_file] {
+    hasher_t hasher;
+    hasher.update_from_file(tmp_file.path());
+    (void)hasher.final();
+  });
+  benchmark("hash + scan (file)", size, [&tmp_file, &found] {
+    hasher_t hasher;
+    found = hasher.update_from_file_with_time_macro_check(tmp_file.path()) || found;
+    (void)hasher.final();
+  });
+
+  if (found) {
+    std::cerr << "*** Error: Unexpected time macro in the test data\n";
+    return 1;
+  }
+  return 0;
+}
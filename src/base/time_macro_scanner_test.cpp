@@ -0,0 +1,84 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <base/time_macro_scanner.hpp>
+
+#include <doctest/doctest.h>
+
+#include <string>
+
+// Workaround for macOS build errors.
+// See: https://github.com/onqtam/doctest/issues/126
+#include <iostream>
+
+using namespace bcache;
+
+namespace {
+bool has_time_macros(const std::string& str) {
+  return bcache::has_time_macros(str.data(), str.size());
+}
+
+std::string make_filler(const size_t size) {
+  // Typical C++ code, with many underscores but no time macros.
+  const std::string code =
+      "#if __cplusplus >= 201103L\nstatic int __x_T = __DEPRECATED_D_;\n#endif\n";
+  std::string result;
+  while (result.size() < size) {
+    result += code;
+  }
+  return result.substr(0, size);
+}
+}  // namespace
+
+TEST_CASE("has_time_macros() finds time macros") {
+  for (const auto& macro : {"__DATE__", "__TIME__", "__TIMESTAMP__"}) {
+    SUBCASE(macro) {
+      // Try many different positions and sizes, to exercise the SIMD and the scalar code paths.
+      for (size_t pos = 0; pos < 100; ++pos) {
+        for (size_t tail = 0; tail < 40; tail += 13) {
+          const auto data = make_filler(pos) + macro + make_filler(tail);
+          CHECK_EQ(has_time_macros(data), true);
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("has_time_macros() ignores non-macros") {
+  SUBCASE("Empty data") {
+    CHECK_EQ(has_time_macros(std::string()), false);
+  }
+
+  SUBCASE("Regular code") {
+    for (size_t size = 0; size < 300; size += 7) {
+      CHECK_EQ(has_time_macros(make_filler(size)), false);
+    }
+  }
+
+  SUBCASE("Truncated macros") {
+    CHECK_EQ(has_time_macros(make_filler(50) + "__TIME_"), false);
+    CHECK_EQ(has_time_macros(make_filler(50) + "__DATE"), false);
+    CHECK_EQ(has_time_macros(make_filler(50) + "__TIMESTAMP_"), false);
+    CHECK_EQ(has_time_macros("_TIME__" + make_filler(50)), false);
+  }
+
+  SUBCASE("Other identifiers") {
+    CHECK_EQ(has_time_macros(make_filler(50) + "__TIMEOUT__ __DATA__" + make_filler(50)), false);
+  }
+}
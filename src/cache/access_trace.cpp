@@ -0,0 +1,164 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------------------
+// An access trace is a sequence of fixed size records (little endian), with the following layout:
+//
+//  Offset  Size  Description
+//  ------  ----  -----------
+//  0       1     Format version (currently 1)
+//  1       1     Event (see event_t)
+//  2       1     Tier (see tier_t)
+//  3       5     (reserved, zero)
+//  8       16    Key (binary version of the hex hash string)
+//  24      8     Time stamp (milliseconds since the epoch)
+//  32      8     Entry size (bytes)
+//  40      8     Cost (milliseconds)
+//
+// Since every record is written with a single append operation, several BuildCache processes can
+// write to the same trace file concurrently.
+//--------------------------------------------------------------------------------------------------
+
+#include <cache/access_trace.hpp>
+
+#include <base/file_utils.hpp>
+#include <base/hasher.hpp>
+#include <base/serializer_utils.hpp>
+#include <config/configuration.hpp>
+
+#include <chrono>
+#include <stdexcept>
+
+namespace bcache {
+namespace trace {
+const std::size_t RECORD_SIZE = 48;
+
+namespace {
+const uint8_t TRACE_FORMAT_VERSION = 1;
+const std::size_t KEY_SIZE = 16;
+
+int from_hex(const char c) {
+  if ((c >= '0') && (c <= '9')) {
+    return c - '0';
+  }
+  if ((c >= 'a') && (c <= 'f')) {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+std::string encode_key(const std::string& key) {
+  // Keys are normally hex strings of the right size, but just in case we hash anything else.
+  std::string result(KEY_SIZE, 0);
+  if (key.size() == 2 * KEY_SIZE) {
+    auto valid = true;
+    for (std::size_t i = 0; i < KEY_SIZE && valid; ++i) {
+      const auto hi = from_hex(key[2 * i]);
+      const auto lo = from_hex(key[2 * i + 1]);
+      valid = (hi >= 0) && (lo >= 0);
+      result[i] = static_cast<char>((hi << 4) | lo);
+    }
+    if (valid) {
+      return result;
+    }
+  }
+  hasher_t hasher;
+  hasher.update(key);
+  const auto hash = hasher.final();
+  return std::string(reinterpret_cast<const char*>(hash.data()), KEY_SIZE);
+}
+
+std::string decode_key(const std::string& data, const std::size_t pos) {
+  static const char HEX_LUT[16] = {
+      '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+  std::string result;
+  for (std::size_t i = 0; i < KEY_SIZE; ++i) {
+    const auto b = static_cast<uint8_t>(data[pos + i]);
+    result += HEX_LUT[b >> 4];
+    result += HEX_LUT[b & 15];
+  }
+  return result;
+}
+}  // namespace
+
+std::string encode(const record_t& record) {
+  std::string data(8, 0);
+  data[0] = static_cast<char>(TRACE_FORMAT_VERSION);
+  data[1] = static_cast<char>(record.event);
+  data[2] = static_cast<char>(record.tier);
+  data += encode_key(record.key);
+  data += serialize::from_int64(record.timestamp_ms);
+  data += serialize::from_int64(record.size);
+  data += serialize::from_int64(record.cost_ms);
+  return data;
+}
+
+std::vector<record_t> decode(const std::string& data) {
+  if ((data.size() % RECORD_SIZE) != 0) {
+    throw std::runtime_error("Invalid access trace size.");
+  }
+
+  std::vector<record_t> records;
+  records.reserve(data.size() / RECORD_SIZE);
+  for (std::string::size_type pos = 0; pos < data.size();) {
+    if (static_cast<uint8_t>(data[pos]) != TRACE_FORMAT_VERSION) {
+      throw std::runtime_error("Unsupported access trace format version.");
+    }
+    record_t record;
+    record.event = static_cast<event_t>(data[pos + 1]);
+    record.tier = static_cast<tier_t>(data[pos + 2]);
+    record.key = decode_key(data, pos + 8);
+    pos += 8 + KEY_SIZE;
+    record.timestamp_ms = serialize::to_int64(data, pos);
+    record.size = serialize::to_int64(data, pos);
+    record.cost_ms = serialize::to_int64(data, pos);
+    records.emplace_back(record);
+  }
+  return records;
+}
+
+void record(const event_t event,
+            const tier_t tier,
+            const std::string& key,
+            const int64_t size,
+            const int64_t cost_ms) noexcept {
+  const auto& trace_file = config::trace_file();
+  if (trace_file.empty()) {
+    return;
+  }
+
+  try {
+    record_t record;
+    record.event = event;
+    record.tier = tier;
+    record.key = key;
+    record.timestamp_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    record.size = size;
+    record.cost_ms = cost_ms;
+    file::append(encode(record), trace_file);
+  } catch (...) {
+    // Tracing must never break a build.
+  }
+}
+
+}  // namespace trace
+}  // namespace bcache
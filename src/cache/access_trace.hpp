@@ -0,0 +1,82 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef BUILDCACHE_ACCESS_TRACE_HPP_
+#define BUILDCACHE_ACCESS_TRACE_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bcache {
+namespace trace {
+/// @brief Cache events that are recorded in an access trace.
+enum class event_t : uint8_t {
+  LOOKUP_HIT = 1,   ///< A cache lookup that resulted in a hit.
+  LOOKUP_MISS = 2,  ///< A cache lookup that resulted in a miss.
+  INSERT = 3,       ///< An entry was added to the cache.
+  EVICT = 4         ///< An entry was removed from the cache.
+};
+
+/// @brief Cache tiers.
+enum class tier_t : uint8_t {
+  LOCAL = 1,  ///< The local cache.
+  REMOTE = 2  ///< The remote cache.
+};
+
+/// @brief A single access trace record.
+struct record_t {
+  event_t event;
+  tier_t tier;
+  std::string key;       ///< The cache entry key (a hex hash string).
+  int64_t timestamp_ms;  ///< Milliseconds since the epoch.
+  int64_t size;          ///< The size of the cache entry (in bytes), or zero if unknown.
+  int64_t cost_ms;       ///< The time it takes to run the program, or zero if unknown.
+};
+
+/// @brief The size of an encoded record (in bytes).
+extern const std::size_t RECORD_SIZE;
+
+/// @brief Encode a record in the binary trace format.
+/// @param record The record to encode.
+/// @returns the binary data (RECORD_SIZE bytes).
+std::string encode(const record_t& record);
+
+/// @brief Decode records from binary trace data.
+/// @param data The binary trace data.
+/// @returns the decoded records.
+/// @throws runtime_error if the data is not a valid trace.
+std::vector<record_t> decode(const std::string& data);
+
+/// @brief Append an event to the access trace file, if enabled (see config::trace_file()).
+/// @param event The event.
+/// @param tier The cache tier.
+/// @param key The cache entry key.
+/// @param size The size of the cache entry (in bytes), or zero if unknown.
+/// @param cost_ms The time it takes to run the program, or zero if unknown.
+/// @note This function never throws. Failures to write to the trace file are silently ignored.
+void record(const event_t event,
+            const tier_t tier,
+            const std::string& key,
+            const int64_t size,
+            const int64_t cost_ms) noexcept;
+}  // namespace trace
+}  // namespace bcache
+
+#endif  // BUILDCACHE_ACCESS_TRACE_HPP_
@@ -21,16 +21,36 @@
 
 #include <base/debug_utils.hpp>
 #include <base/file_utils.hpp>
+#include <base/git_index.hpp>
 #include <base/hasher.hpp>
+#include <base/time_utils.hpp>
+#include <cache/access_trace.hpp>
+#include <cache/dir_archive.hpp>
 #include <cache/direct_mode_manifest.hpp>
 #include <config/configuration.hpp>
+#include <sys/file_watcher.hpp>
 #include <sys/perf_utils.hpp>
 #include <sys/sys_utils.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace bcache {
 namespace {
+// Files that were modified less than this many seconds ago are considered "racy", i.e. their file
+// status information can not be trusted for detecting future modifications.
+const time::seconds_t RACY_TIME_SECONDS = 2;
+
+// Cached files are retrieved concurrently when an entry has several files that together are at
+// least this large (smaller entries are retrieved faster than the threads can be started).
+const int64_t MIN_PARALLEL_RETRIEVE_SIZE = 65536;
+const size_t MAX_RETRIEVE_THREADS = 8U;
+
 // Return the total size (uncompressed bytes) for a cache entry.
 int64_t get_total_entry_size(const cache_entry_t& entry,
                              const std::map<std::string, expected_file_t>& file_paths) {
@@ -48,6 +68,75 @@ int64_t get_total_entry_size(const cache_entry_t& entry,
   }
   return total_size;
 }
+
+// Directory outputs are cached as single packed archive files. This class maps the directory
+// outputs of a set of expected files to temporary archive files, which are then handled by the
+// local and remote caches just like any other files.
+class dir_outputs_t {
+public:
+  explicit dir_outputs_t(const std::map<std::string, expected_file_t>& expected_files)
+      : m_files(expected_files) {
+    for (auto& item : m_files) {
+      if (item.second.is_dir()) {
+        if (!m_tmp_dir) {
+          m_tmp_dir.reset(new file::tmp_file_t(sys::get_local_temp_folder(), ".dirs"));
+          file::create_dir_with_parents(m_tmp_dir->path());
+        }
+        const auto archive_path =
+            file::append_path(m_tmp_dir->path(), "dir" + std::to_string(m_dirs.size()));
+        m_dirs.emplace_back(archive_path, item.second.path());
+        item.second = expected_file_t(archive_path, item.second.required());
+      }
+    }
+  }
+
+  /// @returns the expected files, with directory outputs replaced by archive files.
+  const std::map<std::string, expected_file_t>& files() const {
+    return m_files;
+  }
+
+  /// @brief Pack the (existing) output directories into their archive files.
+  void pack() const {
+    for (const auto& dir : m_dirs) {
+      if (file::dir_exists(dir.second)) {
+        debug::log(debug::DEBUG) << "Packing " << dir.second;
+        dir_archive::pack(dir.second, dir.first);
+      }
+    }
+  }
+
+  /// @brief Unpack the (retrieved) archive files into their output directories.
+  void unpack(const bool allow_hard_links) const {
+    for (const auto& dir : m_dirs) {
+      if (file::file_exists(dir.first)) {
+        debug::log(debug::DEBUG) << "Unpacking " << dir.second;
+        dir_archive::unpack(dir.first, dir.second, allow_hard_links);
+      }
+    }
+  }
+
+private:
+  std::map<std::string, expected_file_t> m_files;
+  std::vector<std::pair<std::string, std::string>> m_dirs;  // Archive path, directory path.
+  std::unique_ptr<file::tmp_file_t> m_tmp_dir;
+};
+
+void record_hit(const trace::tier_t tier,
+                const std::string& hash,
+                const cache_entry_t& entry,
+                const std::map<std::string, expected_file_t>& file_paths) {
+  // Don't spend time on calculating the entry size unless we are tracing.
+  if (config::trace_file().empty()) {
+    return;
+  }
+  int64_t size = 0;
+  try {
+    size = get_total_entry_size(entry, file_paths);
+  } catch (...) {
+    // The size is unknown.
+  }
+  trace::record(trace::event_t::LOOKUP_HIT, tier, hash, size, entry.duration_ms());
+}
 }  // namespace
 
 bool cache_t::lookup_direct(const std::string& direct_hash,
@@ -91,17 +180,51 @@ void cache_t::add_direct(const std::string& direct_hash,
   try {
     // Calculate the hashes for all the implicit input files.
     std::map<std::string, std::string> files_with_hashes;
+    std::map<std::string, file::file_stat_t> files_with_stats;
+    watcher::epoch_t watcher_epoch;
     {
       PERF_SCOPE(HASH_INCLUDE_FILES);
+      const auto check_time_macros = (config::accuracy() != config::cache_accuracy_t::SLOPPY);
+      const auto use_git_index = config::git_index();
+      const auto racy_time_limit_ns =
+          (time::seconds_since_epoch() - RACY_TIME_SECONDS) * INT64_C(1000000000);
+      if (config::file_watcher()) {
+        // Note: The epoch must be sampled before any of the files are hashed.
+        watcher_epoch = watcher::get_epoch();
+      }
       for (const auto& path : implicit_input_files) {
+        // Record the file status before reading the file, so that any modification during or after
+        // hashing will be detected. Files that were modified very recently may be modified again
+        // without the time stamp changing (due to limited time stamp resolution), so we don't
+        // record the file status for such files.
+        auto stat = file::get_file_stat(path);
+        if (stat.modify_time_ns() >= racy_time_limit_ns ||
+            stat.change_time_ns() >= racy_time_limit_ns) {
+          stat = file::file_stat_t();
+        }
+        files_with_stats.insert(std::make_pair(path, stat));
+
         hasher_t hasher;
-        hasher.update_from_file(path);
-        files_with_hashes.insert(std::make_pair(path, hasher.final().as_string()));
+        if (hasher.update_from_file_with_time_macro_check(path) && check_time_macros) {
+          // The result depends on the current date or time, so the direct mode entry would not be
+          // valid for subsequent builds.
+          debug::log(debug::INFO) << "Skipping direct mode entry: Found time macros in " << path;
+          return;
+        }
+
+        // Prefer the git blob ID over the content hash, since it can be validated without reading
+        // the file.
+        auto digest = use_git_index ? git::get_clean_blob_digest(path) : std::string();
+        if (digest.empty()) {
+          digest = hasher.final().as_string();
+        }
+        files_with_hashes.insert(std::make_pair(path, digest));
       }
     }
 
     // Create a direct mode manifest.
-    const auto manifest = direct_mode_manifest_t(hash, files_with_hashes);
+    const auto manifest =
+        direct_mode_manifest_t(hash, files_with_hashes, files_with_stats, watcher_epoch);
 
     // Add the direct mode entry to the local cache.
     m_local_cache.add_direct(direct_hash, manifest);
@@ -121,10 +244,20 @@ bool cache_t::lookup(const std::string& hash,
   // errors as cache misses, and thus we can re-populate the cache if there is a corrupted cache
   // entry for instance.
 
+  // Directory outputs are retrieved as archive files, which are unpacked after a hit.
+  std::unique_ptr<dir_outputs_t> dir_outputs;
+  try {
+    dir_outputs.reset(new dir_outputs_t(expected_files));
+  } catch (const std::exception& e) {
+    debug::log(debug::ERROR) << "Lookup of " << hash << " failed: " << e.what();
+    return false;
+  }
+
   try {
     // First try the local cache.
     if (lookup_in_local_cache(
-            hash, expected_files, allow_hard_links, create_target_dirs, return_code)) {
+            hash, dir_outputs->files(), allow_hard_links, create_target_dirs, return_code)) {
+      dir_outputs->unpack(allow_hard_links);
       return true;
     }
   } catch (const std::runtime_error& e) {
@@ -134,7 +267,8 @@ bool cache_t::lookup(const std::string& hash,
   try {
     // Then try the remote cache.
     if (lookup_in_remote_cache(
-            hash, expected_files, allow_hard_links, create_target_dirs, return_code)) {
+            hash, dir_outputs->files(), allow_hard_links, create_target_dirs, return_code)) {
+      dir_outputs->unpack(allow_hard_links);
       return true;
     }
   } catch (const std::runtime_error& e) {
@@ -150,13 +284,20 @@ void cache_t::add(const std::string& hash,
                   const bool allow_hard_links) {
   PERF_START(ADD_TO_CACHE);
 
+  // Pack any directory outputs into archive files, which are then cached like any other files.
+  const dir_outputs_t dir_outputs(expected_files);
+  dir_outputs.pack();
+  const auto& files = dir_outputs.files();
+
   // We need the size of the cache entry for checking against the configured limits.
-  const auto size = get_total_entry_size(entry, expected_files);
+  const auto size = get_total_entry_size(entry, files);
 
   // Add the entry to the local cache.
   const auto max_local_size = config::max_local_entry_size();
   if (size < max_local_size || max_local_size <= 0) {
-    m_local_cache.add(hash, entry, expected_files, allow_hard_links);
+    m_local_cache.add(hash, entry, files, allow_hard_links);
+    trace::record(
+        trace::event_t::INSERT, trace::tier_t::LOCAL, hash, size, entry.duration_ms());
   } else {
     debug::log(debug::WARNING) << "Cache entry too large for the local cache: " << size << " bytes";
   }
@@ -170,11 +311,15 @@ void cache_t::add(const std::string& hash,
                                        cache_entry_t::comp_mode_t::ALL,
                                        entry.std_out(),
                                        entry.std_err(),
-                                       entry.return_code());
+                                       entry.return_code(),
+                                       entry.toolchain_id(),
+                                       entry.duration_ms());
 
       // Remote cache failures shouldn't crash the build, so try/catch.
       try {
-        m_remote_cache.add(hash, remote_entry, expected_files);
+        m_remote_cache.add(hash, remote_entry, files);
+        trace::record(
+            trace::event_t::INSERT, trace::tier_t::REMOTE, hash, size, entry.duration_ms());
       } catch (const std::exception& e) {
         debug::log(debug::WARNING) << "Remote cache error: " << e.what();
       } catch (...) {
@@ -189,6 +334,27 @@ void cache_t::add(const std::string& hash,
   PERF_STOP(ADD_TO_CACHE);
 }
 
+std::string cache_t::peek_direct(const std::string& direct_hash) noexcept {
+  try {
+    const auto manifest = m_local_cache.lookup_direct(direct_hash);
+    if (manifest) {
+      return manifest.hash();
+    }
+  } catch (const std::exception& e) {
+    debug::log(debug::DEBUG) << "Direct mode peek failed: " << e.what();
+  }
+  return std::string();
+}
+
+cache_entry_t cache_t::peek_local(const std::string& hash) noexcept {
+  try {
+    return m_local_cache.peek(hash);
+  } catch (const std::exception& e) {
+    debug::log(debug::DEBUG) << "Local cache peek failed: " << e.what();
+  }
+  return cache_entry_t();
+}
+
 bool cache_t::lookup_in_local_cache(const std::string& hash,
                                     const std::map<std::string, expected_file_t>& expected_files,
                                     const bool allow_hard_links,
@@ -201,11 +367,14 @@ bool cache_t::lookup_in_local_cache(const std::string& hash,
   PERF_STOP(CACHE_LOOKUP);
 
   if (!cached_entry) {
+    trace::record(trace::event_t::LOOKUP_MISS, trace::tier_t::LOCAL, hash, 0, 0);
     return false;
   }
 
   // Copy all files from the cache to their respective target paths.
   PERF_START(RETRIEVE_CACHED_FILES);
+  std::vector<std::pair<std::string, std::string>> files_to_get;
+  int64_t total_size = 0;
   for (const auto& file_id : cached_entry.file_ids()) {
     // If there is a mismatch in the expected (target) files and the actual (cached) files, throw an
     // exception (i.e. fall back to full program execution).
@@ -222,8 +391,60 @@ bool cache_t::lookup_in_local_cache(const std::string& hash,
       file::create_dir_with_parents(file::get_dir_part(target_path));
     }
 
-    const auto is_compressed = (cached_entry.compression_mode() == cache_entry_t::comp_mode_t::ALL);
-    m_local_cache.get_file(hash, file_id, target_path, is_compressed, allow_hard_links);
+    files_to_get.emplace_back(file_id, target_path);
+    total_size += m_local_cache.get_file_size(hash, file_id);
+  }
+
+  // Retrieve the files concurrently if there is enough work to be shared by several threads. Each
+  // target file is replaced atomically, so the order does not matter.
+  const auto is_compressed = (cached_entry.compression_mode() == cache_entry_t::comp_mode_t::ALL);
+  const auto num_files = files_to_get.size();
+  std::atomic<size_t> next_file(0U);
+  std::mutex error_mutex;
+  std::string error;
+  const auto get_files = [this,
+                           &hash,
+                           &files_to_get,
+                           &next_file,
+                           &error_mutex,
+                           &error,
+                           num_files,
+                           is_compressed,
+                           allow_hard_links]() {
+    for (auto file_no = next_file++; file_no < num_files; file_no = next_file++) {
+      try {
+        const auto& file = files_to_get[file_no];
+        m_local_cache.get_file(hash, file.first, file.second, is_compressed, allow_hard_links);
+      } catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        error = e.what();
+      }
+    }
+  };
+  size_t num_threads = 1U;
+  if (num_files > 1U && total_size >= MIN_PARALLEL_RETRIEVE_SIZE) {
+    const auto max_threads = std::max(2U, std::thread::hardware_concurrency());
+    num_threads = std::min(num_files, std::min<size_t>(max_threads, MAX_RETRIEVE_THREADS));
+  }
+  std::vector<std::thread> threads;
+  for (size_t i = 1U; i < num_threads; ++i) {
+    try {
+      threads.emplace_back(get_files);
+    } catch (const std::system_error& e) {
+      // The remaining files are retrieved by the threads that we already have.
+      debug::log(debug::DEBUG) << "Unable to start a retrieval thread: " << e.what();
+      break;
+    }
+  }
+  get_files();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (!error.empty()) {
+    throw std::runtime_error(error);
+  }
+  if (allow_hard_links && !is_compressed) {
+    m_local_cache.update_integrity(hash);
   }
   PERF_STOP(RETRIEVE_CACHED_FILES);
 
@@ -231,6 +452,7 @@ bool cache_t::lookup_in_local_cache(const std::string& hash,
   sys::print_raw_stdout(cached_entry.std_out());
   sys::print_raw_stderr(cached_entry.std_err());
   return_code = cached_entry.return_code();
+  record_hit(trace::tier_t::LOCAL, hash, cached_entry, expected_files);
 
   return true;
 }
@@ -251,6 +473,7 @@ bool cache_t::lookup_in_remote_cache(const std::string& hash,
 
   if (!cached_entry) {
     m_local_cache.update_stats(hash, cache_stats_t::remote_miss());
+    trace::record(trace::event_t::LOOKUP_MISS, trace::tier_t::REMOTE, hash, 0, 0);
     return false;
   }
 
@@ -281,6 +504,7 @@ bool cache_t::lookup_in_remote_cache(const std::string& hash,
   sys::print_raw_stdout(cached_entry.std_out());
   sys::print_raw_stderr(cached_entry.std_err());
   return_code = cached_entry.return_code();
+  record_hit(trace::tier_t::REMOTE, hash, cached_entry, expected_files);
 
   // Add the remote entry to the local cache (for faster cache hits and reduced network traffic).
   PERF_START(ADD_TO_CACHE);
@@ -295,9 +519,13 @@ bool cache_t::lookup_in_remote_cache(const std::string& hash,
           config::compress() ? cache_entry_t::comp_mode_t::ALL : cache_entry_t::comp_mode_t::NONE,
           cached_entry.std_out(),
           cached_entry.std_err(),
-          cached_entry.return_code());
+          cached_entry.return_code(),
+          cached_entry.toolchain_id(),
+          cached_entry.duration_ms());
       m_local_cache.add(hash, entry, expected_files, allow_hard_links);
       m_local_cache.update_stats(hash, cache_stats_t::remote_hit());
+      trace::record(
+          trace::event_t::INSERT, trace::tier_t::LOCAL, hash, size, entry.duration_ms());
     } else {
       debug::log(debug::WARNING) << "Cache entry too large for the local cache: " << size
                                  << " bytes";
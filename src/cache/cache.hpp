@@ -80,6 +80,18 @@ public:
            const std::map<std::string, expected_file_t>& expected_files,
            const bool allow_hard_links);
 
+  /// @brief Look up a direct mode entry without retrieving anything or updating the statistics.
+  /// @param direct_hash The hash of the direct mode cache entry.
+  /// @returns the hash of the corresponding preprocessor mode cache entry, or an empty string if
+  /// there was no direct mode hit.
+  std::string peek_direct(const std::string& direct_hash) noexcept;
+
+  /// @brief Look up an entry in the local cache without retrieving any files or updating the
+  /// statistics.
+  /// @param hash The hash of the cache entry.
+  /// @returns the cache entry. If there was no cache hit the entry will be empty.
+  cache_entry_t peek_local(const std::string& hash) noexcept;
+
 private:
   bool lookup_in_local_cache(const std::string& hash,
                              const std::map<std::string, expected_file_t>& expected_files,
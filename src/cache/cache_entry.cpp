@@ -27,7 +27,7 @@
 namespace bcache {
 namespace {
 // The version of the entry file serialization data format.
-const int32_t ENTRY_DATA_FORMAT_VERSION = 3;
+const int32_t ENTRY_DATA_FORMAT_VERSION = 5;
 
 std::vector<std::string> v2_files_to_vector(const std::map<std::string, std::string>& files) {
   std::vector<std::string> result;
@@ -43,12 +43,16 @@ cache_entry_t::cache_entry_t(const std::vector<std::string>& file_ids,
                              const cache_entry_t::comp_mode_t compression_mode,
                              const std::string& std_out,
                              const std::string& std_err,
-                             const int return_code)
+                             const int return_code,
+                             const std::string& toolchain_id,
+                             const int64_t duration_ms)
     : m_file_ids(file_ids),
       m_compression_mode(compression_mode),
       m_std_out(std_out),
       m_std_err(std_err),
       m_return_code(return_code),
+      m_toolchain_id(toolchain_id),
+      m_duration_ms(duration_ms),
       m_valid(true) {
 }
 
@@ -64,6 +68,8 @@ std::string cache_entry_t::serialize() const {
     data += serialize::from_string(m_std_err);
   }
   data += serialize::from_int(static_cast<int32_t>(m_return_code));
+  data += serialize::from_string(m_toolchain_id);
+  data += serialize::from_int64(m_duration_ms);
   return data;
 }
 
@@ -85,6 +91,8 @@ cache_entry_t cache_entry_t::deserialize(const std::string& data) {
   auto std_out = serialize::to_string(data, pos);
   auto std_err = serialize::to_string(data, pos);
   const auto return_code = static_cast<int>(serialize::to_int(data, pos));
+  const auto toolchain_id = (format_version >= 4) ? serialize::to_string(data, pos) : std::string();
+  const auto duration_ms = (format_version >= 5) ? serialize::to_int64(data, pos) : int64_t(0);
 
   // Optionally decompress the program output.
   if (compression_mode == comp_mode_t::ALL) {
@@ -92,7 +100,8 @@ cache_entry_t cache_entry_t::deserialize(const std::string& data) {
     std_err = comp::decompress(std_err);
   }
 
-  return cache_entry_t(file_ids, compression_mode, std_out, std_err, return_code);
+  return cache_entry_t(
+      file_ids, compression_mode, std_out, std_err, return_code, toolchain_id, duration_ms);
 }
 
 }  // namespace bcache
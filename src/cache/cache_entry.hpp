@@ -20,6 +20,7 @@
 #ifndef BUILDCACHE_CACHE_ENTRY_HPP_
 #define BUILDCACHE_CACHE_ENTRY_HPP_
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -42,11 +43,15 @@ public:
   /// @param std_out stdout from the program run.
   /// @param std_err stderr from the program run.
   /// @param return_code Program return code (0 = success).
+  /// @param toolchain_id ID of the toolchain that created the entry (optional).
+  /// @param duration_ms The time it took to run the program, in milliseconds (optional).
   cache_entry_t(const std::vector<std::string>& file_ids,
                 const comp_mode_t compression_mode,
                 const std::string& std_out,
                 const std::string& std_err,
-                const int return_code);
+                const int return_code,
+                const std::string& toolchain_id = std::string(),
+                const int64_t duration_ms = 0);
 
   /// @returns true if this object represents a valid cache entry. E.g. for a cache miss, the
   /// return value is false.
@@ -88,12 +93,24 @@ public:
     return m_return_code;
   }
 
+  /// @returns the ID of the toolchain that created the entry, or an empty string if unknown.
+  const std::string& toolchain_id() const {
+    return m_toolchain_id;
+  }
+
+  /// @returns the time it took to run the program (in milliseconds), or zero if unknown.
+  int64_t duration_ms() const {
+    return m_duration_ms;
+  }
+
 private:
   std::vector<std::string> m_file_ids;
   comp_mode_t m_compression_mode = comp_mode_t::NONE;
   std::string m_std_out;
   std::string m_std_err;
   int m_return_code = 0;
+  std::string m_toolchain_id;
+  int64_t m_duration_ms = 0;
   bool m_valid = false;  // true if this is a valid cache entry.
 };
 }  // namespace bcache
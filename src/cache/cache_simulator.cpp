@@ -0,0 +1,281 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <cache/cache_simulator.hpp>
+
+#include <base/file_utils.hpp>
+#include <config/configuration.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <tuple>
+
+namespace bcache {
+namespace sim {
+namespace {
+struct entry_info_t {
+  int64_t size = 0;
+  int64_t cost_ms = 0;
+};
+
+// Collect the size and cost of every entry in the trace.
+std::map<std::string, entry_info_t> get_entry_infos(const std::vector<trace::record_t>& records) {
+  std::map<std::string, entry_info_t> infos;
+  for (const auto& record : records) {
+    auto& info = infos[record.key];
+    if (record.size > 0) {
+      info.size = record.size;
+    }
+    if (record.cost_ms > 0) {
+      info.cost_ms = record.cost_ms;
+    }
+  }
+  return infos;
+}
+
+bool is_local_lookup(const trace::record_t& record) {
+  return (record.tier == trace::tier_t::LOCAL) && ((record.event == trace::event_t::LOOKUP_HIT) ||
+                                                   (record.event == trace::event_t::LOOKUP_MISS));
+}
+
+/// @brief A simulated cache with a configurable eviction policy.
+class simulated_cache_t {
+public:
+  simulated_cache_t(const policy_t policy, const int64_t capacity)
+      : m_policy(policy), m_capacity(capacity) {
+  }
+
+  bool lookup(const std::string& key) {
+    ++m_clock;
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+      return false;
+    }
+    auto& entry = it->second;
+    ++entry.frequency;
+    if (m_policy != policy_t::FIFO) {
+      m_queue.erase(std::make_tuple(entry.priority, entry.seq, key));
+      entry.priority = priority(entry);
+      entry.seq = m_clock;
+      m_queue.insert(std::make_tuple(entry.priority, entry.seq, key));
+    }
+    return true;
+  }
+
+  void insert(const std::string& key, const entry_info_t& info) {
+    if (info.size > m_capacity || m_entries.find(key) != m_entries.end()) {
+      return;
+    }
+
+    // Evict entries until the new entry fits.
+    while (m_used + info.size > m_capacity && !m_queue.empty()) {
+      const auto victim = *m_queue.begin();
+      m_queue.erase(m_queue.begin());
+      if (m_policy == policy_t::GDSF) {
+        m_inflation = std::get<0>(victim);
+      }
+      const auto victim_it = m_entries.find(std::get<2>(victim));
+      m_used -= victim_it->second.info.size;
+      m_entries.erase(victim_it);
+    }
+
+    entry_t entry;
+    entry.info = info;
+    entry.frequency = 1;
+    entry.priority = priority(entry);
+    entry.seq = m_clock;
+    m_queue.insert(std::make_tuple(entry.priority, entry.seq, key));
+    m_entries[key] = entry;
+    m_used += info.size;
+  }
+
+private:
+  struct entry_t {
+    entry_info_t info;
+    int64_t frequency = 0;
+    double priority = 0.0;
+    uint64_t seq = 0;
+  };
+
+  double priority(const entry_t& entry) const {
+    if (m_policy == policy_t::GDSF) {
+      const auto cost = static_cast<double>(std::max(entry.info.cost_ms, int64_t(1)));
+      const auto size = static_cast<double>(std::max(entry.info.size, int64_t(1)));
+      return m_inflation + static_cast<double>(entry.frequency) * cost / size;
+    }
+    return static_cast<double>(m_clock);
+  }
+
+  const policy_t m_policy;
+  const int64_t m_capacity;
+  int64_t m_used = 0;
+  uint64_t m_clock = 0;
+  double m_inflation = 0.0;
+  std::map<std::string, entry_t> m_entries;
+  std::set<std::tuple<double, uint64_t, std::string>> m_queue;
+};
+
+double ratio(const int64_t a, const int64_t b) {
+  return (b > 0) ? (static_cast<double>(a) / static_cast<double>(b)) : 0.0;
+}
+
+std::string format_duration_ms(const int64_t ms) {
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(1) << (static_cast<double>(ms) / 1000.0) << " s";
+  return ss.str();
+}
+}  // namespace
+
+std::string to_string(const policy_t policy) {
+  switch (policy) {
+    case policy_t::LRU:
+      return "LRU";
+    case policy_t::FIFO:
+      return "FIFO";
+    case policy_t::GDSF:
+      return "GDSF";
+  }
+  return "?";
+}
+
+double result_t::miss_ratio() const {
+  return 1.0 - ratio(local_hits + remote_hits, lookups);
+}
+
+double result_t::byte_hit_ratio() const {
+  return ratio(hit_bytes, bytes);
+}
+
+result_t simulate(const std::vector<trace::record_t>& records, const options_t& options) {
+  const auto infos = get_entry_infos(records);
+  simulated_cache_t local_cache(options.policy, options.capacity);
+  std::set<std::string> remote_cache;
+
+  result_t result;
+  for (const auto& record : records) {
+    if (!is_local_lookup(record)) {
+      continue;
+    }
+    const auto& info = infos.at(record.key);
+    ++result.lookups;
+    result.bytes += info.size;
+    result.cost_ms += info.cost_ms;
+
+    if (local_cache.lookup(record.key)) {
+      ++result.local_hits;
+    } else if (options.remote_tier && remote_cache.find(record.key) != remote_cache.end()) {
+      ++result.remote_hits;
+    } else {
+      // A miss: The entry is created by running the program (and is uploaded to the remote tier).
+      if (options.remote_tier) {
+        remote_cache.insert(record.key);
+      }
+      if (info.size > 0 && info.cost_ms >= options.min_cost_ms) {
+        local_cache.insert(record.key, info);
+      }
+      continue;
+    }
+
+    // A hit (in any tier).
+    result.hit_bytes += info.size;
+    result.saved_cost_ms += info.cost_ms;
+    if (info.size > 0 && info.cost_ms >= options.min_cost_ms) {
+      local_cache.insert(record.key, info);
+    }
+  }
+
+  return result;
+}
+
+void print_report(const std::vector<trace::record_t>& records, std::ostream& os) {
+  // Summarize the trace.
+  const auto infos = get_entry_infos(records);
+  int64_t num_lookups = 0;
+  int64_t num_recorded_hits = 0;
+  for (const auto& record : records) {
+    if (is_local_lookup(record)) {
+      ++num_lookups;
+      if (record.event == trace::event_t::LOOKUP_HIT) {
+        ++num_recorded_hits;
+      }
+    }
+  }
+  int64_t unique_bytes = 0;
+  for (const auto& item : infos) {
+    unique_bytes += item.second.size;
+  }
+
+  std::ios old_fmt(nullptr);
+  old_fmt.copyfmt(os);
+  os << std::setiosflags(std::ios::fixed) << std::setprecision(1);
+  os << "Access trace:\n";
+  os << "  Records:            " << records.size() << "\n";
+  os << "  Local lookups:      " << num_lookups << "\n";
+  os << "  Unique entries:     " << infos.size() << "\n";
+  os << "  Unique data:        " << file::human_readable_size(unique_bytes) << "\n";
+  os << "  Recorded hit ratio: " << (100.0 * ratio(num_recorded_hits, num_lookups)) << "%\n";
+  if (num_lookups == 0) {
+    os.copyfmt(old_fmt);
+    return;
+  }
+
+  // Cache sizes to simulate: Fractions of the unique data size, plus the configured size.
+  std::set<int64_t> sizes;
+  for (int64_t denom = 64; denom >= 1; denom /= 2) {
+    sizes.insert(std::max(unique_bytes / denom, int64_t(1)));
+  }
+  sizes.insert(config::max_cache_size());
+
+  // Admission rules to simulate.
+  const std::vector<int64_t> min_costs = {0, 1000};
+
+  os << "\n";
+  os << "Policy  Admission    Cache size    Miss ratio  Byte hit ratio  Time saved"
+        "  Miss ratio (+remote)\n";
+  for (const auto policy : {policy_t::LRU, policy_t::FIFO, policy_t::GDSF}) {
+    for (const auto min_cost_ms : min_costs) {
+      for (const auto size : sizes) {
+        options_t options;
+        options.policy = policy;
+        options.capacity = size;
+        options.min_cost_ms = min_cost_ms;
+        const auto local = simulate(records, options);
+        options.remote_tier = true;
+        const auto tiered = simulate(records, options);
+
+        const auto admission =
+            (min_cost_ms > 0) ? ("cost>=" + format_duration_ms(min_cost_ms)) : std::string("all");
+        os << std::left << std::setw(8) << to_string(policy) << std::setw(13) << admission
+           << std::setw(14) << file::human_readable_size(size) << std::right << std::setw(9)
+           << (100.0 * local.miss_ratio()) << "%" << std::setw(15)
+           << (100.0 * local.byte_hit_ratio()) << "%" << std::setw(12)
+           << format_duration_ms(local.saved_cost_ms) << std::setw(21)
+           << (100.0 * tiered.miss_ratio()) << "%\n";
+      }
+    }
+  }
+  os.copyfmt(old_fmt);
+}
+
+}  // namespace sim
+}  // namespace bcache
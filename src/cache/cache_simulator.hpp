@@ -0,0 +1,86 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef BUILDCACHE_CACHE_SIMULATOR_HPP_
+#define BUILDCACHE_CACHE_SIMULATOR_HPP_
+
+#include <cache/access_trace.hpp>
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace bcache {
+namespace sim {
+/// @brief Eviction policies.
+enum class policy_t {
+  LRU,   ///< Evict the least recently used entry.
+  FIFO,  ///< Evict the oldest entry.
+  GDSF   ///< Greedy-Dual-Size-Frequency (evict entries with a low cost per byte).
+};
+
+/// @brief Get the name of an eviction policy.
+/// @param policy The eviction policy.
+/// @returns the name of the policy.
+std::string to_string(const policy_t policy);
+
+/// @brief Simulation parameters.
+struct options_t {
+  policy_t policy = policy_t::LRU;  ///< Local cache eviction policy.
+  int64_t capacity = 0;             ///< Local cache size (in bytes).
+  int64_t min_cost_ms = 0;          ///< Only admit entries that cost at least this much to create.
+  bool remote_tier = false;         ///< Simulate an unbounded remote cache behind the local cache.
+};
+
+/// @brief Simulation results.
+struct result_t {
+  int64_t lookups = 0;        ///< Number of lookups.
+  int64_t local_hits = 0;     ///< Number of local cache hits.
+  int64_t remote_hits = 0;    ///< Number of remote cache hits.
+  int64_t bytes = 0;          ///< Total number of requested bytes.
+  int64_t hit_bytes = 0;      ///< Number of requested bytes that were served by the cache.
+  int64_t cost_ms = 0;        ///< Total cost of all the requested entries.
+  int64_t saved_cost_ms = 0;  ///< Cost that was saved thanks to the cache.
+
+  /// @returns the ratio of lookups that missed all tiers (0-1).
+  double miss_ratio() const;
+
+  /// @returns the ratio of requested bytes that were served by the cache (0-1).
+  double byte_hit_ratio() const;
+};
+
+/// @brief Replay an access trace against a simulated cache.
+///
+/// The local lookups of the trace are replayed. The size and cost of each entry are taken from the
+/// trace records. Entries are admitted to the simulated cache when they are created (on a miss) or
+/// fetched from the remote tier.
+/// @param records The access trace.
+/// @param options The simulation parameters.
+/// @returns the simulation results.
+result_t simulate(const std::vector<trace::record_t>& records, const options_t& options);
+
+/// @brief Print miss ratio curves for a range of cache sizes, policies and admission rules.
+/// @param records The access trace.
+/// @param os The stream to print to.
+void print_report(const std::vector<trace::record_t>& records, std::ostream& os);
+}  // namespace sim
+}  // namespace bcache
+
+#endif  // BUILDCACHE_CACHE_SIMULATOR_HPP_
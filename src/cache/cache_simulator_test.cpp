@@ -0,0 +1,138 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <cache/access_trace.hpp>
+#include <cache/cache_simulator.hpp>
+
+#include <doctest/doctest.h>
+
+// Workaround for macOS build errors.
+// See: https://github.com/onqtam/doctest/issues/126
+#include <iostream>
+
+using namespace bcache;
+
+namespace {
+const std::string KEY_A = "00112233445566778899aabbccddeeff";
+const std::string KEY_B = "0123456789abcdef0123456789abcdef";
+const std::string KEY_C = "fedcba9876543210fedcba9876543210";
+
+trace::record_t make_record(const trace::event_t event,
+                            const std::string& key,
+                            const int64_t size = 0,
+                            const int64_t cost_ms = 0) {
+  trace::record_t record;
+  record.event = event;
+  record.tier = trace::tier_t::LOCAL;
+  record.key = key;
+  record.timestamp_ms = 1234567890123;
+  record.size = size;
+  record.cost_ms = cost_ms;
+  return record;
+}
+
+// Append a lookup of a new key (a miss followed by an insert) to the trace.
+void add_miss(std::vector<trace::record_t>& records,
+              const std::string& key,
+              const int64_t size,
+              const int64_t cost_ms) {
+  records.emplace_back(make_record(trace::event_t::LOOKUP_MISS, key));
+  records.emplace_back(make_record(trace::event_t::INSERT, key, size, cost_ms));
+}
+
+void add_hit(std::vector<trace::record_t>& records, const std::string& key) {
+  records.emplace_back(make_record(trace::event_t::LOOKUP_HIT, key));
+}
+}  // namespace
+
+TEST_CASE("Access trace records can be encoded and decoded") {
+  const auto record = make_record(trace::event_t::INSERT, KEY_A, 123456789012LL, 4567);
+  const auto data = trace::encode(record) + trace::encode(record);
+  CHECK_EQ(data.size(), 2 * trace::RECORD_SIZE);
+
+  const auto records = trace::decode(data);
+  REQUIRE_EQ(records.size(), 2);
+  CHECK(records[1].event == trace::event_t::INSERT);
+  CHECK(records[1].tier == trace::tier_t::LOCAL);
+  CHECK_EQ(records[1].key, KEY_A);
+  CHECK_EQ(records[1].timestamp_ms, 1234567890123LL);
+  CHECK_EQ(records[1].size, 123456789012LL);
+  CHECK_EQ(records[1].cost_ms, 4567);
+
+  CHECK_THROWS(trace::decode(data.substr(1)));
+}
+
+TEST_CASE("The cache simulator replays lookups") {
+  // A, B, A, C, A, B
+  std::vector<trace::record_t> records;
+  add_miss(records, KEY_A, 100, 10);
+  add_miss(records, KEY_B, 100, 2000);
+  add_hit(records, KEY_A);
+  add_miss(records, KEY_C, 100, 10);
+  add_hit(records, KEY_A);
+  add_hit(records, KEY_B);
+
+  sim::options_t options;
+
+  SUBCASE("Large LRU cache: Only compulsory misses") {
+    options.capacity = 1000;
+    const auto result = sim::simulate(records, options);
+    CHECK_EQ(result.lookups, 6);
+    CHECK_EQ(result.local_hits, 3);
+    CHECK_EQ(result.hit_bytes, 300);
+    CHECK_EQ(result.saved_cost_ms, 2020);
+  }
+
+  SUBCASE("Small LRU cache: B is evicted by C") {
+    options.capacity = 200;
+    const auto result = sim::simulate(records, options);
+    CHECK_EQ(result.local_hits, 2);
+  }
+
+  SUBCASE("Small FIFO cache: A is evicted by C") {
+    options.policy = sim::policy_t::FIFO;
+    options.capacity = 200;
+    const auto result = sim::simulate(records, options);
+    CHECK_EQ(result.local_hits, 1);
+    CHECK_EQ(result.saved_cost_ms, 10);
+  }
+
+  SUBCASE("Small GDSF cache: The cheap entry A is evicted by C") {
+    options.policy = sim::policy_t::GDSF;
+    options.capacity = 200;
+    const auto result = sim::simulate(records, options);
+    CHECK_EQ(result.local_hits, 2);
+    CHECK_EQ(result.saved_cost_ms, 2010);
+  }
+
+  SUBCASE("Cost based admission") {
+    options.capacity = 1000;
+    options.min_cost_ms = 1000;
+    const auto result = sim::simulate(records, options);
+    CHECK_EQ(result.local_hits, 1);
+  }
+
+  SUBCASE("Unbounded remote tier") {
+    options.capacity = 0;
+    options.remote_tier = true;
+    const auto result = sim::simulate(records, options);
+    CHECK_EQ(result.local_hits, 0);
+    CHECK_EQ(result.remote_hits, 3);
+  }
+}
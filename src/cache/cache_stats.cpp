@@ -36,6 +36,7 @@ constexpr char LOCAL_HIT_COUNT[] = "local_hit_count";
 constexpr char LOCAL_MISS_COUNT[] = "local_miss_count";
 constexpr char REMOTE_HIT_COUNT[] = "remote_hit_count";
 constexpr char REMOTE_MISS_COUNT[] = "remote_miss_count";
+constexpr char LOW_SPACE_SKIP_COUNT[] = "low_space_skip_count";
 
 struct JSON_Deleter {
   void operator()(cJSON* obj) const {
@@ -90,6 +91,10 @@ bool cache_stats_t::from_json(cJSON const* obj) noexcept {
   if ((node != nullptr) && (cJSON_IsNumber(node) != 0)) {
     m_remote_miss_count = node->valueint;
   }
+  node = cJSON_GetObjectItemCaseSensitive(obj, LOW_SPACE_SKIP_COUNT);
+  if ((node != nullptr) && (cJSON_IsNumber(node) != 0)) {
+    m_low_space_skip_count = node->valueint;
+  }
   return true;
 }
 
@@ -157,6 +162,16 @@ bool cache_stats_t::to_json(cJSON* obj) const noexcept {
     debug::log(debug::ERROR) << "failed to serialize cache_stats object";
     return false;
   }
+  node = cJSON_GetObjectItemCaseSensitive(obj, LOW_SPACE_SKIP_COUNT);
+  if (node != nullptr) {
+    cJSON_SetNumberValue(node, m_low_space_skip_count);
+  } else {
+    node = cJSON_AddNumberToObject(obj, LOW_SPACE_SKIP_COUNT, m_low_space_skip_count);
+  }
+  if (node == nullptr) {
+    debug::log(debug::ERROR) << "failed to serialize cache_stats object";
+    return false;
+  }
 
   return true;
 }
@@ -192,6 +207,7 @@ void cache_stats_t::dump(std::ostream& os, const std::string& prefix) const {
   os << prefix << "Local hit ratio:   " << local_hit_ratio() << '%' << std::endl;
   os << prefix << "Remote hit ratio:  " << remote_hit_ratio() << '%' << std::endl;
   os << prefix << "Hit ratio:         " << global_hit_ratio() << '%' << std::endl;
+  os << prefix << "Low space skips:   " << m_low_space_skip_count << std::endl;
 }
 
 }  // namespace bcache
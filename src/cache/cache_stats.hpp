@@ -33,6 +33,7 @@ class cache_stats_t {
   int m_local_hit_count{0};
   int m_remote_hit_count{0};
   int m_remote_miss_count{0};
+  int m_low_space_skip_count{0};
 
 public:
   bool from_file(const std::string& path) noexcept;
@@ -47,6 +48,7 @@ public:
     m_local_miss_count += other.m_local_miss_count;
     m_remote_hit_count += other.m_remote_hit_count;
     m_remote_miss_count += other.m_remote_miss_count;
+    m_low_space_skip_count += other.m_low_space_skip_count;
     return *this;
   }
 
@@ -129,6 +131,11 @@ public:
     st.m_remote_miss_count = 0;
     return st;
   }
+  static cache_stats_t low_space_skip() noexcept {
+    cache_stats_t st;
+    st.m_low_space_skip_count = 1;
+    return st;
+  }
 
   void dump(std::ostream& os, const std::string& prefix) const;
 };
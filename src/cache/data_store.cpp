@@ -167,13 +167,9 @@ void data_store_t::store_item(const std::string& key,
     const auto file_path = make_file_path(key);
     const auto raw_data = encode_file_time(time::seconds_since_epoch() + timeout) + value;
 
-    // Save to a temporary file first and once the write operation has succeeded rename it to the
-    // target file.
-    auto tmp_file = file::tmp_file_t(file::get_dir_part(file_path), ".tmp");
-    file::write(raw_data, tmp_file.path());
-
-    // Move the temporary file to its target name.
-    file::move(tmp_file.path(), file_path);
+    // Save to a scratch file that is published under the target name once the write operation has
+    // succeeded.
+    file::write_atomic(raw_data, file_path);
   } catch (...) {
     // We just silence errors, since data items are volatile anyway.
   }
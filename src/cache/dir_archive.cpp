@@ -0,0 +1,456 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <cache/dir_archive.hpp>
+
+#include <base/compressor.hpp>
+#include <base/debug_utils.hpp>
+#include <base/file_utils.hpp>
+#include <base/hasher.hpp>
+#include <base/serializer_utils.hpp>
+#include <base/string_list.hpp>
+#include <base/unicode_utils.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace bcache {
+namespace dir_archive {
+namespace {
+// Archive format:
+//
+//   "BCAR" <version:int32>
+//   <record>...
+//   <end record>
+//
+// Each record consists of a serialized header string (a type, a relative path with "/" separators,
+// the permission bits and, for files, the size, the digest, the compression flag and the stored
+// data size, or for symbolic links, the link target), followed by the stored file data (for files).
+const std::string ARCHIVE_MAGIC = "BCAR";
+const int32_t ARCHIVE_FORMAT_VERSION = 2;
+
+const int32_t RECORD_END = 0;
+const int32_t RECORD_DIR = 1;
+const int32_t RECORD_FILE = 2;
+const int32_t RECORD_SYMLINK = 3;
+
+const size_t MAX_UNPACK_THREADS = 8U;
+
+struct record_t {
+  int32_t type;
+  std::string path;       // Relative path, with "/" separators.
+  int32_t mode;           // Permission bits (zero if unknown).
+  std::string target;     // Link target (for symbolic links).
+  int64_t size;           // Uncompressed size.
+  std::string digest;     // Digest of the uncompressed data.
+  bool is_compressed;     // True if the stored data is compressed.
+  int64_t stored_size;    // Size of the stored data.
+  int64_t offset;         // Offset of the stored data in the archive.
+};
+
+// A simple RAII wrapper for reading from a FILE object.
+class file_handle_t {
+public:
+  explicit file_handle_t(const std::string& path) {
+#ifdef _WIN32
+    if (_wfopen_s(&m_file, utf8_to_ucs2(path).c_str(), L"rb") != 0) {
+      m_file = nullptr;
+    }
+#else
+    m_file = std::fopen(path.c_str(), "rb");
+#endif
+    if (m_file == nullptr) {
+      throw std::runtime_error("Unable to open the archive file " + path);
+    }
+  }
+
+  ~file_handle_t() {
+    std::fclose(m_file);
+  }
+
+  void read(std::string& data, const size_t size) {
+    data.resize(size);
+    if ((size > 0U) && (std::fread(&data[0], 1, size, m_file) != size)) {
+      throw std::runtime_error("Premature end of archive.");
+    }
+  }
+
+  int64_t tell() {
+#ifdef _WIN32
+    return static_cast<int64_t>(_ftelli64(m_file));
+#else
+    return static_cast<int64_t>(ftello(m_file));
+#endif
+  }
+
+  void seek(const int64_t offset) {
+#ifdef _WIN32
+    const auto success = (_fseeki64(m_file, offset, SEEK_SET) == 0);
+#else
+    const auto success = (fseeko(m_file, static_cast<off_t>(offset), SEEK_SET) == 0);
+#endif
+    if (!success) {
+      throw std::runtime_error("Unable to seek in the archive.");
+    }
+  }
+
+private:
+  // Prohibit copy & assignment.
+  file_handle_t(const file_handle_t&) = delete;
+  file_handle_t& operator=(const file_handle_t&) = delete;
+
+  FILE* m_file;
+};
+
+std::string get_digest(const std::string& data) {
+  hasher_t hasher;
+  hasher.update(data);
+  return hasher.final().as_string();
+}
+
+std::string to_relative_path(const std::string& dir, const std::string& path) {
+  auto rel_path = path.substr(dir.size());
+  while (!rel_path.empty() && (rel_path[0] == '/' || rel_path[0] == '\\')) {
+    rel_path = rel_path.substr(1);
+  }
+#ifdef _WIN32
+  std::replace(rel_path.begin(), rel_path.end(), '\\', '/');
+#endif
+  return rel_path;
+}
+
+std::string to_target_path(const std::string& dir, const std::string& rel_path) {
+  // Do not allow paths that point outside of the target directory.
+  auto target_path = dir;
+  for (const auto& part : string_list_t(rel_path, "/")) {
+    if (part.empty() || part == "." || part == ".." || part.find('\\') != std::string::npos ||
+        part.find(':') != std::string::npos) {
+      throw std::runtime_error("Invalid path in archive: " + rel_path);
+    }
+    target_path = file::append_path(target_path, part);
+  }
+  return target_path;
+}
+
+std::string get_parent_path(const std::string& rel_path) {
+  const auto pos = rel_path.rfind('/');
+  return (pos == std::string::npos) ? std::string() : rel_path.substr(0, pos);
+}
+
+// Only relative links that stay within the archived directory are supported. Any ".." parts must
+// come first, so that the link can not escape the directory by going through another link.
+bool is_valid_link_target(const std::string& rel_path, const std::string& target) {
+  if (target.empty() || target[0] == '/' || target.find('\\') != std::string::npos ||
+      target.find(':') != std::string::npos) {
+    return false;
+  }
+  auto levels_up = static_cast<int>(string_list_t(rel_path, "/").size()) - 1;
+  auto is_descending = false;
+  for (const auto& part : string_list_t(target, "/")) {
+    if (part == "..") {
+      if (is_descending || (--levels_up < 0)) {
+        return false;
+      }
+    } else if (!part.empty() && part != ".") {
+      is_descending = true;
+    }
+  }
+  return true;
+}
+
+std::vector<record_t> read_records(const std::string& archive_path) {
+  file_handle_t archive(archive_path);
+  const auto archive_size = file::get_file_info(archive_path).size();
+  std::string data;
+  archive.read(data, ARCHIVE_MAGIC.size() + 4U);
+  std::string::size_type pos = ARCHIVE_MAGIC.size();
+  if ((data.substr(0, pos) != ARCHIVE_MAGIC) ||
+      (serialize::to_int(data, pos) != ARCHIVE_FORMAT_VERSION)) {
+    throw std::runtime_error("Unsupported archive format.");
+  }
+
+  std::vector<record_t> records;
+  while (true) {
+    archive.read(data, 4U);
+    pos = 0;
+    const auto header_size = serialize::to_int(data, pos);
+    if (header_size < 0 || header_size > archive_size - archive.tell()) {
+      throw std::runtime_error("Invalid record header size in archive.");
+    }
+    archive.read(data, static_cast<size_t>(header_size));
+    pos = 0;
+
+    record_t record;
+    record.type = serialize::to_int(data, pos);
+    if (record.type == RECORD_END) {
+      break;
+    }
+    record.path = serialize::to_string(data, pos);
+    record.mode = serialize::to_int(data, pos);
+    record.size = 0;
+    record.is_compressed = false;
+    record.stored_size = 0;
+    if (record.type == RECORD_FILE) {
+      record.size = serialize::to_int64(data, pos);
+      record.digest = serialize::to_string(data, pos);
+      record.is_compressed = serialize::to_bool(data, pos);
+      record.stored_size = serialize::to_int64(data, pos);
+    } else if (record.type == RECORD_SYMLINK) {
+      record.target = serialize::to_string(data, pos);
+      if (!is_valid_link_target(record.path, record.target)) {
+        throw std::runtime_error("Invalid symbolic link in archive: " + record.path);
+      }
+    } else if (record.type != RECORD_DIR) {
+      throw std::runtime_error("Unsupported archive record type.");
+    }
+    record.offset = archive.tell();
+    if (record.stored_size < 0 || record.stored_size > archive_size - record.offset) {
+      throw std::runtime_error("Invalid record data size in archive.");
+    }
+    archive.seek(record.offset + record.stored_size);
+    records.emplace_back(record);
+  }
+  return records;
+}
+
+bool is_file_identical(const std::string& path, const record_t& record) {
+  try {
+    if (!file::get_symlink_target(path).empty() ||
+        file::get_file_info(path).size() != record.size ||
+        (record.mode != 0 && file::get_file_mode(path) != record.mode)) {
+      return false;
+    }
+    return get_digest(file::read(path)) == record.digest;
+  } catch (...) {
+    return false;
+  }
+}
+}  // namespace
+
+void pack(const std::string& dir, const std::string& archive_path) {
+  if (!file::dir_exists(dir)) {
+    throw std::runtime_error("The directory does not exist: " + dir);
+  }
+
+  // Collect the files, directories and symbolic links (in a deterministic order). Symbolic links
+  // are not followed, so that they are restored as links.
+  std::map<std::string, bool> items;  // Relative path -> is dir
+  for (const auto& info : file::walk_directory(dir, file::filter_t(), false)) {
+    items[to_relative_path(dir, info.path())] = info.is_dir();
+  }
+
+  // Write the archive to a scratch file, so that a half-finished archive is never published.
+  file::scratch_file_t archive(archive_path);
+  archive.write(ARCHIVE_MAGIC + serialize::from_int(ARCHIVE_FORMAT_VERSION));
+  for (const auto& item : items) {
+    const auto& rel_path = item.first;
+    const auto path = file::append_path(dir, rel_path);
+    if (item.second) {
+      archive.write(serialize::from_string(serialize::from_int(RECORD_DIR) +
+                                           serialize::from_string(rel_path) +
+                                           serialize::from_int(file::get_file_mode(path))));
+      continue;
+    }
+
+    const auto target = file::get_symlink_target(path);
+    if (!target.empty()) {
+      if (!is_valid_link_target(rel_path, target)) {
+        throw std::runtime_error("Unsupported symbolic link (points outside of the directory): " +
+                                 path);
+      }
+      archive.write(serialize::from_string(
+          serialize::from_int(RECORD_SYMLINK) + serialize::from_string(rel_path) +
+          serialize::from_int(0) + serialize::from_string(target)));
+      continue;
+    }
+
+    // Compress each file separately, unless compression does not pay off.
+    const auto data = file::read(path);
+    auto stored_data = comp::compress(data);
+    const auto is_compressed = (stored_data.size() < data.size());
+    if (!is_compressed) {
+      stored_data = data;
+    }
+
+    archive.write(serialize::from_string(
+        serialize::from_int(RECORD_FILE) + serialize::from_string(rel_path) +
+        serialize::from_int(file::get_file_mode(path)) +
+        serialize::from_int64(static_cast<int64_t>(data.size())) +
+        serialize::from_string(get_digest(data)) + serialize::from_bool(is_compressed) +
+        serialize::from_int64(static_cast<int64_t>(stored_data.size()))));
+    archive.write(stored_data);
+  }
+  archive.write(serialize::from_string(serialize::from_int(RECORD_END)));
+  archive.publish();
+}
+
+void unpack(const std::string& archive_path, const std::string& dir, const bool allow_hard_links) {
+  const auto records = read_records(archive_path);
+
+  // Every record must be located in a directory of the archive, so that nothing is written through
+  // a symbolic link (from the archive or from an earlier extraction).
+  std::map<std::string, const record_t*> dirs;
+  std::vector<const record_t*> links;
+  for (const auto& record : records) {
+    if (record.type == RECORD_DIR) {
+      dirs[record.path] = &record;
+    } else if (record.type == RECORD_SYMLINK) {
+      links.emplace_back(&record);
+    }
+  }
+  for (const auto& record : records) {
+    const auto parent = get_parent_path(record.path);
+    if (!parent.empty() && dirs.find(parent) == dirs.end()) {
+      throw std::runtime_error("Invalid path in archive: " + record.path);
+    }
+  }
+
+  // Create the directories first (parents before children). Files with identical contents are only
+  // extracted once (the first file with a given digest), and the duplicates are linked or copied
+  // afterwards.
+  file::create_dir_with_parents(dir);
+  for (const auto& item : dirs) {
+    const auto target_path = to_target_path(dir, item.first);
+    if (!file::get_symlink_target(target_path).empty()) {
+      file::remove_file(target_path);
+    }
+    file::create_dir_with_parents(target_path);
+  }
+  std::vector<const record_t*> unique_files;
+  std::vector<std::pair<const record_t*, const record_t*>> duplicate_files;
+  std::map<std::string, const record_t*> files_by_digest;
+  for (const auto& record : records) {
+    if (record.type == RECORD_FILE) {
+      const auto it = files_by_digest.find(record.digest);
+      if (it == files_by_digest.end()) {
+        files_by_digest[record.digest] = &record;
+        unique_files.emplace_back(&record);
+      } else {
+        duplicate_files.emplace_back(&record, it->second);
+      }
+    }
+  }
+
+  // Extract the unique files in parallel. Each thread uses its own file handle for the archive.
+  std::atomic<size_t> next_file(0U);
+  std::mutex error_mutex;
+  std::string error;
+  const auto extract_files = [&archive_path,
+                               &dir,
+                               &unique_files,
+                               &next_file,
+                               &error_mutex,
+                               &error]() {
+    try {
+      file_handle_t archive(archive_path);
+      std::string stored_data;
+      for (auto file_no = next_file++; file_no < unique_files.size(); file_no = next_file++) {
+        const auto& record = *unique_files[file_no];
+        const auto target_path = to_target_path(dir, record.path);
+        if (is_file_identical(target_path, record)) {
+          continue;
+        }
+        archive.seek(record.offset);
+        archive.read(stored_data, static_cast<size_t>(record.stored_size));
+        const auto data = record.is_compressed ? comp::decompress(stored_data) : stored_data;
+        if (get_digest(data) != record.digest) {
+          throw std::runtime_error("Corrupt archive data for " + record.path);
+        }
+        file::write_atomic(data, target_path);
+        if (record.mode != 0) {
+          file::set_file_mode(target_path, record.mode);
+        }
+      }
+    } catch (const std::exception& e) {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      error = e.what();
+    }
+  };
+  const auto max_threads = std::max(1U, std::thread::hardware_concurrency());
+  const auto num_threads =
+      std::min(unique_files.size(), std::min<size_t>(max_threads, MAX_UNPACK_THREADS));
+  std::vector<std::thread> threads;
+  for (size_t i = 1U; i < num_threads; ++i) {
+    try {
+      threads.emplace_back(extract_files);
+    } catch (const std::system_error& e) {
+      // The remaining files are extracted by the threads that we already have.
+      debug::log(debug::DEBUG) << "Unable to start an extraction thread: " << e.what();
+      break;
+    }
+  }
+  extract_files();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (!error.empty()) {
+    throw std::runtime_error(error);
+  }
+
+  // Fan out the files that have identical contents.
+  for (const auto& duplicate : duplicate_files) {
+    const auto target_path = to_target_path(dir, duplicate.first->path);
+    if (is_file_identical(target_path, *duplicate.first)) {
+      continue;
+    }
+    // Hard links share their permissions, so only link files that have the same mode.
+    const auto source_path = to_target_path(dir, duplicate.second->path);
+    if (allow_hard_links && duplicate.first->mode == duplicate.second->mode) {
+      file::link_or_copy(source_path, target_path);
+    } else {
+      file::copy(source_path, target_path);
+      if (duplicate.first->mode != 0) {
+        file::set_file_mode(target_path, duplicate.first->mode);
+      }
+    }
+  }
+
+  // Create the symbolic links, replacing whatever is in their place.
+  for (const auto* link : links) {
+    const auto target_path = to_target_path(dir, link->path);
+    const auto old_target = file::get_symlink_target(target_path);
+    if (old_target == link->target) {
+      continue;
+    }
+    if (old_target.empty() && file::dir_exists(target_path)) {
+      file::remove_dir(target_path);
+    } else if (!old_target.empty() || file::file_exists(target_path)) {
+      file::remove_file(target_path);
+    }
+    file::create_symlink(link->target, target_path);
+  }
+
+  // Restore the directory permissions last (children before parents), since a read-only directory
+  // could not be populated.
+  for (auto it = dirs.rbegin(); it != dirs.rend(); ++it) {
+    if (it->second->mode != 0) {
+      file::set_file_mode(to_target_path(dir, it->first), it->second->mode);
+    }
+  }
+}
+}  // namespace dir_archive
+}  // namespace bcache
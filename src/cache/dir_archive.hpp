@@ -0,0 +1,52 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#ifndef BUILDCACHE_DIR_ARCHIVE_HPP_
+#define BUILDCACHE_DIR_ARCHIVE_HPP_
+
+#include <string>
+
+namespace bcache {
+namespace dir_archive {
+/// @brief Pack a directory tree into a single archive file.
+///
+/// The archive is written as a stream of records, one per file or directory, so only one file at
+/// a time is held in memory. Each file is compressed separately (unless compression does not make
+/// it smaller), and the size and digest of every file are recorded. The permission bits of files
+/// and directories are kept, and symbolic links are stored as links (they must be relative and
+/// point inside of the directory).
+/// @param dir The directory to pack.
+/// @param archive_path The archive file to create.
+/// @throws runtime_error if the operation could not be completed.
+void pack(const std::string& dir, const std::string& archive_path);
+
+/// @brief Extract an archive into a directory.
+///
+/// Files are extracted in parallel. Files that already exist with the right contents are not
+/// rewritten, and files that have identical contents are only extracted once and then hard linked
+/// (if allowed) or copied to the other locations. Existing files that are not part of the archive
+/// are left untouched.
+/// @param archive_path The archive file to extract.
+/// @param dir The target directory (it is created if it does not exist).
+/// @param allow_hard_links True if identical files may be hard linked to each other.
+/// @throws runtime_error if the operation could not be completed.
+void unpack(const std::string& archive_path, const std::string& dir, const bool allow_hard_links);
+}  // namespace dir_archive
+}  // namespace bcache
+
+#endif  // BUILDCACHE_DIR_ARCHIVE_HPP_
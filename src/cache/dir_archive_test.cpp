@@ -0,0 +1,126 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <base/file_utils.hpp>
+#include <cache/dir_archive.hpp>
+
+#include <doctest/doctest.h>
+
+// Workaround for macOS build errors.
+// See: https://github.com/onqtam/doctest/issues/126
+#include <iostream>
+
+using namespace bcache;
+
+TEST_CASE("dir_archive: Pack and unpack a directory tree") {
+  const auto tmp = file::tmp_file_t(file::get_temp_dir(), "");
+  file::create_dir(tmp.path());
+  const auto source_dir = file::append_path(tmp.path(), "source");
+  const auto target_dir = file::append_path(tmp.path(), "target");
+  const auto archive_path = file::append_path(tmp.path(), "archive.bin");
+
+  // Create a directory tree with a nested file, an empty directory and two identical files.
+  file::create_dir_with_parents(file::append_path(source_dir, "sub"));
+  file::create_dir_with_parents(file::append_path(source_dir, "empty"));
+  file::write("Hello world!", file::append_path(source_dir, "a.txt"));
+  file::write(std::string(10000, 'x'), file::append_path(source_dir, "b.txt"));
+  file::write("Hello world!", file::append_path(file::append_path(source_dir, "sub"), "c.txt"));
+
+  dir_archive::pack(source_dir, archive_path);
+
+  SUBCASE("Unpacking gives the original tree") {
+    dir_archive::unpack(archive_path, target_dir, false);
+    CHECK_EQ(file::read(file::append_path(target_dir, "a.txt")), "Hello world!");
+    CHECK_EQ(file::read(file::append_path(target_dir, "b.txt")), std::string(10000, 'x'));
+    CHECK_EQ(file::read(file::append_path(file::append_path(target_dir, "sub"), "c.txt")),
+             "Hello world!");
+    CHECK(file::dir_exists(file::append_path(target_dir, "empty")));
+  }
+
+  SUBCASE("Modified files are restored") {
+    dir_archive::unpack(archive_path, target_dir, true);
+    const auto path = file::append_path(target_dir, "b.txt");
+    file::write("Modified", path);
+    dir_archive::unpack(archive_path, target_dir, true);
+    CHECK_EQ(file::read(path), std::string(10000, 'x'));
+  }
+
+  SUBCASE("Invalid archives are rejected") {
+    file::write("Not an archive", archive_path);
+    CHECK_THROWS(dir_archive::unpack(archive_path, target_dir, false));
+  }
+
+  SUBCASE("Corrupt record header sizes are rejected") {
+    // The first record header size follows the magic and the format version.
+    const auto archive = file::read(archive_path);
+    for (const auto* header_size : {"\xff\xff\xff\xff", "\x7f\xff\xff\x7f"}) {
+      file::write(archive.substr(0, 8) + header_size + archive.substr(12), archive_path);
+      CHECK_THROWS_AS(dir_archive::unpack(archive_path, target_dir, false), std::runtime_error);
+    }
+  }
+}
+
+#ifndef _WIN32
+TEST_CASE("dir_archive: File modes and symbolic links are preserved") {
+  const auto tmp = file::tmp_file_t(file::get_temp_dir(), "");
+  file::create_dir(tmp.path());
+  const auto source_dir = file::append_path(tmp.path(), "source");
+  const auto target_dir = file::append_path(tmp.path(), "target");
+  const auto archive_path = file::append_path(tmp.path(), "archive.bin");
+
+  // An executable file, a plain file with identical contents and links to a file and a directory.
+  const auto sub_dir = file::append_path(source_dir, "sub");
+  file::create_dir_with_parents(sub_dir);
+  file::write("#!/bin/sh", file::append_path(source_dir, "run.sh"));
+  file::set_file_mode(file::append_path(source_dir, "run.sh"), 0755);
+  file::write("#!/bin/sh", file::append_path(source_dir, "plain.txt"));
+  file::set_file_mode(file::append_path(source_dir, "plain.txt"), 0644);
+  file::write("Hello", file::append_path(sub_dir, "c.txt"));
+  file::create_symlink("sub/c.txt", file::append_path(source_dir, "file_link"));
+  file::create_symlink("../sub", file::append_path(sub_dir, "dir_link"));
+
+  dir_archive::pack(source_dir, archive_path);
+  dir_archive::unpack(archive_path, target_dir, true);
+
+  CHECK_EQ(file::get_file_mode(file::append_path(target_dir, "run.sh")), 0755);
+  CHECK_EQ(file::get_file_mode(file::append_path(target_dir, "plain.txt")), 0644);
+  CHECK_EQ(file::get_symlink_target(file::append_path(target_dir, "file_link")), "sub/c.txt");
+  CHECK_EQ(file::read(file::append_path(target_dir, "file_link")), "Hello");
+  const auto target_sub_dir = file::append_path(target_dir, "sub");
+  CHECK_EQ(file::get_symlink_target(file::append_path(target_sub_dir, "dir_link")), "../sub");
+
+  SUBCASE("A changed mode is restored") {
+    file::set_file_mode(file::append_path(target_dir, "run.sh"), 0644);
+    dir_archive::unpack(archive_path, target_dir, true);
+    CHECK_EQ(file::get_file_mode(file::append_path(target_dir, "run.sh")), 0755);
+  }
+
+  SUBCASE("A link that replaced a file is restored") {
+    file::remove_file(file::append_path(target_dir, "file_link"));
+    file::write("Not a link", file::append_path(target_dir, "file_link"));
+    dir_archive::unpack(archive_path, target_dir, true);
+    CHECK_EQ(file::get_symlink_target(file::append_path(target_dir, "file_link")), "sub/c.txt");
+  }
+
+  SUBCASE("Links that point outside of the directory are rejected") {
+    file::create_symlink("../../outside", file::append_path(sub_dir, "bad_link"));
+    CHECK_THROWS(dir_archive::pack(source_dir, archive_path));
+  }
+}
+#endif
@@ -28,13 +28,50 @@
 namespace bcache {
 namespace {
 // The version of the manifest file serialization data format.
-const int32_t MANIFEST_DATA_FORMAT_VERSION = 2;
+const int32_t MANIFEST_DATA_FORMAT_VERSION = 4;
+
+std::string from_stat_map(const std::map<std::string, file::file_stat_t>& x) {
+  auto result = serialize::from_int(static_cast<int32_t>(x.size()));
+  for (const auto& element : x) {
+    const auto& stat = element.second;
+    result += serialize::from_string(element.first);
+    result += serialize::from_bool(stat.is_valid());
+    result += serialize::from_int64(stat.size());
+    result += serialize::from_int64(stat.modify_time_ns());
+    result += serialize::from_int64(stat.change_time_ns());
+    result += serialize::from_int64(static_cast<int64_t>(stat.inode()));
+  }
+  return result;
+}
+
+std::map<std::string, file::file_stat_t> to_stat_map(const std::string& data,
+                                                     std::string::size_type& pos) {
+  std::map<std::string, file::file_stat_t> result;
+  const auto map_size = serialize::to_int(data, pos);
+  for (int32_t i = 0; i < map_size; ++i) {
+    const auto path = serialize::to_string(data, pos);
+    const auto is_valid = serialize::to_bool(data, pos);
+    const auto size = serialize::to_int64(data, pos);
+    const auto modify_time_ns = serialize::to_int64(data, pos);
+    const auto change_time_ns = serialize::to_int64(data, pos);
+    const auto inode = static_cast<uint64_t>(serialize::to_int64(data, pos));
+    result[path] = is_valid ? file::file_stat_t(size, modify_time_ns, change_time_ns, inode)
+                            : file::file_stat_t();
+  }
+  return result;
+}
 }  // namespace
 
 direct_mode_manifest_t::direct_mode_manifest_t(
     const std::string& hash,
-    const std::map<std::string, std::string>& files_with_hashes)
-    : m_hash(hash), m_files_width_hashes(files_with_hashes), m_valid(true) {
+    const std::map<std::string, std::string>& files_with_hashes,
+    const std::map<std::string, file::file_stat_t>& files_with_stats,
+    const watcher::epoch_t& watcher_epoch)
+    : m_hash(hash),
+      m_files_width_hashes(files_with_hashes),
+      m_files_with_stats(files_with_stats),
+      m_watcher_epoch(watcher_epoch),
+      m_valid(true) {
 }
 
 std::string direct_mode_manifest_t::serialize() const {
@@ -49,10 +86,16 @@ std::string direct_mode_manifest_t::serialize() const {
   if (compress) {
     auto uncompressed_data = serialize::from_string(m_hash);
     uncompressed_data += serialize::from_map(m_files_width_hashes);
+    uncompressed_data += from_stat_map(m_files_with_stats);
+    uncompressed_data += serialize::from_string(m_watcher_epoch.instance);
+    uncompressed_data += serialize::from_int64(m_watcher_epoch.generation);
     data += comp::compress(uncompressed_data);
   } else {
     data += serialize::from_string(m_hash);
     data += serialize::from_map(m_files_width_hashes);
+    data += from_stat_map(m_files_with_stats);
+    data += serialize::from_string(m_watcher_epoch.instance);
+    data += serialize::from_int64(m_watcher_epoch.generation);
   }
 
   return data;
@@ -80,8 +123,12 @@ direct_mode_manifest_t direct_mode_manifest_t::deserialize(const std::string& da
   // De-serialize the manifest data body.
   const auto hash = serialize::to_string(uncompressed_body, pos);
   const auto files_with_hashes = serialize::to_map(uncompressed_body, pos);
+  const auto files_with_stats = to_stat_map(uncompressed_body, pos);
+  watcher::epoch_t watcher_epoch;
+  watcher_epoch.instance = serialize::to_string(uncompressed_body, pos);
+  watcher_epoch.generation = serialize::to_int64(uncompressed_body, pos);
 
-  return direct_mode_manifest_t(hash, files_with_hashes);
+  return direct_mode_manifest_t(hash, files_with_hashes, files_with_stats, watcher_epoch);
 }
 
 }  // namespace bcache
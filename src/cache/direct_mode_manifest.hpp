@@ -20,6 +20,9 @@
 #ifndef BUILDCACHE_DIRECT_MODE_MANIFEST_HPP_
 #define BUILDCACHE_DIRECT_MODE_MANIFEST_HPP_
 
+#include <base/file_utils.hpp>
+#include <sys/file_watcher.hpp>
+
 #include <map>
 #include <string>
 
@@ -33,8 +36,13 @@ public:
   /// @brief Construct a valid manifest.
   /// @param hash The preprocessor mode cache entry hash.
   /// @param files_with_hashes Paths to implicit input files (key) and their hashes (value).
+  /// @param files_with_stats Paths to implicit input files (key) and their file status at the time
+  /// when they were hashed (value).
+  /// @param watcher_epoch The file watcher epoch from before the files were hashed (if any).
   direct_mode_manifest_t(const std::string& hash,
-                         const std::map<std::string, std::string>& files_with_hashes);
+                         const std::map<std::string, std::string>& files_with_hashes,
+                         const std::map<std::string, file::file_stat_t>& files_with_stats,
+                         const watcher::epoch_t& watcher_epoch = watcher::epoch_t());
 
   /// @returns true if this object represents a valid manifest. E.g. for a cache miss, the
   /// return value is false.
@@ -61,9 +69,21 @@ public:
     return m_files_width_hashes;
   }
 
+  /// @returns a mapping from file paths to their file status information.
+  const std::map<std::string, file::file_stat_t>& files_with_stats() const {
+    return m_files_with_stats;
+  }
+
+  /// @returns the file watcher epoch from before the implicit input files were hashed.
+  const watcher::epoch_t& watcher_epoch() const {
+    return m_watcher_epoch;
+  }
+
 private:
   std::string m_hash;
   std::map<std::string, std::string> m_files_width_hashes;
+  std::map<std::string, file::file_stat_t> m_files_with_stats;
+  watcher::epoch_t m_watcher_epoch;
   bool m_valid = false;  // true if this is a valid manifest.
 };
 }  // namespace bcache
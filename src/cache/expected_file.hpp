@@ -25,11 +25,15 @@
 namespace bcache {
 
 /// @brief A description of an output file that is expected to be produced by a program.
+///
+/// An output may also be a directory, in which case the entire directory tree is cached as a
+/// single packed artifact.
 class expected_file_t {
 public:
   expected_file_t() = default;
   expected_file_t(const expected_file_t&) = default;
-  expected_file_t(const std::string& path, bool required) : m_path(path), m_required(required) {
+  expected_file_t(const std::string& path, bool required, bool is_dir = false)
+      : m_path(path), m_required(required), m_is_dir(is_dir) {
   }
 
   /// @returns the path to the output file.
@@ -42,9 +46,15 @@ public:
     return m_required;
   }
 
+  /// @returns true if the output is a directory.
+  bool is_dir() const {
+    return m_is_dir;
+  }
+
 private:
   std::string m_path;
   bool m_required;
+  bool m_is_dir = false;
 };
 
 }  // namespace bcache
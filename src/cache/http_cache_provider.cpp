@@ -48,6 +48,17 @@ std::string remote_key_name(const std::string& hash_str, const std::string& file
   return KEY_PREFIX + "_" + hash_str + "_" + file;
 }
 
+http::InternetProtocol get_protocol(const bool use_unix_socket) {
+#ifndef _WIN32
+  if (use_unix_socket) {
+    return http::InternetProtocol::Unix;
+  }
+#else
+  (void)use_unix_socket;
+#endif
+  return http::InternetProtocol::V4;
+}
+
 }  // namespace
 
 http_cache_provider_t::~http_cache_provider_t() {
@@ -56,7 +67,19 @@ http_cache_provider_t::~http_cache_provider_t() {
 
 bool http_cache_provider_t::connect(const std::string& host_description) {
   // Decode the host description.
-  if (!parse_host_description(host_description, m_host, m_port, m_path)) {
+  if (m_use_unix_socket) {
+#ifdef _WIN32
+    debug::log(debug::ERROR) << "Unix domain sockets are not supported on this platform";
+    return false;
+#else
+    if (!parse_unix_socket_description(host_description, m_socket_path, m_path)) {
+      return false;
+    }
+    // The host name and port are only used for the Host header of the requests.
+    m_host = "localhost";
+    m_port = -1;
+#endif
+  } else if (!parse_host_description(host_description, m_host, m_port, m_path)) {
     return false;
   }
 
@@ -138,6 +161,54 @@ void http_cache_provider_t::get_file(const std::string& hash,
   file::write(data, target_path);
 }
 
+std::vector<remote_cache_provider_t::object_info_t> http_cache_provider_t::list_objects() {
+  // List the objects using WebDAV (only the direct members of the path).
+  const std::string request_body =
+      "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+      "<propfind xmlns=\"DAV:\"><prop><getcontentlength/><getlastmodified/></prop></propfind>";
+  std::string response_body;
+  const auto status =
+      send_request("PROPFIND", "", "", {"Depth: 1"}, request_body, response_body);
+  if (status != 207) {
+    std::ostringstream ss;
+    ss << "HTTP remote responded (" << status << ") to PROPFIND (is WebDAV enabled?)";
+    throw std::runtime_error(ss.str());
+  }
+
+  std::vector<object_info_t> objects;
+  for (const auto& response : get_xml_elements(response_body, "response")) {
+    const auto hrefs = get_xml_elements(response, "href");
+    const auto sizes = get_xml_elements(response, "getcontentlength");
+    const auto dates = get_xml_elements(response, "getlastmodified");
+    if (hrefs.size() != 1 || sizes.size() != 1 || dates.size() != 1) {
+      // Probably a collection (e.g. the path itself).
+      continue;
+    }
+    object_info_t object;
+    object.key = hrefs[0].substr(hrefs[0].rfind('/') + 1);
+    if (object.key.compare(0, KEY_PREFIX.size() + 1, KEY_PREFIX + "_") != 0) {
+      continue;
+    }
+    object.size = std::stoll(sizes[0]);
+    object.modify_time = parse_http_date(dates[0]);
+    objects.emplace_back(object);
+  }
+  return objects;
+}
+
+void http_cache_provider_t::remove_object(const std::string& key) {
+  std::string response_body;
+  const auto status = send_request("DELETE", key, "", {}, "", response_body);
+
+  // Note: An object that does not exist has already been removed (e.g. by a concurrent process).
+  if (status != 200 && status != 202 && status != 204 && status != 404) {
+    std::ostringstream ss;
+    ss << "HTTP remote responded (" << status << ") to DELETE: " << key;
+    throw std::runtime_error(ss.str());
+  }
+  debug::log(debug::DEBUG) << "Completed HTTP DELETE request: " << key;
+}
+
 std::string http_cache_provider_t::get_path() const {
   return m_path;
 }
@@ -148,6 +219,28 @@ std::vector<std::string> http_cache_provider_t::get_header(const std::string& /*
   return {"Content-Type: " + content_type};
 }
 
+int http_cache_provider_t::send_request(const std::string& method,
+                                        const std::string& key,
+                                        const std::string& query,
+                                        const std::vector<std::string>& extra_headers,
+                                        const std::string& body,
+                                        std::string& response_body) {
+  if (!is_connected()) {
+    throw std::runtime_error("Can't send a request to a disconnected context");
+  }
+
+  // Gather information for this request.
+  auto http_header = get_header(method, key);
+  http_header.insert(http_header.end(), extra_headers.begin(), extra_headers.end());
+
+  // Perform the HTTP request.
+  const auto url = get_object_url(key) + (query.empty() ? std::string() : "?" + query);
+  http::Request request(url, get_protocol(m_use_unix_socket), m_socket_path);
+  http::Response response = request.send(method, body, http_header);
+  response_body = std::string(response.body.begin(), response.body.end());
+  return response.status;
+}
+
 std::string http_cache_provider_t::get_data(const std::string& key) {
   if (!is_connected()) {
     throw std::runtime_error("Can't GET from a disconnected context");
@@ -159,7 +252,7 @@ std::string http_cache_provider_t::get_data(const std::string& key) {
 
   // Perform the HTTP request.
   const auto url = get_object_url(key);
-  http::Request request(url);
+  http::Request request(url, get_protocol(m_use_unix_socket), m_socket_path);
   http::Response response = request.send(method, "", http_header);
 
   // A successful response must have the code 200.
@@ -193,7 +286,7 @@ void http_cache_provider_t::set_data(const std::string& key, const std::string&
 
   // Perform the HTTP request.
   const auto url = get_object_url(key);
-  http::Request request(url);
+  http::Request request(url, get_protocol(m_use_unix_socket), m_socket_path);
   http::Response response = request.send(method, data, http_header);
 
   // A successful response must have the code 200 or 201. Or 204, in that case do not try to read
@@ -26,7 +26,11 @@ namespace bcache {
 
 class http_cache_provider_t : public remote_cache_provider_t {
 public:
-  http_cache_provider_t() = default;
+  /// @brief Construct an HTTP cache provider.
+  /// @param use_unix_socket Connect to a Unix domain socket rather than to a TCP host.
+  explicit http_cache_provider_t(const bool use_unix_socket = false)
+      : m_use_unix_socket(use_unix_socket) {
+  }
   ~http_cache_provider_t() override;
 
   // Implementation of the remote_cache_provider_t interface.
@@ -40,12 +44,30 @@ public:
                 const std::string& source_id,
                 const std::string& target_path,
                 const bool is_compressed) override;
+  std::vector<object_info_t> list_objects() override;
+  void remove_object(const std::string& key) override;
 
 protected:
   /// @brief Get the path of the destination URL.
   /// @returns the path of the destination.
   std::string get_path() const;
 
+  /// @brief Send an HTTP request to the remote cache.
+  /// @param method The HTTP method.
+  /// @param key The full name of the object (or an empty string for the path itself).
+  /// @param query The query string of the URL (excluding the leading "?"), if any.
+  /// @param extra_headers Headers to send in addition to the ones given by get_header().
+  /// @param body The request body.
+  /// @param[out] response_body The response body.
+  /// @returns the HTTP status code of the response.
+  /// @throws runtime_error if the request could not be sent.
+  int send_request(const std::string& method,
+                   const std::string& key,
+                   const std::string& query,
+                   const std::vector<std::string>& extra_headers,
+                   const std::string& body,
+                   std::string& response_body);
+
 private:
   /// @brief Get the headers for the HTTP request.
   /// @param method The HTTP method.
@@ -79,6 +101,8 @@ private:
   std::string m_host;
   std::string m_path;
   int m_port;
+  std::string m_socket_path;
+  const bool m_use_unix_socket;
 
   bool m_ready_for_action = false;
 };
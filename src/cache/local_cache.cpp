@@ -28,6 +28,15 @@
 //  |  |
 //  |  +- ...
 //  |
+//  +- toolchains                             (toolchain registry)
+//  |  |
+//  |  +- 5d41402abc4b2a76b9719d911017c592    (toolchain ID)
+//  |  |  |
+//  |  |  +- info                             (toolchain description, mtime = last seen)
+//  |  |  +- entries                          (cache entries created by the toolchain)
+//  |  |
+//  |  +- ...
+//  |
 //  +- c                                      (cache files)
 //     |
 //     +- 9e                                  (first 2 chars of hash)
@@ -35,6 +44,8 @@
 //     |  +- 8967a0708e7876df765864531bcd3f   (last 30 chars of hash)
 //     |  |  |
 //     |  |  +- .entry                        (information about this cache entry)
+//     |  |  +- .integrity                    (digests of hard linked files, if any)
+//     |  |  +- .digests                      (sizes and digests of the uncompressed files)
 //     |  |  +- somefile                      (a cached file)
 //     |  |  +- yetanotherfile                (a cached file)
 //     |  |  +- ...
@@ -49,28 +60,48 @@
 #include <base/compressor.hpp>
 #include <base/debug_utils.hpp>
 #include <base/file_utils.hpp>
+#include <base/git_index.hpp>
 #include <base/hasher.hpp>
 #include <base/serializer_utils.hpp>
+#include <cache/access_trace.hpp>
+#include <cache/toolchain_registry.hpp>
 #include <config/configuration.hpp>
+#include <sys/file_watcher.hpp>
 #include <sys/perf_utils.hpp>
 
 #include <chrono>
 #include <cstdlib>
 #include <algorithm>
+#include <atomic>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <random>
 #include <set>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 namespace bcache {
 namespace {
 const std::string CACHE_FILES_FOLDER_NAME = "c";
 const std::string DIRECT_CACHE_MANIFEST_FILE_NAME = ".manifest";
 const std::string CACHE_ENTRY_FILE_NAME = ".entry";
+const std::string INTEGRITY_FILE_NAME = ".integrity";
+const std::string DIGESTS_FILE_NAME = ".digests";
+const std::string TARGETS_FILE_NAME = ".targets";
 const std::string FILE_LOCK_SUFFIX = ".lock";
 const std::string STATS_FILE_NAME = "stats.json";
 const std::string HOUSEKEEPING_FILE_LOCK = ".housekeeping" + FILE_LOCK_SUFFIX;
 
+// Low disk space housekeeping is performed at most once per interval. The time of the last low
+// disk space housekeeping is the modification time of a marker file.
+const std::string LOW_SPACE_MARKER_FILE_NAME = ".lowspace";
+const time::seconds_t LOW_SPACE_HOUSEKEEPING_INTERVAL = 60;
+
+// Maximum number of concurrent workers when importing cache entries.
+const size_t MAX_IMPORT_THREADS = 8U;
+
 // Maximum number of manifests per direct mode cache entry (must be at least 1). Set this too low,
 // and there will be cache thrashing (e.g. when switching branches). Set this too high and cache
 // lookup times will suffer (all existing entires are tried until a hit is found).
@@ -132,6 +163,11 @@ bool is_cache_entry_dir_path(const std::string& path) {
   return true;
 }
 
+std::string cache_entry_dir_to_hash(const std::string& path) {
+  // The hash is split into a prefix dir and an entry dir (see hash_to_cache_entry_path()).
+  return file::get_file_part(file::get_dir_part(path)) + file::get_file_part(path);
+}
+
 std::vector<file::file_info_t> get_cache_entry_dirs(const std::string& root_folder) {
   std::vector<file::file_info_t> cache_dirs;
 
@@ -180,10 +216,85 @@ std::vector<file::file_info_t> get_cache_prefix_dirs(const std::string& root_fol
   return prefix_dirs;
 }
 
+int64_t get_free_disk_space_cached(const std::string& root_folder) {
+  // statvfs() is cheap, but there is no need to call it more than once per process and second.
+  static int64_t s_free_space = 0;
+  static time::seconds_t s_checked_time = -1;
+  const auto now = time::seconds_since_epoch();
+  if (now != s_checked_time) {
+    s_free_space = file::get_free_disk_space(root_folder);
+    s_checked_time = now;
+  }
+  return s_free_space;
+}
+
+int64_t get_free_space_deficit(const std::string& root_folder) {
+  // How many bytes are missing to reach the configured minimum free disk space?
+  const auto min_free_space = config::min_free_space();
+  if (min_free_space <= 0) {
+    return 0;
+  }
+  try {
+    return std::max(min_free_space - get_free_disk_space_cached(root_folder), int64_t(0));
+  } catch (const std::exception& e) {
+    debug::log(debug::DEBUG) << e.what();
+    return 0;
+  }
+}
+
+void create_low_space_marker() {
+  const auto marker_path = file::append_path(config::dir(), LOW_SPACE_MARKER_FILE_NAME);
+  if (!file::file_exists(marker_path)) {
+    try {
+      file::write(std::string(), marker_path);
+    } catch (...) {
+      // We try again during the next housekeeping.
+    }
+  }
+}
+
+bool is_time_for_low_space_housekeeping() {
+  // When the disk is full, every attempt to add an entry would trigger housekeeping, so we limit
+  // how often that happens. The marker file is created during regular housekeeping, and touching
+  // it needs no new disk space. If the marker can not be updated (or created), we can not limit
+  // the housekeeping, so we skip it.
+  const auto marker_path = file::append_path(config::dir(), LOW_SPACE_MARKER_FILE_NAME);
+  try {
+    if (!file::file_exists(marker_path)) {
+      file::write(std::string(), marker_path);
+      return true;
+    }
+    const auto since_last =
+        time::seconds_since_epoch() - file::get_file_info(marker_path).modify_time();
+    if (since_last >= 0 && since_last < LOW_SPACE_HOUSEKEEPING_INTERVAL) {
+      return false;
+    }
+    file::touch(marker_path);
+    return true;
+  } catch (const std::exception& e) {
+    debug::log(debug::DEBUG) << "Unable to update the low disk space marker: " << e.what();
+  }
+  return false;
+}
+
 void purge_old_cache_entries(const std::string& root_folder) {
   // Get all the cache entry directories.
   auto dirs = get_cache_entry_dirs(root_folder);
 
+  // Determine the size limit. If the free disk space is below the configured minimum, we need to
+  // evict (at least) enough entries to get back above the watermark.
+  auto size_limit = config::max_cache_size();
+  const auto free_space_deficit = get_free_space_deficit(root_folder);
+  if (free_space_deficit > 0) {
+    int64_t total_size = 0;
+    for (const auto& dir : dirs) {
+      total_size += dir.size();
+    }
+    size_limit = std::min(size_limit, std::max(total_size - free_space_deficit, int64_t(0)));
+    debug::log(debug::INFO) << "Low disk space: Reducing the cache size to " << size_limit
+                            << " bytes";
+  }
+
   // Sort the entries according to their access time (newest first).
   std::sort(
       dirs.begin(), dirs.end(), [](const file::file_info_t& a, const file::file_info_t& b) -> bool {
@@ -198,7 +309,7 @@ void purge_old_cache_entries(const std::string& root_folder) {
   for (const auto& dir : dirs) {
     ++num_entries;
     total_size += dir.size();
-    if (total_size > config::max_cache_size()) {
+    if (total_size > size_limit) {
       try {
         debug::log(debug::DEBUG) << "Purging " << dir.path() << " (last accessed "
                                  << dir.access_time() << ", " << dir.size() << " bytes)";
@@ -209,6 +320,11 @@ void purge_old_cache_entries(const std::string& root_folder) {
           file_lock_t lock{file_lock_path, file_lock_t::to_remote_t(config::remote_locks())};
           if (lock.has_lock()) {
             file::remove_dir(dir.path());
+            trace::record(trace::event_t::EVICT,
+                          trace::tier_t::LOCAL,
+                          cache_entry_dir_to_hash(dir.path()),
+                          dir.size(),
+                          0);
             total_size -= dir.size();
             --num_entries;
             ++num_purged_entries;
@@ -237,8 +353,23 @@ bool is_potentially_stale_lock_file(const file::file_info_t& info, const time::s
   return (seconds_since_accessed > AGE_THRESHOLD_SECONDS);
 }
 
+bool is_stale_scratch_file(const file::file_info_t& info, const time::seconds_t now) {
+  // Is this a named scratch file (i.e. a left-over from an interrupted write operation)?
+  const auto file_name = file::get_file_part(info.path());
+  if (info.is_dir() || (file_name.compare(0, 7, "bcache-") != 0) ||
+      (file::get_extension(file_name) != ".tmp")) {
+    return false;
+  }
+
+  // Is it old?
+  const time::seconds_t AGE_THRESHOLD_SECONDS{3600};
+  const auto seconds_since_modified = now - info.modify_time();
+  return (seconds_since_modified > AGE_THRESHOLD_SECONDS);
+}
+
 void delete_stale_lock_files(const std::string& root_folder) {
   int64_t num_deleted_lock_files = 0;
+  int64_t num_deleted_scratch_files = 0;
 
   try {
     const auto cache_files_dir = file::append_path(root_folder, CACHE_FILES_FOLDER_NAME);
@@ -257,6 +388,10 @@ void delete_stale_lock_files(const std::string& root_folder) {
             file::remove_file(info.path(), true);
             ++num_deleted_lock_files;
           }
+        } else if (is_stale_scratch_file(info, now)) {
+          debug::log(debug::DEBUG) << "Deleting stale " << info.path();
+          file::remove_file(info.path(), true);
+          ++num_deleted_scratch_files;
         }
       }
     }
@@ -264,7 +399,247 @@ void delete_stale_lock_files(const std::string& root_folder) {
     debug::log(debug::ERROR) << e.what();
   }
 
-  debug::log(debug::INFO) << "Deleted " << num_deleted_lock_files << " stale lock files.";
+  debug::log(debug::INFO) << "Deleted " << num_deleted_lock_files << " stale lock files and "
+                          << num_deleted_scratch_files << " stale scratch files.";
+}
+
+// The integrity information for a cached file that may be shared with a build output (via a hard
+// link). It is used for detecting if the build output (and thus the cached file) has been modified
+// after it was added to the cache.
+struct file_integrity_t {
+  std::string file_id;
+  int64_t size;
+  int64_t modify_time_ns;
+  std::string digest;
+};
+
+const int32_t INTEGRITY_FORMAT_VERSION = 1;
+
+std::string get_file_digest(const std::string& path) {
+  hasher_t hasher;
+  hasher.update_from_file(path);
+  return hasher.final().as_string();
+}
+
+std::vector<file_integrity_t> read_integrity(const std::string& cache_entry_path) {
+  std::vector<file_integrity_t> files;
+  const auto integrity_path = file::append_path(cache_entry_path, INTEGRITY_FILE_NAME);
+  if (!file::file_exists(integrity_path)) {
+    return files;
+  }
+  const auto data = file::read(integrity_path);
+  std::string::size_type pos = 0;
+  if (serialize::to_int(data, pos) != INTEGRITY_FORMAT_VERSION) {
+    throw std::runtime_error("Unsupported integrity format version.");
+  }
+  const auto num_files = serialize::to_int(data, pos);
+  for (int32_t i = 0; i < num_files; ++i) {
+    file_integrity_t item;
+    item.file_id = serialize::to_string(data, pos);
+    item.size = serialize::to_int64(data, pos);
+    item.modify_time_ns = serialize::to_int64(data, pos);
+    item.digest = serialize::to_string(data, pos);
+    files.emplace_back(item);
+  }
+  return files;
+}
+
+void write_integrity(const std::string& cache_entry_path,
+                     const std::vector<file_integrity_t>& files) {
+  std::string data = serialize::from_int(INTEGRITY_FORMAT_VERSION);
+  data += serialize::from_int(static_cast<int32_t>(files.size()));
+  for (const auto& item : files) {
+    data += serialize::from_string(item.file_id);
+    data += serialize::from_int64(item.size);
+    data += serialize::from_int64(item.modify_time_ns);
+    data += serialize::from_string(item.digest);
+  }
+  file::write_atomic(data, file::append_path(cache_entry_path, INTEGRITY_FILE_NAME));
+}
+
+// The size and digest of a cached file (uncompressed), used for detecting if a build output
+// already has the same contents as the cached file.
+struct file_digest_t {
+  std::string file_id;
+  int64_t size;
+  std::string digest;
+};
+
+const int32_t DIGESTS_FORMAT_VERSION = 1;
+
+std::vector<file_digest_t> read_digests(const std::string& cache_entry_path) {
+  std::vector<file_digest_t> files;
+  const auto digests_path = file::append_path(cache_entry_path, DIGESTS_FILE_NAME);
+  if (!file::file_exists(digests_path)) {
+    return files;
+  }
+  const auto data = file::read(digests_path);
+  std::string::size_type pos = 0;
+  if (serialize::to_int(data, pos) != DIGESTS_FORMAT_VERSION) {
+    throw std::runtime_error("Unsupported digests format version.");
+  }
+  const auto num_files = serialize::to_int(data, pos);
+  for (int32_t i = 0; i < num_files; ++i) {
+    file_digest_t item;
+    item.file_id = serialize::to_string(data, pos);
+    item.size = serialize::to_int64(data, pos);
+    item.digest = serialize::to_string(data, pos);
+    files.emplace_back(item);
+  }
+  return files;
+}
+
+void write_digests(const std::string& cache_entry_path, const std::vector<file_digest_t>& files) {
+  std::string data = serialize::from_int(DIGESTS_FORMAT_VERSION);
+  data += serialize::from_int(static_cast<int32_t>(files.size()));
+  for (const auto& item : files) {
+    data += serialize::from_string(item.file_id);
+    data += serialize::from_int64(item.size);
+    data += serialize::from_string(item.digest);
+  }
+  file::write_atomic(data, file::append_path(cache_entry_path, DIGESTS_FILE_NAME));
+}
+
+// The file status of a target file, as it was right after it was last written (or touched) from a
+// cached file. A target that still has the same status has not been modified since.
+struct target_stat_t {
+  std::string file_id;
+  std::string target_path;
+  file::file_stat_t stat;
+};
+
+const int32_t TARGETS_FORMAT_VERSION = 1;
+
+// Different build trees may retrieve the same entry, but we only remember the most recent ones.
+const size_t MAX_TARGETS_PER_ENTRY = 16U;
+
+std::vector<target_stat_t> read_target_stats(const std::string& cache_entry_path) {
+  std::vector<target_stat_t> targets;
+  const auto targets_path = file::append_path(cache_entry_path, TARGETS_FILE_NAME);
+  if (!file::file_exists(targets_path)) {
+    return targets;
+  }
+  const auto data = file::read(targets_path);
+  std::string::size_type pos = 0;
+  if (serialize::to_int(data, pos) != TARGETS_FORMAT_VERSION) {
+    throw std::runtime_error("Unsupported targets format version.");
+  }
+  const auto num_targets = serialize::to_int(data, pos);
+  for (int32_t i = 0; i < num_targets; ++i) {
+    target_stat_t item;
+    item.file_id = serialize::to_string(data, pos);
+    item.target_path = serialize::to_string(data, pos);
+    const auto size = serialize::to_int64(data, pos);
+    const auto modify_time_ns = serialize::to_int64(data, pos);
+    const auto change_time_ns = serialize::to_int64(data, pos);
+    const auto inode = static_cast<uint64_t>(serialize::to_int64(data, pos));
+    const auto device = static_cast<uint64_t>(serialize::to_int64(data, pos));
+    item.stat = file::file_stat_t(size, modify_time_ns, change_time_ns, inode, device);
+    targets.emplace_back(item);
+  }
+  return targets;
+}
+
+void write_target_stats(const std::string& cache_entry_path,
+                        const std::vector<target_stat_t>& targets) {
+  std::string data = serialize::from_int(TARGETS_FORMAT_VERSION);
+  data += serialize::from_int(static_cast<int32_t>(targets.size()));
+  for (const auto& item : targets) {
+    data += serialize::from_string(item.file_id);
+    data += serialize::from_string(item.target_path);
+    data += serialize::from_int64(item.stat.size());
+    data += serialize::from_int64(item.stat.modify_time_ns());
+    data += serialize::from_int64(item.stat.change_time_ns());
+    data += serialize::from_int64(static_cast<int64_t>(item.stat.inode()));
+    data += serialize::from_int64(static_cast<int64_t>(item.stat.device()));
+  }
+  file::write_atomic(data, file::append_path(cache_entry_path, TARGETS_FILE_NAME));
+}
+
+bool is_same_file_stat(const file::file_stat_t& a, const file::file_stat_t& b) {
+  return (a == b) && (a.device() == b.device());
+}
+
+// Check if a target file already has the same contents as a cached file, in which case there is no
+// need to write it. Hard linked files are identified by their file status, and other files are
+// identified by their size and digest.
+bool is_target_identical(const std::string& cache_entry_path,
+                         const std::string& source_id,
+                         const std::string& target_path,
+                         const file::file_stat_t& target_stat,
+                         const bool is_compressed) {
+  const auto source_path = file::append_path(cache_entry_path, source_id);
+  if (!is_compressed && (file::get_file_stat(source_path) == target_stat)) {
+    return true;
+  }
+
+  for (const auto& item : read_digests(cache_entry_path)) {
+    if (item.file_id == source_id) {
+      return (item.size == target_stat.size()) && (get_file_digest(target_path) == item.digest);
+    }
+  }
+  return false;
+}
+
+bool is_sampled_for_verification() {
+  static std::mutex s_mutex;
+  static std::mt19937 s_generator{std::random_device{}()};
+  std::lock_guard<std::mutex> lock(s_mutex);
+  return static_cast<int32_t>(s_generator() % 100U) < config::hard_link_verify();
+}
+
+// Check that none of the hard linked files of a cache entry have been modified. Cheap checks (file
+// size and modification time) are always made, and a changed modification time triggers a full
+// digest verification. Files that are currently shared with build outputs are also verified for a
+// random sample of the lookups.
+bool verify_integrity(const std::string& cache_entry_path) {
+  auto files = read_integrity(cache_entry_path);
+  bool is_stale = false;
+  for (auto& item : files) {
+    const auto path = file::append_path(cache_entry_path, item.file_id);
+    const auto stat = file::get_file_stat(path);
+    if (stat.size() != item.size) {
+      debug::log(debug::WARNING) << "Cached file " << path << " has been modified (size)";
+      return false;
+    }
+    const auto is_touched = (stat.modify_time_ns() != item.modify_time_ns);
+    if (is_touched || (file::get_link_count(path) > 1 && is_sampled_for_verification())) {
+      if (get_file_digest(path) != item.digest) {
+        debug::log(debug::WARNING) << "Cached file " << path << " has been modified (digest)";
+        return false;
+      }
+      if (is_touched) {
+        // The file was touched but not modified (e.g. by a build system).
+        item.modify_time_ns = stat.modify_time_ns();
+        is_stale = true;
+      }
+    }
+  }
+  if (is_stale) {
+    write_integrity(cache_entry_path, files);
+  }
+  return true;
+}
+
+bool remove_cache_entry(const std::string& cache_entry_path) {
+  if (!file::dir_exists(cache_entry_path)) {
+    return false;
+  }
+
+  // We acquire an exclusive lock for the cache entry before deleting it.
+  auto removed = false;
+  const auto file_lock_path = cache_entry_file_lock_path(cache_entry_path);
+  {
+    file_lock_t lock{file_lock_path, file_lock_t::to_remote_t(config::remote_locks())};
+    if (lock.has_lock()) {
+      file::remove_dir(cache_entry_path);
+      removed = true;
+    }
+  }
+
+  // ...and remove the lock file too, if any.
+  file::remove_file(file_lock_path, true);
+  return removed;
 }
 
 bool is_time_for_housekeeping() {
@@ -286,6 +661,106 @@ local_cache_t::local_cache_t() {
   file::create_dir_with_parents(config::dir());
 }
 
+int64_t local_cache_t::import_entries(const std::string& root_folder) {
+  // Note: Copying many small files is mostly I/O bound, so we use several threads even on machines
+  // with few cores.
+  const auto source_dirs = get_cache_entry_dirs(root_folder);
+  std::atomic<size_t> next_dir(0U);
+  std::atomic<int64_t> num_imported(0);
+  const auto import_dirs = [this, &source_dirs, &next_dir, &num_imported]() {
+    for (auto dir_no = next_dir++; dir_no < source_dirs.size(); dir_no = next_dir++) {
+      try {
+        if (import_entry(source_dirs[dir_no].path())) {
+          ++num_imported;
+        }
+      } catch (const std::exception& e) {
+        debug::log(debug::WARNING) << "Unable to import " << source_dirs[dir_no].path() << ": "
+                                   << e.what();
+      }
+    }
+  };
+
+  const auto max_threads = std::max(2U, std::thread::hardware_concurrency());
+  const auto num_threads = std::max<size_t>(
+      1U, std::min(source_dirs.size(), std::min<size_t>(max_threads, MAX_IMPORT_THREADS)));
+  std::vector<std::thread> threads;
+  for (size_t i = 1U; i < num_threads; ++i) {
+    try {
+      threads.emplace_back(import_dirs);
+    } catch (const std::system_error& e) {
+      debug::log(debug::DEBUG) << "Unable to start an import thread: " << e.what();
+      break;
+    }
+  }
+  import_dirs();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Enforce the cache size limit.
+  if (num_imported > 0) {
+    perform_housekeeping();
+  }
+
+  return num_imported;
+}
+
+bool local_cache_t::import_entry(const std::string& source_entry_path) {
+  const auto hash = cache_entry_dir_to_hash(source_entry_path);
+  const auto cache_entry_path = hash_to_cache_entry_path(hash);
+
+  // Collect the files of the entry. Integrity information is not imported, since the imported files
+  // are copies (not hard links), and neither is the status of the targets of the other cache.
+  const auto cache_entry_file_name = file::append_path(source_entry_path, CACHE_ENTRY_FILE_NAME);
+  string_list_t source_files;
+  for (const auto& info : file::walk_directory(source_entry_path)) {
+    const auto name = file::get_file_part(info.path());
+    if (!info.is_dir() && name != CACHE_ENTRY_FILE_NAME && name != INTEGRITY_FILE_NAME &&
+        name != TARGETS_FILE_NAME) {
+      source_files += info.path();
+    }
+  }
+
+  file::create_dir_with_parents(file::get_dir_part(cache_entry_path));
+  {
+    // Acquire a scoped exclusive lock for the cache entry.
+    file_lock_t lock{cache_entry_file_lock_path(cache_entry_path),
+                     file_lock_t::to_remote_t(config::remote_locks())};
+    if (!lock.has_lock()) {
+      throw std::runtime_error("Unable to acquire a cache entry lock for writing.");
+    }
+
+    // Skip entries that we already have (checked under the lock, since a concurrent import or
+    // compilation may be adding the same entry).
+    if (file::dir_exists(cache_entry_path)) {
+      return false;
+    }
+
+    // Copy the cached files (and direct mode manifests), and finally the cache entry file, which
+    // makes the entry visible to lookups. A partially imported entry is removed, so that it is not
+    // mistaken for an existing entry by a later import.
+    try {
+      file::create_dir_with_parents(cache_entry_path);
+      for (const auto& path : source_files) {
+        file::copy(path, file::append_path(cache_entry_path, file::get_file_part(path)));
+      }
+      if (file::file_exists(cache_entry_file_name)) {
+        const auto entry_data = file::read(cache_entry_file_name);
+        const auto entry = cache_entry_t::deserialize(entry_data);
+        file::write(entry_data, file::append_path(cache_entry_path, CACHE_ENTRY_FILE_NAME));
+        if (!entry.toolchain_id().empty()) {
+          toolchain_registry_t().add_entry(entry.toolchain_id(), hash);
+        }
+      }
+    } catch (...) {
+      file::remove_dir(cache_entry_path, true);
+      throw;
+    }
+  }
+
+  return true;
+}
+
 std::string local_cache_t::get_cache_files_folder() const {
   auto cache_files_path = file::append_path(config::dir(), CACHE_FILES_FOLDER_NAME);
   file::create_dir_with_parents(cache_files_path);
@@ -339,10 +814,30 @@ void local_cache_t::perform_housekeeping() {
 
     const auto start_t = std::chrono::high_resolution_clock::now();
 
+    // Drop the entries of toolchains that have not been used for a long time. We do this first,
+    // since those entries are most likely dead weight (e.g. after a compiler upgrade).
+    const auto toolchain_expiry = config::toolchain_expiry();
+    if (toolchain_expiry > 0) {
+      const auto now = time::seconds_since_epoch();
+      for (const auto& toolchain : toolchain_registry_t().list()) {
+        if ((now - toolchain.last_seen) > toolchain_expiry) {
+          debug::log(debug::INFO) << "Dropping unused toolchain " << toolchain.id << " ("
+                                  << toolchain.description << ")";
+          drop_toolchain(toolchain.id);
+        }
+      }
+    }
+
     // Purge old cache entries.
     purge_old_cache_entries(config::dir());
 
-    // Delete old stale lock files.
+    // The toolchain registry only ever appends entries, so forget the entries that are gone.
+    compact_toolchain_entries();
+
+    // Prepare for low disk space housekeeping while there is room for it.
+    create_low_space_marker();
+
+    // Delete old stale lock files and scratch files.
     delete_stale_lock_files(config::dir());
 
     const auto stop_t = std::chrono::high_resolution_clock::now();
@@ -353,6 +848,61 @@ void local_cache_t::perform_housekeeping() {
   }
 }
 
+void local_cache_t::compact_toolchain_entries() {
+  toolchain_registry_t registry;
+  for (const auto& toolchain : registry.list()) {
+    try {
+      const auto num_entries =
+          registry.compact_entries(toolchain.id, [this](const std::string& hash) {
+            return file::dir_exists(hash_to_cache_entry_path(hash));
+          });
+      debug::log(debug::DEBUG) << "Compacted the entries of toolchain " << toolchain.id << " ("
+                               << toolchain.num_entries << " -> " << num_entries << ")";
+    } catch (const std::exception& e) {
+      debug::log(debug::DEBUG) << "Unable to compact the entries of toolchain " << toolchain.id
+                               << ": " << e.what();
+    }
+  }
+}
+
+int64_t local_cache_t::drop_toolchain(const std::string& toolchain_id) {
+  toolchain_registry_t registry;
+  int64_t num_removed_entries = 0;
+  for (const auto& hash : registry.entries(toolchain_id)) {
+    try {
+      if (remove_cache_entry(hash_to_cache_entry_path(hash))) {
+        trace::record(trace::event_t::EVICT, trace::tier_t::LOCAL, hash, 0, 0);
+        ++num_removed_entries;
+      }
+    } catch (const std::exception& e) {
+      debug::log(debug::DEBUG) << "Failed: " << e.what();
+    }
+  }
+  registry.remove(toolchain_id);
+  debug::log(debug::INFO) << "Removed " << num_removed_entries << " cache entries for toolchain "
+                          << toolchain_id;
+  return num_removed_entries;
+}
+
+void local_cache_t::show_toolchains() {
+  auto toolchains = toolchain_registry_t().list();
+
+  // Sort the toolchains according to when they were last seen (newest first).
+  std::sort(toolchains.begin(),
+            toolchains.end(),
+            [](const toolchain_registry_t::toolchain_info_t& a,
+               const toolchain_registry_t::toolchain_info_t& b) -> bool {
+              return a.last_seen > b.last_seen;
+            });
+
+  const auto now = time::seconds_since_epoch();
+  for (const auto& toolchain : toolchains) {
+    const auto days = (now - toolchain.last_seen) / (3600 * 24);
+    std::cout << toolchain.id << "  " << toolchain.num_entries << " entries, last seen " << days
+              << " days ago  " << toolchain.description << "\n";
+  }
+}
+
 void local_cache_t::show_stats() {
   // Calculate the total cache size.
   const auto dirs = get_cache_entry_dirs(config::dir());
@@ -361,8 +911,7 @@ void local_cache_t::show_stats() {
   cache_stats_t overall_stats;
   std::set<std::string> visited_dirs;
 
-  auto process_stats = [&visited_dirs, &overall_stats](const std::string& dir) {
-    const auto first_level_dir_path = file::get_dir_part(dir);
+  auto process_stats = [&visited_dirs, &overall_stats](const std::string& first_level_dir_path) {
     if (visited_dirs.find(first_level_dir_path) != visited_dirs.end()) {
       return;
     }
@@ -385,6 +934,11 @@ void local_cache_t::show_stats() {
   for (const auto& dir : dirs) {
     num_entries++;
     total_size += dir.size();
+  }
+
+  // Note: Stats may also be present in first level dirs that no longer contain any entries (e.g.
+  // after a purge).
+  for (const auto& dir : get_cache_prefix_dirs(config::dir())) {
     process_stats(dir.path());
   }
   const auto full_percentage =
@@ -457,6 +1011,11 @@ direct_mode_manifest_t local_cache_t::lookup_direct(const std::string& direct_ha
   // Get the path to the cache entry.
   const auto cache_entry_path = hash_to_cache_entry_path(direct_hash);
 
+  // Should we trust the file status information of the implicit input files?
+  const auto use_stat_validation =
+      config::stat_validation() || (config::accuracy() == config::cache_accuracy_t::SLOPPY);
+  const auto use_file_watcher = config::file_watcher();
+
   // Try all possible manifest numbers until we find a hit (or not).
   for (int manifest_no = 1; manifest_no <= NUM_MANIFESTS_PER_ENTRY; ++manifest_no) {
     try {
@@ -465,17 +1024,46 @@ direct_mode_manifest_t local_cache_t::lookup_direct(const std::string& direct_ha
       const auto manifest_data = file::read(file_name);
       auto manifest = direct_mode_manifest_t::deserialize(manifest_data);
 
+      // If the file watcher daemon can confirm that none of the implicit input files have changed
+      // since the manifest was created, there is no need to check the individual files.
+      if (use_file_watcher && manifest.watcher_epoch().is_valid()) {
+        string_list_t paths;
+        for (const auto& item : manifest.files_width_hashes()) {
+          paths += item.first;
+        }
+        if (watcher::is_unchanged_since(manifest.watcher_epoch(), paths)) {
+          debug::log(debug::DEBUG) << "Direct match (" << file::get_file_part(file_name)
+                                   << "): Confirmed by the file watcher";
+          return manifest;
+        }
+      }
+
       // Validate the hashes for all the implicit input files.
       {
         PERF_SCOPE(HASH_INCLUDE_FILES);
+        const auto& files_with_stats = manifest.files_with_stats();
         for (const auto& item : manifest.files_width_hashes()) {
           const auto& path = item.first;
           const auto& expected_file_hash = item.second;
 
-          // Check that the file has not changed.
-          hasher_t hasher;
-          hasher.update_from_file(path);
-          const auto file_hash = hasher.final().as_string();
+          // If the file status is unchanged, we can skip hashing the file (if allowed).
+          if (use_stat_validation) {
+            const auto stat_it = files_with_stats.find(path);
+            if (stat_it != files_with_stats.end() && stat_it->second == file::get_file_stat(path)) {
+              continue;
+            }
+          }
+
+          // Check that the file has not changed. If the file was identified by its git blob ID
+          // when the manifest was created, it is enough to check that the blob ID is unchanged.
+          std::string file_hash;
+          if (git::is_blob_digest(expected_file_hash)) {
+            file_hash = git::get_clean_blob_digest(path);
+          } else {
+            hasher_t hasher;
+            hasher.update_from_file(path);
+            file_hash = hasher.final().as_string();
+          }
           if (file_hash != expected_file_hash) {
             debug::log(debug::DEBUG) << "No direct match (" << file::get_file_part(file_name)
                                      << "): " << path << " differs";
@@ -497,6 +1085,17 @@ void local_cache_t::add(const std::string& hash,
                         const cache_entry_t& entry,
                         const std::map<std::string, expected_file_t>& expected_files,
                         const bool allow_hard_links) {
+  // Don't fill up the disk. If the free disk space is below the configured minimum, we pause
+  // adding entries to the local cache, and try to make room by evicting old entries instead.
+  if (get_free_space_deficit(config::dir()) > 0) {
+    debug::log(debug::WARNING) << "Low disk space: Not adding the entry to the local cache";
+    update_stats(hash, cache_stats_t::low_space_skip());
+    if (is_time_for_low_space_housekeeping()) {
+      perform_housekeeping();
+    }
+    return;
+  }
+
   // Create the cache entry parent directory if necessary.
   const auto cache_entry_path = hash_to_cache_entry_path(hash);
   const auto cache_entry_parent_path = file::get_dir_part(cache_entry_path);
@@ -514,24 +1113,56 @@ void local_cache_t::add(const std::string& hash,
     file::create_dir_with_parents(cache_entry_path);
 
     // Copy (and optinally compress) the files into the cache.
+    std::vector<file_integrity_t> integrity;
+    std::vector<file_digest_t> digests;
     for (const auto& file_id : entry.file_ids()) {
       const auto& source_path = expected_files.at(file_id).path();
       const auto target_path = file::append_path(cache_entry_path, file_id);
+
+      // Record the size and digest of the file, so that retrieving the file to a target that
+      // already has the same contents can be skipped.
+      const auto source_size = file::get_file_info(source_path).size();
+      const auto source_digest = get_file_digest(source_path);
+      digests.emplace_back(file_digest_t{file_id, source_size, source_digest});
+
       if (entry.compression_mode() == cache_entry_t::comp_mode_t::ALL) {
         debug::log(debug::DEBUG) << "Compressing " << source_path << " => " << target_path;
         comp::compress_file(source_path, target_path);
       } else if (allow_hard_links) {
         file::link_or_copy(source_path, target_path);
+
+        // Files that may be shared with build outputs are made read-only, so that a build step
+        // that tries to modify an output in place fails instead of corrupting the cache. We also
+        // record the file size, time and digest for detecting modifications that bypass that.
+        file::make_read_only(target_path);
+        const auto stat = file::get_file_stat(target_path);
+        integrity.emplace_back(
+            file_integrity_t{file_id, stat.size(), stat.modify_time_ns(), source_digest});
       } else {
         file::copy(source_path, target_path);
       }
     }
+    if (!integrity.empty()) {
+      write_integrity(cache_entry_path, integrity);
+    }
+    if (!digests.empty()) {
+      write_digests(cache_entry_path, digests);
+    }
 
     // Create a cache entry file.
     const auto cache_entry_file_name = file::append_path(cache_entry_path, CACHE_ENTRY_FILE_NAME);
     file::write(entry.serialize(), cache_entry_file_name);
   }
 
+  // Register the entry with its toolchain, so that it can be dropped with the toolchain.
+  if (!entry.toolchain_id().empty()) {
+    try {
+      toolchain_registry_t().add_entry(entry.toolchain_id(), hash);
+    } catch (const std::exception& e) {
+      debug::log(debug::WARNING) << "Unable to register the cache entry: " << e.what();
+    }
+  }
+
   // Occassionally perform housekeeping. We do it here, since:
   //  1) This is the only place where the cache should ever grow.
   //  2) Cache misses are slow anyway.
@@ -564,6 +1195,14 @@ std::pair<cache_entry_t, file_lock_t> local_cache_t::lookup(const std::string& h
     // cache miss).
     const auto cache_entry_file_name = file::append_path(cache_entry_path, CACHE_ENTRY_FILE_NAME);
     const auto entry_data = file::read(cache_entry_file_name);
+
+    // Evict the entry if any of its files have been modified through a hard link.
+    if (!verify_integrity(cache_entry_path)) {
+      file::remove_dir(cache_entry_path);
+      trace::record(trace::event_t::EVICT, trace::tier_t::LOCAL, hash, 0, 0);
+      throw std::runtime_error("The cached files have been modified.");
+    }
+
     update_stats(hash, cache_stats_t::local_hit());
     return std::make_pair(cache_entry_t::deserialize(entry_data), std::move(lock));
   } catch (...) {
@@ -572,6 +1211,16 @@ std::pair<cache_entry_t, file_lock_t> local_cache_t::lookup(const std::string& h
   }
 }
 
+cache_entry_t local_cache_t::peek(const std::string& hash) {
+  try {
+    const auto cache_entry_path = hash_to_cache_entry_path(hash);
+    const auto cache_entry_file_name = file::append_path(cache_entry_path, CACHE_ENTRY_FILE_NAME);
+    return cache_entry_t::deserialize(file::read(cache_entry_file_name));
+  } catch (...) {
+    return cache_entry_t();
+  }
+}
+
 bool local_cache_t::update_stats(const std::string& hash,
                                  const cache_stats_t& delta) const noexcept {
   PERF_SCOPE(UPDATE_STATS);
@@ -604,6 +1253,29 @@ bool local_cache_t::update_stats(const std::string& hash,
   }
 }
 
+int64_t local_cache_t::get_file_size(const std::string& hash,
+                                     const std::string& source_id) const noexcept {
+  try {
+    const auto cache_entry_path = hash_to_cache_entry_path(hash);
+    return file::get_file_info(file::append_path(cache_entry_path, source_id)).size();
+  } catch (...) {
+    return 0;
+  }
+}
+
+void local_cache_t::update_integrity(const std::string& hash) {
+  const auto cache_entry_path = hash_to_cache_entry_path(hash);
+  auto files = read_integrity(cache_entry_path);
+  if (files.empty()) {
+    return;
+  }
+  for (auto& item : files) {
+    const auto path = file::append_path(cache_entry_path, item.file_id);
+    item.modify_time_ns = file::get_file_stat(path).modify_time_ns();
+  }
+  write_integrity(cache_entry_path, files);
+}
+
 void local_cache_t::get_file(const std::string& hash,
                              const std::string& source_id,
                              const std::string& target_path,
@@ -611,7 +1283,35 @@ void local_cache_t::get_file(const std::string& hash,
                              const bool allow_hard_links) {
   const auto cache_entry_path = hash_to_cache_entry_path(hash);
   const auto source_path = file::append_path(cache_entry_path, source_id);
-  if (is_compressed) {
+
+  // Look up the file status that the target had when we last wrote it.
+  std::vector<target_stat_t> targets;
+  try {
+    targets = read_target_stats(cache_entry_path);
+  } catch (const std::exception& e) {
+    debug::log(debug::DEBUG) << "Unable to read the target file status: " << e.what();
+  }
+  auto target = std::find_if(targets.begin(), targets.end(), [&](const target_stat_t& item) {
+    return item.file_id == source_id && item.target_path == target_path;
+  });
+
+  // If the target still has the same file status, it is unchanged. Otherwise we compare the
+  // contents (by size and digest).
+  file::file_stat_t target_stat;
+  try {
+    target_stat = file::get_file_stat(target_path);
+  } catch (...) {
+    // The target file does not exist.
+  }
+  const auto is_unchanged =
+      target_stat.is_valid() &&
+      ((target != targets.end() && is_same_file_stat(target->stat, target_stat)) ||
+       is_target_identical(cache_entry_path, source_id, target_path, target_stat, is_compressed));
+  if (is_unchanged) {
+    // The target file already has the right contents (e.g. after a clean-less rebuild), so there
+    // is no need to write it again.
+    debug::log(debug::DEBUG) << "Target file is unchanged: " << target_path;
+  } else if (is_compressed) {
     debug::log(debug::DEBUG) << "Decompressing file from cache";
     comp::decompress_file(source_path, target_path);
   } else if (allow_hard_links) {
@@ -620,9 +1320,35 @@ void local_cache_t::get_file(const std::string& hash,
     file::copy(source_path, target_path);
   }
 
-  // Touch retrieved file to ensure that the file timestamp is up to date,
-  // and that it is picked up by build system file trackers such as MSBuild.
-  file::touch(target_path);
+  // Touch the retrieved file to ensure that the file timestamp is up to date, and that it is picked
+  // up by build system file trackers such as MSBuild. Files that were just written already have a
+  // fresh timestamp.
+  const auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+  target_stat = file::get_file_stat(target_path);
+  if (target_stat.modify_time_ns() < static_cast<int64_t>(now_ns) - 1000000000LL) {
+    file::touch(target_path);
+    target_stat = file::get_file_stat(target_path);
+  }
+
+  // Remember the file status of the target (most recent first), so that the next retrieval does
+  // not have to read the target.
+  if (!config::read_only() &&
+      (target == targets.end() || !is_same_file_stat(target->stat, target_stat))) {
+    if (target != targets.end()) {
+      targets.erase(target);
+    }
+    targets.insert(targets.begin(), target_stat_t{source_id, target_path, target_stat});
+    if (targets.size() > MAX_TARGETS_PER_ENTRY) {
+      targets.resize(MAX_TARGETS_PER_ENTRY);
+    }
+    try {
+      write_target_stats(cache_entry_path, targets);
+    } catch (const std::exception& e) {
+      debug::log(debug::DEBUG) << "Unable to write the target file status: " << e.what();
+    }
+  }
 }
 
 }  // namespace bcache
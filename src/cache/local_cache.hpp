@@ -48,6 +48,23 @@ public:
   /// @brief Perform housekeeping (prune old entries etc).
   void perform_housekeeping();
 
+  /// @brief Remove all cache entries that were created by the given toolchain.
+  /// @param toolchain_id The toolchain ID.
+  /// @returns the number of removed cache entries.
+  int64_t drop_toolchain(const std::string& toolchain_id);
+
+  /// @brief Show the registered toolchains (print to standard out).
+  void show_toolchains();
+
+  /// @brief Import the cache entries of another local cache.
+  ///
+  /// Entries that do not already exist in this cache are copied concurrently, and are registered
+  /// with their toolchains. Housekeeping is performed afterwards, so the imported entries are
+  /// subject to the regular cache size limit.
+  /// @param root_folder The root folder of the other cache (i.e. its BUILDCACHE_DIR).
+  /// @returns the number of imported cache entries.
+  int64_t import_entries(const std::string& root_folder);
+
   /// @brief Show cache statistics (print to standard out).
   void show_stats();
 
@@ -81,6 +98,18 @@ public:
   /// the entry will be empty, and the file lock object will not hold any lock.
   std::pair<cache_entry_t, file_lock_t> lookup(const std::string& hash);
 
+  /// @brief Get an entry from the cache without locking it or updating the statistics.
+  /// @param hash The cache entry identifier.
+  /// @returns A cache entry struct. If there was no cache hit the entry will be empty.
+  /// @note The entry may be evicted at any time, so this is only useful for estimates.
+  cache_entry_t peek(const std::string& hash);
+
+  /// @brief Get the size of a cached file.
+  /// @param hash The cache entry identifier.
+  /// @param source_id The ID of the cached file.
+  /// @returns the size of the cached file (as stored in the cache), or zero if it is unknown.
+  int64_t get_file_size(const std::string& hash, const std::string& source_id) const noexcept;
+
   /// @brief Copy a cached file to the local file system.
   /// @param hash The cache entry identifier.
   /// @param source_id The ID of the cached file to copy.
@@ -93,6 +122,14 @@ public:
                 const bool is_compressed,
                 const bool allow_hard_links);
 
+  /// @brief Update the recorded integrity information for an entry after retrieving its files.
+  ///
+  /// Retrieving a hard linked file touches the cached file too, so the recorded modification times
+  /// must be updated in order not to be mistaken for tampering at the next lookup.
+  /// @param hash The cache entry identifier.
+  /// @note The entry must be locked by the caller (i.e. this must be called during a lookup).
+  void update_integrity(const std::string& hash);
+
   /// @brief Update statistics associated with the given entry.
   /// @param hash The hash of the entry to which the stats belong.
   /// @param delta The incremental stats delta.
@@ -102,6 +139,8 @@ public:
   bool update_stats(const std::string& hash, const cache_stats_t& delta) const noexcept;
 
 private:
+  bool import_entry(const std::string& source_entry_path);
+  void compact_toolchain_entries();
   std::string hash_to_cache_entry_path(const std::string& hash) const;
   std::string get_cache_files_folder() const;
 };
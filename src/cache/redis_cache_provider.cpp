@@ -70,9 +70,14 @@ redis_cache_provider_t::~redis_cache_provider_t() {
 bool redis_cache_provider_t::connect(const std::string& host_description) {
   // Decode the host description.
   std::string host;
-  int port;
+  int port = -1;
   std::string path;
-  if (!parse_host_description(host_description, host, port, path)) {
+  if (m_use_unix_socket) {
+    // Note: For Unix domain sockets, the "host" is the path to the socket.
+    if (!parse_unix_socket_description(host_description, host, path)) {
+      return false;
+    }
+  } else if (!parse_host_description(host_description, host, port, path)) {
     return false;
   }
 
@@ -85,8 +90,12 @@ bool redis_cache_provider_t::connect(const std::string& host_description) {
     debug::log(debug::INFO) << "Ignoring path part: " << path;
   }
 
-  // Connect to the remote Redis instance.
-  m_ctx = redisConnectWithTimeout(host.c_str(), port, ms_to_timeval(connection_timeout_ms()));
+  // Connect to the Redis instance.
+  if (m_use_unix_socket) {
+    m_ctx = redisConnectUnixWithTimeout(host.c_str(), ms_to_timeval(connection_timeout_ms()));
+  } else {
+    m_ctx = redisConnectWithTimeout(host.c_str(), port, ms_to_timeval(connection_timeout_ms()));
+  }
   if (m_ctx == nullptr || (m_ctx->err != 0)) {
     if (m_ctx != nullptr) {
       debug::log(debug::log_level_t::ERROR) << "Failed connection: " << m_ctx->errstr;
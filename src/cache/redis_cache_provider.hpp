@@ -29,7 +29,11 @@ namespace bcache {
 
 class redis_cache_provider_t : public remote_cache_provider_t {
 public:
-  redis_cache_provider_t() = default;
+  /// @brief Construct a Redis cache provider.
+  /// @param use_unix_socket Connect to a Unix domain socket rather than to a TCP host.
+  explicit redis_cache_provider_t(const bool use_unix_socket = false)
+      : m_use_unix_socket(use_unix_socket) {
+  }
   ~redis_cache_provider_t() override;
 
   // Implementation of the remote_cache_provider_t interface.
@@ -63,6 +67,7 @@ private:
   void set_data(const std::string& key, const std::string& data);
 
   redisContext* m_ctx = nullptr;
+  const bool m_use_unix_socket;
 };
 
 }  // namespace bcache
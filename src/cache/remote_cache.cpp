@@ -25,8 +25,65 @@
 #include <cache/s3_cache_provider.hpp>
 #include <config/configuration.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+
 namespace bcache {
 namespace {
+// Name of the cache entry file (the same for all providers).
+const std::string CACHE_ENTRY_FILE_NAME = ".entry";
+
+// The prefix (namespace) for BuildCache keys (the same for all providers).
+const std::string KEY_PREFIX = "buildcache";
+
+// Remote requests are mostly latency bound, so we use several threads even on machines with few
+// cores.
+const size_t MAX_REMOVE_THREADS = 8U;
+
+/// @brief A remote cache entry and its objects.
+struct gc_entry_t {
+  std::vector<std::string> keys;    ///< The keys of the objects (the entry file first).
+  int64_t size = 0;                 ///< The total size of the objects.
+  time::seconds_t modify_time = 0;  ///< The most recent modification time of the objects.
+};
+
+// Group the objects by cache entry. The keys have the form "buildcache_<hash>_<file>".
+std::vector<gc_entry_t> group_objects(
+    const std::vector<remote_cache_provider_t::object_info_t>& objects) {
+  std::map<std::string, gc_entry_t> entries;
+  for (const auto& object : objects) {
+    const auto hash_start = KEY_PREFIX.size() + 1;
+    const auto hash_end = object.key.find('_', hash_start);
+    if (object.key.compare(0, hash_start, KEY_PREFIX + "_") != 0 ||
+        hash_end == std::string::npos) {
+      continue;
+    }
+    auto& entry = entries[object.key.substr(hash_start, hash_end - hash_start)];
+
+    // Remove the entry file first, so that a concurrent lookup sees a miss rather than an
+    // incomplete entry.
+    if (object.key.compare(hash_end + 1, std::string::npos, CACHE_ENTRY_FILE_NAME) == 0) {
+      entry.keys.insert(entry.keys.begin(), object.key);
+    } else {
+      entry.keys.emplace_back(object.key);
+    }
+    entry.size += object.size;
+    entry.modify_time = std::max(entry.modify_time, object.modify_time);
+  }
+
+  std::vector<gc_entry_t> result;
+  result.reserve(entries.size());
+  for (const auto& entry : entries) {
+    result.emplace_back(entry.second);
+  }
+  return result;
+}
+
 bool get_host_description(std::string& protocol, std::string& host_description) {
   const auto& remote_address = config::remote();
   if (remote_address.empty()) {
@@ -69,8 +126,12 @@ bool remote_cache_t::connect() {
   m_provider = nullptr;
   if (protocol == "http") {
     m_provider = new http_cache_provider_t();
+  } else if (protocol == "http+unix") {
+    m_provider = new http_cache_provider_t(true);
   } else if (protocol == "redis") {
     m_provider = new redis_cache_provider_t();
+  } else if (protocol == "redis+unix") {
+    m_provider = new redis_cache_provider_t(true);
   } else if (protocol == "s3") {
     m_provider = new s3_cache_provider_t();
   }
@@ -115,4 +176,79 @@ void remote_cache_t::get_file(const std::string& hash,
   }
 }
 
+remote_cache_t::gc_result_t remote_cache_t::collect_garbage(const time::seconds_t max_age,
+                                                            const int64_t max_size) {
+  if (m_provider == nullptr) {
+    throw std::runtime_error("Not connected to a remote cache");
+  }
+
+  // Collect all the entries, oldest first.
+  auto entries = group_objects(m_provider->list_objects());
+  std::sort(entries.begin(), entries.end(), [](const gc_entry_t& a, const gc_entry_t& b) {
+    return a.modify_time < b.modify_time;
+  });
+  gc_result_t result;
+  result.num_entries = static_cast<int64_t>(entries.size());
+  for (const auto& entry : entries) {
+    result.size += entry.size;
+  }
+
+  // Select the entries to remove: First the ones that are too old, and then the oldest ones until
+  // the cache is small enough.
+  const auto min_modify_time = time::seconds_since_epoch() - max_age;
+  size_t num_removed = 0U;
+  auto remaining_size = result.size;
+  for (; num_removed < entries.size(); ++num_removed) {
+    const auto& entry = entries[num_removed];
+    const auto is_too_old = (max_age > 0) && (entry.modify_time < min_modify_time);
+    const auto is_too_large = (max_size > 0) && (remaining_size > max_size);
+    if (!is_too_old && !is_too_large) {
+      break;
+    }
+    remaining_size -= entry.size;
+  }
+  debug::log(debug::INFO) << "Removing " << num_removed << " of " << entries.size()
+                          << " remote cache entries";
+
+  // Remove the selected entries concurrently.
+  std::atomic<size_t> next_entry(0U);
+  std::atomic<int64_t> num_removed_entries(0);
+  std::atomic<int64_t> removed_size(0);
+  auto* provider = m_provider;
+  const auto remove_entries =
+      [provider, &entries, num_removed, &next_entry, &num_removed_entries, &removed_size]() {
+        for (auto entry_no = next_entry++; entry_no < num_removed; entry_no = next_entry++) {
+          const auto& entry = entries[entry_no];
+          try {
+            for (const auto& key : entry.keys) {
+              provider->remove_object(key);
+            }
+            ++num_removed_entries;
+            removed_size += entry.size;
+          } catch (const std::exception& e) {
+            debug::log(debug::WARNING) << "Unable to remove a remote cache entry: " << e.what();
+          }
+        }
+      };
+
+  const auto num_threads = std::max<size_t>(1U, std::min(num_removed, MAX_REMOVE_THREADS));
+  std::vector<std::thread> threads;
+  for (size_t i = 1U; i < num_threads; ++i) {
+    try {
+      threads.emplace_back(remove_entries);
+    } catch (const std::system_error& e) {
+      debug::log(debug::DEBUG) << "Unable to start a remove thread: " << e.what();
+      break;
+    }
+  }
+  remove_entries();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  result.num_removed_entries = num_removed_entries;
+  result.removed_size = removed_size;
+  return result;
+}
+
 }  // namespace bcache
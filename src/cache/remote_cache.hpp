@@ -24,12 +24,21 @@
 #include <cache/expected_file.hpp>
 #include <cache/remote_cache_provider.hpp>
 
+#include <cstdint>
 #include <string>
 
 namespace bcache {
 
 class remote_cache_t {
 public:
+  /// @brief Statistics from a remote cache garbage collection.
+  struct gc_result_t {
+    int64_t num_entries = 0;          ///< Number of cache entries before the collection.
+    int64_t size = 0;                 ///< Total size of the cache before the collection.
+    int64_t num_removed_entries = 0;  ///< Number of removed cache entries.
+    int64_t removed_size = 0;         ///< Total size of the removed cache entries.
+  };
+
   /// @brief Initialize the remote cache object.
   remote_cache_t() {
   }
@@ -69,6 +78,17 @@ public:
                 const std::string& target_path,
                 const bool is_compressed);
 
+  /// @brief Remove old entries from the remote cache.
+  ///
+  /// All the entries that are older than the maximum age are removed. Then the oldest remaining
+  /// entries are removed until the total size of the cache is within the maximum size. The age of
+  /// an entry is given by the last modification time of its files.
+  /// @param max_age The maximum age of an entry, in seconds (0 = unlimited).
+  /// @param max_size The maximum total size of the cache, in bytes (0 = unlimited).
+  /// @returns the garbage collection statistics.
+  /// @throws runtime_error if the remote cache does not support garbage collection.
+  gc_result_t collect_garbage(const time::seconds_t max_age, const int64_t max_size);
+
 private:
   remote_cache_provider_t* m_provider = nullptr;
 };
@@ -22,7 +22,75 @@
 #include <base/debug_utils.hpp>
 #include <base/string_list.hpp>
 
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
 namespace bcache {
+namespace {
+// Convert a UTC calendar date to seconds since the Unix epoch (this is a portable timegm()).
+time::seconds_t utc_to_seconds(const int year,
+                               const int month,
+                               const int day,
+                               const int hour,
+                               const int minute,
+                               const int second) {
+  if (month < 1 || month > 12 || day < 1 || day > 31 || hour < 0 || hour > 23 || minute < 0 ||
+      minute > 59 || second < 0 || second > 60) {
+    throw std::runtime_error("Invalid date");
+  }
+
+  // Count the days since 1970-01-01 (see http://howardhinnant.github.io/date_algorithms.html).
+  const int64_t y = static_cast<int64_t>(year) - (month <= 2 ? 1 : 0);
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const int64_t year_of_era = y - era * 400;
+  const int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  const int64_t days = era * 146097 + day_of_era - 719468;
+
+  return ((days * 24 + hour) * 60 + minute) * 60 + second;
+}
+
+// Find the start of the next XML tag with the given local name, at or after pos.
+std::string::size_type find_xml_tag(const std::string& xml,
+                                    const std::string& name,
+                                    const bool is_end_tag,
+                                    std::string::size_type pos,
+                                    std::string::size_type& tag_end) {
+  while ((pos = xml.find('<', pos)) != std::string::npos) {
+    auto name_start = pos + 1;
+    if (is_end_tag != (name_start < xml.size() && xml[name_start] == '/')) {
+      ++pos;
+      continue;
+    }
+    if (is_end_tag) {
+      ++name_start;
+    }
+    tag_end = xml.find('>', name_start);
+    if (tag_end == std::string::npos) {
+      break;
+    }
+    auto name_end = xml.find_first_of(" \t\r\n/>", name_start);
+    const auto qualified_name = xml.substr(name_start, name_end - name_start);
+    const auto colon_pos = qualified_name.find(':');
+    const auto local_name =
+        (colon_pos != std::string::npos) ? qualified_name.substr(colon_pos + 1) : qualified_name;
+    if (local_name == name) {
+      return pos;
+    }
+    pos = tag_end;
+  }
+  return std::string::npos;
+}
+}  // namespace
+
+std::vector<remote_cache_provider_t::object_info_t> remote_cache_provider_t::list_objects() {
+  throw std::runtime_error("Listing objects is not supported by this remote cache provider");
+}
+
+void remote_cache_provider_t::remove_object(const std::string& /* key */) {
+  throw std::runtime_error("Removing objects is not supported by this remote cache provider");
+}
 
 bool remote_cache_provider_t::parse_host_description(const std::string& host_description,
                                                      std::string& host,
@@ -76,6 +144,91 @@ bool remote_cache_provider_t::parse_host_description(const std::string& host_des
   return true;
 }
 
+bool remote_cache_provider_t::parse_unix_socket_description(const std::string& host_description,
+                                                            std::string& socket_path,
+                                                            std::string& path) {
+  // The socket path must be absolute.
+  if (host_description.size() < 2U || host_description[0] != '/') {
+    debug::log(debug::ERROR) << "Invalid Unix domain socket address: \"" << host_description
+                             << "\"";
+    return false;
+  }
+
+  // Split the socket path and the path (if any).
+  const auto colon_pos = host_description.find(':');
+  socket_path = host_description.substr(0, colon_pos);
+  path.clear();
+  if (colon_pos != std::string::npos) {
+    path = host_description.substr(colon_pos + 1);
+    if (!path.empty() && path[0] == '/') {
+      path = path.substr(1);
+    }
+  }
+
+  return true;
+}
+
+string_list_t remote_cache_provider_t::get_xml_elements(const std::string& xml,
+                                                       const std::string& name) {
+  string_list_t result;
+  std::string::size_type pos = 0;
+  std::string::size_type tag_end;
+  while ((pos = find_xml_tag(xml, name, false, pos, tag_end)) != std::string::npos) {
+    // Empty element (e.g. "<foo/>")?
+    if (xml[tag_end - 1] == '/') {
+      result += std::string();
+      pos = tag_end + 1;
+      continue;
+    }
+
+    const auto content_start = tag_end + 1;
+    const auto end_pos = find_xml_tag(xml, name, true, content_start, tag_end);
+    if (end_pos == std::string::npos) {
+      break;
+    }
+    result += xml.substr(content_start, end_pos - content_start);
+    pos = tag_end + 1;
+  }
+  return result;
+}
+
+time::seconds_t remote_cache_provider_t::parse_http_date(const std::string& date) {
+  static const char* MONTHS[] = {
+      "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+  char month_name[4] = {0};
+  int day;
+  int year;
+  int hour;
+  int minute;
+  int second;
+  const auto comma_pos = date.find(',');
+  const auto* str = date.c_str() + (comma_pos != std::string::npos ? comma_pos + 1 : 0);
+  if (std::sscanf(str, "%d %3s %d %d:%d:%d", &day, month_name, &year, &hour, &minute, &second) !=
+      6) {
+    throw std::runtime_error("Invalid HTTP date: " + date);
+  }
+  for (int month = 1; month <= 12; ++month) {
+    if (std::strcmp(month_name, MONTHS[month - 1]) == 0) {
+      return utc_to_seconds(year, month, day, hour, minute, second);
+    }
+  }
+  throw std::runtime_error("Invalid HTTP date: " + date);
+}
+
+time::seconds_t remote_cache_provider_t::parse_iso8601_date(const std::string& date) {
+  int year;
+  int month;
+  int day;
+  int hour;
+  int minute;
+  int second;
+  if (std::sscanf(
+          date.c_str(), "%d-%d-%dT%d:%d:%d", &year, &month, &day, &hour, &minute, &second) != 6) {
+    throw std::runtime_error("Invalid ISO 8601 date: " + date);
+  }
+  return utc_to_seconds(year, month, day, hour, minute, second);
+}
+
 int remote_cache_provider_t::connection_timeout_ms() {
   // We set this relatively low, since a high timeout value would defeat the purpose of BuildCache.
   // TODO(m): Make this configurable.
@@ -20,16 +20,27 @@
 #ifndef BUILDCACHE_REMOTE_CACHE_PROVIDER_HPP_
 #define BUILDCACHE_REMOTE_CACHE_PROVIDER_HPP_
 
+#include <base/string_list.hpp>
+#include <base/time_utils.hpp>
 #include <cache/cache_entry.hpp>
 #include <cache/expected_file.hpp>
 
+#include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
 namespace bcache {
 
 class remote_cache_provider_t {
 public:
+  /// @brief Information about an object in the remote cache.
+  struct object_info_t {
+    std::string key;                  ///< The full name of the object.
+    int64_t size = 0;                 ///< The size of the object (in bytes).
+    time::seconds_t modify_time = 0;  ///< The time when the object was last modified.
+  };
+
   /// @brief De-initialzie the remote cache object.
   virtual ~remote_cache_provider_t() = default;
 
@@ -66,6 +77,19 @@ public:
                         const std::string& target_path,
                         const bool is_compressed) = 0;
 
+  /// @brief List the BuildCache objects in the remote cache.
+  /// @returns information about all the objects.
+  /// @throws runtime_error if the objects could not be listed.
+  /// @note The default implementation throws an exception (listing is not supported).
+  virtual std::vector<object_info_t> list_objects();
+
+  /// @brief Remove an object from the remote cache.
+  /// @param key The full name of the object.
+  /// @throws runtime_error if the object could not be removed.
+  /// @note This method may be called concurrently from several threads.
+  /// @note The default implementation throws an exception (removal is not supported).
+  virtual void remove_object(const std::string& key);
+
 protected:
   // Constructor called by child classes.
   remote_cache_provider_t() = default;
@@ -81,6 +105,40 @@ protected:
                                      int& port,
                                      std::string& path);
 
+  /// @brief Parse a Unix domain socket description string.
+  ///
+  /// The description has the form "/path/to/socket[:/path]", where the optional path part is the
+  /// same as the path of a host description.
+  /// @param host_description The Unix domain socket description string.
+  /// @param[out] socket_path The absolute path to the socket.
+  /// @param[out] path The path (optional - defaults to "").
+  /// @returns true if the parser was successful, or false if it failed.
+  static bool parse_unix_socket_description(const std::string& host_description,
+                                            std::string& socket_path,
+                                            std::string& path);
+
+  /// @brief Get the contents of XML elements.
+  ///
+  /// This is a minimal XML scanner for extracting values from service responses. Namespace
+  /// prefixes are ignored (e.g. "D:href" matches the name "href"), and nested elements with the
+  /// same name are not supported.
+  /// @param xml The XML document (or the contents of an element).
+  /// @param name The local name of the elements to find.
+  /// @returns the contents of all the matching elements, in document order.
+  static string_list_t get_xml_elements(const std::string& xml, const std::string& name);
+
+  /// @brief Parse an HTTP date string (RFC 7231, e.g. "Sun, 06 Nov 1994 08:49:37 GMT").
+  /// @param date The date string.
+  /// @returns the time in seconds since the Unix epoch.
+  /// @throws runtime_error if the date could not be parsed.
+  static time::seconds_t parse_http_date(const std::string& date);
+
+  /// @brief Parse an ISO 8601 UTC date string (e.g. "2009-10-12T17:50:30.000Z").
+  /// @param date The date string.
+  /// @returns the time in seconds since the Unix epoch.
+  /// @throws runtime_error if the date could not be parsed.
+  static time::seconds_t parse_iso8601_date(const std::string& date);
+
   /// @brief Get the timeout for remote connections.
   /// @returns the timeout, in milliseconds.
   static int connection_timeout_ms();
@@ -43,6 +43,19 @@ public:
         host_description, result.host, result.port, result.path);
     return result;
   }
+
+  static parsed_host_description_t parse_unix_socket_description(
+      const std::string& host_description) {
+    parsed_host_description_t result;
+    result.port = -1;
+    result.success = remote_cache_provider_t::parse_unix_socket_description(
+        host_description, result.host, result.path);
+    return result;
+  }
+
+  using remote_cache_provider_t::get_xml_elements;
+  using remote_cache_provider_t::parse_http_date;
+  using remote_cache_provider_t::parse_iso8601_date;
 };
 }  // namespace
 
@@ -106,3 +119,56 @@ TEST_CASE("parse_host_description() fails for incorrect host descriptions") {
     CHECK_EQ(result.success, false);
   }
 }
+
+TEST_CASE("parse_unix_socket_description() parses Unix domain socket descriptions") {
+  SUBCASE("Socket path only") {
+    const auto result = test_cache_provider_t::parse_unix_socket_description("/run/cache.sock");
+    CHECK_EQ(result.success, true);
+    CHECK_EQ(result.host, "/run/cache.sock");
+    CHECK_EQ(result.path, "");
+  }
+
+  SUBCASE("Socket path and path") {
+    const auto result =
+        test_cache_provider_t::parse_unix_socket_description("/run/cache.sock:/my/path");
+    CHECK_EQ(result.success, true);
+    CHECK_EQ(result.host, "/run/cache.sock");
+    CHECK_EQ(result.path, "my/path");
+  }
+
+  SUBCASE("Relative socket path") {
+    const auto result = test_cache_provider_t::parse_unix_socket_description("run/cache.sock");
+    CHECK_EQ(result.success, false);
+  }
+
+  SUBCASE("Empty socket path") {
+    const auto result = test_cache_provider_t::parse_unix_socket_description("");
+    CHECK_EQ(result.success, false);
+  }
+}
+
+TEST_CASE("get_xml_elements() extracts element contents") {
+  const std::string xml =
+      "<?xml version=\"1.0\"?><D:multistatus xmlns:D=\"DAV:\">"
+      "<D:response><D:href>/a/b</D:href><D:getcontentlength>12</D:getcontentlength></D:response>"
+      "<D:response><D:href>/a/c</D:href><D:resourcetype/></D:response>"
+      "</D:multistatus>";
+
+  const auto responses = test_cache_provider_t::get_xml_elements(xml, "response");
+  REQUIRE_EQ(responses.size(), 2);
+  CHECK_EQ(test_cache_provider_t::get_xml_elements(responses[0], "href")[0], "/a/b");
+  CHECK_EQ(test_cache_provider_t::get_xml_elements(responses[0], "getcontentlength")[0], "12");
+  CHECK_EQ(test_cache_provider_t::get_xml_elements(responses[1], "href")[0], "/a/c");
+  CHECK_EQ(test_cache_provider_t::get_xml_elements(responses[1], "resourcetype")[0], "");
+  CHECK_EQ(test_cache_provider_t::get_xml_elements(responses[1], "getcontentlength").size(), 0);
+  CHECK_EQ(test_cache_provider_t::get_xml_elements("<Key>x</Key>", "Key")[0], "x");
+}
+
+TEST_CASE("Date parsing produces the expected times") {
+  CHECK_EQ(test_cache_provider_t::parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT"), 784111777);
+  CHECK_EQ(test_cache_provider_t::parse_http_date("Thu, 01 Jan 1970 00:00:00 GMT"), 0);
+  CHECK_EQ(test_cache_provider_t::parse_iso8601_date("2009-10-12T17:50:30.000Z"), 1255369830);
+  CHECK_EQ(test_cache_provider_t::parse_iso8601_date("2024-02-29T00:00:00Z"), 1709164800);
+  CHECK_THROWS(test_cache_provider_t::parse_http_date("yesterday"));
+  CHECK_THROWS(test_cache_provider_t::parse_iso8601_date("2009-13-12T17:50:30Z"));
+}
@@ -25,14 +25,38 @@
 #include <cpp-base64/base64.h>
 #include <ctime>
 
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 
 namespace bcache {
+namespace {
+// The prefix (namespace) for BuildCache keys.
+const std::string KEY_PREFIX = "buildcache";
+
+std::string url_encode(const std::string& str) {
+  static const char* HEX_DIGITS = "0123456789ABCDEF";
+  std::string result;
+  for (const auto c : str) {
+    if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' ||
+        c == '_' || c == '.' || c == '~') {
+      result += c;
+    } else {
+      const auto x = static_cast<unsigned char>(c);
+      result += '%';
+      result += HEX_DIGITS[x >> 4];
+      result += HEX_DIGITS[x & 15];
+    }
+  }
+  return result;
+}
+}  // namespace
 
 std::string get_date_rfc2616_gmt() {
   // TODO(m): setlocale() is not guaranteed to be thread safe. Can we do this in a more thread safe
-  // manner?
+  // manner? For now we at least serialize our own calls (e.g. for concurrent remote GC requests).
+  static std::mutex date_mutex;
+  std::lock_guard<std::mutex> lock(date_mutex);
 
   // Set the locale to "C" (and save old locale).
   const auto* old_locale_ptr = ::setlocale(LC_ALL, nullptr);
@@ -69,6 +93,47 @@ bool s3_cache_provider_t::connect(const std::string& host_description) {
   return http_cache_provider_t::connect(host_description);
 }
 
+std::vector<remote_cache_provider_t::object_info_t> s3_cache_provider_t::list_objects() {
+  // List the objects using ListObjectsV2, one page (at most 1000 objects) at a time.
+  std::vector<object_info_t> objects;
+  std::string continuation_token;
+  while (true) {
+    auto query = "list-type=2&prefix=" + url_encode(KEY_PREFIX + "_");
+    if (!continuation_token.empty()) {
+      query += "&continuation-token=" + url_encode(continuation_token);
+    }
+    std::string response_body;
+    const auto status = send_request("GET", "", query, {}, "", response_body);
+    if (status != 200) {
+      std::ostringstream ss;
+      ss << "S3 remote responded (" << status << ") to ListObjectsV2: " << response_body;
+      throw std::runtime_error(ss.str());
+    }
+
+    for (const auto& contents : get_xml_elements(response_body, "Contents")) {
+      const auto keys = get_xml_elements(contents, "Key");
+      const auto sizes = get_xml_elements(contents, "Size");
+      const auto dates = get_xml_elements(contents, "LastModified");
+      if (keys.size() != 1 || sizes.size() != 1 || dates.size() != 1) {
+        throw std::runtime_error("Invalid ListObjectsV2 response");
+      }
+      object_info_t object;
+      object.key = keys[0];
+      object.size = std::stoll(sizes[0]);
+      object.modify_time = parse_iso8601_date(dates[0]);
+      objects.emplace_back(object);
+    }
+
+    const auto is_truncated = get_xml_elements(response_body, "IsTruncated");
+    const auto tokens = get_xml_elements(response_body, "NextContinuationToken");
+    if (is_truncated.size() != 1 || is_truncated[0] != "true" || tokens.size() != 1) {
+      break;
+    }
+    continuation_token = tokens[0];
+  }
+  return objects;
+}
+
 std::vector<std::string> s3_cache_provider_t::get_header(const std::string& method,
                                                          const std::string& key) const {
   // Gather information for this request.
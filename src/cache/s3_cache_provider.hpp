@@ -28,6 +28,7 @@ class s3_cache_provider_t : public http_cache_provider_t {
 public:
   // Override S3 specific parts of the http_cache_provider_t.
   bool connect(const std::string& host_description) override;
+  std::vector<object_info_t> list_objects() override;
 
 private:
   /// @brief Sign a string (to create an AWS authorization string).
@@ -0,0 +1,186 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <cache/toolchain_registry.hpp>
+
+#include <base/debug_utils.hpp>
+#include <base/file_utils.hpp>
+#include <base/hasher.hpp>
+#include <config/configuration.hpp>
+
+#include <set>
+#include <stdexcept>
+
+namespace bcache {
+namespace {
+const std::string TOOLCHAINS_FOLDER_NAME = "toolchains";
+const std::string INFO_FILE_NAME = "info";
+const std::string ENTRIES_FILE_NAME = "entries";
+const std::string COMPACT_FILE_NAME = "entries.compact";
+
+// How often the "last seen" time stamp of a toolchain is updated.
+const time::seconds_t SEEN_UPDATE_INTERVAL = 3600;  // One hour.
+
+void read_entries(const std::string& path, string_list_t& result, std::set<std::string>& seen) {
+  if (file::file_exists(path)) {
+    for (const auto& hash : string_list_t(file::read(path), "\n")) {
+      if (!hash.empty() && seen.insert(hash).second) {
+        result += hash;
+      }
+    }
+  }
+}
+
+bool is_valid_toolchain_id(const std::string& id) {
+  // Toolchain ID:s are hex strings (as produced by hasher_t::hash_t::as_string()).
+  if (id.empty()) {
+    return false;
+  }
+  for (const auto c : id) {
+    if ((c < '0') || (c > 'f') || ((c > '9') && (c < 'a'))) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+toolchain_registry_t::toolchain_registry_t() {
+  m_root_dir = file::append_path(config::dir(), TOOLCHAINS_FOLDER_NAME);
+}
+
+std::string toolchain_registry_t::toolchain_id(const std::string& program_id) {
+  hasher_t hasher;
+  hasher.update(program_id);
+  return hasher.final().as_string();
+}
+
+std::string toolchain_registry_t::toolchain_dir(const std::string& id) const {
+  if (!is_valid_toolchain_id(id)) {
+    throw std::runtime_error("Invalid toolchain ID: " + id);
+  }
+  return file::append_path(m_root_dir, id);
+}
+
+void toolchain_registry_t::mark_seen(const std::string& id, const std::string& description) {
+  const auto info_path = file::append_path(toolchain_dir(id), INFO_FILE_NAME);
+  try {
+    // The modification time of the info file is the "last seen" time.
+    const auto info = file::get_file_info(info_path);
+    if ((time::seconds_since_epoch() - info.modify_time()) < SEEN_UPDATE_INTERVAL) {
+      return;
+    }
+  } catch (...) {
+    // The toolchain has not been registered yet.
+  }
+
+  try {
+    file::create_dir_with_parents(file::get_dir_part(info_path));
+    file::write_atomic(description, info_path);
+  } catch (const std::exception& e) {
+    debug::log(debug::DEBUG) << "Unable to update the toolchain registry: " << e.what();
+  }
+}
+
+void toolchain_registry_t::add_entry(const std::string& id, const std::string& hash) {
+  const auto dir = toolchain_dir(id);
+  file::create_dir_with_parents(dir);
+
+  // Appending a single line to the entries file is safe even if several processes do it
+  // concurrently.
+  file::append(hash + "\n", file::append_path(dir, ENTRIES_FILE_NAME));
+}
+
+string_list_t toolchain_registry_t::entries(const std::string& id) {
+  const auto dir = toolchain_dir(id);
+  string_list_t result;
+  std::set<std::string> seen;
+  read_entries(file::append_path(dir, COMPACT_FILE_NAME), result, seen);
+  read_entries(file::append_path(dir, ENTRIES_FILE_NAME), result, seen);
+  return result;
+}
+
+int64_t toolchain_registry_t::compact_entries(
+    const std::string& id,
+    const std::function<bool(const std::string&)>& entry_exists) {
+  const auto dir = toolchain_dir(id);
+  const auto entries_path = file::append_path(dir, ENTRIES_FILE_NAME);
+  const auto compact_path = file::append_path(dir, COMPACT_FILE_NAME);
+
+  // Other processes may append to the entries file while we compact it, so we move it out of the
+  // way first (new entries then go to a new entries file), and append the remaining entries to the
+  // new file. A compact file that is left over from an interrupted compaction is included too.
+  string_list_t old_entries;
+  std::set<std::string> seen;
+  read_entries(compact_path, old_entries, seen);
+  if (file::file_exists(entries_path)) {
+    file::move(entries_path, compact_path);
+    read_entries(compact_path, old_entries, seen);
+  }
+
+  std::string remaining_entries;
+  int64_t num_remaining_entries = 0;
+  for (const auto& hash : old_entries) {
+    if (entry_exists(hash)) {
+      remaining_entries += hash + "\n";
+      ++num_remaining_entries;
+    }
+  }
+  if (!remaining_entries.empty()) {
+    file::append(remaining_entries, entries_path);
+  }
+  file::remove_file(compact_path, true);
+  return num_remaining_entries;
+}
+
+void toolchain_registry_t::remove(const std::string& id) {
+  file::remove_dir(toolchain_dir(id), true);
+}
+
+std::vector<toolchain_registry_t::toolchain_info_t> toolchain_registry_t::list() {
+  std::vector<toolchain_info_t> result;
+  if (!file::dir_exists(m_root_dir)) {
+    return result;
+  }
+
+  for (const auto& dir : file::walk_directory(m_root_dir)) {
+    const auto id = file::get_file_part(dir.path());
+    if (!dir.is_dir() || file::get_dir_part(dir.path()) != m_root_dir ||
+        !is_valid_toolchain_id(id)) {
+      continue;
+    }
+    try {
+      toolchain_info_t info;
+      info.id = id;
+      info.last_seen = dir.modify_time();
+      const auto info_path = file::append_path(dir.path(), INFO_FILE_NAME);
+      if (file::file_exists(info_path)) {
+        info.description = file::read(info_path);
+        info.last_seen = file::get_file_info(info_path).modify_time();
+      }
+      info.num_entries = static_cast<int64_t>(entries(id).size());
+      result.emplace_back(info);
+    } catch (const std::exception& e) {
+      debug::log(debug::DEBUG) << "Skipping toolchain " << id << ": " << e.what();
+    }
+  }
+  return result;
+}
+
+}  // namespace bcache
@@ -0,0 +1,97 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef BUILDCACHE_TOOLCHAIN_REGISTRY_HPP_
+#define BUILDCACHE_TOOLCHAIN_REGISTRY_HPP_
+
+#include <base/string_list.hpp>
+#include <base/time_utils.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bcache {
+/// @brief Keep track of the toolchains (program ID:s) that use the local cache.
+///
+/// The registry records when each toolchain was last seen, and which cache entries were created
+/// by each toolchain. This makes it possible to remove all the entries of a toolchain that is no
+/// longer in use (e.g. after a compiler upgrade) without walking the entire cache.
+///
+/// A toolchain ID is a hash of the program ID of a wrapped program (see
+/// program_wrapper_t::get_program_id()).
+class toolchain_registry_t {
+public:
+  /// @brief Information about a single toolchain.
+  struct toolchain_info_t {
+    std::string id;             ///< The toolchain ID.
+    std::string description;    ///< A human readable description (e.g. the program path).
+    time::seconds_t last_seen;  ///< The last time that the toolchain was used.
+    int64_t num_entries;        ///< The number of registered cache entries.
+  };
+
+  /// @brief Construct a toolchain registry for the local cache.
+  toolchain_registry_t();
+
+  /// @brief Get the toolchain ID for a program ID.
+  /// @param program_id The program ID.
+  /// @returns the toolchain ID.
+  static std::string toolchain_id(const std::string& program_id);
+
+  /// @brief Record that a toolchain is in use.
+  /// @param id The toolchain ID.
+  /// @param description A human readable description of the toolchain.
+  /// @note To keep the cost down, the time stamp is only updated every once in a while.
+  void mark_seen(const std::string& id, const std::string& description);
+
+  /// @brief Register a cache entry that was created by a toolchain.
+  /// @param id The toolchain ID.
+  /// @param hash The cache entry identifier.
+  void add_entry(const std::string& id, const std::string& hash);
+
+  /// @brief Get the cache entries that have been registered for a toolchain.
+  /// @param id The toolchain ID.
+  /// @returns a list of cache entry identifiers.
+  string_list_t entries(const std::string& id);
+
+  /// @brief Compact the registered cache entries of a toolchain.
+  ///
+  /// Duplicate entries and entries that no longer exist in the cache are dropped.
+  /// @param id The toolchain ID.
+  /// @param entry_exists A function that checks if a cache entry still exists.
+  /// @returns the number of remaining entries.
+  int64_t compact_entries(const std::string& id,
+                          const std::function<bool(const std::string&)>& entry_exists);
+
+  /// @brief Remove a toolchain from the registry.
+  /// @param id The toolchain ID.
+  void remove(const std::string& id);
+
+  /// @brief List all the registered toolchains.
+  /// @returns a list of toolchain information objects.
+  std::vector<toolchain_info_t> list();
+
+private:
+  std::string toolchain_dir(const std::string& id) const;
+
+  std::string m_root_dir;
+};
+}  // namespace bcache
+
+#endif  // BUILDCACHE_TOOLCHAIN_REGISTRY_HPP_
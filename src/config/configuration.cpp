@@ -51,6 +51,7 @@ std::string s_config_file;
 // Configuration options.
 config::cache_accuracy_t s_accuracy;
 bool s_cache_link_commands;
+bool s_canonical_args;
 bool s_compress;
 config::compress_format_t s_compress_format;
 int32_t s_compress_level;
@@ -58,6 +59,10 @@ int32_t s_debug;
 bool s_disable;
 std::string s_dir;
 bool s_direct_mode;
+int64_t s_failure_ttl;
+bool s_file_watcher;
+bool s_git_index;
+int32_t s_hard_link_verify;
 bool s_hard_links;
 string_list_t s_hash_extra_files;
 std::string s_impersonate;
@@ -66,6 +71,9 @@ string_list_t s_lua_paths;
 int64_t s_max_cache_size;
 int64_t s_max_local_entry_size;
 int64_t s_max_remote_entry_size;
+int64_t s_min_free_space;
+std::string s_offload;
+std::string s_offload_secret;
 bool s_perf;
 std::string s_prefix;
 bool s_read_only;
@@ -74,9 +82,15 @@ std::string s_redis_username;
 std::string s_redis_password;
 bool s_remote_locks;
 std::string s_remote;
+int64_t s_remote_max_age;
+int64_t s_remote_max_size;
 std::string s_s3_access;
 std::string s_s3_secret;
+bool s_stat_validation;
 bool s_terminate_on_miss;
+int64_t s_toolchain_expiry;
+std::string s_trace_file;
+bool s_tree_hash;
 
 std::string to_lower(const std::string& str) {
   std::string str_lower(str.size(), ' ');
@@ -135,6 +149,7 @@ config::compress_format_t to_compress_format(const std::string& str) {
 void set_defaults() noexcept {
   s_accuracy = config::cache_accuracy_t::DEFAULT;
   s_cache_link_commands = false;
+  s_canonical_args = false;
   s_compress = true;
   s_compress_format = config::compress_format_t::DEFAULT;
   s_compress_level = -1;
@@ -142,6 +157,10 @@ void set_defaults() noexcept {
   s_disable = false;
   s_dir = std::string();
   s_direct_mode = false;
+  s_failure_ttl = 0;
+  s_file_watcher = false;
+  s_git_index = false;
+  s_hard_link_verify = 0;
   s_hard_links = false;
   s_hash_extra_files = string_list_t();
   s_impersonate = std::string();
@@ -150,6 +169,9 @@ void set_defaults() noexcept {
   s_max_cache_size = DEFAULT_MAX_CACHE_SIZE;
   s_max_local_entry_size = DEFAULT_MAX_LOCAL_ENTRY_SIZE;
   s_max_remote_entry_size = DEFAULT_MAX_REMOTE_ENTRY_SIZE;
+  s_min_free_space = 0;
+  s_offload = std::string();
+  s_offload_secret = std::string();
   s_perf = false;
   s_prefix = std::string();
   s_read_only = false;
@@ -158,9 +180,15 @@ void set_defaults() noexcept {
   s_redis_password = std::string();
   s_remote_locks = false;
   s_remote = std::string();
+  s_remote_max_age = 0;
+  s_remote_max_size = 0;
   s_s3_access = std::string();
   s_s3_secret = std::string();
+  s_stat_validation = false;
   s_terminate_on_miss = false;
+  s_toolchain_expiry = 2592000;
+  s_trace_file = std::string();
+  s_tree_hash = false;
 }
 
 void load_from_file(const std::string& file_name) {
@@ -199,6 +227,13 @@ void load_from_file(const std::string& file_name) {
     }
   }
 
+  {
+    const auto* node = cJSON_GetObjectItemCaseSensitive(root, "canonical_args");
+    if (cJSON_IsBool(node) != 0) {
+      s_canonical_args = (cJSON_IsTrue(node) != 0);
+    }
+  }
+
   {
     const auto* node = cJSON_GetObjectItemCaseSensitive(root, "compress");
     if (cJSON_IsBool(node) != 0) {
@@ -241,6 +276,34 @@ void load_from_file(const std::string& file_name) {
     }
   }
 
+  {
+    const auto* node = cJSON_GetObjectItemCaseSensitive(root, "failure_ttl");
+    if (cJSON_IsNumber(node) != 0) {
+      s_failure_ttl = static_cast<int64_t>(node->valuedouble);
+    }
+  }
+
+  {
+    const auto* node = cJSON_GetObjectItemCaseSensitive(root, "file_watcher");
+    if (cJSON_IsBool(node) != 0) {
+      s_file_watcher = (cJSON_IsTrue(node) != 0);
+    }
+  }
+
+  {
+    const auto* node = cJSON_GetObjectItemCaseSensitive(root, "git_index");
+    if (cJSON_IsBool(node) != 0) {
+      s_git_index = (cJSON_IsTrue(node) != 0);
+    }
+  }
+
+  {
+    const auto* node = cJSON_GetObjectItemCaseSensitive(root, "hard_link_verify");
+    if (cJSON_IsNumber(node) != 0) {
+      s_hard_link_verify = static_cast<int32_t>(node->valueint);
+    }
+  }
+
   {
     const auto* node = cJSON_GetObjectItemCaseSensitive(root, "hard_links");
     if (cJSON_IsBool(node) != 0) {
@@ -301,6 +364,27 @@ void load_from_file(const std::string& file_name) {
     }
   }
 
+  {
+    const auto* node = cJSON_GetObjectItemCaseSensitive(root, "min_free_space");
+    if (cJSON_IsNumber(node) != 0) {
+      s_min_free_space = static_cast<int64_t>(node->valuedouble);
+    }
+  }
+
+  {
+    const auto* node = cJSON_GetObjectItemCaseSensitive(root, "offload");
+    if ((cJSON_IsString(node) != 0) && node->valuestring != nullptr) {
+      s_offload = std::string(node->valuestring);
+    }
+  }
+
+  {
+    const auto* node = cJSON_GetObjectItemCaseSensitive(root, "offload_secret");
+    if ((cJSON_IsString(node) != 0) && node->valuestring != nullptr) {
+      s_offload_secret = std::string(node->valuestring);
+    }
+  }
+
   {
     const auto* node = cJSON_GetObjectItemCaseSensitive(root, "perf");
     if (cJSON_IsBool(node) != 0) {
@@ -357,6 +441,20 @@ void load_from_file(const std::string& file_name) {
     }
   }
 
+  {
+    const auto* node = cJSON_GetObjectItemCaseSensitive(root, "remote_max_age");
+    if (cJSON_IsNumber(node) != 0) {
+      s_remote_max_age = static_cast<int64_t>(node->valuedouble);
+    }
+  }
+
+  {
+    const auto* node = cJSON_GetObjectItemCaseSensitive(root, "remote_max_size");
+    if (cJSON_IsNumber(node) != 0) {
+      s_remote_max_size = static_cast<int64_t>(node->valuedouble);
+    }
+  }
+
   {
     const auto* node = cJSON_GetObjectItemCaseSensitive(root, "s3_access");
     if ((cJSON_IsString(node) != 0) && node->valuestring != nullptr) {
@@ -371,6 +469,13 @@ void load_from_file(const std::string& file_name) {
     }
   }
 
+  {
+    const auto* node = cJSON_GetObjectItemCaseSensitive(root, "stat_validation");
+    if (cJSON_IsBool(node) != 0) {
+      s_stat_validation = (cJSON_IsTrue(node) != 0);
+    }
+  }
+
   {
     const auto* node = cJSON_GetObjectItemCaseSensitive(root, "terminate_on_miss");
     if (cJSON_IsBool(node) != 0) {
@@ -378,6 +483,27 @@ void load_from_file(const std::string& file_name) {
     }
   }
 
+  {
+    const auto* node = cJSON_GetObjectItemCaseSensitive(root, "toolchain_expiry");
+    if (cJSON_IsNumber(node) != 0) {
+      s_toolchain_expiry = static_cast<int64_t>(node->valuedouble);
+    }
+  }
+
+  {
+    const auto* node = cJSON_GetObjectItemCaseSensitive(root, "trace_file");
+    if ((cJSON_IsString(node) != 0) && node->valuestring != nullptr) {
+      s_trace_file = std::string(node->valuestring);
+    }
+  }
+
+  {
+    const auto* node = cJSON_GetObjectItemCaseSensitive(root, "tree_hash");
+    if (cJSON_IsBool(node) != 0) {
+      s_tree_hash = (cJSON_IsTrue(node) != 0);
+    }
+  }
+
   cJSON_Delete(root);
 }
 }  // namespace
@@ -438,6 +564,13 @@ void init(const char* bcache_dir) {
       }
     }
 
+    {
+      const env_var_t env("BUILDCACHE_CANONICAL_ARGS");
+      if (env) {
+        s_canonical_args = env.as_bool();
+      }
+    }
+
     {
       const env_var_t env("BUILDCACHE_COMPRESS");
       if (env) {
@@ -488,6 +621,42 @@ void init(const char* bcache_dir) {
       }
     }
 
+    {
+      const env_var_t env("BUILDCACHE_FAILURE_TTL");
+      if (env) {
+        try {
+          s_failure_ttl = env.as_int64();
+        } catch (...) {
+          // Ignore...
+        }
+      }
+    }
+
+    {
+      const env_var_t env("BUILDCACHE_FILE_WATCHER");
+      if (env) {
+        s_file_watcher = env.as_bool();
+      }
+    }
+
+    {
+      const env_var_t env("BUILDCACHE_GIT_INDEX");
+      if (env) {
+        s_git_index = env.as_bool();
+      }
+    }
+
+    {
+      const env_var_t env("BUILDCACHE_HARD_LINK_VERIFY");
+      if (env) {
+        try {
+          s_hard_link_verify = static_cast<int32_t>(env.as_int64());
+        } catch (...) {
+          // Ignore...
+        }
+      }
+    }
+
     {
       const env_var_t env("BUILDCACHE_HARD_LINKS");
       if (env) {
@@ -556,6 +725,31 @@ void init(const char* bcache_dir) {
       }
     }
 
+    {
+      const env_var_t env("BUILDCACHE_MIN_FREE_SPACE");
+      if (env) {
+        try {
+          s_min_free_space = env.as_int64();
+        } catch (...) {
+          // Ignore...
+        }
+      }
+    }
+
+    {
+      const env_var_t env("BUILDCACHE_OFFLOAD");
+      if (env) {
+        s_offload = env.as_string();
+      }
+    }
+
+    {
+      const env_var_t env("BUILDCACHE_OFFLOAD_SECRET");
+      if (env) {
+        s_offload_secret = env.as_string();
+      }
+    }
+
     {
       const env_var_t env("BUILDCACHE_PERF");
       if (env) {
@@ -612,6 +806,28 @@ void init(const char* bcache_dir) {
       }
     }
 
+    {
+      const env_var_t env("BUILDCACHE_REMOTE_MAX_AGE");
+      if (env) {
+        try {
+          s_remote_max_age = env.as_int64();
+        } catch (...) {
+          // Ignore...
+        }
+      }
+    }
+
+    {
+      const env_var_t env("BUILDCACHE_REMOTE_MAX_SIZE");
+      if (env) {
+        try {
+          s_remote_max_size = env.as_int64();
+        } catch (...) {
+          // Ignore...
+        }
+      }
+    }
+
     {
       const env_var_t env("BUILDCACHE_S3_ACCESS");
       if (env) {
@@ -626,6 +842,13 @@ void init(const char* bcache_dir) {
       }
     }
 
+    {
+      const env_var_t env("BUILDCACHE_STAT_VALIDATION");
+      if (env) {
+        s_stat_validation = env.as_bool();
+      }
+    }
+
     {
       const env_var_t env("BUILDCACHE_TERMINATE_ON_MISS");
       if (env) {
@@ -633,6 +856,31 @@ void init(const char* bcache_dir) {
       }
     }
 
+    {
+      const env_var_t env("BUILDCACHE_TOOLCHAIN_EXPIRY");
+      if (env) {
+        try {
+          s_toolchain_expiry = env.as_int64();
+        } catch (...) {
+          // Ignore...
+        }
+      }
+    }
+
+    {
+      const env_var_t env("BUILDCACHE_TRACE_FILE");
+      if (env) {
+        s_trace_file = env.as_string();
+      }
+    }
+
+    {
+      const env_var_t env("BUILDCACHE_TREE_HASH");
+      if (env) {
+        s_tree_hash = env.as_bool();
+      }
+    }
+
     // We also look for Lua files in the cache root dir (i.e. ${BUILDCACHE_DIR}/lua).
     // Note: We give the default Lua path the lowest priority.
     s_lua_paths += file::append_path(s_dir, "lua");
@@ -655,6 +903,10 @@ bool cache_link_commands() {
   return s_cache_link_commands;
 }
 
+bool canonical_args() {
+  return s_canonical_args;
+}
+
 bool compress() {
   return s_compress;
 }
@@ -683,6 +935,22 @@ bool disable() {
   return s_disable;
 }
 
+int64_t failure_ttl() {
+  return s_failure_ttl;
+}
+
+bool file_watcher() {
+  return s_file_watcher;
+}
+
+bool git_index() {
+  return s_git_index;
+}
+
+int32_t hard_link_verify() {
+  return s_hard_link_verify;
+}
+
 bool hard_links() {
   return s_hard_links;
 }
@@ -715,6 +983,18 @@ int64_t max_remote_entry_size() {
   return s_max_remote_entry_size;
 }
 
+int64_t min_free_space() {
+  return s_min_free_space;
+}
+
+const std::string& offload() {
+  return s_offload;
+}
+
+const std::string& offload_secret() {
+  return s_offload_secret;
+}
+
 bool perf() {
   return s_perf;
 }
@@ -747,6 +1027,14 @@ bool remote_locks() {
   return s_remote_locks;
 }
 
+int64_t remote_max_age() {
+  return s_remote_max_age;
+}
+
+int64_t remote_max_size() {
+  return s_remote_max_size;
+}
+
 const std::string& s3_access() {
   return s_s3_access;
 }
@@ -755,9 +1043,25 @@ const std::string& s3_secret() {
   return s_s3_secret;
 }
 
+bool stat_validation() {
+  return s_stat_validation;
+}
+
 bool terminate_on_miss() {
   return s_terminate_on_miss;
 }
 
+int64_t toolchain_expiry() {
+  return s_toolchain_expiry;
+}
+
+const std::string& trace_file() {
+  return s_trace_file;
+}
+
+bool tree_hash() {
+  return s_tree_hash;
+}
+
 }  // namespace config
 }  // namespace bcache
@@ -67,6 +67,9 @@ cache_accuracy_t accuracy();
 /// @returns true if BuildCache should cache link commands.
 bool cache_link_commands();
 
+/// @returns true if compiler arguments should be canonicalized before hashing.
+bool canonical_args();
+
 /// @returns true if BuildCache should compress data in the cache.
 bool compress();
 
@@ -88,6 +91,18 @@ bool direct_mode();
 /// @returns true if BuildCache is disabled.
 bool disable();
 
+/// @returns the life time (in seconds) of cached compilation failures (0 = disabled).
+int64_t failure_ttl();
+
+/// @returns Should direct mode use the file watcher daemon (if running) for validating include files?
+bool file_watcher();
+
+/// @returns Should direct mode use git blob IDs from the git index as file digests for clean tracked files?
+bool git_index();
+
+/// @returns the percentage of shared cache files whose contents are verified on a hit.
+int32_t hard_link_verify();
+
 /// @returns true if BuildCache should use hard links when possible.
 bool hard_links();
 
@@ -112,6 +127,15 @@ int64_t max_local_entry_size();
 /// @returns the maximum remote cache entry size (in bytes).
 int64_t max_remote_entry_size();
 
+/// @returns the minimum free disk space to keep in the cache file system (in bytes)
+int64_t min_free_space();
+
+/// @returns the address of the compile offload worker (empty if disabled).
+const std::string& offload();
+
+/// @returns the shared secret for authenticating compile offload requests.
+const std::string& offload_secret();
+
 /// @returns true if performance profiling output is enabled.
 bool perf();
 
@@ -136,15 +160,33 @@ const std::string& remote();
 /// @returns true if BuildCache must use file locks that are safe for remote file systems.
 bool remote_locks();
 
+/// @returns the maximum age of remote cache entries for --remote-gc (in seconds, 0 = unlimited).
+int64_t remote_max_age();
+
+/// @returns the maximum size of the remote cache for --remote-gc (in bytes, 0 = unlimited).
+int64_t remote_max_size();
+
 /// @returns the S3 access key for the remote cache.
 const std::string& s3_access();
 
 /// @returns the S3 secret key for the remote cache.
 const std::string& s3_secret();
 
+/// @returns true if direct mode include files may be validated using file status information only.
+bool stat_validation();
+
 /// @returns true if a "terminate on a miss" mode is enabled.
 bool terminate_on_miss();
 
+/// @returns the time (in seconds) after which the cache entries of an unused toolchain are dropped
+int64_t toolchain_expiry();
+
+/// @returns the access trace file (empty string for no tracing)
+const std::string& trace_file();
+
+/// @returns Should large preprocessed sources be hashed in parallel (using a tree hash)?
+bool tree_hash();
+
 }  // namespace config
 }  // namespace bcache
 
@@ -20,14 +20,20 @@
 #include <base/debug_utils.hpp>
 #include <base/string_list.hpp>
 #include <base/unicode_utils.hpp>
+#include <cache/access_trace.hpp>
+#include <cache/cache_simulator.hpp>
 #include <cache/local_cache.hpp>
+#include <cache/remote_cache.hpp>
 #include <config/configuration.hpp>
+#include <sys/file_watcher.hpp>
+#include <sys/offload.hpp>
 #include <sys/perf_utils.hpp>
 #include <sys/sys_utils.hpp>
 #include <wrappers/ccc_analyzer_wrapper.hpp>
 #include <wrappers/clang_cl_wrapper.hpp>
 #include <wrappers/gcc_wrapper.hpp>
 #include <wrappers/ghs_wrapper.hpp>
+#include <wrappers/json_wrapper.hpp>
 #include <wrappers/lua_wrapper.hpp>
 #include <wrappers/msvc_wrapper.hpp>
 #include <wrappers/program_wrapper.hpp>
@@ -63,30 +69,41 @@ bool is_lua_script(const std::string& script_path) {
   return (bcache::lower_case(bcache::file::get_extension(script_path)) == ".lua");
 }
 
+bool is_json_spec(const std::string& spec_path) {
+  return (bcache::lower_case(bcache::file::get_extension(spec_path)) == ".json");
+}
+
 std::unique_ptr<bcache::program_wrapper_t> find_suitable_wrapper(
     const bcache::file::exe_path_t& exe_path,
     const bcache::string_list_t& args) {
   std::unique_ptr<bcache::program_wrapper_t> wrapper;
 
-  // Try Lua wrappers first (so you can override internal wrappers).
+  // Try Lua and JSON wrappers first (so you can override internal wrappers).
   // Iterate over the existing Lua paths.
   for (const auto& lua_root_dir : bcache::config::lua_paths()) {
     if (bcache::file::dir_exists(lua_root_dir)) {
-      // Find all .lua files in the given directory.
+      // Find all .lua and .json files in the given directory.
       const auto lua_files = bcache::file::walk_directory(lua_root_dir);
       for (const auto& file_info : lua_files) {
         const auto& script_path = file_info.path();
-        if ((!file_info.is_dir()) && is_lua_script(script_path)) {
-          // Check if the given wrapper can handle this command (first match wins).
+        if (file_info.is_dir()) {
+          continue;
+        }
+        if (is_lua_script(script_path)) {
           wrapper.reset(new bcache::lua_wrapper_t(exe_path, args, script_path));
-          if (wrapper->can_handle_command()) {
-            bcache::debug::log(bcache::debug::DEBUG)
-                << "Found matching Lua wrapper for " << exe_path.virtual_path() << ": "
-                << script_path;
-            break;
-          }
-          wrapper = nullptr;
+        } else if (is_json_spec(script_path)) {
+          wrapper.reset(new bcache::json_wrapper_t(exe_path, args, script_path));
+        } else {
+          continue;
         }
+
+        // Check if the given wrapper can handle this command (first match wins).
+        if (wrapper->can_handle_command()) {
+          bcache::debug::log(bcache::debug::DEBUG)
+              << "Found matching wrapper for " << exe_path.virtual_path() << ": " << script_path;
+          break;
+        }
+        wrapper = nullptr;
       }
     }
     if (wrapper) {
@@ -159,6 +176,150 @@ std::unique_ptr<bcache::program_wrapper_t> find_suitable_wrapper(
   std::exit(return_code);
 }
 
+[[noreturn]] void show_toolchains_and_exit() {
+  int return_code = 0;
+  try {
+    bcache::local_cache_t cache;
+    cache.show_toolchains();
+  } catch (const std::exception& e) {
+    std::cerr << "*** Unexpected error: " << e.what() << "\n";
+    return_code = 1;
+  } catch (...) {
+    std::cerr << "*** Unexpected error.\n";
+    return_code = 1;
+  }
+  std::exit(return_code);
+}
+
+[[noreturn]] void drop_toolchain_and_exit(const std::string& toolchain_id) {
+  int return_code = 0;
+  try {
+    bcache::local_cache_t cache;
+    const auto num_removed_entries = cache.drop_toolchain(toolchain_id);
+    std::cout << "Removed " << num_removed_entries << " cache entries\n";
+  } catch (const std::exception& e) {
+    std::cerr << "*** Unexpected error: " << e.what() << "\n";
+    return_code = 1;
+  } catch (...) {
+    std::cerr << "*** Unexpected error.\n";
+    return_code = 1;
+  }
+  std::exit(return_code);
+}
+
+[[noreturn]] void import_and_exit(const std::string& root_folder) {
+  int return_code = 0;
+  try {
+    bcache::local_cache_t cache;
+    const auto num_imported_entries = cache.import_entries(root_folder);
+    std::cout << "Imported " << num_imported_entries << " cache entries\n";
+  } catch (const std::exception& e) {
+    std::cerr << "*** Unexpected error: " << e.what() << "\n";
+    return_code = 1;
+  } catch (...) {
+    std::cerr << "*** Unexpected error.\n";
+    return_code = 1;
+  }
+  std::exit(return_code);
+}
+
+[[noreturn]] void remote_gc_and_exit() {
+  int return_code = 0;
+  try {
+    if (bcache::config::read_only() || bcache::config::read_only_remote()) {
+      throw std::runtime_error("The remote cache is read only");
+    }
+    bcache::remote_cache_t remote_cache;
+    if (!remote_cache.connect()) {
+      throw std::runtime_error("Unable to connect to the remote cache (see BUILDCACHE_REMOTE)");
+    }
+    const auto result = remote_cache.collect_garbage(bcache::config::remote_max_age(),
+                                                     bcache::config::remote_max_size());
+    std::cout << "Removed " << result.num_removed_entries << " of " << result.num_entries
+              << " remote cache entries ("
+              << bcache::file::human_readable_size(result.removed_size) << " of "
+              << bcache::file::human_readable_size(result.size) << ")\n";
+  } catch (const std::exception& e) {
+    std::cerr << "*** Unexpected error: " << e.what() << "\n";
+    return_code = 1;
+  } catch (...) {
+    std::cerr << "*** Unexpected error.\n";
+    return_code = 1;
+  }
+  std::exit(return_code);
+}
+
+[[noreturn]] void simulate_and_exit(const std::string& trace_file) {
+  int return_code = 0;
+  try {
+    const auto records = bcache::trace::decode(bcache::file::read(trace_file));
+    bcache::sim::print_report(records, std::cout);
+  } catch (const std::exception& e) {
+    std::cerr << "*** Unexpected error: " << e.what() << "\n";
+    return_code = 1;
+  } catch (...) {
+    std::cerr << "*** Unexpected error.\n";
+    return_code = 1;
+  }
+  std::exit(return_code);
+}
+
+void print_estimate(const bcache::string_list_t& command) {
+  // Note: The wrapper keeps references to the executable path and the arguments.
+  std::string result = "unknown\t-\t-1";
+  try {
+    auto args = command;
+    const auto exe_path = bcache::file::find_executable(args[0], BUILDCACHE_EXE_NAME);
+    args[0] = exe_path.virtual_path();
+    auto wrapper = find_suitable_wrapper(exe_path, args);
+    if (wrapper) {
+      const auto estimate = wrapper->estimate();
+      result = std::string(estimate.is_hit ? "hit" : "miss") + "\t" +
+               (estimate.tier.empty() ? std::string("-") : estimate.tier) + "\t" +
+               std::to_string(estimate.duration_ms);
+    }
+  } catch (const std::exception& e) {
+    bcache::debug::log(bcache::debug::INFO) << "Estimate failed: " << e.what();
+  }
+  std::cout << result << std::endl;
+}
+
+[[noreturn]] void estimate_and_exit(const bcache::string_list_t& command) {
+  print_estimate(command);
+  std::exit(0);
+}
+
+[[noreturn]] void estimate_batch_and_exit(const std::string& commands_file) {
+  int return_code = 0;
+  try {
+    // Read one command per line. Commands from stdin are handled as they arrive, so that a build
+    // scheduler can keep a single estimator process running.
+    const auto estimate_line = [](const std::string& line) {
+      const auto command = bcache::string_list_t::split_args(line);
+      if (command.size() > 0) {
+        print_estimate(command);
+      }
+    };
+    if (commands_file == "-") {
+      std::string line;
+      while (std::getline(std::cin, line)) {
+        estimate_line(line);
+      }
+    } else {
+      for (const auto& line : bcache::string_list_t(bcache::file::read(commands_file), "\n")) {
+        estimate_line(line);
+      }
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "*** Unexpected error: " << e.what() << "\n";
+    return_code = 1;
+  } catch (...) {
+    std::cerr << "*** Unexpected error.\n";
+    return_code = 1;
+  }
+  std::exit(return_code);
+}
+
 [[noreturn]] void show_stats_and_exit() {
   int return_code = 0;
   try {
@@ -192,6 +353,8 @@ std::unique_ptr<bcache::program_wrapper_t> find_suitable_wrapper(
               << "\n";
     std::cout << "  BUILDCACHE_CACHE_LINK_COMMANDS:    "
               << (bcache::config::cache_link_commands() ? "true" : "false") << "\n";
+    std::cout << "  BUILDCACHE_CANONICAL_ARGS:         "
+              << (bcache::config::canonical_args() ? "true" : "false") << "\n";
     std::cout << "  BUILDCACHE_COMPRESS:               "
               << (bcache::config::compress() ? "true" : "false") << "\n";
     std::cout << "  BUILDCACHE_COMPRESS_FORMAT:        "
@@ -204,6 +367,13 @@ std::unique_ptr<bcache::program_wrapper_t> find_suitable_wrapper(
               << (bcache::config::direct_mode() ? "true" : "false") << "\n";
     std::cout << "  BUILDCACHE_DISABLE:                "
               << (bcache::config::disable() ? "true" : "false") << "\n";
+    std::cout << "  BUILDCACHE_FAILURE_TTL:            " << bcache::config::failure_ttl() << "\n";
+    std::cout << "  BUILDCACHE_FILE_WATCHER:           "
+              << (bcache::config::file_watcher() ? "true" : "false") << "\n";
+    std::cout << "  BUILDCACHE_GIT_INDEX:              "
+              << (bcache::config::git_index() ? "true" : "false") << "\n";
+    std::cout << "  BUILDCACHE_HARD_LINK_VERIFY:       "
+              << bcache::config::hard_link_verify() << "\n";
     std::cout << "  BUILDCACHE_HARD_LINKS:             "
               << (bcache::config::hard_links() ? "true" : "false") << "\n";
     std::cout << "  BUILDCACHE_HASH_EXTRA_FILES:       "
@@ -220,6 +390,11 @@ std::unique_ptr<bcache::program_wrapper_t> find_suitable_wrapper(
     std::cout << "  BUILDCACHE_MAX_REMOTE_ENTRY_SIZE:  " << bcache::config::max_remote_entry_size()
               << " (" << bcache::file::human_readable_size(bcache::config::max_remote_entry_size())
               << ")\n";
+    std::cout << "  BUILDCACHE_MIN_FREE_SPACE:         " << bcache::config::min_free_space() << " ("
+              << bcache::file::human_readable_size(bcache::config::min_free_space()) << ")\n";
+    std::cout << "  BUILDCACHE_OFFLOAD:                " << bcache::config::offload() << "\n";
+    std::cout << "  BUILDCACHE_OFFLOAD_SECRET:         "
+              << (bcache::config::offload_secret().empty() ? "" : "*******") << "\n";
     std::cout << "  BUILDCACHE_PERF:                   "
               << (bcache::config::perf() ? "true" : "false") << "\n";
     std::cout << "  BUILDCACHE_PREFIX:                 " << bcache::config::prefix() << "\n";
@@ -234,12 +409,24 @@ std::unique_ptr<bcache::program_wrapper_t> find_suitable_wrapper(
     std::cout << "  BUILDCACHE_REMOTE:                 " << bcache::config::remote() << "\n";
     std::cout << "  BUILDCACHE_REMOTE_LOCKS:           "
               << (bcache::config::remote_locks() ? "true" : "false") << "\n";
+    std::cout << "  BUILDCACHE_REMOTE_MAX_AGE:         " << bcache::config::remote_max_age()
+              << "\n";
+    std::cout << "  BUILDCACHE_REMOTE_MAX_SIZE:        " << bcache::config::remote_max_size()
+              << " (" << bcache::file::human_readable_size(bcache::config::remote_max_size())
+              << ")\n";
     std::cout << "  BUILDCACHE_S3_ACCESS:              "
               << (bcache::config::s3_access().empty() ? "" : "*******") << "\n";
     std::cout << "  BUILDCACHE_S3_SECRET:              "
               << (bcache::config::s3_secret().empty() ? "" : "*******") << "\n";
+    std::cout << "  BUILDCACHE_STAT_VALIDATION:        "
+              << (bcache::config::stat_validation() ? "true" : "false") << "\n";
     std::cout << "  BUILDCACHE_TERMINATE_ON_MISS:      "
               << (bcache::config::terminate_on_miss() ? "true" : "false") << "\n";
+    std::cout << "  BUILDCACHE_TOOLCHAIN_EXPIRY:       "
+              << bcache::config::toolchain_expiry() << "\n";
+    std::cout << "  BUILDCACHE_TRACE_FILE:             " << bcache::config::trace_file() << "\n";
+    std::cout << "  BUILDCACHE_TREE_HASH:              "
+              << (bcache::config::tree_hash() ? "true" : "false") << "\n";
   } catch (const std::exception& e) {
     std::cerr << "*** Unexpected error: " << e.what() << "\n";
     return_code = 1;
@@ -325,6 +512,47 @@ std::unique_ptr<bcache::program_wrapper_t> find_suitable_wrapper(
   std::exit(return_code);
 }
 
+[[noreturn]] void run_file_watcher_and_exit(const bcache::string_list_t& roots) {
+  int return_code = 0;
+  try {
+    // This will ensure that the local cache directory exists.
+    bcache::local_cache_t cache;
+
+    bcache::watcher::run_daemon(roots);
+  } catch (const std::exception& e) {
+    std::cerr << "*** Unexpected error: " << e.what() << "\n";
+    return_code = 1;
+  } catch (...) {
+    std::cerr << "*** Unexpected error.\n";
+    return_code = 1;
+  }
+  std::exit(return_code);
+}
+
+[[noreturn]] void run_offload_worker_and_exit(const std::string& address) {
+  int return_code = 0;
+  try {
+    // This will ensure that the local cache directory exists.
+    bcache::local_cache_t cache;
+
+    // Identify the programs of the jobs using the same program wrappers as the clients.
+    const auto identify_program = [](bcache::string_list_t& command) {
+      const auto exe_path = bcache::file::find_executable(command[0], BUILDCACHE_EXE_NAME);
+      command[0] = exe_path.real_path();
+      auto wrapper = find_suitable_wrapper(exe_path, command);
+      return wrapper ? wrapper->get_program_identity() : std::string();
+    };
+    bcache::offload::run_worker(address, identify_program);
+  } catch (const std::exception& e) {
+    std::cerr << "*** Unexpected error: " << e.what() << "\n";
+    return_code = 1;
+  } catch (...) {
+    std::cerr << "*** Unexpected error.\n";
+    return_code = 1;
+  }
+  std::exit(return_code);
+}
+
 [[noreturn]] void wrap_compiler_and_exit(int argc, const char** argv) {
   auto args = bcache::string_list_t(argc, argv);
   bool was_wrapped = false;
@@ -452,6 +680,22 @@ void print_help(const char* program_name) {
   std::cout << "    -z, --zero-stats      zero statistics counters\n";
   std::cout << "    -H, --housekeeping    perform housekeeping duties\n";
   std::cout << "    -e, --edit-config     edit the configuration file\n";
+  std::cout << "    --list-toolchains     list the toolchains that use the local cache\n";
+  std::cout << "    --drop-toolchain ID   remove all local cache entries of a toolchain\n";
+  std::cout << "    --import DIR          import the entries of another local cache (e.g. a\n";
+  std::cout << "                          warm cache from another machine)\n";
+  std::cout << "    --remote-gc           remove old entries from the remote cache (see\n";
+  std::cout << "                          BUILDCACHE_REMOTE_MAX_AGE and _MAX_SIZE)\n";
+  std::cout << "    --simulate TRACE      simulate different cache configurations using an\n";
+  std::cout << "                          access trace (see BUILDCACHE_TRACE_FILE)\n";
+  std::cout << "    --estimate CMD...     estimate if a command would be a cache hit\n";
+  std::cout << "    --estimate-batch FILE estimate one command per line of FILE (or stdin\n";
+  std::cout << "                          if FILE is -)\n";
+  std::cout << "    -W, --watch DIR...    run a file watcher daemon for the given source\n";
+  std::cout << "                          directories (Linux only)\n";
+  std::cout << "    --offload-worker ADDRESS\n";
+  std::cout << "                          run a worker for offloaded compilations that\n";
+  std::cout << "                          listens on ADDRESS (host:port)\n";
   std::cout << "\n";
   std::cout << "    -h, --help            print this help text\n";
   std::cout << "    -V, --version         print version and copyright information\n";
@@ -518,6 +762,59 @@ int main(int argc, const char** argv) {
     print_version_and_exit();
   } else if (compare_arg(arg_str, "-e", "--edit-config")) {
     edit_config_and_exit();
+  } else if (arg_str == "--list-toolchains") {
+    show_toolchains_and_exit();
+  } else if (arg_str == "--drop-toolchain") {
+    if ((arg_pos + 1) >= argc) {
+      std::cerr << argv[0] << ": missing ID for " << arg_str << "\n";
+      print_help(argv[0]);
+      std::exit(1);
+    }
+    drop_toolchain_and_exit(argv[arg_pos + 1]);
+  } else if (arg_str == "--import") {
+    if ((arg_pos + 1) >= argc) {
+      std::cerr << argv[0] << ": missing DIR for " << arg_str << "\n";
+      print_help(argv[0]);
+      std::exit(1);
+    }
+    import_and_exit(argv[arg_pos + 1]);
+  } else if (arg_str == "--remote-gc") {
+    remote_gc_and_exit();
+  } else if (arg_str == "--simulate") {
+    if ((arg_pos + 1) >= argc) {
+      std::cerr << argv[0] << ": missing TRACE for " << arg_str << "\n";
+      print_help(argv[0]);
+      std::exit(1);
+    }
+    simulate_and_exit(argv[arg_pos + 1]);
+  } else if (arg_str == "--estimate") {
+    if ((arg_pos + 1) >= argc) {
+      std::cerr << argv[0] << ": missing CMD for " << arg_str << "\n";
+      print_help(argv[0]);
+      std::exit(1);
+    }
+    estimate_and_exit(bcache::string_list_t(argc - (arg_pos + 1), &argv[arg_pos + 1]));
+  } else if (arg_str == "--estimate-batch") {
+    if ((arg_pos + 1) >= argc) {
+      std::cerr << argv[0] << ": missing FILE for " << arg_str << "\n";
+      print_help(argv[0]);
+      std::exit(1);
+    }
+    estimate_batch_and_exit(argv[arg_pos + 1]);
+  } else if (compare_arg(arg_str, "-W", "--watch")) {
+    if ((arg_pos + 1) >= argc) {
+      std::cerr << argv[0] << ": missing DIR for " << arg_str << "\n";
+      print_help(argv[0]);
+      std::exit(1);
+    }
+    run_file_watcher_and_exit(bcache::string_list_t(argc - (arg_pos + 1), &argv[arg_pos + 1]));
+  } else if (arg_str == "--offload-worker") {
+    if ((arg_pos + 1) >= argc) {
+      std::cerr << argv[0] << ": missing ADDRESS for " << arg_str << "\n";
+      print_help(argv[0]);
+      std::exit(1);
+    }
+    run_offload_worker_and_exit(argv[arg_pos + 1]);
   } else if (compare_arg(arg_str, "-h", "--help")) {
     print_help(argv[0]);
     std::exit(0);
@@ -0,0 +1,569 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#include <sys/file_watcher.hpp>
+
+#include <base/debug_utils.hpp>
+#include <base/file_utils.hpp>
+#include <config/configuration.hpp>
+
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace bcache {
+namespace watcher {
+#if defined(__linux__)
+namespace {
+// The name of the daemon socket file (located in $BUILDCACHE_DIR).
+const std::string SOCKET_NAME = "watcher.sock";
+
+// The daemon is expected to respond almost immediately. If it does not, we fall back to regular
+// validation rather than stalling the build.
+const int CLIENT_TIMEOUT_MS = 500;
+
+// A misbehaving client must not be able to block the daemon for long.
+const int DAEMON_TIMEOUT_MS = 1000;
+
+// The inotify events that we treat as changes.
+const uint32_t WATCH_MASK = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+                            IN_DELETE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF |
+                            IN_ONLYDIR;
+
+// A generation number that is newer than any epoch (used for directories that can not be watched).
+const int64_t NEVER_CLEAN = std::numeric_limits<int64_t>::max();
+
+// The maximum number of recorded changes. When there are more changes than this, the oldest half of
+// them is forgotten (and epochs from before that point are no longer accepted).
+const std::size_t MAX_CHANGES = 100000U;
+
+// The maximum number of symbolic links to follow when resolving a path (as SYMLOOP_MAX on Linux).
+const int MAX_SYMLINKS = 40;
+
+std::string get_socket_path() {
+  return file::append_path(config::dir(), SOCKET_NAME);
+}
+
+bool make_socket_address(const std::string& path, struct sockaddr_un& address) {
+  if (path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::memcpy(&address.sun_path[0], path.c_str(), path.size() + 1);
+  return true;
+}
+
+void set_socket_timeout(const int fd, const int timeout_ms) {
+  struct timeval tv;
+  tv.tv_sec = timeout_ms / 1000;
+  tv.tv_usec = (timeout_ms % 1000) * 1000;
+  (void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  (void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+bool write_all(const int fd, const std::string& data) {
+  std::string::size_type pos = 0;
+  while (pos < data.size()) {
+    const auto n = ::send(fd, data.data() + pos, data.size() - pos, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    pos += static_cast<std::string::size_type>(n);
+  }
+  return true;
+}
+
+bool read_all(const int fd, std::string& data) {
+  char buf[4096];
+  while (true) {
+    const auto n = ::recv(fd, &buf[0], sizeof(buf), 0);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (n == 0) {
+      return true;
+    }
+    data.append(&buf[0], static_cast<std::string::size_type>(n));
+  }
+}
+
+std::string to_absolute_path(const std::string& path, const std::string& cwd) {
+  if (!path.empty() && path[0] == '/') {
+    return path;
+  }
+  return file::append_path(cwd, path);
+}
+
+/// @brief Resolve an absolute path in the same way as realpath().
+///
+/// The symbolic links that are followed on the way are collected too, since a file may change by
+/// retargeting any of them.
+/// @param path The absolute path to resolve.
+/// @param[out] links The paths of the symbolic links that were followed.
+/// @param[out] resolved The resolved path.
+/// @returns false if the path could not be resolved.
+bool resolve_path(const std::string& path, string_list_t& links, std::string& resolved) {
+  // A stack of path components that remain to be resolved (the next component is last).
+  std::vector<std::string> pending;
+  const auto push_components = [&pending](const std::string& p) {
+    const auto components = string_list_t(p, "/");
+    for (auto i = components.size(); i > 0; --i) {
+      pending.emplace_back(components[i - 1]);
+    }
+  };
+  push_components(path);
+
+  resolved.clear();
+  int num_links = 0;
+  while (!pending.empty()) {
+    const auto component = pending.back();
+    pending.pop_back();
+    if (component.empty() || component == ".") {
+      continue;
+    }
+    if (component == "..") {
+      resolved = resolved.substr(0, resolved.rfind('/'));
+      continue;
+    }
+
+    const auto candidate = resolved + "/" + component;
+    struct stat st;
+    if (::lstat(candidate.c_str(), &st) != 0) {
+      return false;
+    }
+    if (S_ISLNK(st.st_mode)) {
+      if (++num_links > MAX_SYMLINKS) {
+        return false;
+      }
+      char target[PATH_MAX];
+      const auto n = ::readlink(candidate.c_str(), &target[0], sizeof(target));
+      if (n <= 0 || n >= static_cast<ssize_t>(sizeof(target))) {
+        return false;
+      }
+      links += candidate;
+      if (target[0] == '/') {
+        resolved.clear();
+      }
+      push_components(std::string(&target[0], static_cast<std::string::size_type>(n)));
+    } else {
+      resolved = candidate;
+    }
+  }
+  if (resolved.empty()) {
+    resolved = "/";
+  }
+  return true;
+}
+
+// Send a request to the daemon. Returns an empty string if the request failed.
+std::string query_daemon(const std::string& request) {
+  struct sockaddr_un address;
+  if (!make_socket_address(get_socket_path(), address)) {
+    return std::string();
+  }
+  const auto fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return std::string();
+  }
+  set_socket_timeout(fd, CLIENT_TIMEOUT_MS);
+
+  std::string response;
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0) {
+    if (!write_all(fd, request) || ::shutdown(fd, SHUT_WR) != 0 || !read_all(fd, response)) {
+      response.clear();
+    }
+  } else {
+    debug::log(debug::DEBUG) << "Unable to connect to the file watcher daemon";
+  }
+  ::close(fd);
+  return response;
+}
+
+class daemon_t {
+public:
+  explicit daemon_t(const string_list_t& roots) {
+    for (const auto& root : roots) {
+      char* resolved = ::realpath(root.c_str(), nullptr);
+      if (resolved == nullptr) {
+        throw std::runtime_error("Unable to resolve the directory " + root);
+      }
+      m_roots.emplace_back(std::string(resolved));
+      std::free(resolved);
+    }
+    if (m_roots.empty()) {
+      throw std::runtime_error("No directories to watch.");
+    }
+  }
+
+  ~daemon_t() {
+    if (m_inotify_fd >= 0) {
+      ::close(m_inotify_fd);
+    }
+    if (m_socket_fd >= 0) {
+      ::close(m_socket_fd);
+      (void)::unlink(m_socket_path.c_str());
+    }
+  }
+
+  void run() {
+    open_socket();
+    reset();
+
+    while (true) {
+      struct pollfd fds[2];
+      fds[0].fd = m_inotify_fd;
+      fds[0].events = POLLIN;
+      fds[1].fd = m_socket_fd;
+      fds[1].events = POLLIN;
+      if (::poll(&fds[0], 2, -1) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::runtime_error("Unable to poll for file watcher events.");
+      }
+
+      if ((fds[0].revents & POLLIN) != 0) {
+        process_events();
+      }
+
+      if ((fds[1].revents & POLLIN) != 0) {
+        const auto client_fd = ::accept4(m_socket_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client_fd >= 0) {
+          set_socket_timeout(client_fd, DAEMON_TIMEOUT_MS);
+          std::string request;
+          if (read_all(client_fd, request)) {
+            (void)write_all(client_fd, handle_request(request));
+          }
+          ::close(client_fd);
+        }
+      }
+    }
+  }
+
+private:
+  void open_socket() {
+    m_socket_path = get_socket_path();
+    struct sockaddr_un address;
+    if (!make_socket_address(m_socket_path, address)) {
+      throw std::runtime_error("The socket path is too long: " + m_socket_path);
+    }
+
+    // Refuse to start if there is already a daemon running, and remove stale socket files.
+    if (!query_daemon("EPOCH\n").empty()) {
+      throw std::runtime_error("A file watcher daemon is already running.");
+    }
+    (void)::unlink(m_socket_path.c_str());
+
+    m_socket_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_socket_fd < 0) {
+      throw std::runtime_error("Unable to create the file watcher socket.");
+    }
+    if (::bind(m_socket_fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(m_socket_fd, SOMAXCONN) != 0) {
+      ::close(m_socket_fd);
+      m_socket_fd = -1;
+      throw std::runtime_error("Unable to listen on " + m_socket_path);
+    }
+  }
+
+  // Start a new daemon instance: All previous epochs are invalidated, and all watches are set up
+  // from scratch. This is done at startup, and if the kernel event queue overflows.
+  void reset() {
+    if (m_inotify_fd >= 0) {
+      ::close(m_inotify_fd);
+    }
+    m_inotify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify_fd < 0) {
+      throw std::runtime_error("Unable to initialize inotify.");
+    }
+    m_watches.clear();
+    m_changes.clear();
+    m_min_generation = 0;
+    m_instance = file::get_unique_id();
+
+    for (const auto& root : m_roots) {
+      add_watches(root);
+    }
+    debug::log(debug::INFO) << "Watching " << m_watches.size() << " directories (instance "
+                            << m_instance << ")";
+  }
+
+  void add_watch(const std::string& dir) {
+    const auto wd = ::inotify_add_watch(m_inotify_fd, dir.c_str(), WATCH_MASK);
+    if (wd >= 0) {
+      m_watches[wd] = dir;
+    } else {
+      // Typically the watch limit has been reached (see /proc/sys/fs/inotify/max_user_watches).
+      // Files under this directory can never be considered unchanged.
+      debug::log(debug::WARNING) << "Unable to watch " << dir << ": " << std::strerror(errno);
+      m_changes[dir] = NEVER_CLEAN;
+    }
+  }
+
+  void add_watches(const std::string& dir) {
+    // Note: We add the watch before walking the directory, so that no subdirectories are missed.
+    add_watch(dir);
+    try {
+      for (const auto& info : file::walk_directory(dir)) {
+        if (info.is_dir()) {
+          add_watch(info.path());
+        }
+      }
+    } catch (const std::exception& e) {
+      debug::log(debug::WARNING) << "Unable to walk " << dir << ": " << e.what();
+    }
+  }
+
+  void process_events() {
+    alignas(struct inotify_event) char buf[65536];
+    while (true) {
+      const auto n = ::read(m_inotify_fd, &buf[0], sizeof(buf));
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno == EAGAIN) {
+          return;
+        }
+        throw std::runtime_error("Unable to read inotify events.");
+      }
+
+      bool overflow = false;
+      for (ssize_t pos = 0; pos < n;) {
+        const auto* event = reinterpret_cast<const struct inotify_event*>(&buf[pos]);
+        pos += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+
+        if ((event->mask & IN_Q_OVERFLOW) != 0) {
+          overflow = true;
+          break;
+        }
+        const auto it = m_watches.find(event->wd);
+        if (it == m_watches.end()) {
+          continue;
+        }
+
+        const auto path =
+            (event->len > 0) ? file::append_path(it->second, &event->name[0]) : it->second;
+        m_changes[path] = ++m_generation;
+        if (m_changes.size() > MAX_CHANGES) {
+          compact_changes();
+        }
+
+        if ((event->mask & IN_ISDIR) != 0 && (event->mask & (IN_CREATE | IN_MOVED_TO)) != 0) {
+          add_watches(path);
+        }
+        if ((event->mask & IN_IGNORED) != 0) {
+          m_watches.erase(it);
+        }
+      }
+
+      if (overflow) {
+        debug::log(debug::WARNING) << "Event queue overflow - restarting";
+        reset();
+      }
+    }
+  }
+
+  // Forget the oldest half of the recorded changes. A forgotten change can only make epochs that
+  // are older than the change dirty, so such epochs are rejected from now on.
+  void compact_changes() {
+    std::vector<int64_t> generations;
+    generations.reserve(m_changes.size());
+    for (const auto& change : m_changes) {
+      if (change.second != NEVER_CLEAN) {
+        generations.emplace_back(change.second);
+      }
+    }
+    if (generations.empty()) {
+      return;
+    }
+    const auto median = generations.begin() + generations.size() / 2;
+    std::nth_element(generations.begin(), median, generations.end());
+    const auto threshold = *median;
+
+    for (auto it = m_changes.begin(); it != m_changes.end();) {
+      if (it->second <= threshold) {
+        it = m_changes.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    m_min_generation = std::max(m_min_generation, threshold);
+    debug::log(debug::DEBUG) << "Compacted the recorded changes (" << m_changes.size() << " left)";
+  }
+
+  const std::string* find_root(const std::string& path) const {
+    for (const auto& root : m_roots) {
+      if (root == "/" || (path.size() > root.size() && path.compare(0, root.size(), root) == 0 &&
+                          path[root.size()] == '/')) {
+        return &root;
+      }
+    }
+    return nullptr;
+  }
+
+  bool is_unchanged_since(const int64_t generation, const std::string& path) const {
+    const auto* root = find_root(path);
+    if (root == nullptr) {
+      return false;
+    }
+
+    // Neither the file itself nor any of its parent directories may have changed.
+    auto p = path;
+    while (p.size() > root->size()) {
+      const auto it = m_changes.find(p);
+      if (it != m_changes.end() && it->second > generation) {
+        return false;
+      }
+      p = p.substr(0, p.rfind('/'));
+    }
+    return true;
+  }
+
+  std::string handle_request(const std::string& request) {
+    // Make sure that all changes that happened before the request are accounted for.
+    process_events();
+
+    const auto lines = string_list_t(request, "\n");
+    if (lines.size() >= 1 && lines[0] == "EPOCH") {
+      return m_instance + " " + std::to_string(m_generation) + "\n";
+    }
+
+    if (lines.size() >= 1 && lines[0].compare(0, 6, "CHECK ") == 0) {
+      const auto epoch = string_list_t(lines[0], " ");
+      if (epoch.size() != 3 || epoch[1] != m_instance) {
+        return "DIRTY\n";
+      }
+      int64_t generation;
+      try {
+        generation = std::stoll(epoch[2]);
+      } catch (...) {
+        return "DIRTY\n";
+      }
+      if (generation < m_min_generation) {
+        return "DIRTY\n";
+      }
+      for (size_t i = 1; i < lines.size(); ++i) {
+        if (!lines[i].empty() && !is_unchanged_since(generation, lines[i])) {
+          return "DIRTY\n";
+        }
+      }
+      return "CLEAN\n";
+    }
+
+    return "ERROR\n";
+  }
+
+  std::vector<std::string> m_roots;
+  std::string m_socket_path;
+  std::string m_instance;
+  int64_t m_generation = 0;
+  int64_t m_min_generation = 0;
+  std::unordered_map<int, std::string> m_watches;
+  std::unordered_map<std::string, int64_t> m_changes;
+  int m_inotify_fd = -1;
+  int m_socket_fd = -1;
+};
+}  // namespace
+
+void run_daemon(const string_list_t& roots) {
+  daemon_t daemon(roots);
+  daemon.run();
+}
+
+epoch_t get_epoch() {
+  epoch_t epoch;
+  const auto response = query_daemon("EPOCH\n");
+  const auto space_pos = response.find(' ');
+  if (space_pos != std::string::npos) {
+    try {
+      epoch.generation = std::stoll(response.substr(space_pos + 1));
+      epoch.instance = response.substr(0, space_pos);
+    } catch (...) {
+      // Treat malformed responses as if there is no daemon.
+    }
+  }
+  return epoch;
+}
+
+bool is_unchanged_since(const epoch_t& epoch, const string_list_t& paths) {
+  if (!epoch.is_valid()) {
+    return false;
+  }
+  const auto cwd = file::get_cwd();
+  auto request = "CHECK " + epoch.instance + " " + std::to_string(epoch.generation) + "\n";
+  for (const auto& path : paths) {
+    // Check the files that are actually read (which may be outside of the watched directory trees)
+    // as well as the symbolic links that lead to them.
+    string_list_t links;
+    std::string resolved;
+    if (!resolve_path(to_absolute_path(path, cwd), links, resolved)) {
+      return false;
+    }
+    links += resolved;
+    for (const auto& checked_path : links) {
+      if (checked_path.find('\n') != std::string::npos) {
+        return false;
+      }
+      request += checked_path + "\n";
+    }
+  }
+  return query_daemon(request) == "CLEAN\n";
+}
+#else
+void run_daemon(const string_list_t& roots) {
+  (void)roots;
+  throw std::runtime_error("The file watcher daemon is only supported on Linux.");
+}
+
+epoch_t get_epoch() {
+  return epoch_t();
+}
+
+bool is_unchanged_since(const epoch_t& epoch, const string_list_t& paths) {
+  (void)epoch;
+  (void)paths;
+  return false;
+}
+#endif
+}  // namespace watcher
+}  // namespace bcache
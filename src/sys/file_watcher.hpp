@@ -0,0 +1,66 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#ifndef BUILDCACHE_FILE_WATCHER_HPP_
+#define BUILDCACHE_FILE_WATCHER_HPP_
+
+#include <base/string_list.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace bcache {
+namespace watcher {
+/// @brief A point in time, as seen by a file watcher daemon.
+///
+/// An epoch consists of a daemon instance ID (which is unique for every daemon session) and a
+/// generation number (which is incremented for every observed file system change).
+struct epoch_t {
+  std::string instance;
+  int64_t generation = 0;
+
+  /// @returns true if this is a valid epoch.
+  bool is_valid() const {
+    return !instance.empty();
+  }
+};
+
+/// @brief Run the file watcher daemon.
+///
+/// The daemon watches the given directory trees for changes and answers queries from BuildCache
+/// processes over a Unix domain socket in $BUILDCACHE_DIR. This function does not return unless
+/// there is an error.
+/// @param roots The root directories to watch.
+/// @throws runtime_error if the daemon could not be started.
+void run_daemon(const string_list_t& roots);
+
+/// @brief Get the current epoch from the file watcher daemon.
+/// @returns the current epoch, or an invalid epoch if no daemon could be reached.
+epoch_t get_epoch();
+
+/// @brief Check if a set of files is unchanged since a given epoch.
+/// @param epoch The epoch (as returned by get_epoch() at some earlier point in time).
+/// @param paths The files to check.
+/// @returns true if the daemon could confirm that none of the files have changed since the epoch.
+/// If the daemon could not be reached, or if any of the files are outside of the watched directory
+/// trees, the return value is false.
+bool is_unchanged_since(const epoch_t& epoch, const string_list_t& paths);
+}  // namespace watcher
+}  // namespace bcache
+
+#endif  // BUILDCACHE_FILE_WATCHER_HPP_
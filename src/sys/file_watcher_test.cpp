@@ -0,0 +1,114 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#include <base/file_utils.hpp>
+#include <config/configuration.hpp>
+#include <sys/file_watcher.hpp>
+
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+// Workaround for macOS build errors.
+// See: https://github.com/onqtam/doctest/issues/126
+#include <iostream>
+
+using namespace bcache;
+
+#if defined(__linux__)
+namespace {
+watcher::epoch_t get_epoch_with_retries() {
+  // The daemon may need some time to start listening.
+  for (int i = 0; i < 100; ++i) {
+    const auto epoch = watcher::get_epoch();
+    if (epoch.is_valid()) {
+      return epoch;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  return watcher::epoch_t();
+}
+}  // namespace
+
+TEST_CASE("file_watcher: Changes invalidate epochs") {
+  // The daemon thread outlives this test case, so everything that it uses must be static.
+  static const auto tmp = file::tmp_file_t(file::get_temp_dir(), "");
+  static const auto root = file::append_path(tmp.path(), "root");
+  const auto outside = file::append_path(tmp.path(), "outside");
+  file::create_dir_with_parents(root);
+  file::create_dir_with_parents(outside);
+  config::init(tmp.path().c_str());
+
+  const auto a_h = file::append_path(root, "a.h");
+  const auto b_h = file::append_path(root, "b.h");
+  const auto outside_h = file::append_path(outside, "outside.h");
+  const auto link_in = file::append_path(root, "link_in.h");
+  const auto link_out = file::append_path(root, "link_out.h");
+  file::write("a", a_h);
+  file::write("b", b_h);
+  file::write("outside", outside_h);
+  REQUIRE(::symlink("a.h", link_in.c_str()) == 0);
+  REQUIRE(::symlink(outside_h.c_str(), link_out.c_str()) == 0);
+
+  std::thread([]() {
+    try {
+      watcher::run_daemon(string_list_t{root});
+    } catch (...) {
+    }
+  }).detach();
+
+  const auto epoch = get_epoch_with_retries();
+  REQUIRE(epoch.is_valid());
+
+  // Only existing files inside of the watched directory tree can be unchanged.
+  CHECK(watcher::is_unchanged_since(epoch, string_list_t{a_h, b_h}));
+  CHECK(watcher::is_unchanged_since(epoch, string_list_t{link_in}));
+  CHECK_FALSE(watcher::is_unchanged_since(epoch, string_list_t{outside_h}));
+  CHECK_FALSE(watcher::is_unchanged_since(epoch, string_list_t{link_out}));
+  CHECK_FALSE(watcher::is_unchanged_since(epoch, string_list_t{file::append_path(root, "x.h")}));
+
+  // Epochs from other daemon instances are never accepted.
+  auto other_epoch = epoch;
+  other_epoch.instance = "other";
+  CHECK_FALSE(watcher::is_unchanged_since(other_epoch, string_list_t{a_h}));
+
+  // A modified file is dirty (also through a link), but other files are not.
+  file::write("changed", a_h);
+  CHECK_FALSE(watcher::is_unchanged_since(epoch, string_list_t{a_h}));
+  CHECK_FALSE(watcher::is_unchanged_since(epoch, string_list_t{link_in}));
+  CHECK(watcher::is_unchanged_since(epoch, string_list_t{b_h}));
+
+  // A new epoch is clean again.
+  const auto new_epoch = watcher::get_epoch();
+  REQUIRE(new_epoch.is_valid());
+  CHECK(new_epoch.generation > epoch.generation);
+  CHECK(watcher::is_unchanged_since(new_epoch, string_list_t{a_h, link_in}));
+
+  // Retargeting a link makes it dirty, even if the new target is unchanged.
+  REQUIRE(::unlink(link_in.c_str()) == 0);
+  REQUIRE(::symlink("b.h", link_in.c_str()) == 0);
+  CHECK_FALSE(watcher::is_unchanged_since(new_epoch, string_list_t{link_in}));
+  CHECK(watcher::is_unchanged_since(new_epoch, string_list_t{b_h}));
+}
+#endif
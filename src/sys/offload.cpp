@@ -0,0 +1,588 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#include <sys/offload.hpp>
+
+#include <base/debug_utils.hpp>
+#include <base/file_utils.hpp>
+#include <base/hmac.hpp>
+#include <base/serializer_utils.hpp>
+#include <base/time_utils.hpp>
+#include <config/configuration.hpp>
+
+#include <stdexcept>
+#include <string>
+
+#if !defined(_WIN32)
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+namespace bcache {
+namespace offload {
+namespace {
+bool starts_with(const std::string& str, const char* prefix) {
+  return str.compare(0, std::char_traits<char>::length(prefix), prefix) == 0;
+}
+}  // namespace
+
+bool is_safe_arg(const std::string& arg) {
+  // Options that load plugins, run other programs or produce profiling/linking side effects.
+  for (const auto& prefix : {"-fpass-plugin",
+                             "-fplugin",
+                             "-fprofile",
+                             "-fcoverage",
+                             "-fuse-ld",
+                             "-mllvm",
+                             "-Wa,",
+                             "-Wl,",
+                             "-Wp,"}) {
+    if (starts_with(arg, prefix)) {
+      return false;
+    }
+  }
+
+  // Path prefix maps only rewrite strings in the output. Any other option that contains a path
+  // could make the compiler access files outside of the work directory.
+  const auto is_prefix_map =
+      starts_with(arg, "-f") && (arg.find("-prefix-map=") != std::string::npos);
+  if (!is_prefix_map && arg.find_first_of("/\\") != std::string::npos) {
+    return false;
+  }
+
+  // Code generation, language dialect and diagnostic options. Note that single letter options such
+  // as -w must be matched exactly (e.g. -wrapper is not a diagnostic option).
+  for (const auto& exact : {"-O", "-ansi", "-pipe", "-pthread", "-w"}) {
+    if (arg == exact) {
+      return true;
+    }
+  }
+  for (const auto& prefix : {"--param=", "-O", "-W", "-f", "-m", "-pedantic", "-std="}) {
+    if (starts_with(arg, prefix) && arg.size() > std::char_traits<char>::length(prefix)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#if !defined(_WIN32)
+namespace {
+// Messages are sent as frames: <size:int64> <data>. Each message is a signature followed by a
+// payload. The request signature is an HMAC of the request payload, and the response signature is
+// an HMAC of the request signature and the response payload (so that a response can not be reused
+// for another request). The request payload includes a timestamp and a nonce, so that a captured
+// request can not be replayed.
+const int32_t PROTOCOL_VERSION = 2;
+
+// Frames are bounded, so that a peer can not make us allocate arbitrary amounts of memory.
+const int64_t MAX_REQUEST_SIZE = 256LL * 1024 * 1024;
+const int64_t MAX_RESPONSE_SIZE = 1024LL * 1024 * 1024;
+
+// Requests with timestamps that differ more than this from the worker clock are rejected.
+const time::seconds_t MAX_REQUEST_AGE = 300;
+
+// Connecting to the worker must be fast, or there is no point in offloading.
+const int CONNECT_TIMEOUT_MS = 1000;
+
+// The time that a client waits for a job to finish (compiling a large file can be slow).
+const int JOB_TIMEOUT_MS = 600000;
+
+// A misbehaving client must not be able to block a worker thread for long.
+const int WORKER_TIMEOUT_MS = 30000;
+
+void set_socket_timeout(const int fd, const int timeout_ms) {
+  struct timeval tv;
+  tv.tv_sec = timeout_ms / 1000;
+  tv.tv_usec = (timeout_ms % 1000) * 1000;
+  (void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  (void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+bool write_all(const int fd, const std::string& data) {
+  std::string::size_type pos = 0;
+  while (pos < data.size()) {
+    const auto n = ::send(fd, data.data() + pos, data.size() - pos, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    pos += static_cast<std::string::size_type>(n);
+  }
+  return true;
+}
+
+bool read_exactly(const int fd, std::string& data, const std::string::size_type size) {
+  data.resize(size);
+  std::string::size_type pos = 0;
+  while (pos < size) {
+    const auto n = ::recv(fd, &data[pos], size - pos, 0);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (n == 0) {
+      return false;
+    }
+    pos += static_cast<std::string::size_type>(n);
+  }
+  return true;
+}
+
+bool write_frame(const int fd, const std::string& data) {
+  return write_all(fd, serialize::from_int64(static_cast<int64_t>(data.size())) + data);
+}
+
+// Read a frame. The size is checked before any data is buffered.
+bool read_frame(const int fd, std::string& data, const int64_t max_size) {
+  if (!read_exactly(fd, data, 8U)) {
+    return false;
+  }
+  std::string::size_type pos = 0;
+  const auto size = serialize::to_int64(data, pos);
+  if (size < 0 || size > max_size) {
+    throw std::runtime_error("Invalid offload message size");
+  }
+  return read_exactly(fd, data, static_cast<std::string::size_type>(size));
+}
+
+struct addrinfo* resolve_address(const std::string& address, const bool passive) {
+  const auto colon_pos = address.rfind(':');
+  if (colon_pos == std::string::npos) {
+    throw std::runtime_error("Invalid offload address (expected host:port): " + address);
+  }
+  const auto host = address.substr(0, colon_pos);
+  const auto port = address.substr(colon_pos + 1);
+
+  struct addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = passive ? AI_PASSIVE : 0;
+  struct addrinfo* result = nullptr;
+  if (::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0) {
+    throw std::runtime_error("Unable to resolve the offload address: " + address);
+  }
+  return result;
+}
+
+// Messages are authenticated with an HMAC, using the shared secret (if any).
+std::string sign(const std::string& data) {
+  const auto& secret = config::offload_secret();
+  return secret.empty() ? std::string() : sha1_hmac(secret, data);
+}
+
+std::string make_message(const std::string& signature, const std::string& payload) {
+  return serialize::from_string(signature) + serialize::from_string(payload);
+}
+
+std::string make_nonce() {
+  static std::mutex s_mutex;
+  static std::random_device s_random_device;
+  std::lock_guard<std::mutex> lock(s_mutex);
+  std::string nonce;
+  for (int i = 0; i < 4; ++i) {
+    char buf[9];
+    std::snprintf(buf, sizeof(buf), "%08x", static_cast<unsigned int>(s_random_device()));
+    nonce += buf;
+  }
+  return nonce;
+}
+
+bool is_plain_file_name(const std::string& name) {
+  return !name.empty() && name != "." && name != ".." &&
+         name.find_first_of("/\\") == std::string::npos;
+}
+
+bool is_loopback_address(const struct sockaddr* addr) {
+  if (addr->sa_family == AF_INET) {
+    const auto* addr_in = reinterpret_cast<const struct sockaddr_in*>(addr);
+    return (ntohl(addr_in->sin_addr.s_addr) >> 24) == 127U;
+  }
+  if (addr->sa_family == AF_INET6) {
+    const auto* addr_in6 = reinterpret_cast<const struct sockaddr_in6*>(addr);
+    return IN6_IS_ADDR_LOOPBACK(&addr_in6->sin6_addr) != 0;
+  }
+  return false;
+}
+
+std::string serialize_job(const job_t& job) {
+  std::vector<std::string> command(job.command.begin(), job.command.end());
+  std::string data = serialize::from_int(PROTOCOL_VERSION);
+  data += serialize::from_int64(time::seconds_since_epoch());
+  data += serialize::from_string(make_nonce());
+  data += serialize::from_string(job.program_id);
+  data += serialize::from_vector(command);
+  data += serialize::from_string(job.source_name);
+  data += serialize::from_string(job.source);
+  data += serialize::from_map(job.build_files);
+  return data;
+}
+
+job_t deserialize_job(const std::string& data, time::seconds_t& timestamp) {
+  std::string::size_type pos = 0;
+  if (serialize::to_int(data, pos) != PROTOCOL_VERSION) {
+    throw std::runtime_error("Unsupported offload protocol version.");
+  }
+  timestamp = serialize::to_int64(data, pos);
+  (void)serialize::to_string(data, pos);  // Nonce.
+  job_t job;
+  job.program_id = serialize::to_string(data, pos);
+  job.command = string_list_t(serialize::to_vector(data, pos));
+  job.source_name = serialize::to_string(data, pos);
+  job.source = serialize::to_string(data, pos);
+  job.build_files = serialize::to_map(data, pos);
+  return job;
+}
+
+std::string serialize_response(const std::string& error, const result_t& result) {
+  std::string data = serialize::from_int(PROTOCOL_VERSION);
+  data += serialize::from_string(error);
+  data += serialize::from_int(result.run_result.return_code);
+  data += serialize::from_string(result.run_result.std_out);
+  data += serialize::from_string(result.run_result.std_err);
+  data += serialize::from_map(result.build_files);
+  return data;
+}
+
+std::string serialize_error(const std::string& error) {
+  return serialize_response(error, result_t());
+}
+
+/// @brief Rebuild the command of a job from its validated parts.
+///
+/// The client command is never run as-is: Only the program name and the safe flags are taken from
+/// it, and the input and output arguments are derived from the file names of the job.
+string_list_t make_worker_command(const job_t& job) {
+  // Only write files inside of the work dir.
+  if (!is_plain_file_name(job.source_name)) {
+    throw std::runtime_error("Invalid source file name: " + job.source_name);
+  }
+  const auto object = job.build_files.find("object");
+  if (job.build_files.size() != 1U || object == job.build_files.end() ||
+      !is_plain_file_name(object->second) || object->second == job.source_name) {
+    throw std::runtime_error("Invalid build files");
+  }
+
+  // The command must be: program [flags...] -c source -o object
+  const auto& cmd = job.command;
+  const auto n = cmd.size();
+  if (n < 5U || !is_plain_file_name(cmd[0]) || cmd[n - 4] != "-c" ||
+      cmd[n - 3] != job.source_name || cmd[n - 2] != "-o" || cmd[n - 1] != object->second) {
+    throw std::runtime_error("Unsupported command");
+  }
+
+  string_list_t command;
+  command += cmd[0];
+  for (size_t i = 1U; i < n - 4; ++i) {
+    if (!is_safe_arg(cmd[i])) {
+      throw std::runtime_error("Unsupported argument: " + cmd[i]);
+    }
+    command += cmd[i];
+  }
+  command += std::string("-c");
+  command += job.source_name;
+  command += std::string("-o");
+  command += object->second;
+  return command;
+}
+
+result_t run_job_in_work_dir(const job_t& job, const identify_program_fn& identify_program) {
+  auto command = make_worker_command(job);
+
+  // Check that we have the same program (e.g. the same compiler version) as the client. A program
+  // that no wrapper recognizes is never run.
+  // Note: The program wrappers are not designed to be used concurrently from several threads.
+  {
+    static std::mutex identify_mutex;
+    std::lock_guard<std::mutex> lock(identify_mutex);
+    const auto program_id = identify_program(command);
+    if (program_id.empty() || program_id != job.program_id) {
+      throw std::runtime_error("No matching program");
+    }
+  }
+
+  // Run the command in a temporary work dir.
+  file::tmp_file_t work_dir(sys::get_local_temp_folder(), ".offload");
+  file::create_dir(work_dir.path());
+  file::write(job.source, file::append_path(work_dir.path(), job.source_name));
+
+  result_t result;
+  result.run_result = sys::run(command, true, work_dir.path());
+  for (const auto& file : job.build_files) {
+    const auto path = file::append_path(work_dir.path(), file.second);
+    if (file::file_exists(path)) {
+      result.build_files[file.first] = file::read(path);
+    }
+  }
+  return result;
+}
+
+/// @brief State that is shared by the worker and its job threads.
+struct worker_state_t {
+  explicit worker_state_t(const identify_program_fn& identify)
+      : identify_program(identify), num_jobs(0) {
+  }
+
+  const identify_program_fn identify_program;
+  std::atomic<int> num_jobs;
+
+  /// Signatures of recently accepted requests (signature -> timestamp), for detecting replays.
+  std::mutex recent_requests_mutex;
+  std::map<std::string, time::seconds_t> recent_requests;
+};
+
+// Reject requests that are too old (or from the future), or that have already been accepted.
+void check_replay(worker_state_t& state,
+                  const std::string& signature,
+                  const time::seconds_t timestamp) {
+  const auto now = time::seconds_since_epoch();
+  if (timestamp < now - MAX_REQUEST_AGE || timestamp > now + MAX_REQUEST_AGE) {
+    throw std::runtime_error("Request timestamp out of range");
+  }
+  std::lock_guard<std::mutex> lock(state.recent_requests_mutex);
+  for (auto it = state.recent_requests.begin(); it != state.recent_requests.end();) {
+    if (it->second < now - MAX_REQUEST_AGE) {
+      it = state.recent_requests.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  if (!state.recent_requests.insert(std::make_pair(signature, timestamp)).second) {
+    throw std::runtime_error("Replayed request");
+  }
+}
+
+void handle_connection(const int fd, worker_state_t& state) {
+  set_socket_timeout(fd, WORKER_TIMEOUT_MS);
+
+  // Until the request has been authenticated, the response is not bound to it.
+  std::string request_signature;
+  std::string response;
+  try {
+    std::string request;
+    if (!read_frame(fd, request, MAX_REQUEST_SIZE)) {
+      return;
+    }
+    std::string::size_type pos = 0;
+    const auto signature = serialize::to_string(request, pos);
+    const auto payload = serialize::to_string(request, pos);
+    if (!is_equal_digest(signature, sign(payload))) {
+      throw std::runtime_error("Authentication failed");
+    }
+    time::seconds_t timestamp;
+    const auto job = deserialize_job(payload, timestamp);
+    if (!signature.empty()) {
+      check_replay(state, signature, timestamp);
+    }
+    request_signature = signature;
+    debug::log(debug::INFO) << "Running job: " << job.command.join(" ", true);
+    response = serialize_response(std::string(), run_job_in_work_dir(job, state.identify_program));
+  } catch (const std::exception& e) {
+    debug::log(debug::INFO) << "Rejected job: " << e.what();
+    response = serialize_error(e.what());
+  }
+
+  // The job may take a long time, and the client is waiting for it.
+  set_socket_timeout(fd, JOB_TIMEOUT_MS);
+  (void)write_frame(fd, make_message(sign(request_signature + response), response));
+}
+
+int connect_to_worker(const std::string& address) {
+  auto* addresses = resolve_address(address, false);
+  int fd = -1;
+  for (auto* addr = addresses; addr != nullptr; addr = addr->ai_next) {
+    fd = ::socket(addr->ai_family, addr->ai_socktype | SOCK_CLOEXEC, addr->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    // Note: On Linux, the send timeout also applies to connect().
+    set_socket_timeout(fd, CONNECT_TIMEOUT_MS);
+    if (::connect(fd, addr->ai_addr, addr->ai_addrlen) == 0) {
+      break;
+    }
+    ::close(fd);
+    fd = -1;
+  }
+  ::freeaddrinfo(addresses);
+  return fd;
+}
+}  // namespace
+
+bool run_job(const job_t& job, result_t& result) noexcept {
+  try {
+    const auto fd = connect_to_worker(config::offload());
+    if (fd < 0) {
+      debug::log(debug::INFO) << "Unable to connect to the offload worker";
+      return false;
+    }
+
+    const auto payload = serialize_job(job);
+    const auto request_signature = sign(payload);
+    set_socket_timeout(fd, JOB_TIMEOUT_MS);
+    std::string message;
+    auto success = false;
+    try {
+      success = write_frame(fd, make_message(request_signature, payload)) &&
+                read_frame(fd, message, MAX_RESPONSE_SIZE);
+    } catch (...) {
+      ::close(fd);
+      throw;
+    }
+    ::close(fd);
+    if (!success) {
+      debug::log(debug::INFO) << "The offload worker did not respond";
+      return false;
+    }
+
+    std::string::size_type pos = 0;
+    const auto signature = serialize::to_string(message, pos);
+    const auto response = serialize::to_string(message, pos);
+    pos = 0;
+    if (serialize::to_int(response, pos) != PROTOCOL_VERSION) {
+      throw std::runtime_error("Unsupported offload protocol version.");
+    }
+
+    // Note: A rejection does not need to be authenticated, since the job is just run locally.
+    const auto error = serialize::to_string(response, pos);
+    if (!error.empty()) {
+      debug::log(debug::INFO) << "The offload worker rejected the job: " << error;
+      return false;
+    }
+    if (!is_equal_digest(signature, sign(request_signature + response))) {
+      debug::log(debug::WARNING) << "The offload worker response could not be authenticated";
+      return false;
+    }
+    result.run_result.return_code = serialize::to_int(response, pos);
+    result.run_result.std_out = serialize::to_string(response, pos);
+    result.run_result.std_err = serialize::to_string(response, pos);
+    result.build_files = serialize::to_map(response, pos);
+    return true;
+  } catch (const std::exception& e) {
+    debug::log(debug::INFO) << "Unable to offload the job: " << e.what();
+  }
+  return false;
+}
+
+void run_worker(const std::string& address, const identify_program_fn& identify_program) {
+  // Without a secret anyone who can connect could run jobs, so only allow local clients.
+  const auto require_loopback = config::offload_secret().empty();
+
+  auto* addresses = resolve_address(address, true);
+  int listen_fd = -1;
+  for (auto* addr = addresses; addr != nullptr; addr = addr->ai_next) {
+    if (require_loopback && !is_loopback_address(addr->ai_addr)) {
+      continue;
+    }
+    listen_fd = ::socket(addr->ai_family, addr->ai_socktype | SOCK_CLOEXEC, addr->ai_protocol);
+    if (listen_fd < 0) {
+      continue;
+    }
+    const int enable = 1;
+    (void)setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    if (::bind(listen_fd, addr->ai_addr, addr->ai_addrlen) == 0 &&
+        ::listen(listen_fd, SOMAXCONN) == 0) {
+      break;
+    }
+    ::close(listen_fd);
+    listen_fd = -1;
+  }
+  ::freeaddrinfo(addresses);
+  if (listen_fd < 0) {
+    if (require_loopback) {
+      throw std::runtime_error("Unable to listen on " + address +
+                               " (an offload secret is required for non-loopback addresses)");
+    }
+    throw std::runtime_error("Unable to listen on " + address);
+  }
+  if (require_loopback) {
+    debug::log(debug::WARNING) << "No offload secret is configured: Only accepting local jobs";
+  }
+
+  // Run one job per core. Excess jobs are rejected immediately, so that the clients can run them
+  // locally instead of waiting in a queue.
+  // Note: The job threads are detached, and may outlive this function (e.g. if accept() fails), so
+  // they share ownership of the worker state.
+  const auto max_jobs = static_cast<int>(std::max(1U, std::thread::hardware_concurrency()));
+  const auto state = std::make_shared<worker_state_t>(identify_program);
+  debug::log(debug::INFO) << "Offload worker listening on " << address << " (" << max_jobs
+                          << " concurrent jobs)";
+  while (true) {
+    const auto client_fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client_fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      ::close(listen_fd);
+      throw std::runtime_error("Unable to accept offload connections.");
+    }
+
+    if (state->num_jobs >= max_jobs) {
+      const auto response = serialize_error("Busy");
+      (void)write_frame(client_fd, make_message(sign(response), response));
+      ::close(client_fd);
+      continue;
+    }
+
+    ++state->num_jobs;
+    try {
+      std::thread([client_fd, state]() {
+        handle_connection(client_fd, *state);
+        ::close(client_fd);
+        --state->num_jobs;
+      }).detach();
+    } catch (const std::system_error& e) {
+      debug::log(debug::WARNING) << "Unable to start a job thread: " << e.what();
+      ::close(client_fd);
+      --state->num_jobs;
+    }
+  }
+}
+#else
+bool run_job(const job_t& /* job */, result_t& /* result */) noexcept {
+  debug::log(debug::DEBUG) << "Compile offloading is not supported on this platform";
+  return false;
+}
+
+void run_worker(const std::string& /* address */,
+                const identify_program_fn& /* identify_program */) {
+  throw std::runtime_error("The offload worker is not supported on this platform.");
+}
+#endif
+}  // namespace offload
+}  // namespace bcache
@@ -0,0 +1,95 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#ifndef BUILDCACHE_OFFLOAD_HPP_
+#define BUILDCACHE_OFFLOAD_HPP_
+
+#include <base/string_list.hpp>
+#include <sys/sys_utils.hpp>
+
+#include <functional>
+#include <map>
+#include <string>
+
+namespace bcache {
+namespace offload {
+/// @brief A compilation job that can be run on an offload worker.
+///
+/// The worker runs the command in an empty work directory, where the source file has been written
+/// to @c source_name. The build files are collected from the work directory after the command has
+/// finished.
+///
+/// The command must have the form "program [flags...] -c source -o object", where the program is a
+/// plain program name (it is looked up in the PATH of the worker), all the flags are accepted by
+/// is_safe_arg(), source is @c source_name and object is the "object" build file (the only build
+/// file). The worker rebuilds the command from these parts, and rejects any other job.
+struct job_t {
+  std::string program_id;  ///< Identifies the program (the worker must have the same program).
+  string_list_t command;   ///< The command to run (the first item is the program name).
+  std::string source_name;  ///< The file name of the source file.
+  std::string source;       ///< The source file contents (e.g. preprocessed source code).
+  std::map<std::string, std::string> build_files;  ///< Build file names (file ID -> file name).
+};
+
+/// @brief The result of an offloaded job.
+struct result_t {
+  sys::run_result_t run_result;                    ///< The program return code and output.
+  std::map<std::string, std::string> build_files;  ///< Build file contents (file ID -> data).
+};
+
+/// @brief A function that identifies the program of a command on the worker.
+///
+/// Given a command, the function returns the program ID of the program that would run the command
+/// on the worker (i.e. the same ID as a program wrapper would produce), or an empty string if the
+/// program can not be identified. The function may replace the program name of the command (the
+/// first item) with the full path to the program.
+using identify_program_fn = std::function<std::string(string_list_t& command)>;
+
+/// @brief Check if a compiler flag is safe to run on an offload worker.
+///
+/// Only flags that control code generation, language dialects and diagnostics are allowed. Flags
+/// that name programs, plugins or files outside of the work directory are rejected, since they
+/// could make the worker run or access anything.
+/// @param arg The compiler flag.
+/// @returns true if the flag is safe to run on a worker.
+bool is_safe_arg(const std::string& arg);
+
+/// @brief Run a job on the offload worker (as given by the BUILDCACHE_OFFLOAD configuration).
+///
+/// If an offload secret is configured, the response of the worker is authenticated (and bound to
+/// the request) before any result is returned.
+/// @param job The job to run.
+/// @param[out] result The result of the job.
+/// @returns true if the job was run by the worker, or false if the job could not be offloaded (in
+/// which case it should be run locally instead).
+bool run_job(const job_t& job, result_t& result) noexcept;
+
+/// @brief Run an offload worker.
+///
+/// The worker listens for jobs on the given TCP address, and runs each job in a temporary work
+/// directory. Jobs are only accepted if the program ID of the job matches the program ID of the
+/// program that the worker would use. Unless an offload secret is configured, the worker only
+/// listens on loopback addresses. This function does not return unless there is an error.
+/// @param address The address to listen on (host:port).
+/// @param identify_program A function for identifying the programs of the jobs.
+/// @throws runtime_error if the worker could not be started.
+void run_worker(const std::string& address, const identify_program_fn& identify_program);
+}  // namespace offload
+}  // namespace bcache
+
+#endif  // BUILDCACHE_OFFLOAD_HPP_
@@ -0,0 +1,363 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#include <base/env_utils.hpp>
+#include <base/file_utils.hpp>
+#include <base/hmac.hpp>
+#include <base/serializer_utils.hpp>
+#include <base/time_utils.hpp>
+#include <config/configuration.hpp>
+#include <sys/offload.hpp>
+
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Workaround for macOS build errors.
+// See: https://github.com/onqtam/doctest/issues/126
+#include <iostream>
+
+using namespace bcache;
+
+TEST_CASE("offload: Only safe flags are accepted") {
+  CHECK(offload::is_safe_arg("-O2"));
+  CHECK(offload::is_safe_arg("-Wall"));
+  CHECK(offload::is_safe_arg("-w"));
+  CHECK(offload::is_safe_arg("-std=c++11"));
+  CHECK(offload::is_safe_arg("-fno-exceptions"));
+  CHECK(offload::is_safe_arg("-march=native"));
+  CHECK(offload::is_safe_arg("-ffile-prefix-map=/home/me=."));
+
+  CHECK_FALSE(offload::is_safe_arg("-wrapper"));
+  CHECK_FALSE(offload::is_safe_arg("-fplugin=evil.so"));
+  CHECK_FALSE(offload::is_safe_arg("-B/tmp/evil"));
+  CHECK_FALSE(offload::is_safe_arg("-specs=evil.specs"));
+  CHECK_FALSE(offload::is_safe_arg("-o"));
+  CHECK_FALSE(offload::is_safe_arg("-Wl,--evil"));
+  CHECK_FALSE(offload::is_safe_arg("-fsanitize-ignorelist=/etc/passwd"));
+  CHECK_FALSE(offload::is_safe_arg("@args.txt"));
+  CHECK_FALSE(offload::is_safe_arg("hello.c"));
+}
+
+#if !defined(_WIN32)
+namespace {
+const char FAKE_CC_SCRIPT[] =
+    "#!/bin/sh\n"
+    "while [ $# -gt 0 ]; do\n"
+    "  case \"$1\" in\n"
+    "    -c) src=\"$2\"; shift ;;\n"
+    "    -o) obj=\"$2\"; shift ;;\n"
+    "  esac\n"
+    "  shift\n"
+    "done\n"
+    "cp \"$src\" \"$obj\"\n";
+
+offload::job_t make_job() {
+  offload::job_t job;
+  job.program_id = "fakecc 1.0";
+  job.command = string_list_t{"fakecc", "-O2", "-c", "hello.i", "-o", "hello.o"};
+  job.source_name = "hello.i";
+  job.source = "int x;";
+  job.build_files["object"] = "hello.o";
+  return job;
+}
+
+// A raw connection to a worker, for sending requests that run_job() would never send.
+class connection_t {
+public:
+  explicit connection_t(const int port) : m_fd(::socket(AF_INET, SOCK_STREAM, 0)) {
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(m_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+      throw std::runtime_error("Unable to connect");
+    }
+  }
+
+  ~connection_t() {
+    ::close(m_fd);
+  }
+
+  void send(const std::string& data) {
+    if (::send(m_fd, data.data(), data.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(data.size())) {
+      throw std::runtime_error("Unable to send");
+    }
+  }
+
+  std::string receive(const size_t size) {
+    std::string data(size, '\0');
+    size_t pos = 0;
+    while (pos < size) {
+      const auto n = ::recv(m_fd, &data[pos], size - pos, 0);
+      if (n <= 0) {
+        throw std::runtime_error("Unable to receive");
+      }
+      pos += static_cast<size_t>(n);
+    }
+    return data;
+  }
+
+  // Returns the error of the response (or an empty string if the job was accepted).
+  std::string receive_error() {
+    auto data = receive(8U);
+    std::string::size_type pos = 0;
+    data = receive(static_cast<size_t>(serialize::to_int64(data, pos)));
+    pos = 0;
+    (void)serialize::to_string(data, pos);  // Signature.
+    const auto response = serialize::to_string(data, pos);
+    pos = 0;
+    (void)serialize::to_int(response, pos);  // Version.
+    return serialize::to_string(response, pos);
+  }
+
+private:
+  int m_fd;
+};
+
+std::string make_frame(const std::string& data) {
+  return serialize::from_int64(static_cast<int64_t>(data.size())) + data;
+}
+
+// Send raw data to the worker, and get the error of the response.
+std::string send_to_worker(const int port, const std::string& data) {
+  // The worker may still be busy with the previous job (it runs one job per core).
+  std::string error;
+  for (int i = 0; i < 100; ++i) {
+    connection_t connection(port);
+    connection.send(data);
+    error = connection.receive_error();
+    if (error != "Busy") {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  return error;
+}
+
+// Make a signed request message (the same format as run_job() uses).
+std::string make_request(const offload::job_t& job,
+                         const std::string& secret,
+                         const time::seconds_t timestamp,
+                         const std::string& nonce) {
+  std::string payload = serialize::from_int(2);
+  payload += serialize::from_int64(timestamp);
+  payload += serialize::from_string(nonce);
+  payload += serialize::from_string(job.program_id);
+  payload +=
+      serialize::from_vector(std::vector<std::string>(job.command.begin(), job.command.end()));
+  payload += serialize::from_string(job.source_name);
+  payload += serialize::from_string(job.source);
+  payload += serialize::from_map(job.build_files);
+  return serialize::from_string(sha1_hmac(secret, payload)) + serialize::from_string(payload);
+}
+
+bool run_with_retries(const offload::job_t& job, offload::result_t& result) {
+  // The worker may need some time to start listening.
+  for (int i = 0; i < 100; ++i) {
+    if (offload::run_job(job, result)) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  return false;
+}
+}  // namespace
+
+TEST_CASE("offload: A worker without a secret refuses non-loopback addresses") {
+  const auto tmp = file::tmp_file_t(file::get_temp_dir(), "");
+  file::create_dir(tmp.path());
+  scoped_unset_env_t no_secret("BUILDCACHE_OFFLOAD_SECRET");
+  config::init(tmp.path().c_str());
+
+  const auto identify_program = [](string_list_t&) { return std::string("fakecc 1.0"); };
+  CHECK_THROWS_AS(offload::run_worker("0.0.0.0:0", identify_program), std::runtime_error);
+}
+
+TEST_CASE("offload: A local worker only runs validated jobs") {
+  // The worker thread outlives this test case, so everything that it uses must be static.
+  static const auto tmp = file::tmp_file_t(file::get_temp_dir(), "");
+  file::create_dir(tmp.path());
+  static const auto fake_cc = file::append_path(tmp.path(), "fakecc");
+  file::write(FAKE_CC_SCRIPT, fake_cc);
+  REQUIRE(::chmod(fake_cc.c_str(), 0755) == 0);
+
+  const auto address = "127.0.0.1:" + std::to_string(20000 + (::getpid() % 20000));
+  set_env("BUILDCACHE_OFFLOAD", address);
+  set_env("BUILDCACHE_OFFLOAD_SECRET", "s3cr3t");
+  config::init(tmp.path().c_str());
+
+  // Only the fake compiler is recognized by the worker.
+  static const offload::identify_program_fn identify_program = [](string_list_t& command) {
+    if (command[0] != "fakecc") {
+      return std::string();
+    }
+    command[0] = fake_cc;
+    return std::string("fakecc 1.0");
+  };
+  std::thread([address]() {
+    try {
+      offload::run_worker(address, identify_program);
+    } catch (...) {
+    }
+  }).detach();
+
+  offload::result_t result;
+  REQUIRE(run_with_retries(make_job(), result));
+  CHECK_EQ(result.run_result.return_code, 0);
+  CHECK_EQ(result.build_files["object"], "int x;");
+
+  // An unknown program is never run, even if the job claims no program ID.
+  {
+    auto job = make_job();
+    job.program_id = "";
+    job.command[0] = "sh";
+    CHECK_FALSE(offload::run_job(job, result));
+  }
+
+  // The program must be identified as the same program as on the client.
+  {
+    auto job = make_job();
+    job.program_id = "fakecc 2.0";
+    CHECK_FALSE(offload::run_job(job, result));
+  }
+
+  // The program must be given by name.
+  {
+    auto job = make_job();
+    job.command[0] = "/bin/fakecc";
+    CHECK_FALSE(offload::run_job(job, result));
+  }
+
+  // Unsafe flags are rejected.
+  for (const auto& arg : {"-wrapper", "-fplugin=evil.so", "-B/tmp", "-specs=evil", "@args"}) {
+    auto job = make_job();
+    job.command = string_list_t{"fakecc", arg, "-c", "hello.i", "-o", "hello.o"};
+    CHECK_FALSE(offload::run_job(job, result));
+  }
+
+  // Outputs can only be written to the work dir, by the expected arguments.
+  {
+    auto job = make_job();
+    job.command =
+        string_list_t{"fakecc", "-o", "/tmp/evil.o", "-c", "hello.i", "-o", "hello.o"};
+    CHECK_FALSE(offload::run_job(job, result));
+  }
+  {
+    auto job = make_job();
+    job.command = string_list_t{"fakecc", "-c", "hello.i", "-o", "../hello.o"};
+    job.build_files["object"] = "../hello.o";
+    CHECK_FALSE(offload::run_job(job, result));
+  }
+
+  // Oversized requests are rejected before they are buffered.
+  const auto port = 20000 + (::getpid() % 20000);
+  CHECK_EQ(send_to_worker(port, serialize::from_int64(1LL << 40)), "Invalid offload message size");
+
+  // Requests must be signed with the right secret.
+  const auto now = time::seconds_since_epoch();
+  CHECK_EQ(send_to_worker(port, make_frame(make_request(make_job(), "wrong", now, "n1"))),
+           "Authentication failed");
+
+  // Captured requests can not be replayed, and old requests are rejected.
+  const auto request = make_frame(make_request(make_job(), "s3cr3t", now, "n2"));
+  CHECK_EQ(send_to_worker(port, request), "");
+  CHECK_EQ(send_to_worker(port, request), "Replayed request");
+  CHECK_EQ(send_to_worker(port, make_frame(make_request(make_job(), "s3cr3t", now - 3600, "n3"))),
+           "Request timestamp out of range");
+
+  unset_env("BUILDCACHE_OFFLOAD");
+  unset_env("BUILDCACHE_OFFLOAD_SECRET");
+}
+
+TEST_CASE("offload: Worker responses must be authenticated") {
+  const auto tmp = file::tmp_file_t(file::get_temp_dir(), "");
+  file::create_dir(tmp.path());
+
+  // A fake worker that accepts one job and responds with the given signature secret.
+  const auto listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  REQUIRE(::bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0);
+  REQUIRE(::listen(listen_fd, 1) == 0);
+  REQUIRE(::getsockname(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), &addr_len) == 0);
+  const auto run_fake_worker = [listen_fd](const std::string& secret) {
+    const auto fd = ::accept(listen_fd, nullptr, nullptr);
+    std::string data(8U, '\0');
+    (void)::recv(fd, &data[0], data.size(), MSG_WAITALL);
+    std::string::size_type pos = 0;
+    data.resize(static_cast<size_t>(serialize::to_int64(data, pos)));
+    (void)::recv(fd, &data[0], data.size(), MSG_WAITALL);
+    pos = 0;
+    const auto request_signature = serialize::to_string(data, pos);
+
+    std::string response = serialize::from_int(2);
+    response += serialize::from_string(std::string());
+    response += serialize::from_int(0);
+    response += serialize::from_string(std::string());
+    response += serialize::from_string(std::string());
+    response += serialize::from_map({{"object", "evil"}});
+    const auto message = serialize::from_string(sha1_hmac(secret, request_signature + response)) +
+                         serialize::from_string(response);
+    const auto frame = make_frame(message);
+    (void)::send(fd, frame.data(), frame.size(), MSG_NOSIGNAL);
+    ::close(fd);
+  };
+
+  set_env("BUILDCACHE_OFFLOAD", "127.0.0.1:" + std::to_string(ntohs(addr.sin_port)));
+  set_env("BUILDCACHE_OFFLOAD_SECRET", "s3cr3t");
+  config::init(tmp.path().c_str());
+
+  SUBCASE("A forged response is rejected") {
+    std::thread worker(run_fake_worker, "wrong");
+    offload::result_t result;
+    CHECK_FALSE(offload::run_job(make_job(), result));
+    worker.join();
+  }
+
+  SUBCASE("A response that is signed for the request is accepted") {
+    std::thread worker(run_fake_worker, "s3cr3t");
+    offload::result_t result;
+    CHECK(offload::run_job(make_job(), result));
+    CHECK_EQ(result.build_files["object"], "evil");
+    worker.join();
+  }
+
+  ::close(listen_fd);
+  unset_env("BUILDCACHE_OFFLOAD");
+  unset_env("BUILDCACHE_OFFLOAD_SECRET");
+}
+#endif
@@ -49,6 +49,7 @@
 #undef log
 #else
 #include <cerrno>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -82,6 +83,27 @@ std::string make_exe_path_suitable_for_icecc(const std::string& path) {
 }
 
 #if !defined(_WIN32)
+bool make_cloexec_pipe(int fds[2]) {
+#if defined(__linux__)
+  return pipe2(fds, O_CLOEXEC) == 0;
+#else
+  // Note: Without pipe2() there is a small window where the pipe can leak to other processes.
+  if (pipe(fds) != 0) {
+    return false;
+  }
+  (void)fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  (void)fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  return true;
+#endif
+}
+
+/// @brief Write an error message to stderr and terminate a forked child process.
+/// @note This function is async-signal-safe.
+[[noreturn]] void write_error_and_exit(const std::string& message) {
+  (void)write(STDERR_FILENO, message.data(), message.size());
+  _exit(1);
+}
+
 bool try_start_editor(const std::string& program, const std::string& file) {
   try {
     const auto& exe_path = file::find_executable(program);
@@ -162,8 +184,8 @@ bool read_from_pipe(const int pipe_fd,
 }  // namespace
 
 run_result_t run(const string_list_t& args, const bool quiet, const std::string& work_dir) {
-  // Temporarily change the directory to work_dir if requested.
-  file::scoped_work_dir_t scoped_work_dir(work_dir);
+  // Note: The work_dir is applied to the child process only (rather than temporarily changing the
+  // CWD of the BuildCache process), which makes it safe to call this function from several threads.
 
   // Initialize the run result.
   run_result_t result;
@@ -232,6 +254,7 @@ run_result_t run(const string_list_t& args, const bool quiet, const std::string&
 
     // Note: The cmdw string may be modified by CreateProcessW (!) so it must not be const.
     auto cmdw = utf8_to_ucs2(cmd);
+    const auto work_dirw = utf8_to_ucs2(work_dir);
 
     // Start the child process.
     PROCESS_INFORMATION process_info;
@@ -243,7 +266,7 @@ run_result_t run(const string_list_t& args, const bool quiet, const std::string&
                        TRUE,
                        0,
                        nullptr,
-                       nullptr,
+                       work_dir.empty() ? nullptr : work_dirw.c_str(),
                        &startup_info,
                        &process_info) == 0) {
       throw std::runtime_error("Unable to create child process.");
@@ -322,13 +345,34 @@ run_result_t run(const string_list_t& args, const bool quiet, const std::string&
     CloseHandle(std_in_write_handle);
   }
 #else
-  // Create pipes for stdout and stderr.
+  // Prepare everything that the child process needs before forking: After fork() the child may
+  // only use async-signal-safe functions (another thread may hold the allocator lock, for
+  // instance), so it must not allocate memory or throw exceptions.
+  std::vector<char*> argv;
+  for (const auto& arg : args) {
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  const auto* const work_dir_c = work_dir.empty() ? nullptr : work_dir.c_str();
+  const std::string redirect_error = "*** BuildCache error: Could not redirect stdout/stderr\n";
+  const std::string chdir_error =
+      "*** BuildCache error: Unable to change the working directory to " + work_dir + "\n";
+  const std::string no_such_file_error = "*** BuildCache error: execv(): No such file: " +
+                                         (args.size() > 0 ? args[0] : std::string()) + "\n";
+  const std::string permission_error = "*** BuildCache error: execv(): Permission denied: " +
+                                       (args.size() > 0 ? args[0] : std::string()) + "\n";
+  const std::string launch_error = "*** BuildCache error: execv(): Unable to launch command: " +
+                                   (args.size() > 0 ? args[0] : std::string()) + "\n";
+
+  // Create pipes for stdout and stderr. The pipes are close-on-exec, so that they are not leaked
+  // to child processes that are started concurrently from other threads (the child process gets
+  // its own copies through dup2(), which clears the flag).
   int pipe_stdout[2];
   int pipe_stderr[2];
-  if (pipe(pipe_stdout) == -1) {
+  if (!make_cloexec_pipe(pipe_stdout)) {
     throw std::runtime_error("Error creating stdout pipe.");
   }
-  if (pipe(pipe_stderr) == -1) {
+  if (!make_cloexec_pipe(pipe_stderr)) {
     close(pipe_stdout[0]);
     close(pipe_stdout[1]);
     throw std::runtime_error("Error creating stderr pipe.");
@@ -337,50 +381,42 @@ run_result_t run(const string_list_t& args, const bool quiet, const std::string&
   // Create the child process.
   auto child_pid = fork();
   if (child_pid == 0) {
-    try {
-      // Redirect stdout & stderr to the pipes.
-      auto dup2_or_throw = [](int fildes, int fildes2) {
-        while (true) {
-          if (dup2(fildes, fildes2) != -1) {
-            break;
-          }
-          if (errno != EINTR) {
-            throw std::runtime_error("Could not redirect stdout/stderr");
-          }
+    // Redirect stdout & stderr to the pipes.
+    const auto dup2_retry = [](int fildes, int fildes2) {
+      while (dup2(fildes, fildes2) == -1) {
+        if (errno != EINTR) {
+          return false;
         }
-      };
-      dup2_or_throw(pipe_stdout[1], STDOUT_FILENO);
-      dup2_or_throw(pipe_stderr[1], STDERR_FILENO);
-
-      // The child process will not use the pipes directly, so close them.
-      close(pipe_stdout[0]);
-      close(pipe_stdout[1]);
-      close(pipe_stderr[0]);
-      close(pipe_stderr[1]);
-
-      // Build a nullptr-terminated argv array from args.
-      std::vector<char*> argv;
-      for (const auto& arg : args) {
-        argv.push_back(const_cast<char*>(arg.c_str()));
-      }
-      argv.push_back(nullptr);
-
-      // Call the command.
-      execv(argv[0], argv.data());
-
-      // If execv returns, it must have failed.
-      switch (errno) {
-        case ENOENT:
-          throw std::runtime_error("execv(): No such file: " + args[0]);
-        case EACCES:
-          throw std::runtime_error("execv(): Permission denied: " + args[0]);
-        default:
-          throw std::runtime_error("execv(): Unable to launch command: " + args[0]);
       }
-    } catch (std::exception& e) {
-      // TODO(m): Signal this error to the parent process somehow.
-      std::cerr << "*** BuildCache error: " << e.what() << "\n";
-      std::exit(1);
+      return true;
+    };
+    if (!dup2_retry(pipe_stdout[1], STDOUT_FILENO) || !dup2_retry(pipe_stderr[1], STDERR_FILENO)) {
+      write_error_and_exit(redirect_error);
+    }
+
+    // The child process will not use the pipes directly, so close them.
+    close(pipe_stdout[0]);
+    close(pipe_stdout[1]);
+    close(pipe_stderr[0]);
+    close(pipe_stderr[1]);
+
+    // Change the directory to work_dir if requested.
+    if (work_dir_c != nullptr && chdir(work_dir_c) != 0) {
+      write_error_and_exit(chdir_error);
+    }
+
+    // Call the command.
+    execv(argv[0], argv.data());
+
+    // If execv returns, it must have failed.
+    // TODO(m): Signal this error to the parent process somehow.
+    switch (errno) {
+      case ENOENT:
+        write_error_and_exit(no_such_file_error);
+      case EACCES:
+        write_error_and_exit(permission_error);
+      default:
+        write_error_and_exit(launch_error);
     }
   } else if (child_pid != -1) {
     // The parent has no need for the entrances of the pipes, so close them.
@@ -441,6 +477,10 @@ run_result_t run(const string_list_t& args, const bool quiet, const std::string&
     }
   } else {
     debug::log(debug::ERROR) << "Could not create child process (errno: " << errno << ")";
+    close(pipe_stdout[0]);
+    close(pipe_stdout[1]);
+    close(pipe_stderr[0]);
+    close(pipe_stderr[1]);
   }
 #endif  // _WIN32
 
@@ -0,0 +1,112 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#include <sys/tree_hash.hpp>
+
+#include <base/debug_utils.hpp>
+#include <base/serializer_utils.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace bcache {
+namespace sys {
+namespace {
+// Node type tags, for domain separation between the different kinds of tree nodes.
+const uint8_t LEAF_NODE_TAG = 0U;
+const uint8_t INNER_NODE_TAG = 1U;
+const uint8_t ROOT_NODE_TAG = 2U;
+
+hasher_t::hash_t hash_leaf(const std::string& data, const size_t leaf_no) {
+  const auto start = leaf_no * TREE_HASH_LEAF_SIZE;
+  const auto size = std::min(TREE_HASH_LEAF_SIZE, data.size() - start);
+  hasher_t hasher;
+  hasher.update(&LEAF_NODE_TAG, 1);
+  hasher.update(&data[start], size);
+  return hasher.final();
+}
+
+hasher_t::hash_t hash_inner_node(const hasher_t::hash_t& left, const hasher_t::hash_t& right) {
+  hasher_t hasher;
+  hasher.update(&INNER_NODE_TAG, 1);
+  hasher.update(left.data(), hasher_t::hash_t::SIZE);
+  hasher.update(right.data(), hasher_t::hash_t::SIZE);
+  return hasher.final();
+}
+}  // namespace
+
+const std::string TREE_HASH_VERSION = "tree-hash-1";
+
+hasher_t::hash_t tree_hash(const std::string& data, const int max_threads) {
+  // Hash all the leaves. The leaves are handed out to the worker threads dynamically, which gives
+  // a good load balance.
+  const auto num_leaves =
+      std::max<size_t>(1U, (data.size() + TREE_HASH_LEAF_SIZE - 1U) / TREE_HASH_LEAF_SIZE);
+  std::vector<hasher_t::hash_t> nodes(num_leaves);
+  std::atomic<size_t> next_leaf(0U);
+  const auto hash_leaves = [&data, &nodes, &next_leaf, num_leaves]() {
+    for (auto leaf_no = next_leaf++; leaf_no < num_leaves; leaf_no = next_leaf++) {
+      nodes[leaf_no] = hash_leaf(data, leaf_no);
+    }
+  };
+
+  auto num_threads = static_cast<size_t>(
+      max_threads > 0 ? max_threads : static_cast<int>(std::thread::hardware_concurrency()));
+  num_threads = std::max<size_t>(1U, std::min(num_threads, num_leaves));
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; ++i) {
+    try {
+      threads.emplace_back(hash_leaves);
+    } catch (const std::system_error& e) {
+      // Not being able to start a thread is not fatal: The remaining leaves are hashed by the
+      // threads that we already have.
+      debug::log(debug::DEBUG) << "Unable to start a hashing thread: " << e.what();
+      break;
+    }
+  }
+  hash_leaves();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Combine the nodes pairwise until there is a single node left. An odd node at the end of a
+  // level is promoted to the next level as is.
+  while (nodes.size() > 1U) {
+    std::vector<hasher_t::hash_t> parents;
+    parents.reserve((nodes.size() + 1U) / 2U);
+    for (size_t i = 0; i < nodes.size(); i += 2U) {
+      parents.emplace_back((i + 1U) < nodes.size() ? hash_inner_node(nodes[i], nodes[i + 1U])
+                                                   : nodes[i]);
+    }
+    nodes.swap(parents);
+  }
+
+  // The root hash also covers the total data size, so that inputs that only differ in their
+  // partitioning into leaves can not collide.
+  hasher_t hasher;
+  hasher.update(&ROOT_NODE_TAG, 1);
+  hasher.update(serialize::from_int64(static_cast<int64_t>(data.size())));
+  hasher.update(nodes[0].data(), hasher_t::hash_t::SIZE);
+  return hasher.final();
+}
+}  // namespace sys
+}  // namespace bcache
@@ -0,0 +1,54 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#ifndef BUILDCACHE_TREE_HASH_HPP_
+#define BUILDCACHE_TREE_HASH_HPP_
+
+#include <base/hasher.hpp>
+
+#include <cstddef>
+#include <string>
+
+namespace bcache {
+namespace sys {
+/// @brief The version of the tree hash format.
+///
+/// This must be changed whenever the tree hash algorithm (e.g. the leaf size) changes, since that
+/// would change the resulting cache keys.
+extern const std::string TREE_HASH_VERSION;
+
+/// @brief The size of a tree hash leaf, in bytes.
+const size_t TREE_HASH_LEAF_SIZE = 1U << 20;
+
+/// @brief The minimum data size for which tree hashing is worthwhile, in bytes.
+const size_t TREE_HASH_MIN_SIZE = 4U * TREE_HASH_LEAF_SIZE;
+
+/// @brief Calculate the tree hash of a block of data.
+///
+/// The data is split into fixed size leaves, which are hashed in parallel. The leaf hashes are
+/// then combined pairwise into a binary hash tree (a Merkle tree). The result only depends on the
+/// data, not on the number of threads that were used.
+/// @param data The data to hash.
+/// @param max_threads The maximum number of threads to use (zero means one thread per hardware
+/// thread).
+/// @returns the root hash of the tree.
+hasher_t::hash_t tree_hash(const std::string& data, const int max_threads = 0);
+}  // namespace sys
+}  // namespace bcache
+
+#endif  // BUILDCACHE_TREE_HASH_HPP_
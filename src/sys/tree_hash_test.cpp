@@ -0,0 +1,64 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#include <sys/tree_hash.hpp>
+
+#include <doctest/doctest.h>
+
+#include <string>
+
+// Workaround for macOS build errors.
+// See: https://github.com/onqtam/doctest/issues/126
+#include <iostream>
+
+using namespace bcache;
+
+namespace {
+std::string make_data(const size_t size) {
+  std::string data(size, 0);
+  uint32_t x = 12345U;
+  for (auto& c : data) {
+    x = x * 1103515245U + 12345U;
+    c = static_cast<char>(x >> 24);
+  }
+  return data;
+}
+}  // namespace
+
+TEST_CASE("tree_hash produces expected results") {
+  SUBCASE("The result is independent of the number of threads") {
+    const auto data = make_data(5U * sys::TREE_HASH_LEAF_SIZE + 123U);
+    const auto hash1 = sys::tree_hash(data, 1);
+    CHECK(hash1 == sys::tree_hash(data, 2));
+    CHECK(hash1 == sys::tree_hash(data, 3));
+    CHECK(hash1 == sys::tree_hash(data, 16));
+  }
+
+  SUBCASE("Different data gives different hashes") {
+    auto data = make_data(3U * sys::TREE_HASH_LEAF_SIZE);
+    const auto hash1 = sys::tree_hash(data);
+    data[2U * sys::TREE_HASH_LEAF_SIZE + 17U] ^= 1;
+    CHECK_FALSE(hash1 == sys::tree_hash(data));
+  }
+
+  SUBCASE("Different sizes give different hashes") {
+    const auto data = make_data(sys::TREE_HASH_LEAF_SIZE + 1U);
+    CHECK_FALSE(sys::tree_hash(data) == sys::tree_hash(data.substr(0, data.size() - 1U)));
+    CHECK_FALSE(sys::tree_hash(std::string()) == sys::tree_hash(std::string(1, 0)));
+  }
+}
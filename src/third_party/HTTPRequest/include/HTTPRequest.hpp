@@ -46,6 +46,7 @@ extern "C" char *_strdup(const char *strSource);
 #  include <netdb.h>
 #  include <sys/select.h>
 #  include <sys/socket.h>
+#  include <sys/un.h>
 #  include <unistd.h>
 #endif
 
@@ -68,7 +69,10 @@ namespace http
     enum class InternetProtocol: std::uint8_t
     {
         V4,
-        V6
+        V6,
+#ifndef _WIN32
+        Unix
+#endif
     };
 
     inline namespace detail
@@ -131,9 +135,21 @@ namespace http
         {
             return (internetProtocol == InternetProtocol::V4) ? AF_INET :
                 (internetProtocol == InternetProtocol::V6) ? AF_INET6 :
+#ifndef _WIN32
+                (internetProtocol == InternetProtocol::Unix) ? AF_UNIX :
+#endif
                 throw RequestError("Unsupported protocol");
         }
 
+        constexpr int getProtocol(InternetProtocol internetProtocol)
+        {
+#ifndef _WIN32
+            return (internetProtocol == InternetProtocol::Unix) ? 0 : IPPROTO_TCP;
+#else
+            return (static_cast<void>(internetProtocol), IPPROTO_TCP);
+#endif
+        }
+
         class Socket final
         {
         public:
@@ -146,7 +162,7 @@ namespace http
 #endif
 
             explicit Socket(InternetProtocol internetProtocol):
-                endpoint(socket(getAddressFamily(internetProtocol), SOCK_STREAM, IPPROTO_TCP))
+                endpoint(socket(getAddressFamily(internetProtocol), SOCK_STREAM, getProtocol(internetProtocol)))
             {
                 if (endpoint == invalid)
                     throw std::system_error(getLastError(), std::system_category(), "Failed to create socket");
@@ -513,9 +529,12 @@ namespace http
     class Request final
     {
     public:
+        // Note: With InternetProtocol::Unix, the request is sent to the Unix domain socket given by
+        // socketPath (the domain of the URL is then only used for the Host header).
         explicit Request(const std::string& url,
-                         const InternetProtocol protocol = InternetProtocol::V4):
-            internetProtocol(protocol)
+                         const InternetProtocol protocol = InternetProtocol::V4,
+                         const std::string& socketPath = ""):
+            internetProtocol(protocol), unixSocketPath(socketPath)
         {
             const auto schemeEndPosition = url.find("://");
 
@@ -600,15 +619,29 @@ namespace http
             if (scheme != "http")
                 throw RequestError("Only HTTP scheme is supported");
 
-            addrinfo hints = {};
-            hints.ai_family = getAddressFamily(internetProtocol);
-            hints.ai_socktype = SOCK_STREAM;
+            std::unique_ptr<addrinfo, decltype(&freeaddrinfo)> addressInfo(nullptr, freeaddrinfo);
+#ifndef _WIN32
+            struct sockaddr_un unixAddress = {};
+            if (internetProtocol == InternetProtocol::Unix)
+            {
+                if (unixSocketPath.empty() || unixSocketPath.size() >= sizeof(unixAddress.sun_path))
+                    throw RequestError("Invalid Unix domain socket path: " + unixSocketPath);
+                unixAddress.sun_family = AF_UNIX;
+                std::memcpy(unixAddress.sun_path, unixSocketPath.c_str(), unixSocketPath.size() + 1);
+            }
+            else
+#endif
+            {
+                addrinfo hints = {};
+                hints.ai_family = getAddressFamily(internetProtocol);
+                hints.ai_socktype = SOCK_STREAM;
 
-            addrinfo* info;
-            if (getaddrinfo(domain.c_str(), port.c_str(), &hints, &info) != 0)
-                throw std::system_error(getLastError(), std::system_category(), "Failed to get address info of " + domain);
+                addrinfo* info;
+                if (getaddrinfo(domain.c_str(), port.c_str(), &hints, &info) != 0)
+                    throw std::system_error(getLastError(), std::system_category(), "Failed to get address info of " + domain);
 
-            std::unique_ptr<addrinfo, decltype(&freeaddrinfo)> addressInfo(info, freeaddrinfo);
+                addressInfo.reset(info);
+            }
 
             // RFC 7230, 3.1.1. Request Line
             std::string headerData = method + " " + path + " HTTP/1.1\r\n";
@@ -626,6 +659,12 @@ namespace http
 
             Socket socket(internetProtocol);
 
+#ifndef _WIN32
+            if (internetProtocol == InternetProtocol::Unix)
+                socket.connect(reinterpret_cast<const struct sockaddr*>(&unixAddress), sizeof(unixAddress),
+                               (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1);
+            else
+#endif
             // take the first address from the list
             socket.connect(addressInfo->ai_addr, static_cast<socklen_t>(addressInfo->ai_addrlen),
                            (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1);
@@ -814,6 +853,7 @@ namespace http
         WinSock winSock;
 #endif
         InternetProtocol internetProtocol;
+        std::string unixSocketPath;
         std::string scheme;
         std::string domain;
         std::string port;
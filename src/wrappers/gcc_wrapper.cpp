@@ -20,22 +20,32 @@
 #include <wrappers/gcc_wrapper.hpp>
 
 #include <base/debug_utils.hpp>
+#include <base/elf_utils.hpp>
 #include <base/hasher.hpp>
+#include <base/preprocessed_normalizer.hpp>
 #include <base/unicode_utils.hpp>
 #include <cache/data_store.hpp>
 #include <config/configuration.hpp>
 #include <sys/sys_utils.hpp>
 
+#include <algorithm>
 #include <fstream>
+#include <map>
 #include <regex>
 #include <set>
 #include <stdexcept>
+#include <vector>
 
 namespace bcache {
 namespace {
 // Tick this to a new number if the format has changed in a non-backwards-compatible way.
 const std::string HASH_VERSION = "3";
 
+// Path prefix map options (e.g. -fdebug-prefix-map=OLD=NEW).
+const std::string FILE_PREFIX_MAP = "-ffile-prefix-map=";
+const std::string DEBUG_PREFIX_MAP = "-fdebug-prefix-map=";
+const std::string PROFILE_PREFIX_MAP = "-fprofile-prefix-map=";
+
 bool is_arg_plus_file_name(const std::string& arg) {
   // Is this an argument that is followed by a file path?
   static const std::set<std::string> path_args = {"-I", "-MF", "-MT", "-MQ", "-o"};
@@ -48,6 +58,42 @@ bool is_arg_pair(const std::string& arg) {
   return is_arg_plus_file_name(arg);
 }
 
+/// @brief Get the build IDs of the compiler backend programs (cc1, cc1plus).
+/// @param compiler The compiler driver executable.
+/// @param[out] build_ids A string that identifies the backend programs.
+/// @returns false if the backend programs could not be identified using build IDs.
+bool get_backend_build_ids(const std::string& compiler, std::string& build_ids) {
+  // Ask the compiler driver where the backend is located.
+  string_list_t args;
+  args += compiler;
+  args += "-print-prog-name=cc1";
+  const auto result = sys::run(args);
+  if (result.return_code != 0) {
+    return false;
+  }
+  const auto cc1_path = strip(result.std_out);
+
+  // A bare program name (e.g. "cc1") means that there is no separate backend program (this is the
+  // case for clang, where the driver is also the compiler).
+  build_ids.clear();
+  const auto backend_dir = file::get_dir_part(cc1_path);
+  if (backend_dir.empty()) {
+    return true;
+  }
+
+  for (const auto& backend : {"cc1", "cc1plus"}) {
+    const auto backend_path = file::append_path(backend_dir, backend);
+    if (file::file_exists(backend_path)) {
+      const auto build_id = elf::get_build_id(backend_path);
+      if (build_id.empty()) {
+        return false;
+      }
+      build_ids += std::string(":") + backend + "=" + build_id;
+    }
+  }
+  return true;
+}
+
 bool is_source_file(const std::string& arg) {
   const auto ext = lower_case(file::get_extension(arg));
   return ((ext == ".cpp") || (ext == ".cc") || (ext == ".cxx") || (ext == ".c"));
@@ -88,6 +134,243 @@ bool has_coverage_output(const string_list_t& args) {
   return false;
 }
 
+bool is_preprocessor_arg_plus_value(const std::string& arg) {
+  // Is this a preprocessor argument that is followed by a value (e.g. a file path)?
+  static const std::set<std::string> preprocessor_args = {"-D",
+                                                          "-U",
+                                                          "-include",
+                                                          "-imacros",
+                                                          "-isystem",
+                                                          "-iquote",
+                                                          "-idirafter",
+                                                          "-iprefix",
+                                                          "-iwithprefix",
+                                                          "-iwithprefixbefore",
+                                                          "-isysroot",
+                                                          "-imultilib"};
+  return preprocessor_args.find(arg) != preprocessor_args.end();
+}
+
+bool can_offload_arg(const std::string& arg) {
+  // Arguments that refer to local files (other than the source file) or that produce extra output
+  // files make the compilation depend on the local machine.
+  for (const auto& prefix : {"-B",
+                             "-M",
+                             "-Wp,",
+                             "-Xpreprocessor",
+                             "-fplugin",
+                             "-fprofile",
+                             "-save-temps",
+                             "-specs",
+                             "-wrapper",
+                             "--coverage"}) {
+    if (arg.compare(0, std::char_traits<char>::length(prefix), prefix) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool is_debug_line_info_required(const string_list_t& args) {
+  return has_debug_symbols(args) && (config::accuracy() >= config::cache_accuracy_t::STRICT);
+}
+
+bool is_coverage_line_info_required(const string_list_t& args) {
+  return has_coverage_output(args) && (config::accuracy() >= config::cache_accuracy_t::DEFAULT);
+}
+
+/// @brief Parse a path prefix map option.
+/// @param arg The argument.
+/// @param[out] option The option part of the argument (e.g. "-fdebug-prefix-map=").
+/// @param[out] old_prefix The old path prefix.
+/// @param[out] new_prefix The new path prefix.
+/// @returns false if the argument is not a prefix map option.
+bool parse_prefix_map_arg(const std::string& arg,
+                          std::string& option,
+                          std::string& old_prefix,
+                          std::string& new_prefix) {
+  for (const auto& prefix_map_option : {FILE_PREFIX_MAP, DEBUG_PREFIX_MAP, PROFILE_PREFIX_MAP}) {
+    if (arg.compare(0, prefix_map_option.size(), prefix_map_option) == 0) {
+      const auto separator_pos = arg.find('=', prefix_map_option.size());
+      if (separator_pos == std::string::npos) {
+        return false;
+      }
+      option = prefix_map_option;
+      old_prefix = arg.substr(option.size(), separator_pos - option.size());
+      new_prefix = arg.substr(separator_pos + 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+/// @brief Check if a prefix map option affects the line information that we need to preserve.
+bool does_prefix_map_affect_line_info(const std::string& option, const string_list_t& args) {
+  // Note: With recent GCC versions -ffile-prefix-map also implies -fprofile-prefix-map.
+  return (is_debug_line_info_required(args) &&
+          (option == FILE_PREFIX_MAP || option == DEBUG_PREFIX_MAP)) ||
+         (is_coverage_line_info_required(args) &&
+          (option == FILE_PREFIX_MAP || option == PROFILE_PREFIX_MAP));
+}
+
+/// @brief Check if a prefix map option is applied to all the line information that we need to
+/// preserve.
+///
+/// If so, we can apply the same mapping to the preprocessed source before hashing it, and the
+/// result is consistent with the compiled output.
+bool is_prefix_map_applied_to_line_info(const std::string& option, const string_list_t& args) {
+  const auto debug = is_debug_line_info_required(args);
+  const auto coverage = is_coverage_line_info_required(args);
+  if (!debug && !coverage) {
+    return false;
+  }
+  if (debug && option != FILE_PREFIX_MAP && option != DEBUG_PREFIX_MAP) {
+    return false;
+  }
+  // Older GCC versions do not apply -ffile-prefix-map to coverage data.
+  return !coverage || option == PROFILE_PREFIX_MAP;
+}
+
+prefix_map_list_t get_line_info_prefix_maps(const string_list_t& args) {
+  prefix_map_list_t prefix_maps;
+  for (const auto& arg : args) {
+    std::string option;
+    std::string old_prefix;
+    std::string new_prefix;
+    if (parse_prefix_map_arg(arg, option, old_prefix, new_prefix) &&
+        is_prefix_map_applied_to_line_info(option, args)) {
+      prefix_maps.emplace_back(old_prefix, new_prefix);
+    }
+  }
+  return prefix_maps;
+}
+
+bool is_arg_plus_option_value(const std::string& arg) {
+  // Is this an argument that is followed by a value that must be passed on verbatim (i.e. the value
+  // must not be interpreted as a compiler flag)?
+  static const std::set<std::string> value_args = {"--param",
+                                                   "-arch",
+                                                   "-aux-info",
+                                                   "-idirafter",
+                                                   "-imacros",
+                                                   "-include",
+                                                   "-iprefix",
+                                                   "-iquote",
+                                                   "-isysroot",
+                                                   "-isystem",
+                                                   "-mllvm",
+                                                   "-target",
+                                                   "-x",
+                                                   "-Xassembler",
+                                                   "-Xclang",
+                                                   "-Xlinker",
+                                                   "-Xpreprocessor"};
+  return value_args.find(arg) != value_args.end();
+}
+
+/// @brief Normalize equivalent spellings of a compiler flag.
+std::string normalize_flag_spelling(const std::string& arg) {
+  static const std::map<std::string, std::string> aliases = {
+      {"-O", "-O1"},
+      {"-W", "-Wextra"},
+      {"-std=c++03", "-std=c++98"},
+      {"-std=c++0x", "-std=c++11"},
+      {"-std=c++1y", "-std=c++14"},
+      {"-std=c++1z", "-std=c++17"},
+      {"-std=c++2a", "-std=c++20"},
+      {"-std=c1x", "-std=c11"},
+      {"-std=c9x", "-std=c99"},
+      {"-std=gnu++03", "-std=gnu++98"},
+      {"-std=gnu++0x", "-std=gnu++11"},
+      {"-std=gnu++1y", "-std=gnu++14"},
+      {"-std=gnu++1z", "-std=gnu++17"},
+      {"-std=gnu++2a", "-std=gnu++20"},
+      {"-std=gnu1x", "-std=gnu11"},
+      {"-std=gnu9x", "-std=gnu99"},
+      {"-std=iso9899:1999", "-std=c99"},
+      {"-std=iso9899:2011", "-std=c11"}};
+  const auto normalized = (arg.compare(0, 6, "--std=") == 0) ? arg.substr(1) : arg;
+  const auto it = aliases.find(normalized);
+  return (it != aliases.end()) ? it->second : normalized;
+}
+
+/// @brief Get the "last wins" key of a compiler flag.
+///
+/// Flags that have the same key override each other, so that only the last one of them has any
+/// effect (e.g. -O1 and -O2, or -fexceptions and -fno-exceptions).
+/// @param arg The (normalized) compiler flag.
+/// @returns the key of the flag, or an empty string if the flag does not override other flags.
+std::string get_last_wins_key(const std::string& arg) {
+  // Options on the form -foo=value, where the last value wins.
+  static const std::vector<std::string> last_wins_value_args = {"-std=",
+                                                                "-fexcess-precision=",
+                                                                "-ffp-contract=",
+                                                                "-fvisibility=",
+                                                                "-ftls-model=",
+                                                                "-mabi=",
+                                                                "-march=",
+                                                                "-mcpu=",
+                                                                "-mfloat-abi=",
+                                                                "-mfpu=",
+                                                                "-mtune="};
+
+  // Optimization levels and debug levels. Note: A bare -g keeps the current debug level (if any),
+  // so it is not part of the -g group (e.g. -g3 -g is level 3).
+  if (arg.compare(0, 2, "-O") == 0) {
+    return "-O";
+  }
+  if (arg == "-g0" || arg == "-g1" || arg == "-g2" || arg == "-g3") {
+    return "-g";
+  }
+
+  for (const auto& prefix : last_wins_value_args) {
+    if (arg.compare(0, prefix.size(), prefix) == 0) {
+      return prefix;
+    }
+  }
+
+  // Boolean flags on the form -ffoo/-fno-foo, -mfoo/-mno-foo and -Wfoo/-Wno-foo. Flags with values
+  // (e.g. -fsanitize=address) may accumulate, so we only treat identical flags as overriding each
+  // other (except for warnings, which are pure last wins flags).
+  const auto prefix = arg.substr(0, 2);
+  if ((arg.size() > 2U) && (prefix == "-f" || prefix == "-m" || prefix == "-W") &&
+      (arg.find(',') == std::string::npos)) {
+    if ((prefix != "-W") && (arg.find('=') != std::string::npos)) {
+      return std::string();
+    }
+    auto name = arg.substr(2);
+    if (name.compare(0, 3, "no-") == 0) {
+      name = name.substr(3);
+    }
+    // Warning levels (e.g. -Wformat=2 and -Wformat) override each other, but -Werror=foo only
+    // overrides -Wno-error=foo.
+    if ((prefix == "-W") && (name.compare(0, 6, "error=") != 0)) {
+      name = name.substr(0, name.find('='));
+    }
+    return prefix + name;
+  }
+
+  return std::string();
+}
+
+/// @brief Get the base name of a warning flag (e.g. "format" for -Wformat=2 or -Wno-format).
+std::string get_warning_base_name(const std::string& arg) {
+  auto name = arg.substr(2);
+  if (name.compare(0, 3, "no-") == 0) {
+    name = name.substr(3);
+  }
+  return name.substr(0, name.find('='));
+}
+
+/// @brief Check if this is a warning flag that can be reordered freely.
+///
+/// Flags that enable warnings (e.g. -Wall, -Wshadow or -Werror=format) commute with each other,
+/// whereas flags that disable warnings may interact with preceding group flags.
+bool is_order_independent_flag(const std::string& arg) {
+  return (arg.size() > 2U) && (arg.compare(0, 2, "-W") == 0) &&
+         (arg.compare(0, 5, "-Wno-") != 0) && (arg.find(',') == std::string::npos);
+}
+
 string_list_t make_preprocessor_cmd(const string_list_t& args,
                                     const std::string& preprocessed_file,
                                     bool use_direct_mode) {
@@ -110,11 +393,8 @@ string_list_t make_preprocessor_cmd(const string_list_t& args,
   }
 
   // Should we inhibit line info in the preprocessed output?
-  const bool debug_symbols_required =
-      has_debug_symbols(args) && (config::accuracy() >= config::cache_accuracy_t::STRICT);
-  const bool coverage_symbols_required =
-      has_coverage_output(args) && (config::accuracy() >= config::cache_accuracy_t::DEFAULT);
-  const bool inhibit_line_info = !(debug_symbols_required || coverage_symbols_required);
+  const bool inhibit_line_info =
+      !(is_debug_line_info_required(args) || is_coverage_line_info_required(args));
 
   // Append the required arguments for producing preprocessed output.
   preprocess_args += std::string("-E");
@@ -183,6 +463,53 @@ bool is_file_identical_to(const std::string& path,
 
 }  // namespace
 
+string_list_t gcc_wrapper_t::canonicalize_flags(const string_list_t& args) {
+  // Split the arguments into flags (a flag is either a single argument or an argument pair).
+  std::vector<string_list_t> flags;
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (is_arg_plus_option_value(args[i]) && (i + 1 < args.size())) {
+      flags.emplace_back(string_list_t{args[i], args[i + 1]});
+      ++i;
+    } else {
+      flags.emplace_back(string_list_t{normalize_flag_spelling(args[i])});
+    }
+  }
+
+  // Drop flags that are overridden by later flags.
+  std::set<std::string> seen_keys;
+  std::vector<string_list_t> kept_flags;
+  for (auto it = flags.rbegin(); it != flags.rend(); ++it) {
+    const auto key = (it->size() == 1U) ? get_last_wins_key((*it)[0]) : std::string();
+    if (key.empty() || seen_keys.insert(key).second) {
+      kept_flags.insert(kept_flags.begin(), *it);
+    }
+  }
+
+  // Move the optimization level first.
+  std::stable_partition(kept_flags.begin(), kept_flags.end(), [](const string_list_t& flag) {
+    return (flag.size() == 1U) && (flag[0].compare(0, 2, "-O") == 0);
+  });
+
+  // Sort runs of order independent flags by their base names. Flags that share a base name (e.g.
+  // -Werror and -Werror=format) may interact, so they keep their relative order.
+  const auto is_sortable = [](const string_list_t& flag) {
+    return (flag.size() == 1U) && is_order_independent_flag(flag[0]);
+  };
+  for (auto it = kept_flags.begin(); it != kept_flags.end();) {
+    const auto run_end = std::find_if_not(it, kept_flags.end(), is_sortable);
+    std::stable_sort(it, run_end, [](const string_list_t& a, const string_list_t& b) {
+      return get_warning_base_name(a[0]) < get_warning_base_name(b[0]);
+    });
+    it = (run_end == kept_flags.end()) ? run_end : run_end + 1;
+  }
+
+  string_list_t result;
+  for (const auto& flag : kept_flags) {
+    result += flag;
+  }
+  return result;
+}
+
 gcc_wrapper_t::gcc_wrapper_t(const file::exe_path_t& exe_path, const string_list_t& args)
     : program_wrapper_t(exe_path, args) {
 }
@@ -346,9 +673,19 @@ std::map<std::string, expected_file_t> gcc_wrapper_t::get_build_files() {
 }
 
 std::string gcc_wrapper_t::get_program_id() {
-  // TODO(m): Add things like executable file size too.
+  // If the compiler driver and backend have build IDs (which is usually the case for ELF binaries),
+  // use them to identify the compiler. This is cheaper than running the compiler and parsing the
+  // version string, and more accurate since it identifies the exact binaries.
+  const auto driver_build_id = elf::get_build_id(m_exe_path.real_path());
+  if (!driver_build_id.empty()) {
+    std::string backend_build_ids;
+    if (get_backend_build_ids(m_args[0], backend_build_ids)) {
+      return HASH_VERSION + "build-id:" + driver_build_id + backend_build_ids;
+    }
+    debug::log(debug::DEBUG) << "Unable to get the backend build IDs for " << m_args[0];
+  }
 
-  // Get the version string for the compiler.
+  // Fall back to the version string for the compiler.
   string_list_t version_args;
   version_args += m_args[0];
   version_args += "--version";
@@ -380,9 +717,19 @@ string_list_t gcc_wrapper_t::get_relevant_arguments() {
           ((first_two_chars == "-I") || (first_two_chars == "-D") || (first_two_chars == "-M") ||
            (arg.substr(0, 10) == "--sysroot=") || is_source_file(arg));
 
+      std::string prefix_map_option;
+      std::string old_prefix;
+      std::string new_prefix;
       if (is_arg_plus_file_name(arg)) {
         // We don't want to hash file paths.
         skip_next_arg = true;
+      } else if (parse_prefix_map_arg(arg, prefix_map_option, old_prefix, new_prefix) &&
+                 (is_prefix_map_applied_to_line_info(prefix_map_option, m_args) ||
+                  !does_prefix_map_affect_line_info(prefix_map_option, m_args))) {
+        // The old prefix is usually an absolute path (e.g. the source root). It is either
+        // irrelevant for the cache accuracy, or it is accounted for when the preprocessed source
+        // is normalized, so we only keep the new prefix.
+        filtered_args += prefix_map_option + new_prefix;
       } else if (!is_unwanted_arg) {
         filtered_args += arg;
       }
@@ -391,6 +738,15 @@ string_list_t gcc_wrapper_t::get_relevant_arguments() {
     }
   }
 
+  // Canonicalize the flags, so that equivalent command lines give the same hash.
+  if (config::canonical_args()) {
+    string_list_t flags;
+    for (size_t i = 1; i < filtered_args.size(); ++i) {
+      flags += filtered_args[i];
+    }
+    filtered_args = string_list_t{filtered_args[0]} + canonicalize_flags(flags);
+  }
+
   debug::log(debug::DEBUG) << "Filtered arguments: " << filtered_args.join(" ", true);
 
   return filtered_args;
@@ -451,11 +807,105 @@ std::string gcc_wrapper_t::preprocess_source() {
     m_implicit_input_files = get_include_files(result.std_err);
   }
 
-  // Read and return the preprocessed file.
-  return file::read(preprocessed_file.path());
+  // Read the preprocessed file.
+  auto preprocessed_source = file::read(preprocessed_file.path());
+
+  // If we had to keep the line information, normalize it so that the hash only depends on the line
+  // information that ends up in the compiled output. Path prefix maps are applied the same way as
+  // the compiler applies them, and in the DEFAULT accuracy mode whitespace is also collapsed.
+  if (is_debug_line_info_required(m_args) || is_coverage_line_info_required(m_args)) {
+    const auto collapse_whitespace = (config::accuracy() < config::cache_accuracy_t::STRICT);
+    return normalize_preprocessed_source(
+        preprocessed_source, get_line_info_prefix_maps(m_args), collapse_whitespace);
+  }
+
+  // Keep the preprocessed source for offloading (it is then compiled as-is by the worker).
+  if (!config::offload().empty()) {
+    m_offload_source = preprocessed_source;
+  }
+
+  return preprocessed_source;
 }
 
 string_list_t gcc_wrapper_t::get_implicit_input_files() {
   return m_implicit_input_files;
 }
+
+bool gcc_wrapper_t::get_offload_job(offload::job_t& job) {
+  // The preprocessed source has no line information, so we can not offload commands that produce
+  // debug or coverage information (it would refer to the preprocessed file rather than the
+  // original source files).
+  if (m_offload_source.empty() || has_debug_symbols(m_args) || has_coverage_output(m_args)) {
+    return false;
+  }
+
+  // The worker runs the compiler by name (it is resolved in its PATH).
+  job.command += file::get_file_part(m_args[0]);
+  const auto is_cxx_compiler = (m_args[0].find("++") != std::string::npos);
+
+  // Keep the arguments that affect the compilation of the preprocessed source.
+  std::string source_file;
+  std::string object_file;
+  std::string language;
+  for (size_t i = 1U; i < m_args.size(); ++i) {
+    const auto& arg = m_args[i];
+    const auto has_value = (i + 1U < m_args.size());
+    if (!can_offload_arg(arg)) {
+      debug::log(debug::DEBUG) << "Not offloading the command: Unsupported argument " << arg;
+      return false;
+    } else if (arg == "-o" && has_value) {
+      object_file = m_args[++i];
+    } else if (arg == "-x" && has_value) {
+      language = m_args[++i];
+    } else if (arg.substr(0, 2) == "-x") {
+      language = arg.substr(2);
+    } else if ((is_arg_plus_file_name(arg) || is_preprocessor_arg_plus_value(arg)) && has_value) {
+      ++i;
+    } else if (is_source_file(arg)) {
+      if (!source_file.empty()) {
+        return false;
+      }
+      source_file = arg;
+    } else {
+      const auto first_two_chars = arg.substr(0, 2);
+      const auto is_preprocessor_arg = (first_two_chars == "-I") || (first_two_chars == "-D") ||
+                                       (first_two_chars == "-U") || (first_two_chars == "-i") ||
+                                       (arg.substr(0, 10) == "--sysroot=");
+      if (arg != "-c" && !is_preprocessor_arg) {
+        // The worker rejects any job with flags that it does not consider safe.
+        if (!offload::is_safe_arg(arg)) {
+          debug::log(debug::DEBUG) << "Not offloading the command: Unsupported argument " << arg;
+          return false;
+        }
+        job.command += arg;
+      }
+    }
+  }
+  if (source_file.empty() || object_file.empty()) {
+    return false;
+  }
+
+  // Select the file extension for preprocessed C or C++ source.
+  bool is_cxx;
+  if (language == "c") {
+    is_cxx = false;
+  } else if (language == "c++") {
+    is_cxx = true;
+  } else if (language.empty()) {
+    is_cxx = is_cxx_compiler || (lower_case(file::get_extension(source_file)) != ".c");
+  } else {
+    return false;
+  }
+
+  // Note: Diagnostic messages will refer to the source file name.
+  job.source_name = file::change_extension(file::get_file_part(source_file), is_cxx ? ".ii" : ".i");
+  job.source = m_offload_source;
+  const auto object_name = file::get_file_part(object_file);
+  job.build_files["object"] = (object_name != job.source_name) ? object_name : "object.o";
+  job.command += std::string("-c");
+  job.command += job.source_name;
+  job.command += std::string("-o");
+  job.command += job.build_files["object"];
+  return true;
+}
 }  // namespace bcache
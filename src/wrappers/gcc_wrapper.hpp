@@ -30,6 +30,17 @@ public:
 
   bool can_handle_command() override;
 
+  /// @brief Canonicalize compiler flags.
+  ///
+  /// Equivalent spellings are normalized, flags that are overridden by later flags are dropped, the
+  /// optimization level is moved first (it is order independent), and runs of order independent
+  /// warning flags are sorted (flags that share a base name, e.g. -Wformat=2 and -Wformat, are
+  /// never reordered). Other flags, including order sensitive flags such as -I and -l, are kept in
+  /// their original order.
+  /// @param args The compiler flags (not including the program name).
+  /// @returns the canonicalized flags.
+  static string_list_t canonicalize_flags(const string_list_t& args);
+
 protected:
   string_list_t get_capabilities() override;
   std::map<std::string, expected_file_t> get_build_files() override;
@@ -39,6 +50,7 @@ protected:
   string_list_t get_input_files() override;
   std::string preprocess_source() override;
   string_list_t get_implicit_input_files() override;
+  bool get_offload_job(offload::job_t& job) override;
 
 private:
   void resolve_args() override;
@@ -47,6 +59,7 @@ private:
   virtual string_list_t get_include_files(const std::string& std_err) const;
 
   string_list_t m_implicit_input_files;
+  std::string m_offload_source;
 };
 }  // namespace bcache
 #endif  // BUILDCACHE_GCC_WRAPPER_HPP_
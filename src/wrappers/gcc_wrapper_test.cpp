@@ -0,0 +1,99 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#include <wrappers/gcc_wrapper.hpp>
+
+#include <doctest/doctest.h>
+
+// Workaround for macOS build errors.
+// See: https://github.com/onqtam/doctest/issues/126
+#include <iostream>
+
+using namespace bcache;
+
+namespace {
+std::string canonicalize(const string_list_t& args) {
+  return gcc_wrapper_t::canonicalize_flags(args).join(" ");
+}
+}  // namespace
+
+TEST_CASE("gcc_wrapper: Canonicalize flags") {
+  SUBCASE("Equivalent spellings are normalized") {
+    CHECK_EQ(canonicalize({"--std=gnu++11"}), "-std=gnu++11");
+    CHECK_EQ(canonicalize({"-std=c9x"}), "-std=c99");
+  }
+
+  SUBCASE("Overridden flags are dropped") {
+    CHECK_EQ(canonicalize({"-O0", "-c", "-O2"}), "-O2 -c");
+    CHECK_EQ(canonicalize({"-fexceptions", "-fno-exceptions"}), "-fno-exceptions");
+    CHECK_EQ(canonicalize({"-std=c++11", "-std=c++14"}), "-std=c++14");
+    CHECK_EQ(canonicalize({"-Wshadow", "-Wno-shadow"}), "-Wno-shadow");
+  }
+
+  SUBCASE("Accumulating flags are kept") {
+    CHECK_EQ(canonicalize({"-fsanitize=address", "-fsanitize=undefined"}),
+             "-fsanitize=address -fsanitize=undefined");
+    CHECK_EQ(canonicalize({"-Werror=format", "-Werror=shadow"}), "-Werror=format -Werror=shadow");
+  }
+
+  SUBCASE("Warning levels override each other") {
+    CHECK_EQ(canonicalize({"-Wformat=2", "-Wformat"}), "-Wformat");
+    CHECK_EQ(canonicalize({"-Wformat", "-Wformat=2"}), "-Wformat=2");
+    CHECK_EQ(canonicalize({"-Wstrict-overflow=1", "-Wall", "-Wstrict-overflow=3"}),
+             "-Wall -Wstrict-overflow=3");
+    CHECK_EQ(canonicalize({"-Wimplicit-fallthrough=5", "-Wno-implicit-fallthrough"}),
+             "-Wno-implicit-fallthrough");
+    CHECK_EQ(canonicalize({"-Werror=format", "-Wno-error=format"}), "-Wno-error=format");
+  }
+
+  SUBCASE("Order independent warnings are sorted") {
+    CHECK_EQ(canonicalize({"-Wshadow", "-Wall", "-Wextra"}), "-Wall -Wextra -Wshadow");
+    CHECK_EQ(canonicalize({"-Wextra", "-Wall"}), canonicalize({"-Wall", "-Wextra"}));
+
+    // -Wno-* flags break the runs, since they may interact with preceding group flags.
+    CHECK_EQ(canonicalize({"-Wextra", "-Wall", "-Wno-unused", "-Wshadow", "-Wconversion"}),
+             "-Wall -Wextra -Wno-unused -Wconversion -Wshadow");
+  }
+
+  SUBCASE("Flags that share a base name are never reordered") {
+    CHECK_EQ(canonicalize({"-Werror=format", "-Werror"}), "-Werror=format -Werror");
+    CHECK_EQ(canonicalize({"-Werror", "-Werror=format"}), "-Werror -Werror=format");
+    CHECK_EQ(canonicalize({"-Wformat=2", "-Wall", "-Wformat"}), "-Wall -Wformat");
+  }
+
+  SUBCASE("Debug levels") {
+    CHECK_EQ(canonicalize({"-g1", "-g3"}), "-g3");
+    CHECK_EQ(canonicalize({"-g"}), "-g");
+
+    // A bare -g keeps the preceding debug level, so it must not be treated as -g2.
+    CHECK_EQ(canonicalize({"-g3", "-g"}), "-g3 -g");
+    CHECK_EQ(canonicalize({"-g1", "-g"}), "-g1 -g");
+    CHECK_NE(canonicalize({"-g3", "-g"}), canonicalize({"-g2"}));
+    CHECK_NE(canonicalize({"-g1", "-g"}), canonicalize({"-g2"}));
+    CHECK_EQ(canonicalize({"-g3", "-g", "-g1"}), "-g -g1");
+  }
+
+  SUBCASE("The optimization level is moved first") {
+    CHECK_EQ(canonicalize({"-c", "-fPIC", "-O2"}), "-O2 -c -fPIC");
+  }
+
+  SUBCASE("Order sensitive flags keep their order") {
+    CHECK_EQ(canonicalize({"-Ib", "-Ia", "-c"}), "-Ib -Ia -c");
+    CHECK_EQ(canonicalize({"-include", "b.h", "-include", "a.h"}), "-include b.h -include a.h");
+  }
+}
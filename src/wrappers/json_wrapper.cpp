@@ -0,0 +1,505 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#include <wrappers/json_wrapper.hpp>
+
+#include <base/debug_utils.hpp>
+#include <base/env_utils.hpp>
+#include <base/file_utils.hpp>
+#include <base/hasher.hpp>
+#include <base/unicode_utils.hpp>
+#include <cache/data_store.hpp>
+#include <sys/sys_utils.hpp>
+
+#include <cjson/cJSON.h>
+
+#include <algorithm>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace bcache {
+namespace {
+// Tick this to a new number if the format of the program ID has changed in a non-backwards-
+// compatible way.
+const std::string HASH_VERSION = "1";
+
+// The data store that remembers which specifications do not match which programs.
+const std::string NO_MATCH_CACHE_NAME = "json_wrapper";
+
+// How long a "no match" result is remembered. The key changes whenever the specification file
+// changes, so this only limits how long stale items are kept around.
+const time::seconds_t NO_MATCH_LIFE_TIME = 3600 * 24 * 7;  // One week.
+
+// A selector picks zero or more values (e.g. file paths) from the command line arguments.
+struct selector_t {
+  enum class kind_t { ARG_REGEX, ARG_AFTER, POSITION, EXTENSION };
+
+  kind_t kind = kind_t::ARG_REGEX;
+  std::regex regex;        // For ARG_REGEX.
+  std::string option;      // For ARG_AFTER.
+  int position = 0;        // For POSITION.
+  string_list_t extensions;  // For EXTENSION (lower case, including the leading period).
+
+  std::string format;    // Optional output format (e.g. "{}/{input.stem}.pb.cc").
+  std::string id;        // Only used for output files.
+  bool required = true;  // Only used for output files.
+};
+
+// A small RAII helper for cJSON documents.
+class json_doc_t {
+public:
+  explicit json_doc_t(const std::string& data) : m_root(cJSON_Parse(data.c_str())) {
+    if (m_root == nullptr) {
+      throw std::runtime_error("Invalid JSON data.");
+    }
+  }
+
+  ~json_doc_t() {
+    cJSON_Delete(m_root);
+  }
+
+  const cJSON* root() const {
+    return m_root;
+  }
+
+private:
+  cJSON* m_root;
+};
+
+std::string get_string(const cJSON* node, const std::string& what) {
+  if (cJSON_IsString(node) == 0 || node->valuestring == nullptr) {
+    throw std::runtime_error("Expected a string for \"" + what + "\".");
+  }
+  return std::string(node->valuestring);
+}
+
+string_list_t get_string_list(const cJSON* node, const std::string& what) {
+  string_list_t result;
+  if (node == nullptr) {
+    return result;
+  }
+  if (cJSON_IsArray(node) == 0) {
+    throw std::runtime_error("Expected an array of strings for \"" + what + "\".");
+  }
+  const cJSON* item;
+  cJSON_ArrayForEach(item, node) {
+    result += get_string(item, what);
+  }
+  return result;
+}
+
+selector_t parse_selector(const cJSON* node, const std::string& what) {
+  if (cJSON_IsObject(node) == 0) {
+    throw std::runtime_error("Expected an object for \"" + what + "\".");
+  }
+
+  selector_t selector;
+  int num_kinds = 0;
+  if (const auto* arg_regex = cJSON_GetObjectItemCaseSensitive(node, "arg_regex")) {
+    selector.kind = selector_t::kind_t::ARG_REGEX;
+    selector.regex = std::regex(get_string(arg_regex, what + ".arg_regex"));
+    ++num_kinds;
+  }
+  if (const auto* arg_after = cJSON_GetObjectItemCaseSensitive(node, "arg_after")) {
+    selector.kind = selector_t::kind_t::ARG_AFTER;
+    selector.option = get_string(arg_after, what + ".arg_after");
+    ++num_kinds;
+  }
+  if (const auto* position = cJSON_GetObjectItemCaseSensitive(node, "position")) {
+    if (cJSON_IsNumber(position) == 0) {
+      throw std::runtime_error("Expected a number for \"" + what + ".position\".");
+    }
+    selector.kind = selector_t::kind_t::POSITION;
+    selector.position = position->valueint;
+    ++num_kinds;
+  }
+  if (const auto* extensions = cJSON_GetObjectItemCaseSensitive(node, "extension")) {
+    selector.kind = selector_t::kind_t::EXTENSION;
+    for (const auto& ext : get_string_list(extensions, what + ".extension")) {
+      selector.extensions += lower_case(ext);
+    }
+    ++num_kinds;
+  }
+  if (num_kinds != 1) {
+    throw std::runtime_error("Expected exactly one of arg_regex, arg_after, position or extension "
+                             "for \"" +
+                             what + "\".");
+  }
+
+  if (const auto* format = cJSON_GetObjectItemCaseSensitive(node, "format")) {
+    selector.format = get_string(format, what + ".format");
+  }
+  if (const auto* id = cJSON_GetObjectItemCaseSensitive(node, "id")) {
+    selector.id = get_string(id, what + ".id");
+  }
+  if (const auto* required = cJSON_GetObjectItemCaseSensitive(node, "required")) {
+    if (cJSON_IsBool(required) == 0) {
+      throw std::runtime_error("Expected a boolean for \"" + what + ".required\".");
+    }
+    selector.required = (cJSON_IsTrue(required) != 0);
+  }
+  return selector;
+}
+
+std::vector<selector_t> parse_selectors(const cJSON* node, const std::string& what) {
+  std::vector<selector_t> result;
+  if (node == nullptr) {
+    return result;
+  }
+  if (cJSON_IsArray(node) == 0) {
+    throw std::runtime_error("Expected an array for \"" + what + "\".");
+  }
+  const cJSON* item;
+  cJSON_ArrayForEach(item, node) {
+    result.emplace_back(parse_selector(item, what));
+  }
+  return result;
+}
+
+/// @brief Get the data store key for the result of matching a specification against a program.
+/// @param spec_path The path to the specification file.
+/// @param program_exe The name of the program (excluding the file extension).
+/// @returns a data store key that changes whenever the specification file changes.
+std::string make_no_match_key(const std::string& spec_path, const std::string& program_exe) {
+  const auto stat = file::get_file_stat(spec_path);
+  std::ostringstream ss;
+  ss << ":" << stat.size() << ":" << stat.modify_time_ns() << ":" << stat.inode();
+  hasher_t hasher;
+  hasher.update(spec_path);
+  hasher.inject_separator();
+  hasher.update(ss.str());
+  hasher.inject_separator();
+  hasher.update(program_exe);
+  return hasher.final().as_string();
+}
+
+void replace_all(std::string& str, const std::string& from, const std::string& to) {
+  for (auto pos = str.find(from); pos != std::string::npos; pos = str.find(from, pos + to.size())) {
+    str.replace(pos, from.size(), to);
+  }
+}
+}  // namespace
+
+// The compiled form of a JSON wrapper specification.
+struct json_wrapper_t::spec_t {
+  string_list_t capabilities;
+  std::string program_id_kind;  // "", "path" or "run".
+  string_list_t program_id_args;
+  string_list_t options_with_value;
+  std::vector<std::regex> ignored_args;
+  string_list_t env_vars;
+  std::vector<selector_t> inputs;
+  std::vector<selector_t> implicit_inputs;
+  std::vector<selector_t> outputs;
+};
+
+json_wrapper_t::json_wrapper_t(const file::exe_path_t& exe_path,
+                               const string_list_t& args,
+                               const std::string& spec_path)
+    : program_wrapper_t(exe_path, args), m_spec_path(spec_path) {
+}
+
+json_wrapper_t::~json_wrapper_t() = default;
+
+bool json_wrapper_t::can_handle_command() {
+  // Every specification is tried for every command, and most of them do not match. Parsing the
+  // specification and compiling its match regex is slow, so we remember the ones that do not match
+  // this program.
+  const auto program_exe = file::get_file_part(m_exe_path.real_path(), false);
+  data_store_t store(NO_MATCH_CACHE_NAME);
+  std::string no_match_key;
+  try {
+    no_match_key = make_no_match_key(m_spec_path, program_exe);
+    if (store.get_item(no_match_key).is_valid()) {
+      return false;
+    }
+  } catch (const std::exception& e) {
+    debug::log(debug::DEBUG) << "Unable to check " << m_spec_path << ": " << e.what();
+    return false;
+  }
+  const auto remember_no_match = [&store, &no_match_key]() {
+    store.store_item(no_match_key, std::string(), NO_MATCH_LIFE_TIME);
+  };
+
+  // First check: regex match against the program name. We do this before compiling the rest of the
+  // specification, since most specifications will not match.
+  std::unique_ptr<json_doc_t> doc;
+  try {
+    doc.reset(new json_doc_t(file::read(m_spec_path)));
+    const auto match =
+        get_string(cJSON_GetObjectItemCaseSensitive(doc->root(), "match"), "match");
+    if (!std::regex_match(program_exe, std::regex(match))) {
+      remember_no_match();
+      return false;
+    }
+  } catch (const std::exception& e) {
+    // Other JSON files (e.g. configuration files) may live next to the wrappers, so this is not
+    // necessarily an error.
+    debug::log(debug::DEBUG) << "Not a valid JSON wrapper " << m_spec_path << ": " << e.what();
+    remember_no_match();
+    return false;
+  }
+
+  try {
+    const auto* root = doc->root();
+
+    // Compile the specification.
+    std::unique_ptr<spec_t> spec(new spec_t());
+    spec->capabilities =
+        get_string_list(cJSON_GetObjectItemCaseSensitive(root, "capabilities"), "capabilities");
+
+    if (const auto* program_id = cJSON_GetObjectItemCaseSensitive(root, "program_id")) {
+      if (cJSON_IsString(program_id) != 0 && get_string(program_id, "program_id") == "path") {
+        spec->program_id_kind = "path";
+      } else if (cJSON_IsObject(program_id) != 0) {
+        spec->program_id_kind = "run";
+        spec->program_id_args = get_string_list(
+            cJSON_GetObjectItemCaseSensitive(program_id, "run"), "program_id.run");
+      } else {
+        throw std::runtime_error("Expected \"path\" or {\"run\": [...]} for \"program_id\".");
+      }
+    }
+
+    if (const auto* arguments = cJSON_GetObjectItemCaseSensitive(root, "arguments")) {
+      spec->options_with_value =
+          get_string_list(cJSON_GetObjectItemCaseSensitive(arguments, "options_with_value"),
+                          "arguments.options_with_value");
+      for (const auto& expr : get_string_list(
+               cJSON_GetObjectItemCaseSensitive(arguments, "ignore"), "arguments.ignore")) {
+        spec->ignored_args.emplace_back(std::regex(expr));
+      }
+    }
+
+    spec->env_vars =
+        get_string_list(cJSON_GetObjectItemCaseSensitive(root, "env_vars"), "env_vars");
+    spec->inputs = parse_selectors(cJSON_GetObjectItemCaseSensitive(root, "inputs"), "inputs");
+    spec->implicit_inputs = parse_selectors(
+        cJSON_GetObjectItemCaseSensitive(root, "implicit_inputs"), "implicit_inputs");
+    spec->outputs = parse_selectors(cJSON_GetObjectItemCaseSensitive(root, "outputs"), "outputs");
+    for (const auto& output : spec->outputs) {
+      if (output.id.empty()) {
+        throw std::runtime_error("Missing \"id\" for an output.");
+      }
+    }
+
+    m_spec = std::move(spec);
+    return true;
+  } catch (const std::exception& e) {
+    // A broken specification for this program can not be trusted to handle this command.
+    debug::log(debug::ERROR) << "Invalid JSON wrapper " << m_spec_path << ": " << e.what();
+  }
+  return false;
+}
+
+namespace {
+// Get the positional (non-option) arguments.
+string_list_t get_positional_args(const string_list_t& args,
+                                  const string_list_t& options_with_value) {
+  string_list_t result;
+  for (size_t i = 1; i < args.size(); ++i) {
+    const auto& arg = args[i];
+    if (arg.size() > 1U && arg[0] == '-') {
+      if (std::find(options_with_value.begin(), options_with_value.end(), arg) !=
+          options_with_value.end()) {
+        ++i;
+      }
+    } else {
+      result += arg;
+    }
+  }
+  return result;
+}
+
+string_list_t select_values(const selector_t& selector,
+                            const string_list_t& args,
+                            const string_list_t& options_with_value) {
+  string_list_t result;
+  switch (selector.kind) {
+    case selector_t::kind_t::ARG_REGEX:
+      for (size_t i = 1; i < args.size(); ++i) {
+        std::smatch match;
+        if (std::regex_match(args[i], match, selector.regex)) {
+          result += (match.size() > 1U) ? match[1].str() : match[0].str();
+        }
+      }
+      break;
+
+    case selector_t::kind_t::ARG_AFTER:
+      for (size_t i = 1; (i + 1U) < args.size(); ++i) {
+        if (args[i] == selector.option) {
+          result += args[++i];
+        }
+      }
+      break;
+
+    case selector_t::kind_t::POSITION: {
+      const auto positional = get_positional_args(args, options_with_value);
+      const auto size = static_cast<int>(positional.size());
+      const auto pos = (selector.position >= 0) ? selector.position : (size + selector.position);
+      if (pos >= 0 && pos < size) {
+        result += positional[static_cast<size_t>(pos)];
+      }
+      break;
+    }
+
+    case selector_t::kind_t::EXTENSION:
+      for (const auto& arg : get_positional_args(args, options_with_value)) {
+        const auto ext = lower_case(file::get_extension(arg));
+        if (std::find(selector.extensions.begin(), selector.extensions.end(), ext) !=
+            selector.extensions.end()) {
+          result += arg;
+        }
+      }
+      break;
+  }
+  return result;
+}
+
+// Apply the format string of a selector to a selected value. If the format string refers to the
+// input files, one result is produced per input file.
+string_list_t format_value(const std::string& format,
+                           const std::string& value,
+                           const string_list_t& input_files) {
+  if (format.empty()) {
+    return string_list_t{value};
+  }
+
+  string_list_t result;
+  auto str = format;
+  replace_all(str, "{}", value);
+  if (str.find("{input") == std::string::npos) {
+    result += str;
+  } else {
+    for (const auto& input : input_files) {
+      auto dir = file::get_dir_part(input);
+      auto item = str;
+      replace_all(item, "{input.dir}", dir.empty() ? std::string(".") : dir);
+      replace_all(item, "{input.name}", file::get_file_part(input));
+      replace_all(item, "{input.stem}", file::get_file_part(input, false));
+      replace_all(item, "{input}", input);
+      result += item;
+    }
+  }
+  return result;
+}
+}  // namespace
+
+string_list_t json_wrapper_t::get_capabilities() {
+  return m_spec->capabilities;
+}
+
+std::map<std::string, expected_file_t> json_wrapper_t::get_build_files() {
+  std::map<std::string, expected_file_t> files;
+  const auto input_files = get_input_files();
+  for (const auto& output : m_spec->outputs) {
+    string_list_t paths;
+    for (const auto& value : select_values(output, m_args, m_spec->options_with_value)) {
+      paths += format_value(output.format, value, input_files);
+    }
+    if (paths.size() == 0 && output.required) {
+      throw std::runtime_error("Unable to find the output file for \"" + output.id + "\".");
+    }
+    for (size_t i = 0; i < paths.size(); ++i) {
+      const auto id = (paths.size() == 1U) ? output.id : (output.id + "_" + std::to_string(i));
+      files[id] = expected_file_t(paths[i], output.required);
+    }
+  }
+  return files;
+}
+
+std::string json_wrapper_t::get_program_id() {
+  if (m_spec->program_id_kind == "path") {
+    return HASH_VERSION + m_exe_path.real_path();
+  }
+  if (m_spec->program_id_kind == "run") {
+    string_list_t args;
+    args += m_exe_path.real_path();
+    args += m_spec->program_id_args;
+    const auto result = sys::run(args);
+    if (result.return_code != 0) {
+      throw std::runtime_error("Unable to get the program version information.");
+    }
+    return HASH_VERSION + result.std_out + result.std_err;
+  }
+  return program_wrapper_t::get_program_id();
+}
+
+string_list_t json_wrapper_t::get_relevant_arguments() {
+  // Note: The program path is excluded, since the program is identified by the program ID.
+  string_list_t filtered_args;
+  for (size_t i = 1; i < m_args.size(); ++i) {
+    const auto& arg = m_args[i];
+    const auto is_ignored =
+        std::any_of(m_spec->ignored_args.begin(),
+                    m_spec->ignored_args.end(),
+                    [&arg](const std::regex& expr) { return std::regex_search(arg, expr); });
+    if (is_ignored) {
+      // Also skip the value of the option, if any.
+      if (std::find(m_spec->options_with_value.begin(), m_spec->options_with_value.end(), arg) !=
+          m_spec->options_with_value.end()) {
+        ++i;
+      }
+    } else {
+      filtered_args += arg;
+    }
+  }
+  return filtered_args;
+}
+
+std::map<std::string, std::string> json_wrapper_t::get_relevant_env_vars() {
+  std::map<std::string, std::string> env_vars;
+  for (const auto& name : m_spec->env_vars) {
+    if (env_defined(name)) {
+      env_vars[name] = get_env(name);
+    }
+  }
+  return env_vars;
+}
+
+string_list_t json_wrapper_t::get_input_files() {
+  string_list_t files;
+  for (const auto& input : m_spec->inputs) {
+    for (const auto& value : select_values(input, m_args, m_spec->options_with_value)) {
+      files += format_value(input.format, value, string_list_t());
+    }
+  }
+  return files;
+}
+
+std::string json_wrapper_t::preprocess_source() {
+  // The "preprocessed source" is the contents of all the input files.
+  std::string result;
+  for (const auto& path : get_input_files() + get_implicit_input_files()) {
+    const auto data = file::read(path);
+    result += std::to_string(data.size()) + ":" + data;
+  }
+  return result;
+}
+
+string_list_t json_wrapper_t::get_implicit_input_files() {
+  string_list_t files;
+  for (const auto& input : m_spec->implicit_inputs) {
+    for (const auto& value : select_values(input, m_args, m_spec->options_with_value)) {
+      files += format_value(input.format, value, string_list_t());
+    }
+  }
+  return files;
+}
+}  // namespace bcache
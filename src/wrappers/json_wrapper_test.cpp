@@ -0,0 +1,160 @@
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+#include <base/file_utils.hpp>
+#include <config/configuration.hpp>
+#include <wrappers/json_wrapper.hpp>
+
+#include <doctest/doctest.h>
+
+#include <string>
+
+// Workaround for macOS build errors.
+// See: https://github.com/onqtam/doctest/issues/126
+#include <iostream>
+
+using namespace bcache;
+
+namespace {
+// Expose the wrapper methods that are normally only called by program_wrapper_t.
+class test_json_wrapper_t : public json_wrapper_t {
+public:
+  test_json_wrapper_t(const file::exe_path_t& exe_path,
+                      const string_list_t& args,
+                      const std::string& spec_path)
+      : json_wrapper_t(exe_path, args, spec_path) {
+  }
+
+  using json_wrapper_t::get_build_files;
+  using json_wrapper_t::get_implicit_input_files;
+  using json_wrapper_t::get_input_files;
+  using json_wrapper_t::get_relevant_arguments;
+  using json_wrapper_t::resolve_args;
+};
+
+const char PROTOC_SPEC[] = R"json({
+  "match": "protoc.*",
+  "arguments": {
+    "options_with_value": ["-I", "--descriptor_set_out"],
+    "ignore": ["^-I"]
+  },
+  "inputs": [{"extension": [".proto"]}],
+  "implicit_inputs": [{"arg_after": "--include"}],
+  "outputs": [
+    {"id": "cc", "arg_regex": "--cpp_out=(.*)", "format": "{}/{input.stem}.pb.cc"},
+    {"id": "desc", "arg_after": "--descriptor_set_out", "required": false},
+    {"id": "log", "position": -1, "format": "{input.dir}/{}.{input.name}", "required": false}
+  ]
+})json";
+}  // namespace
+
+TEST_CASE("json_wrapper: Selectors and format templates") {
+  const auto tmp = file::tmp_file_t(file::get_temp_dir(), "");
+  file::create_dir(tmp.path());
+  config::init(tmp.path().c_str());
+  const auto spec_path = file::append_path(tmp.path(), "protoc.json");
+  file::write(PROTOC_SPEC, spec_path);
+  const file::exe_path_t exe_path("/usr/bin/protoc", "/usr/bin/protoc", "protoc");
+
+  SUBCASE("A single input file") {
+    const string_list_t args{"protoc",
+                             "-I",
+                             "inc",
+                             "--cpp_out=gen",
+                             "--descriptor_set_out",
+                             "out.desc",
+                             "--include",
+                             "common.h",
+                             "src/a.PROTO",
+                             "build"};
+    test_json_wrapper_t wrapper(exe_path, args, spec_path);
+    REQUIRE(wrapper.can_handle_command());
+    wrapper.resolve_args();
+
+    // Values of options in options_with_value are not positional arguments.
+    CHECK_EQ(wrapper.get_input_files().join(" "), "src/a.PROTO");
+    CHECK_EQ(wrapper.get_implicit_input_files().join(" "), "common.h");
+    CHECK_EQ(wrapper.get_relevant_arguments().join(" "),
+             "--cpp_out=gen --descriptor_set_out out.desc --include common.h src/a.PROTO build");
+
+    const auto files = wrapper.get_build_files();
+    REQUIRE_EQ(files.size(), 3U);
+    CHECK_EQ(files.at("cc").path(), "gen/a.pb.cc");
+    CHECK_EQ(files.at("desc").path(), "out.desc");
+    CHECK_EQ(files.at("log").path(), "src/build.a.PROTO");
+    CHECK_FALSE(files.at("log").required());
+  }
+
+  SUBCASE("Input templates produce one file per input") {
+    const string_list_t args{"protoc", "--cpp_out=gen", "a.proto", "b.proto"};
+    test_json_wrapper_t wrapper(exe_path, args, spec_path);
+    REQUIRE(wrapper.can_handle_command());
+    wrapper.resolve_args();
+
+    CHECK_EQ(wrapper.get_input_files().join(" "), "a.proto b.proto");
+    const auto files = wrapper.get_build_files();
+    CHECK_EQ(files.at("cc_0").path(), "gen/a.pb.cc");
+    CHECK_EQ(files.at("cc_1").path(), "gen/b.pb.cc");
+    CHECK_EQ(files.count("cc"), 0U);
+  }
+
+  SUBCASE("Missing required outputs are errors") {
+    const string_list_t args{"protoc", "a.proto"};
+    test_json_wrapper_t wrapper(exe_path, args, spec_path);
+    REQUIRE(wrapper.can_handle_command());
+    wrapper.resolve_args();
+    CHECK_THROWS_AS(wrapper.get_build_files(), std::runtime_error);
+  }
+}
+
+TEST_CASE("json_wrapper: Matching specifications") {
+  const auto tmp = file::tmp_file_t(file::get_temp_dir(), "");
+  file::create_dir(tmp.path());
+  config::init(tmp.path().c_str());
+  const auto spec_path = file::append_path(tmp.path(), "spec.json");
+  const file::exe_path_t exe_path("/usr/bin/flatc", "/usr/bin/flatc", "flatc");
+  const string_list_t args{"flatc", "a.fbs"};
+
+  SUBCASE("Specifications for other programs do not match") {
+    file::write(PROTOC_SPEC, spec_path);
+    CHECK_FALSE(json_wrapper_t(exe_path, args, spec_path).can_handle_command());
+  }
+
+  SUBCASE("Other JSON files do not match") {
+    file::write("{\"compress\": true}", spec_path);
+    CHECK_FALSE(json_wrapper_t(exe_path, args, spec_path).can_handle_command());
+    file::write("not json", spec_path);
+    CHECK_FALSE(json_wrapper_t(exe_path, args, spec_path).can_handle_command());
+  }
+
+  SUBCASE("Broken selectors do not match") {
+    file::write(R"({"match": "flatc", "inputs": [{"position": 1, "extension": [".fbs"]}]})",
+                spec_path);
+    CHECK_FALSE(json_wrapper_t(exe_path, args, spec_path).can_handle_command());
+    file::write(R"({"match": "flatc", "outputs": [{"position": 1}]})", spec_path);
+    CHECK_FALSE(json_wrapper_t(exe_path, args, spec_path).can_handle_command());
+  }
+
+  SUBCASE("A remembered mismatch is forgotten when the specification changes") {
+    file::write(R"({"match": "protoc"})", spec_path);
+    CHECK_FALSE(json_wrapper_t(exe_path, args, spec_path).can_handle_command());
+    CHECK_FALSE(json_wrapper_t(exe_path, args, spec_path).can_handle_command());
+    file::write(R"({"match": "flatc"})", spec_path);
+    CHECK(json_wrapper_t(exe_path, args, spec_path).can_handle_command());
+  }
+}
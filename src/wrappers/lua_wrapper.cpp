@@ -21,6 +21,8 @@
 
 #include <base/debug_utils.hpp>
 #include <base/file_utils.hpp>
+#include <base/hasher.hpp>
+#include <cache/data_store.hpp>
 #include <config/configuration.hpp>
 #include <sys/perf_utils.hpp>
 #include <sys/sys_utils.hpp>
@@ -32,12 +34,24 @@ extern "C" {
 }
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <regex>
+#include <sstream>
 #include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 namespace bcache {
 namespace {
+// Data store name and default life time for values that are memoized by Lua scripts.
+const std::string MEMO_CACHE_NAME = "lua_memo";
+const time::seconds_t MEMO_DEFAULT_LIFE_TIME = 3600;  // One hour.
+
+// The Lua registry field that holds the path of the running script.
+const char SCRIPT_PATH_FIELD[] = "bcache.script_path";
+
 int panic_handler(lua_State* state) {
   debug::log(debug::FATAL) << "Unprotected error in call to Lua API (" << lua_tostring(state, -1)
                            << ")";
@@ -263,22 +277,120 @@ int l_log_warning(lua_State* state) {
   return 0;
 }
 
-int l_resolve_path(lua_State* state) {
-  push(state, file::resolve_path(pop_string(state)));
+/// @brief Get the data store key for a memoized value.
+///
+/// Keys are private to each script, so that two wrappers that happen to use the same key (e.g.
+/// "version") do not get each other's values.
+/// @param state The Lua state of the script.
+/// @param key The key provided by the Lua script.
+/// @param deps A list of files whose status identities should be part of the key.
+/// @returns a data store key that changes whenever any of the dependency files changes.
+std::string make_memo_key(lua_State* state, const std::string& key, const string_list_t& deps) {
+  (void)lua_getfield(state, LUA_REGISTRYINDEX, SCRIPT_PATH_FIELD);
+  const auto* script_path = lua_tostring(state, -1);
+  hasher_t hasher;
+  hasher.update(script_path != nullptr ? script_path : "");
+  lua_pop(state, 1);
+  hasher.inject_separator();
+  hasher.update(key);
+  for (const auto& dep : deps) {
+    hasher.inject_separator();
+    hasher.update(dep);
+    try {
+      const auto stat = file::get_file_stat(dep);
+      std::ostringstream ss;
+      ss << ":" << stat.size() << ":" << stat.modify_time_ns() << ":" << stat.change_time_ns()
+         << ":" << stat.inode();
+      hasher.update(ss.str());
+    } catch (const std::runtime_error&) {
+      // Missing files are part of the identity too.
+      hasher.update(":missing");
+    }
+  }
+  return hasher.final().as_string();
+}
+
+int l_memo(lua_State* state) {
+  // Get arguments (in reverse order).
+  auto ttl = MEMO_DEFAULT_LIFE_TIME;
+  if (lua_gettop(state) > 3) {
+    ttl = static_cast<time::seconds_t>(pop_int(state));
+    lua_pop(state, 1);
+  }
+  if (lua_isfunction(state, -1) == 0) {
+    throw std::runtime_error("Expected a function on the stack.");
+  }
+  lua_insert(state, 1);
+  const auto deps = pop_string_list(state);
+  const auto key = make_memo_key(state, pop_string(state), deps);
+
+  // Look up the value in the data store.
+  data_store_t store(MEMO_CACHE_NAME);
+  const auto item = store.get_item(key);
+  if (item.is_valid()) {
+    lua_pop(state, 1);
+    push(state, item.value());
+    return 1;
+  }
+
+  // We had a miss. Call the function and store the result.
+  if (lua_pcall(state, 0, 1, 0) != 0) {
+    throw std::runtime_error(pop_string(state));
+  }
+  const auto value = pop_string(state, true);
+  store.store_item(key, value, ttl);
   return 1;
 }
 
-int l_run(lua_State* state) {
+int l_memo_get(lua_State* state) {
+  data_store_t store(MEMO_CACHE_NAME);
+  const auto key = make_memo_key(state, pop_string(state), string_list_t());
+  const auto item = store.get_item(key);
+  if (item.is_valid()) {
+    push(state, item.value());
+  } else {
+    lua_pushnil(state);
+  }
+  return 1;
+}
+
+int l_memo_set(lua_State* state) {
   // Get arguments (in reverse order).
-  std::string work_dir;
-  auto quiet = true;
+  auto ttl = MEMO_DEFAULT_LIFE_TIME;
   if (lua_gettop(state) > 2) {
+    ttl = static_cast<time::seconds_t>(pop_int(state));
+    lua_pop(state, 1);
+  }
+  const auto value = pop_string(state);
+  const auto key = make_memo_key(state, pop_string(state), string_list_t());
+
+  data_store_t store(MEMO_CACHE_NAME);
+  store.store_item(key, value, ttl);
+  return 0;
+}
+
+int l_resolve_path(lua_State* state) {
+  push(state, file::resolve_path(pop_string(state)));
+  return 1;
+}
+
+/// @brief Get the optional quiet and work_dir arguments (in reverse order) of a run function.
+void pop_run_options(lua_State* state, const int first_arg, bool& quiet, std::string& work_dir) {
+  quiet = true;
+  if (lua_gettop(state) > first_arg + 1) {
     work_dir = pop_string(state);
   }
-  if (lua_gettop(state) > 1) {
+  if (lua_gettop(state) > first_arg) {
     quiet = (lua_toboolean(state, -1) != 0);
     lua_pop(state, 1);
   }
+}
+
+int l_run(lua_State* state) {
+  // Get arguments (in reverse order).
+  std::string work_dir;
+  bool quiet;
+  pop_run_options(state, 1, quiet, work_dir);
   const auto cmd = pop_string_list(state);
 
   // Call the C++ function and push the result.
@@ -286,6 +398,142 @@ int l_run(lua_State* state) {
   return 1;
 }
 
+/// @brief A handle for a command that is running in the background (see l_run_async).
+struct async_run_t {
+  std::thread thread;
+  sys::run_result_t result;
+  std::string error;
+  bool waited = false;
+};
+
+const char ASYNC_RUN_METATABLE[] = "bcache.async_run";
+
+// The maximum number of commands that run_parallel() runs at the same time.
+const std::size_t MAX_PARALLEL_RUNS = 32;
+
+int l_async_run_gc(lua_State* state) {
+  // Make sure that the background thread is finished before the handle is released.
+  auto* handle = static_cast<async_run_t*>(luaL_checkudata(state, 1, ASYNC_RUN_METATABLE));
+  if (handle->thread.joinable()) {
+    handle->thread.join();
+  }
+  handle->~async_run_t();
+  return 0;
+}
+
+int l_run_async(lua_State* state) {
+  // Get arguments (in reverse order).
+  std::string work_dir;
+  bool quiet;
+  pop_run_options(state, 1, quiet, work_dir);
+  const auto cmd = pop_string_list(state);
+
+  // Create the handle as a userdata object that is owned by the Lua state.
+  auto* handle = new (lua_newuserdata(state, sizeof(async_run_t))) async_run_t();
+  if (luaL_newmetatable(state, ASYNC_RUN_METATABLE) != 0) {
+    lua_pushcfunction(state, l_async_run_gc);
+    lua_setfield(state, -2, "__gc");
+  }
+  lua_setmetatable(state, -2);
+
+  // Start the command in a background thread.
+  auto run_cmd = [handle, cmd, quiet, work_dir]() {
+    try {
+      handle->result = sys::run(cmd, quiet, work_dir);
+    } catch (const std::exception& e) {
+      handle->error = e.what();
+    }
+  };
+  try {
+    handle->thread = std::thread(run_cmd);
+  } catch (const std::system_error& e) {
+    // Run the command in the calling thread instead (wait() then returns immediately).
+    debug::log(debug::DEBUG) << "Unable to start a command thread: " << e.what();
+    run_cmd();
+  }
+  return 1;
+}
+
+int l_wait(lua_State* state) {
+  auto* handle = static_cast<async_run_t*>(luaL_checkudata(state, 1, ASYNC_RUN_METATABLE));
+  if (handle->waited) {
+    throw std::runtime_error("The command has already been waited for.");
+  }
+  if (handle->thread.joinable()) {
+    handle->thread.join();
+  }
+  handle->waited = true;
+  if (!handle->error.empty()) {
+    throw std::runtime_error(handle->error);
+  }
+
+  push(state, handle->result);
+  return 1;
+}
+
+int l_run_parallel(lua_State* state) {
+  // Get arguments (in reverse order).
+  std::string work_dir;
+  bool quiet;
+  pop_run_options(state, 1, quiet, work_dir);
+  if (lua_istable(state, -1) == 0) {
+    throw std::runtime_error("Expected a table of commands.");
+  }
+  std::vector<string_list_t> cmds;
+  const auto num_cmds = static_cast<lua_Integer>(lua_rawlen(state, -1));
+  for (lua_Integer i = 1; i <= num_cmds; ++i) {
+    lua_rawgeti(state, -1, i);
+    cmds.emplace_back(pop_string_list(state));
+  }
+  lua_pop(state, 1);
+
+  // Run the commands concurrently. The threads mostly wait for their child processes, so we use up
+  // to MAX_PARALLEL_RUNS threads, where each thread picks the next command that has not yet been
+  // started.
+  std::vector<sys::run_result_t> results(cmds.size());
+  std::vector<std::string> errors(cmds.size());
+  std::atomic<std::size_t> next_cmd(0);
+  auto worker = [&cmds, &results, &errors, &next_cmd, quiet, &work_dir]() {
+    for (auto i = next_cmd++; i < cmds.size(); i = next_cmd++) {
+      try {
+        results[i] = sys::run(cmds[i], quiet, work_dir);
+      } catch (const std::exception& e) {
+        errors[i] = e.what();
+      }
+    }
+  };
+  const auto num_threads = std::min(MAX_PARALLEL_RUNS, cmds.size());
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < num_threads; ++i) {
+    try {
+      threads.emplace_back(worker);
+    } catch (const std::system_error& e) {
+      // The remaining commands are run by the threads that we already have.
+      debug::log(debug::DEBUG) << "Unable to start a command thread: " << e.what();
+      break;
+    }
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (const auto& error : errors) {
+    if (!error.empty()) {
+      throw std::runtime_error(error);
+    }
+  }
+
+  // Push the results as an array of tables (in the same order as the commands).
+  lua_createtable(state, static_cast<int>(results.size()), 0);
+  lua_Integer key = 1;
+  for (const auto& result : results) {
+    push(state, result);
+    lua_rawseti(state, -2, key);
+    ++key;
+  }
+  return 1;
+}
+
 int l_split_args(lua_State* state) {
   push(state, string_list_t::split_args(pop_string(state)));
   return 1;
@@ -303,9 +551,15 @@ const luaL_Reg BCACHE_LIB_FUNCS[] = {{"append_path", l_append_path},
                                      {"log_fatal", l_log_fatal},
                                      {"log_info", l_log_info},
                                      {"log_warning", l_log_warning},
+                                     {"memo", l_memo},
+                                     {"memo_get", l_memo_get},
+                                     {"memo_set", l_memo_set},
                                      {"resolve_path", l_resolve_path},
                                      {"run", l_run},
+                                     {"run_async", l_run_async},
+                                     {"run_parallel", l_run_parallel},
                                      {"split_args", l_split_args},
+                                     {"wait", l_wait},
                                      {nullptr, nullptr}};
 
 int luaopen_bcache(lua_State* state) {
@@ -391,7 +645,10 @@ std::map<std::string, expected_file_t> to_expected_files_map(
   for (const auto& file : files) {
     // Right now we simply assume that all files are required.
     // TODO(m): Make it possible to specify files as optional in Lua.
-    expected_files[file.first] = {file.second, true};
+    // A path with a trailing path separator denotes a directory output.
+    const auto& path = file.second;
+    const auto is_dir = !path.empty() && (path.back() == '/' || path.back() == '\\');
+    expected_files[file.first] = {is_dir ? path.substr(0, path.size() - 1) : path, true, is_dir};
   }
   return expected_files;
 }
@@ -490,6 +747,10 @@ void lua_wrapper_t::runner_t::setup_lua_libs_and_globals() {
     lua_rawseti(m_state, -2, static_cast<lua_Integer>(i + 1));
   }
   lua_setglobal(m_state, "ARGS");
+
+  // Remember the script path for functions that need to know which script is calling them.
+  (void)lua_pushlstring(m_state, m_script_path.c_str(), m_script_path.size());
+  lua_setfield(m_state, LUA_REGISTRYINDEX, SCRIPT_PATH_FIELD);
 }
 
 [[noreturn]] void lua_wrapper_t::runner_t::bail(const std::string& message) {
@@ -21,13 +21,21 @@
 
 #include <base/compressor.hpp>
 #include <base/debug_utils.hpp>
+#include <base/elf_utils.hpp>
+#include <base/file_utils.hpp>
+#include <base/git_index.hpp>
 #include <base/hasher.hpp>
+#include <base/serializer_utils.hpp>
+#include <base/time_macro_scanner.hpp>
 #include <cache/cache_entry.hpp>
 #include <cache/data_store.hpp>
+#include <cache/toolchain_registry.hpp>
 #include <config/configuration.hpp>
 #include <sys/perf_utils.hpp>
 #include <sys/sys_utils.hpp>
+#include <sys/tree_hash.hpp>
 
+#include <chrono>
 #include <iostream>
 #include <map>
 #include <sstream>
@@ -36,6 +44,68 @@ namespace bcache {
 namespace {
 std::string PROGRAM_ID_CACHE_NAME = "prgid";
 time::seconds_t PROGRAM_ID_CACHE_LIFE_TIME = 300;  // Five minutes.
+std::string DURATION_CACHE_NAME = "durations";
+time::seconds_t DURATION_CACHE_LIFE_TIME = 2592000;  // 30 days.
+std::string FAILURE_CACHE_NAME = "failures";
+
+// Look up a cached compilation failure, and replay it if one was found.
+bool replay_cached_failure(const std::string& hash,
+                           const std::map<std::string, expected_file_t>& expected_files,
+                           int& return_code) {
+  const auto item = data_store_t(FAILURE_CACHE_NAME).get_item(hash);
+  if (!item.is_valid()) {
+    return false;
+  }
+
+  std::string::size_type pos = 0;
+  const auto& data = item.value();
+  const auto cached_return_code = serialize::to_int(data, pos);
+  const auto std_out = serialize::to_string(data, pos);
+  const auto std_err = serialize::to_string(data, pos);
+
+  // A failed compilation does not leave any (valid) build files behind, so remove any old build
+  // files just like the program would have done.
+  for (const auto& file : expected_files) {
+    file::remove_file(file.second.path(), true);
+  }
+
+  sys::print_raw_stdout(std_out);
+  sys::print_raw_stderr(std_err);
+  return_code = cached_return_code;
+  return true;
+}
+
+// Remember a compilation failure for a short while.
+void store_failure(const std::string& hash, const sys::run_result_t& result) {
+  // Only cache failures that produced diagnostics (e.g. compilation errors). Failures without any
+  // diagnostics are more likely to be intermittent (e.g. a killed process).
+  if (result.std_err.empty()) {
+    return;
+  }
+  try {
+    const auto data = serialize::from_int(result.return_code) +
+                      serialize::from_string(result.std_out) +
+                      serialize::from_string(result.std_err);
+    data_store_t(FAILURE_CACHE_NAME).store_item(hash, data, config::failure_ttl());
+  } catch (const std::exception& e) {
+    debug::log(debug::DEBUG) << "Failed to store the failure: " << e.what();
+  }
+}
+
+// Check if any of the given files contain time macros that disqualify them from direct mode.
+bool has_disqualifying_time_macros(const string_list_t& files) {
+  if (config::accuracy() == config::cache_accuracy_t::SLOPPY) {
+    return false;
+  }
+  for (const auto& file : files) {
+    const auto data = file::read(file);
+    if (has_time_macros(data.data(), data.size())) {
+      debug::log(debug::INFO) << "Skipping direct mode entry: Found time macros in " << file;
+      return true;
+    }
+  }
+  return false;
+}
 }  // namespace
 
 program_wrapper_t::capabilities_t::capabilities_t(const string_list_t& cap_strings) {
@@ -78,81 +148,33 @@ bool program_wrapper_t::handle_command(int& return_code) {
     const auto expected_files = get_build_files();
     PERF_STOP(GET_BUILD_FILES);
 
-    // Start a hash.
-    hasher_t hasher;
-
-    // Add additional file contents to the resulting hash.
-    PERF_START(HASH_EXTRA_FILES);
-    for (const auto& extra_file : bcache::config::hash_extra_files()) {
-      hasher.update_from_file(extra_file);
-    }
-    PERF_STOP(HASH_EXTRA_FILES);
-
-    // Hash the program identification (version string or similar).
-    PERF_START(GET_PRG_ID);
-    hasher.update(get_program_id_cached());
-    PERF_STOP(GET_PRG_ID);
-
-    // Hash the (filtered) command line flags and environment variables.
-    PERF_START(FILTER_ARGS);
-    hasher.update(get_relevant_arguments());
-    hasher.update(get_relevant_env_vars());
-    PERF_STOP(FILTER_ARGS);
-
-    // This string will be non-empty if we are able to create a direct mode cache lookup hash. If we
-    // have a miss in the DM cache, this will be used for creating the DM cache entry.
-    std::string direct_hash;
-
-    if (m_active_capabilities.direct_mode()) {
-      try {
-        const auto input_files = get_input_files();
-        if (input_files.size() > 0) {
-          // The hash so far is common for direct mode and preprocessor mode. Make a copy and inject
-          // a separator sequence to ensure that there can not be any collisions between direct mode
-          // and preprocessor mode hashes.
-          hasher_t dm_hasher = hasher;
-          dm_hasher.inject_separator();
-
-          // Hash the complete command line, as we need things like defines that are usually
-          // filtered by get_relevant_arguments().
-          dm_hasher.update(m_args);
-
-          // Hash all the input files.
-          PERF_START(HASH_INPUT_FILES);
-          for (const auto& file : input_files) {
-            // Hash the complete source file path. This ensures that we get different direct mode
-            // cache entries for different source paths, which should minimize cache thrashing when
-            // different work folders are used (e.g. in a CI system with several concurrent
-            // executors).
-            dm_hasher.update(file::resolve_path(file));
-            dm_hasher.inject_separator();
-
-            // Hash the source file content.
-            // TODO(m): Check file for disqualifying content (e.g. __TIME__ in C/C++ files).
-            dm_hasher.update_from_file(file);
-          }
-          PERF_STOP(HASH_INPUT_FILES);
-          direct_hash = dm_hasher.final().as_string();
-
-          // Look up the hash in the cache.
-          if (m_cache.lookup_direct(direct_hash,
-                                    expected_files,
-                                    m_active_capabilities.hard_links(),
-                                    m_active_capabilities.create_target_dirs(),
-                                    return_code)) {
-            return true;
-          }
-        }
-      } catch (const std::runtime_error& e) {
-        // This can happen if one of the input files are missing, for instance.
-        debug::log(debug::ERROR) << "Direct mode lookup failed: " << e.what();
+    // Hash the program identification, the relevant arguments and environment variables etc.
+    std::string program_id;
+    auto hasher = hash_program_and_arguments(program_id);
+
+    // Record that the toolchain is in use (entries of unused toolchains are evicted first).
+    const auto toolchain_id = toolchain_registry_t::toolchain_id(program_id);
+    toolchain_registry_t().mark_seen(toolchain_id, m_exe_path.real_path());
+
+    // The direct hash will be non-empty if we are able to create a direct mode cache lookup hash. If
+    // we have a miss in the DM cache, this will be used for creating the DM cache entry.
+    // Input files that were identified by their git blob ID (and thus not read) have not been
+    // checked for time macros yet. That check is deferred until we create a direct mode entry.
+    string_list_t unscanned_input_files;
+    const auto direct_hash = get_direct_hash(hasher, unscanned_input_files);
+    if (!direct_hash.empty()) {
+      // Look up the hash in the cache.
+      if (m_cache.lookup_direct(direct_hash,
+                                expected_files,
+                                m_active_capabilities.hard_links(),
+                                m_active_capabilities.create_target_dirs(),
+                                return_code)) {
+        return true;
       }
     }
 
     // Hash the preprocessed file contents.
-    PERF_START(PREPROCESS);
-    hasher.update(preprocess_source());
-    PERF_STOP(PREPROCESS);
+    hash_preprocessed_source(hasher);
 
     // Finalize the hash.
     const auto hash = hasher.final().as_string();
@@ -163,7 +185,7 @@ bool program_wrapper_t::handle_command(int& return_code) {
                        m_active_capabilities.hard_links(),
                        m_active_capabilities.create_target_dirs(),
                        return_code)) {
-      if (!direct_hash.empty()) {
+      if (!direct_hash.empty() && !has_disqualifying_time_macros(unscanned_input_files)) {
         // Add a direct mode cache entry.
         m_cache.add_direct(direct_hash, hash, get_implicit_input_files());
       }
@@ -174,6 +196,18 @@ bool program_wrapper_t::handle_command(int& return_code) {
 
     debug::log(debug::INFO) << "Cache miss (" << hash << ")";
 
+    // Identical retries of a recently failed compilation fail instantly with the same diagnostics.
+    if (config::failure_ttl() > 0) {
+      try {
+        if (replay_cached_failure(hash, expected_files, return_code)) {
+          debug::log(debug::INFO) << "Cached failure (" << hash << ")";
+          return true;
+        }
+      } catch (const std::exception& e) {
+        debug::log(debug::DEBUG) << "Failed to replay the failure: " << e.what();
+      }
+    }
+
     // If the "terminate on a miss" mode is enabled and we didn't find an entry in the cache, we
     // exit with an error code.
     if (config::terminate_on_miss()) {
@@ -188,14 +222,36 @@ bool program_wrapper_t::handle_command(int& return_code) {
 
     // Run the actual program command to produce the build file(s).
     PERF_START(RUN_FOR_MISS);
-    const auto result = run_for_miss();
+    const auto run_start_t = std::chrono::steady_clock::now();
+    sys::run_result_t result;
+    if (!run_offloaded(program_id, expected_files, result)) {
+      result = run_for_miss();
+    }
+    const auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 std::chrono::steady_clock::now() - run_start_t)
+                                 .count();
     PERF_STOP(RUN_FOR_MISS);
 
+    // Remember the run time, so that it can be reported by later estimates (see estimate()). In
+    // read-only mode nothing is written to the local cache directory.
+    if (!config::read_only()) {
+      try {
+        data_store_t(DURATION_CACHE_NAME)
+            .store_item(get_command_key(program_id),
+                        std::to_string(duration_ms),
+                        DURATION_CACHE_LIFE_TIME);
+      } catch (const std::exception& e) {
+        debug::log(debug::DEBUG) << "Failed to store the run time: " << e.what();
+      }
+    }
+
     // Extract only the file ID:s (and filter out missing optional files).
     std::vector<std::string> file_ids;
     for (const auto& file : expected_files) {
       const auto& expected_file = file.second;
-      if (expected_file.required() || file::file_exists(expected_file.path())) {
+      const auto exists = expected_file.is_dir() ? file::dir_exists(expected_file.path())
+                                                 : file::file_exists(expected_file.path());
+      if (expected_file.required() || exists) {
         file_ids.emplace_back(file.first);
       }
     }
@@ -211,13 +267,18 @@ bool program_wrapper_t::handle_command(int& return_code) {
           config::compress() ? cache_entry_t::comp_mode_t::ALL : cache_entry_t::comp_mode_t::NONE,
           result.std_out,
           result.std_err,
-          result.return_code);
+          result.return_code,
+          toolchain_id,
+          static_cast<int64_t>(duration_ms));
       m_cache.add(hash, entry, expected_files, m_active_capabilities.hard_links());
 
-      if (!direct_hash.empty()) {
+      if (!direct_hash.empty() && !has_disqualifying_time_macros(unscanned_input_files)) {
         // Add a direct mode cache entry.
         m_cache.add_direct(direct_hash, hash, get_implicit_input_files());
       }
+    } else if (result.return_code != 0 && config::failure_ttl() > 0 && !config::read_only()) {
+      // Failures are only remembered locally and for a short while (see BUILDCACHE_FAILURE_TTL).
+      store_failure(hash, result);
     }
 
     // Everything's ok!
@@ -235,6 +296,162 @@ bool program_wrapper_t::handle_command(int& return_code) {
   return false;
 }
 
+program_wrapper_t::estimate_t program_wrapper_t::estimate() {
+  estimate_t result;
+
+  resolve_args();
+  m_active_capabilities = capabilities_t(get_capabilities());
+
+  std::string program_id;
+  auto hasher = hash_program_and_arguments(program_id);
+
+  // Prefer a direct mode lookup, since it does not require running the preprocessor.
+  std::string hash;
+  string_list_t unscanned_input_files;
+  const auto direct_hash = get_direct_hash(hasher, unscanned_input_files);
+  if (!direct_hash.empty()) {
+    hash = m_cache.peek_direct(direct_hash);
+    if (!hash.empty()) {
+      result.tier = "direct";
+    }
+  }
+  if (hash.empty()) {
+    hash_preprocessed_source(hasher);
+    hash = hasher.final().as_string();
+    result.tier = "local";
+  }
+
+  // Check for a matching entry in the local cache.
+  const auto entry = m_cache.peek_local(hash);
+  result.is_hit = static_cast<bool>(entry);
+  if (result.is_hit && entry.duration_ms() > 0) {
+    result.duration_ms = entry.duration_ms();
+  } else {
+    // Fall back to the run time of the last miss for this command, if any.
+    const auto item = data_store_t(DURATION_CACHE_NAME).get_item(get_command_key(program_id));
+    if (item.is_valid()) {
+      result.duration_ms = std::stoll(item.value());
+    }
+  }
+  if (!result.is_hit) {
+    result.tier.clear();
+  }
+
+  debug::log(debug::INFO) << "Estimate (" << hash << "): " << (result.is_hit ? "hit" : "miss");
+  return result;
+}
+
+hasher_t program_wrapper_t::hash_program_and_arguments(std::string& program_id) {
+  // Start a hash.
+  hasher_t hasher;
+
+  // Add additional file contents to the resulting hash.
+  PERF_START(HASH_EXTRA_FILES);
+  for (const auto& extra_file : bcache::config::hash_extra_files()) {
+    hasher.update_from_file(extra_file);
+  }
+  PERF_STOP(HASH_EXTRA_FILES);
+
+  // Hash the program identification (version string or similar).
+  PERF_START(GET_PRG_ID);
+  program_id = get_program_id_cached();
+  hasher.update(program_id);
+  PERF_STOP(GET_PRG_ID);
+
+  // Hash the (filtered) command line flags and environment variables.
+  PERF_START(FILTER_ARGS);
+  hasher.update(get_relevant_arguments());
+  hasher.update(get_relevant_env_vars());
+  PERF_STOP(FILTER_ARGS);
+
+  return hasher;
+}
+
+std::string program_wrapper_t::get_direct_hash(const hasher_t& hasher,
+                                               string_list_t& unscanned_input_files) {
+  if (!m_active_capabilities.direct_mode()) {
+    return std::string();
+  }
+
+  try {
+    const auto input_files = get_input_files();
+    if (input_files.size() == 0) {
+      return std::string();
+    }
+
+    // The hash so far is common for direct mode and preprocessor mode. Make a copy and inject a
+    // separator sequence to ensure that there can not be any collisions between direct mode and
+    // preprocessor mode hashes.
+    hasher_t dm_hasher = hasher;
+    dm_hasher.inject_separator();
+
+    // Hash the complete command line, as we need things like defines that are usually filtered by
+    // get_relevant_arguments().
+    dm_hasher.update(m_args);
+
+    // Hash all the input files.
+    PERF_START(HASH_INPUT_FILES);
+    bool has_time_macros = false;
+    for (const auto& file : input_files) {
+      // Hash the complete source file path. This ensures that we get different direct mode cache
+      // entries for different source paths, which should minimize cache thrashing when different
+      // work folders are used (e.g. in a CI system with several concurrent executors).
+      dm_hasher.update(file::resolve_path(file));
+      dm_hasher.inject_separator();
+
+      // Hash the source file content, and check it for disqualifying content (e.g. __TIME__ in
+      // C/C++ files).
+      const auto blob_digest =
+          config::git_index() ? git::get_clean_blob_digest(file) : std::string();
+      if (!blob_digest.empty()) {
+        dm_hasher.update(blob_digest);
+        dm_hasher.inject_separator();
+        unscanned_input_files += file;
+      } else if (dm_hasher.update_from_file_with_time_macro_check(file)) {
+        has_time_macros = true;
+      }
+    }
+    PERF_STOP(HASH_INPUT_FILES);
+
+    if (has_time_macros && config::accuracy() != config::cache_accuracy_t::SLOPPY) {
+      debug::log(debug::INFO) << "Direct mode disabled: Found time macros in input files";
+      return std::string();
+    }
+
+    return dm_hasher.final().as_string();
+  } catch (const std::runtime_error& e) {
+    // This can happen if one of the input files are missing, for instance.
+    debug::log(debug::ERROR) << "Direct mode hashing failed: " << e.what();
+  }
+
+  return std::string();
+}
+
+void program_wrapper_t::hash_preprocessed_source(hasher_t& hasher) {
+  PERF_SCOPE(PREPROCESS);
+  const auto preprocessed_source = preprocess_source();
+  if (config::tree_hash() && preprocessed_source.size() >= sys::TREE_HASH_MIN_SIZE) {
+    // Hash large inputs in parallel. Since this changes the cache key, the tree hash format
+    // version is part of the hash.
+    hasher.update(sys::TREE_HASH_VERSION);
+    hasher.update(sys::tree_hash(preprocessed_source).as_string());
+  } else {
+    hasher.update(preprocessed_source);
+  }
+}
+
+std::string program_wrapper_t::get_command_key(const std::string& program_id) const {
+  // Identify the command by the program, the complete command line and the working directory. This
+  // is cheap to compute (no files are read), which is what we want for run time bookkeeping.
+  hasher_t hasher;
+  hasher.update(program_id);
+  hasher.inject_separator();
+  hasher.update(m_args);
+  hasher.inject_separator();
+  hasher.update(file::get_cwd());
+  return hasher.final().as_string();
+}
+
 //--------------------------------------------------------------------------------------------------
 // Default wrapper interface implementation. Wrappers are expected to override the parts that are
 // relevant.
@@ -258,7 +475,13 @@ std::map<std::string, expected_file_t> program_wrapper_t::get_build_files() {
 }
 
 std::string program_wrapper_t::get_program_id() {
-  // Default: The hash of the program binary serves as the program identification.
+  // Default: The build ID of the program binary serves as the program identification, if available.
+  const auto build_id = elf::get_build_id(m_exe_path.real_path());
+  if (!build_id.empty()) {
+    return "build-id:" + build_id;
+  }
+
+  // ...otherwise the hash of the program binary serves as the program identification.
   hasher_t hasher;
   hasher.update_from_file(m_exe_path.real_path());
   return hasher.final().as_string();
@@ -297,6 +520,54 @@ sys::run_result_t program_wrapper_t::run_for_miss() {
   return sys::run_with_prefix(m_unresolved_args, false);
 }
 
+bool program_wrapper_t::get_offload_job(offload::job_t& job) {
+  // Default: The command can not be offloaded.
+  (void)job;
+  return false;
+}
+
+std::string program_wrapper_t::get_program_identity() {
+  resolve_args();
+  return get_program_id_cached();
+}
+
+bool program_wrapper_t::run_offloaded(const std::string& program_id,
+                                      const std::map<std::string, expected_file_t>& expected_files,
+                                      sys::run_result_t& result) {
+  if (config::offload().empty()) {
+    return false;
+  }
+  offload::job_t job;
+  if (!get_offload_job(job)) {
+    debug::log(debug::DEBUG) << "The command can not be offloaded";
+    return false;
+  }
+  job.program_id = program_id;
+  offload::result_t offload_result;
+  if (!offload::run_job(job, offload_result)) {
+    return false;
+  }
+  debug::log(debug::INFO) << "Offloaded the command to " << config::offload();
+
+  // Write the build files to their expected locations.
+  for (const auto& file : offload_result.build_files) {
+    const auto it = expected_files.find(file.first);
+    if (it != expected_files.end()) {
+      const auto& path = it->second.path();
+      if (m_active_capabilities.create_target_dirs()) {
+        file::create_dir_with_parents(file::get_dir_part(path));
+      }
+      file::write_atomic(file.second, path);
+    }
+  }
+
+  // Reproduce the program output, as if the command had been run locally.
+  result = offload_result.run_result;
+  sys::print_raw_stdout(result.std_out);
+  sys::print_raw_stderr(result.std_err);
+  return true;
+}
+
 std::string program_wrapper_t::get_program_id_cached() {
   try {
     // Get an ID of the program executable, based on its path, size and modification time.
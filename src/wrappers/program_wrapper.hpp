@@ -21,11 +21,14 @@
 #define BUILDCACHE_PROGRAM_WRAPPER_HPP_
 
 #include <base/file_utils.hpp>
+#include <base/hasher.hpp>
 #include <base/string_list.hpp>
 #include <cache/cache.hpp>
 #include <cache/expected_file.hpp>
+#include <sys/offload.hpp>
 #include <sys/sys_utils.hpp>
 
+#include <cstdint>
 #include <string>
 
 namespace bcache {
@@ -37,6 +40,13 @@ namespace bcache {
 /// This class also implements the entire program wrapping mechanism, with cache lookups etc.
 class program_wrapper_t {
 public:
+  /// @brief The result of a cache hit estimate.
+  struct estimate_t {
+    bool is_hit = false;       ///< True if the command would most likely be a cache hit.
+    std::string tier;          ///< The cache tier that would be hit ("direct" or "local").
+    int64_t duration_ms = -1;  ///< Historical run time of the command (-1 if unknown).
+  };
+
   virtual ~program_wrapper_t() = default;
 
   /// @brief Try to wrap a program command.
@@ -44,10 +54,25 @@ public:
   /// @returns true if the command was recognized and handled.
   bool handle_command(int& return_code);
 
+  /// @brief Estimate if a program command would be a cache hit.
+  ///
+  /// This performs the same key computation as @c handle_command, but only looks in the local
+  /// cache, and neither runs the command, retrieves any cached files nor updates the statistics.
+  /// @returns the estimate.
+  /// @throws runtime_error if the command could not be handled by this wrapper.
+  estimate_t estimate();
+
   /// @brief Check if this class implements a wrapper for the given command.
   /// @returns true if this wrapper can handle the command.
   virtual bool can_handle_command() = 0;
 
+  /// @brief Get the program ID of the wrapped program.
+  ///
+  /// This is used by offload workers for checking that they run the same program as the client.
+  /// @returns the program ID (the same ID that is used for the cache lookups).
+  /// @throws runtime_error if the program could not be identified.
+  std::string get_program_identity();
+
 protected:
   /// @brief A helper class for managing wrapper capabilities.
   class capabilities_t {
@@ -164,6 +189,16 @@ protected:
   /// @returns the run result for the child process.
   virtual sys::run_result_t run_for_miss();
 
+  /// @brief Create a job for running the command on an offload worker (when there is a cache miss).
+  ///
+  /// The job must be self contained, i.e. it must not depend on any files other than the source
+  /// file that is sent with the job. The program ID of the job is filled out by the caller.
+  /// @param[out] job The offload job.
+  /// @returns true if the command can be offloaded.
+  /// @throws runtime_error if the request could not be completed.
+  /// @note The @c preprocess_source method has been called before calling this method.
+  virtual bool get_offload_job(offload::job_t& job);
+
   const file::exe_path_t& m_exe_path;
   const string_list_t& m_unresolved_args;
   string_list_t m_args;
@@ -176,6 +211,13 @@ protected:
 
 private:
   std::string get_program_id_cached();
+  hasher_t hash_program_and_arguments(std::string& program_id);
+  std::string get_direct_hash(const hasher_t& hasher, string_list_t& unscanned_input_files);
+  void hash_preprocessed_source(hasher_t& hasher);
+  std::string get_command_key(const std::string& program_id) const;
+  bool run_offloaded(const std::string& program_id,
+                     const std::map<std::string, expected_file_t>& expected_files,
+                     sys::run_result_t& result);
 
   cache_t m_cache;
 };
@@ -20,6 +20,7 @@
 #include <wrappers/ti_common_wrapper.hpp>
 
 #include <base/debug_utils.hpp>
+#include <base/elf_utils.hpp>
 #include <base/file_utils.hpp>
 #include <base/hasher.hpp>
 #include <base/unicode_utils.hpp>
@@ -190,7 +191,11 @@ std::map<std::string, expected_file_t> ti_common_wrapper_t::get_build_files() {
 }
 
 std::string ti_common_wrapper_t::get_program_id() {
-  // TODO(m): Add things like executable file size too.
+  // Use the build ID of the compiler binary, if available (this avoids running the compiler).
+  const auto build_id = elf::get_build_id(m_exe_path.real_path());
+  if (!build_id.empty()) {
+    return "build-id:" + build_id;
+  }
 
   // Get the help string from the compiler (it includes the version string).
   string_list_t version_args;
@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""A minimal stand-in for an HTTP (WebDAV) or S3 remote cache server, for testing.
+
+The server keeps all objects in memory and supports the requests that BuildCache uses:
+GET, PUT, DELETE, PROPFIND (Depth: 1) and paginated ListObjectsV2. No authentication is
+performed.
+
+It can be run stand-alone (e.g. "remote_cache_test_server.py 8080") or be used from a
+test script.
+"""
+
+import argparse
+import email.utils
+import http.server
+import socketserver
+import threading
+import time
+import urllib.parse
+
+# Use small pages for ListObjectsV2, so that the pagination is exercised.
+_LIST_PAGE_SIZE = 2
+
+
+class _RequestHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, format, *args):
+        if self.server.verbose:
+            super().log_message(format, *args)
+
+    def _reply(self, code, body=b""):
+        self.send_response(code)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def _read_body(self):
+        return self.rfile.read(int(self.headers.get("Content-Length", 0)))
+
+    def _list_objects_v2(self, bucket_path, query):
+        query_prefix = query.get("prefix", [""])[0]
+        prefix = bucket_path.rstrip("/") + "/" + query_prefix
+        with self.server.lock:
+            keys = sorted(k for k in self.server.objects if k.startswith(prefix))
+            start = int(query.get("continuation-token", ["0"])[0])
+            page_keys = keys[start : start + _LIST_PAGE_SIZE]
+            page = [(k, self.server.objects[k]) for k in page_keys]
+        is_truncated = start + _LIST_PAGE_SIZE < len(keys)
+
+        xml = '<?xml version="1.0" encoding="UTF-8"?>'
+        xml += '<ListBucketResult xmlns="http://s3.amazonaws.com/doc/2006-03-01/">'
+        for key, (data, modify_time) in page:
+            date = time.strftime("%Y-%m-%dT%H:%M:%S.000Z", time.gmtime(modify_time))
+            xml += "<Contents><Key>%s</Key>" % key[len(prefix) - len(query_prefix) :]
+            xml += "<LastModified>%s</LastModified>" % date
+            xml += "<Size>%d</Size></Contents>" % len(data)
+        xml += "<IsTruncated>%s</IsTruncated>" % ("true" if is_truncated else "false")
+        if is_truncated:
+            next_token = start + _LIST_PAGE_SIZE
+            xml += "<NextContinuationToken>%d</NextContinuationToken>" % next_token
+        xml += "</ListBucketResult>"
+        self._reply(200, xml.encode())
+
+    def do_GET(self):
+        url = urllib.parse.urlparse(self.path)
+        query = urllib.parse.parse_qs(url.query)
+        if query.get("list-type") == ["2"]:
+            return self._list_objects_v2(url.path, query)
+        with self.server.lock:
+            obj = self.server.objects.get(url.path)
+        if obj is None:
+            self._reply(404)
+        else:
+            self._reply(200, obj[0])
+
+    def do_PUT(self):
+        data = self._read_body()
+        self.server.put_object(self.path, data)
+        self._reply(201)
+
+    def do_DELETE(self):
+        with self.server.lock:
+            found = self.server.objects.pop(self.path, None) is not None
+        self._reply(204 if found else 404)
+
+    def do_PROPFIND(self):
+        self._read_body()
+        base = self.path.rstrip("/") + "/"
+        xml = '<?xml version="1.0" encoding="utf-8"?><D:multistatus xmlns:D="DAV:">'
+        xml += "<D:response><D:href>%s</D:href><D:propstat><D:prop>" % base
+        xml += "<D:resourcetype><D:collection/></D:resourcetype>"
+        xml += "</D:prop></D:propstat></D:response>"
+        with self.server.lock:
+            objects = list(self.server.objects.items())
+        for path, (data, modify_time) in objects:
+            if path.startswith(base) and "/" not in path[len(base) :]:
+                xml += "<D:response><D:href>%s</D:href><D:propstat><D:prop>" % path
+                xml += "<D:getcontentlength>%d</D:getcontentlength>" % len(data)
+                date = email.utils.formatdate(modify_time, usegmt=True)
+                xml += "<D:getlastmodified>%s</D:getlastmodified>" % date
+                xml += "</D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat>"
+                xml += "</D:response>"
+        xml += "</D:multistatus>"
+        self._reply(207, xml.encode())
+
+
+class RemoteCacheTestServer(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    """An in-memory remote cache server.
+
+    Port 0 selects a free port (see the port attribute).
+    """
+
+    daemon_threads = True
+
+    def __init__(self, port=0, verbose=False):
+        super().__init__(("127.0.0.1", port), _RequestHandler)
+        self.verbose = verbose
+        self.lock = threading.Lock()
+        self.objects = {}  # URL path -> (data, modify time)
+
+    @property
+    def port(self):
+        return self.server_address[1]
+
+    def put_object(self, path, data, modify_time=None):
+        with self.lock:
+            if modify_time is None:
+                modify_time = time.time()
+            self.objects[path] = (data, modify_time)
+
+    def object_paths(self):
+        with self.lock:
+            return sorted(self.objects.keys())
+
+    def start(self):
+        thread = threading.Thread(target=self.serve_forever, daemon=True)
+        thread.start()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Run a stand-in remote cache server.")
+    parser.add_argument("port", type=int, help="the port to listen on (on 127.0.0.1)")
+    args = parser.parse_args()
+    server = RemoteCacheTestServer(args.port, verbose=True)
+    print(f"Listening on http://127.0.0.1:{server.port}")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""Test "buildcache --remote-gc" against a local stand-in remote cache server.
+
+Usage: run_remote_gc_test.py [path/to/buildcache]
+"""
+
+import os
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+
+# Do not leave a __pycache__ folder in the source tree.
+sys.dont_write_bytecode = True
+from remote_cache_test_server import RemoteCacheTestServer  # noqa: E402
+
+_DAY = 24 * 60 * 60
+
+
+def populate(server, base_path):
+    # Three cache entries: one old and two recent (the older of which is the biggest).
+    now = time.time()
+    entries = [
+        ("old", now - 10 * _DAY, 100),
+        ("big", now - _DAY, 1000),
+        ("new", now, 100),
+    ]
+    for name, modify_time, size in entries:
+        for file_name in (".entry", "obj", "dep"):
+            path = f"{base_path}/buildcache_{name}_{file_name}"
+            server.put_object(path, b"x" * size, modify_time)
+
+    # Objects that are not BuildCache entries must be left alone.
+    server.put_object(f"{base_path}/unrelated.txt", b"Hello", now - 10 * _DAY)
+
+
+def remaining_entries(server, base_path):
+    names = set()
+    for path in server.object_paths():
+        if not path.startswith(base_path + "/"):
+            continue
+        key = path[len(base_path) + 1 :]
+        names.add(key.split("_")[1] if key.startswith("buildcache_") else key)
+    return sorted(names)
+
+
+def run_gc(buildcache_exe, remote, max_age, max_size):
+    with tempfile.TemporaryDirectory() as cache_dir:
+        env = dict(os.environ)
+        env["BUILDCACHE_DIR"] = cache_dir
+        env["BUILDCACHE_REMOTE"] = remote
+        env["BUILDCACHE_REMOTE_MAX_AGE"] = str(max_age)
+        env["BUILDCACHE_REMOTE_MAX_SIZE"] = str(max_size)
+        env["BUILDCACHE_S3_ACCESS"] = "test-access"
+        env["BUILDCACHE_S3_SECRET"] = "test-secret"
+        proc = subprocess.run(
+            [buildcache_exe, "--remote-gc"],
+            env=env,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.STDOUT,
+            encoding="utf-8",
+        )
+    print(proc.stdout.strip())
+    if proc.returncode != 0:
+        raise RuntimeError(f"buildcache --remote-gc failed ({proc.returncode})")
+
+
+def check(description, actual, expected):
+    if actual != expected:
+        print(f"*** FAIL: {description}: got {actual}, expected {expected}")
+        return False
+    print(f"OK: {description}")
+    return True
+
+
+def test_remote(buildcache_exe, server, protocol):
+    base_path = f"/{protocol}-cache"
+    remote = f"{protocol}://127.0.0.1:{server.port}{base_path}"
+    populate(server, base_path)
+    success = True
+
+    # Remove entries that are older than two days.
+    run_gc(buildcache_exe, remote, 2 * _DAY, 0)
+    success &= check(
+        f"{protocol}: max age",
+        remaining_entries(server, base_path),
+        ["big", "new", "unrelated.txt"],
+    )
+
+    # Remove the oldest entries until the cache is small enough.
+    run_gc(buildcache_exe, remote, 0, 1000)
+    success &= check(
+        f"{protocol}: max size",
+        remaining_entries(server, base_path),
+        ["new", "unrelated.txt"],
+    )
+    return success
+
+
+def main():
+    if len(sys.argv) > 1:
+        buildcache_exe = sys.argv[1]
+    else:
+        buildcache_exe = str(Path.cwd() / "buildcache")
+    server = RemoteCacheTestServer()
+    server.start()
+    try:
+        success = True
+        for protocol in ("http", "s3"):
+            success &= test_remote(buildcache_exe, server, protocol)
+    finally:
+        server.shutdown()
+    return 0 if success else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())